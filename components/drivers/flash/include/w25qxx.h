@@ -25,6 +25,7 @@
 #define w25qxx_FLASH_SECTOR_SIZE            4096
 #define w25qxx_FLASH_PAGE_NUM_PER_SECTOR    16
 #define w25qxx_FLASH_CHIP_SIZE              (16777216 UL)
+#define W25QXX_CACHE_LINES                  2
 
 #define WRITE_ENABLE                        0x06
 #define WRITE_DISABLE                       0x04
@@ -85,6 +86,17 @@ typedef enum _w25qxx_read
     W25QXX_QUAD_FAST,
 } w25qxx_read_t;
 
+/**
+ * @brief      write-back cache counters, for wear monitoring
+ */
+typedef struct _w25qxx_cache_stats
+{
+    uint32_t writes;         /* sector-sized pieces written into the cache */
+    uint32_t erase_requests; /* w25qxx_cache_erase_sector calls */
+    uint32_t erases;         /* sector erases sent to the chip */
+    uint32_t page_programs;
+} w25qxx_cache_stats_t;
+
 w25qxx_status_t w25qxx_init_dma(uint8_t spi_index, uint8_t spi_ss);
 w25qxx_status_t w25qxx_is_busy_dma(void);
 w25qxx_status_t w25qxx_chip_erase_dma(void);
@@ -105,5 +117,12 @@ w25qxx_status_t w25qxx_write_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t
 w25qxx_status_t w25qxx_write_data_direct_dma(uint32_t addr, uint8_t *data_buf, uint32_t length);
 w25qxx_status_t w25qxx_read_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t length, w25qxx_read_t mode);
 
+/* writes and erases stay in RAM until w25qxx_cache_sync() or eviction, reads see them */
+w25qxx_status_t w25qxx_cache_write(uint32_t addr, uint8_t *data_buf, uint32_t length);
+w25qxx_status_t w25qxx_cache_read(uint32_t addr, uint8_t *data_buf, uint32_t length);
+w25qxx_status_t w25qxx_cache_erase_sector(uint32_t addr);
+w25qxx_status_t w25qxx_cache_sync(void);
+void w25qxx_cache_get_stats(w25qxx_cache_stats_t *stats);
+
 #endif
 
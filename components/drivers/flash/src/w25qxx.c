@@ -18,6 +18,9 @@
 #include "sysctl.h"
 #include "dmac.h"
 #include "sipeed_spi.h"
+#include "sdcard.h"
+#include <string.h>
+#include <stdbool.h>
 uint32_t spi_bus_no = 0;
 uint32_t spi_chip_select = 0;
 
@@ -28,30 +31,40 @@ static w25qxx_status_t w25qxx_quad_read_data_dma(uint32_t addr, uint8_t *data_bu
 
 static w25qxx_status_t w25qxx_page_program_dma(uint32_t addr, uint8_t *data_buf, uint32_t length);
 static w25qxx_status_t w25qxx_quad_page_program_dma(uint32_t addr, uint8_t *data_buf, uint32_t length);
+static void w25qxx_cache_drop(uint32_t addr, uint32_t length);
 
+// DMAC_CHANNEL0/1 are the SD card's too, see sd_dma_lock()
 static w25qxx_status_t w25qxx_receive_data_dma(uint8_t *cmd_buff, uint8_t cmd_len, uint8_t *rx_buff, uint32_t rx_len)
 {
+    sd_dma_lock();
     sipeed_spi_init(spi_bus_no, SPI_WORK_MODE_0, SPI_FF_STANDARD, DATALENGTH, 0);
     sipeed_spi_receive_data_standard_dma(DMAC_CHANNEL0, DMAC_CHANNEL1, spi_bus_no, spi_chip_select, cmd_buff, cmd_len, rx_buff, rx_len);
+    sd_dma_unlock();
     return W25QXX_OK;
 }
 
 static w25qxx_status_t w25qxx_send_data_dma(uint8_t *cmd_buff, uint8_t cmd_len, uint8_t *tx_buff, uint32_t tx_len)
 {
+    sd_dma_lock();
     sipeed_spi_init(spi_bus_no, SPI_WORK_MODE_0, SPI_FF_STANDARD, DATALENGTH, 0);
     sipeed_spi_send_data_standard_dma(DMAC_CHANNEL0, spi_bus_no, spi_chip_select, cmd_buff, cmd_len, tx_buff, tx_len);
+    sd_dma_unlock();
     return W25QXX_OK;
 }
 
 static w25qxx_status_t w25qxx_receive_data_enhanced_dma(uint32_t *cmd_buff, uint8_t cmd_len, uint8_t *rx_buff, uint32_t rx_len)
 {
+    sd_dma_lock();
     sipeed_spi_receive_data_multiple_dma(DMAC_CHANNEL0, DMAC_CHANNEL1, spi_bus_no, spi_chip_select, cmd_buff, cmd_len, rx_buff, rx_len);
+    sd_dma_unlock();
     return W25QXX_OK;
 }
 
 static w25qxx_status_t w25qxx_send_data_enhanced_dma(uint32_t *cmd_buff, uint8_t cmd_len, uint8_t *tx_buff, uint32_t tx_len)
 {
+    sd_dma_lock();
     sipeed_spi_send_data_multiple_dma(DMAC_CHANNEL0, spi_bus_no, spi_chip_select, cmd_buff, cmd_len, tx_buff, tx_len);
+    sd_dma_unlock();
     return W25QXX_OK;
 }
 
@@ -162,7 +175,7 @@ w25qxx_status_t w25qxx_is_busy_dma(void)
     return W25QXX_OK;
 }
 
-w25qxx_status_t w25qxx_sector_erase_dma(uint32_t addr)
+static w25qxx_status_t w25qxx_sector_erase_nocache(uint32_t addr)
 {
     uint8_t cmd[4] = {SECTOR_ERASE};
 
@@ -174,10 +187,17 @@ w25qxx_status_t w25qxx_sector_erase_dma(uint32_t addr)
     return W25QXX_OK;
 }
 
+w25qxx_status_t w25qxx_sector_erase_dma(uint32_t addr)
+{
+    w25qxx_cache_drop(addr & ~(w25qxx_FLASH_SECTOR_SIZE - 1), w25qxx_FLASH_SECTOR_SIZE);
+    return w25qxx_sector_erase_nocache(addr);
+}
+
 w25qxx_status_t w25qxx_32k_block_erase_dma(uint32_t addr)
 {
     uint8_t cmd[4] = {BLOCK_32K_ERASE};
 
+    w25qxx_cache_drop(addr & ~(0x8000 - 1), 0x8000);
     cmd[1] = (uint8_t)(addr >> 16);
     cmd[2] = (uint8_t)(addr >> 8);
     cmd[3] = (uint8_t)(addr);
@@ -190,6 +210,7 @@ w25qxx_status_t w25qxx_64k_block_erase_dma(uint32_t addr)
 {
     uint8_t cmd[4] = {BLOCK_64K_ERASE};
 
+    w25qxx_cache_drop(addr & ~(0x10000 - 1), 0x10000);
     cmd[1] = (uint8_t)(addr >> 16);
     cmd[2] = (uint8_t)(addr >> 8);
     cmd[3] = (uint8_t)(addr);
@@ -202,6 +223,7 @@ w25qxx_status_t w25qxx_chip_erase_dma(void)
 {
     uint8_t cmd[1] = {CHIP_ERASE};
 
+    w25qxx_cache_drop(0, 0xFFFFFFFF);
     w25qxx_write_enable_dma();
     w25qxx_send_data_dma(cmd, 1, 0, 0);
     return W25QXX_OK;
@@ -283,29 +305,103 @@ static w25qxx_status_t w25qxx_quad_page_program_dma(uint32_t addr, uint8_t *data
     return W25QXX_OK;
 }
 
-static w25qxx_status_t w25qxx_sector_program(uint32_t addr, uint8_t *data_buf)
+/*
+ * Write-back sector cache. Lines hold the wanted content of a sector; at flush the sector
+ * is only erased if some bit has to go from 0 to 1, otherwise just the changed pages are
+ * programmed. An erase followed by writes to the same sector costs a single erase.
+ */
+typedef struct
+{
+    uint32_t addr;
+    uint32_t stamp;
+    uint16_t dirty; /* one bit per page */
+    uint8_t valid;
+    uint8_t erase;
+} w25qxx_cache_line_t;
+
+static uint8_t w25qxx_cache_buf[W25QXX_CACHE_LINES][w25qxx_FLASH_SECTOR_SIZE] __attribute__((aligned(8)));
+static w25qxx_cache_line_t w25qxx_cache_lines[W25QXX_CACHE_LINES];
+static uint32_t w25qxx_cache_stamp = 0;
+static w25qxx_cache_stats_t w25qxx_stats = {0};
+
+static bool w25qxx_page_blank(const uint8_t *data)
+{
+    const uint32_t *p = (const uint32_t *)data;
+    for (uint32_t i = 0; i < w25qxx_FLASH_PAGE_SIZE / 4; i++)
+    {
+        if (p[i] != 0xFFFFFFFF)
+            return false;
+    }
+    return true;
+}
+
+static w25qxx_status_t w25qxx_cache_flush_line(w25qxx_cache_line_t *line, uint8_t *data)
 {
     uint8_t index = 0;
 
+    if (!line->valid || (!line->erase && !line->dirty))
+        return W25QXX_OK;
+    if (line->erase)
+    {
+        w25qxx_sector_erase_nocache(line->addr);
+        while (w25qxx_is_busy_dma() == W25QXX_BUSY)
+            ;
+        w25qxx_stats.erases++;
+    }
     for (index = 0; index < w25qxx_FLASH_PAGE_NUM_PER_SECTOR; index++)
     {
-        w25qxx_page_program_fun(addr, data_buf, w25qxx_FLASH_PAGE_SIZE);
-        addr += w25qxx_FLASH_PAGE_SIZE;
-        data_buf += w25qxx_FLASH_PAGE_SIZE;
+        uint8_t *page = data + index * w25qxx_FLASH_PAGE_SIZE;
+        if (line->erase ? w25qxx_page_blank(page) : !(line->dirty & (1 << index)))
+            continue;
+        w25qxx_page_program_fun(line->addr + index * w25qxx_FLASH_PAGE_SIZE, page, w25qxx_FLASH_PAGE_SIZE);
+        w25qxx_stats.page_programs++;
     }
+    line->erase = 0;
+    line->dirty = 0;
     return W25QXX_OK;
 }
 
-w25qxx_status_t w25qxx_write_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t length)
+/* load: fill a newly taken line from flash, otherwise the caller overwrites all of it */
+static int w25qxx_cache_get(uint32_t sector_addr, bool load)
+{
+    int i, victim = 0;
+
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+    {
+        if (w25qxx_cache_lines[i].valid && w25qxx_cache_lines[i].addr == sector_addr)
+        {
+            w25qxx_cache_lines[i].stamp = ++w25qxx_cache_stamp;
+            return i;
+        }
+    }
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+    {
+        if (!w25qxx_cache_lines[i].valid)
+        {
+            victim = i;
+            break;
+        }
+        if (w25qxx_cache_lines[i].stamp < w25qxx_cache_lines[victim].stamp)
+            victim = i;
+    }
+    w25qxx_cache_flush_line(&w25qxx_cache_lines[victim], w25qxx_cache_buf[victim]);
+    if (load)
+        w25qxx_read_fun(sector_addr, w25qxx_cache_buf[victim], w25qxx_FLASH_SECTOR_SIZE);
+    w25qxx_cache_lines[victim].addr = sector_addr;
+    w25qxx_cache_lines[victim].stamp = ++w25qxx_cache_stamp;
+    w25qxx_cache_lines[victim].dirty = 0;
+    w25qxx_cache_lines[victim].erase = 0;
+    w25qxx_cache_lines[victim].valid = 1;
+    return victim;
+}
+
+w25qxx_status_t w25qxx_cache_write(uint32_t addr, uint8_t *data_buf, uint32_t length)
 {
     uint32_t sector_addr = 0;
     uint32_t sector_offset = 0;
     uint32_t sector_remain = 0;
     uint32_t write_len = 0;
     uint32_t index = 0;
-    uint8_t *pread = NULL;
-    uint8_t *pwrite = NULL;
-    uint8_t swap_buf[w25qxx_FLASH_SECTOR_SIZE] = {0};
 
     while (length)
     {
@@ -313,33 +409,19 @@ w25qxx_status_t w25qxx_write_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t
         sector_offset = addr & (w25qxx_FLASH_SECTOR_SIZE - 1);
         sector_remain = w25qxx_FLASH_SECTOR_SIZE - sector_offset;
         write_len = ((length < sector_remain) ? length : sector_remain);
-        w25qxx_read_fun(sector_addr, swap_buf, w25qxx_FLASH_SECTOR_SIZE);
-        pread = swap_buf + sector_offset;
-        pwrite = data_buf;
+        int i = w25qxx_cache_get(sector_addr, true);
+        w25qxx_cache_line_t *line = &w25qxx_cache_lines[i];
+        uint8_t *pcache = w25qxx_cache_buf[i] + sector_offset;
         for (index = 0; index < write_len; index++)
         {
-            if ((*pwrite) != ((*pwrite) & (*pread)))
-            {
-                w25qxx_sector_erase_dma(sector_addr);
-                while (w25qxx_is_busy_dma() == W25QXX_BUSY)
-                    ;
-                break;
-            }
-            pwrite++;
-            pread++;
-        }
-        if (write_len == w25qxx_FLASH_SECTOR_SIZE)
-        {
-            w25qxx_sector_program(sector_addr, data_buf);
-        }
-        else
-        {
-            pread = swap_buf + sector_offset;
-            pwrite = data_buf;
-            for (index = 0; index < write_len; index++)
-                *pread++ = *pwrite++;
-            w25qxx_sector_program(sector_addr, swap_buf);
+            if (pcache[index] == data_buf[index])
+                continue;
+            if (data_buf[index] & ~pcache[index])
+                line->erase = 1;
+            line->dirty |= 1 << ((sector_offset + index) / w25qxx_FLASH_PAGE_SIZE);
+            pcache[index] = data_buf[index];
         }
+        w25qxx_stats.writes++;
         length -= write_len;
         addr += write_len;
         data_buf += write_len;
@@ -347,11 +429,110 @@ w25qxx_status_t w25qxx_write_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t
     return W25QXX_OK;
 }
 
+w25qxx_status_t w25qxx_cache_read(uint32_t addr, uint8_t *data_buf, uint32_t length)
+{
+    uint32_t i = 0;
+
+    w25qxx_read_fun(addr, data_buf, length);
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+    {
+        w25qxx_cache_line_t *line = &w25qxx_cache_lines[i];
+        if (!line->valid || (!line->erase && !line->dirty))
+            continue;
+        uint32_t start = line->addr > addr ? line->addr : addr;
+        uint32_t end = line->addr + w25qxx_FLASH_SECTOR_SIZE;
+        if (end > addr + length)
+            end = addr + length;
+        if (start < end)
+            memcpy(data_buf + (start - addr), w25qxx_cache_buf[i] + (start - line->addr), end - start);
+    }
+    return W25QXX_OK;
+}
+
+w25qxx_status_t w25qxx_cache_erase_sector(uint32_t addr)
+{
+    uint32_t sector_addr = addr & (~(w25qxx_FLASH_SECTOR_SIZE - 1));
+    int i = w25qxx_cache_get(sector_addr, true);
+    w25qxx_cache_line_t *line = &w25qxx_cache_lines[i];
+    uint8_t *data = w25qxx_cache_buf[i];
+    uint32_t index = 0;
+
+    w25qxx_stats.erase_requests++;
+    if (!line->erase)
+    {
+        /* the flash copy is still the loaded one, a blank sector needs no erase */
+        for (index = 0; index < w25qxx_FLASH_PAGE_NUM_PER_SECTOR; index++)
+        {
+            if (!w25qxx_page_blank(data + index * w25qxx_FLASH_PAGE_SIZE))
+                break;
+        }
+        if (index == w25qxx_FLASH_PAGE_NUM_PER_SECTOR && !line->dirty)
+            return W25QXX_OK;
+    }
+    memset(data, 0xFF, w25qxx_FLASH_SECTOR_SIZE);
+    line->erase = 1;
+    line->dirty = 0;
+    return W25QXX_OK;
+}
+
+w25qxx_status_t w25qxx_cache_sync(void)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+        w25qxx_cache_flush_line(&w25qxx_cache_lines[i], w25qxx_cache_buf[i]);
+    return W25QXX_OK;
+}
+
+static bool w25qxx_cache_overlaps(w25qxx_cache_line_t *line, uint32_t addr, uint32_t length)
+{
+    return line->valid && line->addr + w25qxx_FLASH_SECTOR_SIZE > addr && line->addr < (uint64_t)addr + length;
+}
+
+/* an erase wiped whole sectors behind the cache, what their lines held is gone either way */
+static void w25qxx_cache_drop(uint32_t addr, uint32_t length)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+    {
+        if (w25qxx_cache_overlaps(&w25qxx_cache_lines[i], addr, length))
+            w25qxx_cache_lines[i].valid = 0;
+    }
+}
+
+/* a direct program only covers part of the sectors, the rest of a dirty line is written first */
+static void w25qxx_cache_evict(uint32_t addr, uint32_t length)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < W25QXX_CACHE_LINES; i++)
+    {
+        w25qxx_cache_line_t *line = &w25qxx_cache_lines[i];
+        if (!w25qxx_cache_overlaps(line, addr, length))
+            continue;
+        w25qxx_cache_flush_line(line, w25qxx_cache_buf[i]);
+        line->valid = 0;
+    }
+}
+
+void w25qxx_cache_get_stats(w25qxx_cache_stats_t *stats)
+{
+    *stats = w25qxx_stats;
+}
+
+w25qxx_status_t w25qxx_write_data_dma(uint32_t addr, uint8_t *data_buf, uint32_t length)
+{
+    w25qxx_cache_write(addr, data_buf, length);
+    return w25qxx_cache_sync();
+}
+
 w25qxx_status_t w25qxx_write_data_direct_dma(uint32_t addr, uint8_t *data_buf, uint32_t length)
 {
     uint32_t page_remain = 0;
     uint32_t write_len = 0;
 
+    w25qxx_cache_evict(addr, length);
     while (length)
     {
         page_remain = w25qxx_FLASH_PAGE_SIZE - (addr & (w25qxx_FLASH_PAGE_SIZE - 1));
@@ -100,6 +100,12 @@ typedef enum _lcd_dir
     DIR_RGB2BRG = 0x08, // lcd_set_direction(DIR_YX_RLUD | DIR_RGB2BRG); // 0x28
 } lcd_dir_t;
 
+// draw_pic_async flags
+#define LCD_PIC_GRAY        (1 << 0) // img is 8 bit grayscale, else rgb565
+#define LCD_PIC_NATIVE      (1 << 1) // rgb565 img is in DVP u32 order
+#define LCD_PIC_BILINEAR    (1 << 2) // bilinear scaling, else nearest
+#define LCD_PIC_DIRTY       (1 << 3) // only send row bands changed since the last async picture
+
 //屏幕参数结构体
 typedef struct
 {	//基础参数
@@ -147,9 +153,13 @@ typedef struct
 	void (*draw_point)(uint16_t x, uint16_t y, uint16_t color); 
 	// void (*draw_string)(uint16_t x, uint16_t y, char *str, uint16_t color);
 	void (*draw_picture)(uint16_t x,uint16_t y,uint16_t w,uint16_t h,uint8_t *img);
+	void (*draw_picture_native)(uint16_t x,uint16_t y,uint16_t w,uint16_t h,uint8_t *img); // rgb565 in DVP u32 order, sent as is, optional
 	void (*draw_pic_roi)(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t rx, uint16_t ry, uint16_t rw, uint16_t rh, uint8_t *img);
 	void (*draw_pic_gray)(uint16_t x1, uint16_t y1, uint16_t w, uint16_t h, uint8_t *img);
 	void (*draw_pic_grayroi)(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t rx, uint16_t ry, uint16_t rw, uint16_t rh, uint8_t *img);
+	// scale roi of a w*h img to dw*dh at (x,y), start a DMA transfer and return, img may be reused right away, optional
+	int (*draw_pic_async)(uint16_t x, uint16_t y, uint16_t dw, uint16_t dh, uint16_t w, uint16_t h, uint16_t rx, uint16_t ry, uint16_t rw, uint16_t rh, uint8_t *img, uint32_t flags);
+	int (*wait_idle)(void); // wait for the async transfer, optional; 0, or -1 if it never finished
 	void (*fill_rectangle)(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t color);
 } lcd_t;
 
@@ -93,6 +93,8 @@ void tft_write_byte(uint8_t *data_buf, uint32_t length);
 void tft_write_half(uint16_t *data_buf, uint32_t length);
 void tft_write_word(uint32_t *data_buf, uint32_t length);
 void tft_fill_data(uint32_t *data_buf, uint32_t length);
+void tft_write_word_async(uint32_t *data_buf, uint32_t length);
+int tft_wait_idle(void);
 void tft_set_datawidth(uint8_t width);
 
 #endif
@@ -37,6 +37,10 @@ typedef struct _lcd_ctl
 
 
 static uint16_t* g_lcd_display_buff = NULL;
+static uint16_t* g_lcd_async_buff = NULL; // second buffer so an async picture can convert while the last one is sent
+static uint16_t* g_lcd_async_last = NULL; // buffer the last async picture was sent from
+static bool g_lcd_async_valid = false;    // panel still shows g_lcd_async_last at g_lcd_async_area
+static uint16_t g_lcd_async_area[4];
 static uint16_t g_lcd_w = 0;
 static uint16_t g_lcd_h = 0;
 static bool g_lcd_init = false;
@@ -208,10 +212,17 @@ static int mcu_lcd_init(lcd_para_t *lcd_para)
     // lcd_para->offset_h1, lcd_para->offset_h0, lcd_para->oct);
     if(g_lcd_w != lcd_para->width || g_lcd_h != lcd_para->height)
     {
+        tft_wait_idle();
         if(g_lcd_display_buff)
         {
             free(g_lcd_display_buff);
         }
+        if(g_lcd_async_buff)
+        {
+            free(g_lcd_async_buff);
+            g_lcd_async_buff = NULL;
+        }
+        g_lcd_async_last = NULL;
         g_lcd_display_buff = (uint16_t*)malloc(lcd_para->width*lcd_para->height*2);
         if(!g_lcd_display_buff)
             return 12; //ENOMEM
@@ -272,11 +283,19 @@ static int mcu_lcd_init_shield(lcd_para_t *lcd_para){
 
 static void mcu_lcd_destroy()
 {
+    tft_wait_idle();
     if(g_lcd_display_buff)
     {
         free(g_lcd_display_buff);
         g_lcd_display_buff = NULL;
     }
+    if(g_lcd_async_buff)
+    {
+        free(g_lcd_async_buff);
+        g_lcd_async_buff = NULL;
+    }
+    g_lcd_async_last = NULL;
+    g_lcd_async_valid = false;
     g_lcd_w = 0;
     g_lcd_h = 0;
 }
@@ -346,6 +365,8 @@ static void lcd_set_area(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
 {
     uint8_t data[4] = {0};
 
+    // whatever is drawn now may cover the last async picture
+    g_lcd_async_valid = false;
     x1 += lcd_ctl.start_offset_w;
     x2 += lcd_ctl.start_offset_w;
     y1 += lcd_ctl.start_offset_h;
@@ -592,6 +613,22 @@ static void mcu_lcd_draw_picture(uint16_t x1, uint16_t y1, uint16_t width, uint1
     }
 }
 
+// DVP native u32 order is the order draw_picture swaps into when LCD_SWAP_COLOR_BYTES is set,
+// the frame is sent directly; without it only the bytes of each pixel still need swapping
+static void mcu_lcd_draw_picture_native(uint16_t x1, uint16_t y1, uint16_t width, uint16_t height, uint8_t *ptr)
+{
+    lcd_set_area(x1, y1, x1 + width - 1, y1 + height - 1);
+    #if LCD_SWAP_COLOR_BYTES
+        tft_write_word((uint32_t*)ptr, width * height / 2);
+    #else
+        uint32_t i, size = width * height;
+        uint16_t* p = (uint16_t*)ptr;
+        for(i=0; i<size; ++i)
+            g_lcd_display_buff[i] = SWAP_16(p[i]);
+        tft_write_word((uint32_t*)g_lcd_display_buff, size / 2);
+    #endif
+}
+
 //draw pic's roi on (x,y)
 //x,y of LCD, w,h is pic; rx,ry,rw,rh is roi
 static void mcu_lcd_draw_pic_roi(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t rx, uint16_t ry, uint16_t rw, uint16_t rh, uint8_t *ptr)
@@ -632,6 +669,189 @@ static void mcu_lcd_draw_pic_grayroi(uint16_t x, uint16_t y, uint16_t w, uint16_
 	return;
 }
 
+#define LCD_ASYNC_BAND_ROWS 16
+
+typedef struct
+{
+    uint16_t *dst;
+    const uint8_t *src;
+    uint16_t w, h;
+    uint16_t rx, ry, rw, rh;
+    uint16_t dw, dh;
+    uint32_t flags;
+} lcd_async_job_t;
+
+static lcd_async_job_t g_lcd_async_job;
+
+static inline uint16_t lcd_rgb565_to_wire(uint16_t c)
+{
+    #if LCD_SWAP_COLOR_BYTES
+        return (uint16_t)SWAP_16(c);
+    #else
+        return c;
+    #endif
+}
+
+static inline uint16_t lcd_async_rgb565(const lcd_async_job_t *job, uint32_t i)
+{
+    const uint16_t *p = (const uint16_t *)job->src;
+    if (job->flags & LCD_PIC_NATIVE)
+        return __builtin_bswap16(p[i ^ 1]);
+    return p[i];
+}
+
+// a, b rgb565, f in [0, 32]
+static inline uint16_t lcd_blend_rgb565(uint16_t a, uint16_t b, uint32_t f)
+{
+    uint32_t x = (a | ((uint32_t)a << 16)) & 0x07E0F81F;
+    uint32_t y = (b | ((uint32_t)b << 16)) & 0x07E0F81F;
+    uint32_t r = ((x * (32 - f) + y * f) >> 5) & 0x07E0F81F;
+    return (uint16_t)(r | (r >> 16));
+}
+
+static inline uint16_t lcd_async_nearest(const lcd_async_job_t *job, uint32_t i)
+{
+    if (job->flags & LCD_PIC_GRAY)
+        return gray2rgb565[job->src[i] >> 2];
+    #if LCD_SWAP_COLOR_BYTES
+        // native order already holds the wire bytes
+        if (job->flags & LCD_PIC_NATIVE)
+            return ((const uint16_t *)job->src)[i ^ 1];
+    #endif
+    return lcd_rgb565_to_wire(lcd_async_rgb565(job, i));
+}
+
+static inline uint16_t lcd_async_bilinear(const lcd_async_job_t *job, uint32_t i0, uint32_t i1, uint32_t dx, uint32_t fx, uint32_t fy)
+{
+    // i0, i1 first pixel of the upper and lower row, dx 0 or 1 to the right neighbour
+    if (job->flags & LCD_PIC_GRAY)
+    {
+        const uint8_t *p = job->src;
+        uint32_t t = p[i0] * (32 - fx) + p[i0 + dx] * fx;
+        uint32_t b = p[i1] * (32 - fx) + p[i1 + dx] * fx;
+        return gray2rgb565[((t * (32 - fy) + b * fy) >> 10) >> 2];
+    }
+    uint16_t t = lcd_blend_rgb565(lcd_async_rgb565(job, i0), lcd_async_rgb565(job, i0 + dx), fx);
+    uint16_t b = lcd_blend_rgb565(lcd_async_rgb565(job, i1), lcd_async_rgb565(job, i1 + dx), fx);
+    return lcd_rgb565_to_wire(lcd_blend_rgb565(t, b, fy));
+}
+
+// Scale rows [y_start, y_end) of the destination into job->dst in the order tft_write_word sends them.
+static void lcd_async_convert_rows(const lcd_async_job_t *job, uint32_t y_start, uint32_t y_end)
+{
+    uint32_t x_step = ((uint32_t)job->rw << 16) / job->dw;
+    uint32_t y_step = ((uint32_t)job->rh << 16) / job->dh;
+    for (uint32_t y = y_start; y < y_end; y++)
+    {
+        uint16_t *out = job->dst + y * job->dw;
+        uint32_t fy = y * y_step;
+        uint32_t sy = fy >> 16;
+        uint32_t row0 = (job->ry + sy) * job->w + job->rx;
+        uint32_t fx = 0;
+        if (job->flags & LCD_PIC_BILINEAR)
+        {
+            uint32_t row1 = (sy + 1 < job->rh) ? row0 + job->w : row0;
+            for (uint32_t x = 0; x < job->dw; x++, fx += x_step)
+            {
+                uint32_t sx = fx >> 16;
+                uint32_t dx = (sx + 1 < job->rw) ? 1 : 0;
+                out[x ^ 1] = lcd_async_bilinear(job, row0 + sx, row1 + sx, dx, (fx >> 11) & 31, (fy >> 11) & 31);
+            }
+        }
+        else
+        {
+            for (uint32_t x = 0; x < job->dw; x++, fx += x_step)
+                out[x ^ 1] = lcd_async_nearest(job, row0 + (fx >> 16));
+        }
+    }
+}
+
+static int lcd_async_convert_half(int core)
+{
+    lcd_async_convert_rows(&g_lcd_async_job, g_lcd_async_job.dh / 2, g_lcd_async_job.dh);
+    return 0;
+}
+
+static int mcu_lcd_wait_idle(void)
+{
+    return tft_wait_idle();
+}
+
+// draw roi (rx,ry,rw,rh) of a w*h picture scaled to dw*dh at (x,y).
+// The picture is converted right away, then sent by DMA while the caller goes on.
+static int mcu_lcd_draw_pic_async(uint16_t x, uint16_t y, uint16_t dw, uint16_t dh, uint16_t w, uint16_t h,
+                                  uint16_t rx, uint16_t ry, uint16_t rw, uint16_t rh, uint8_t *ptr, uint32_t flags)
+{
+    extern volatile bool maixpy_sdcard_loading;
+    lcd_async_job_t *job = &g_lcd_async_job;
+    uint32_t y0 = 0, y1 = dh;
+
+    // transfers go out in u32 words, pixel pairs must not straddle rows
+    if ((dw % 2) || !dw || !dh || !rw || !rh || rx + rw > w || ry + rh > h ||
+        (uint32_t)dw * dh > (uint32_t)g_lcd_w * g_lcd_h)
+        return 22; //EINVAL
+    if (!g_lcd_async_buff)
+    {
+        g_lcd_async_buff = (uint16_t*)malloc(g_lcd_w * g_lcd_h * 2);
+        if (!g_lcd_async_buff)
+            return 12; //ENOMEM
+    }
+    // the buffer of the last picture may still be on the wire, fill the other one
+    job->dst = (g_lcd_async_last == g_lcd_display_buff) ? g_lcd_async_buff : g_lcd_display_buff;
+    job->src = ptr;
+    job->w = w;
+    job->h = h;
+    job->rx = rx;
+    job->ry = ry;
+    job->rw = rw;
+    job->rh = rh;
+    job->dw = dw;
+    job->dh = dh;
+    job->flags = flags;
+    if (maixpy_sdcard_loading || dh < 2)
+    {
+        lcd_async_convert_rows(job, 0, dh);
+    }
+    else
+    {
+        dual_func = lcd_async_convert_half;
+        lcd_async_convert_rows(job, 0, dh / 2);
+        while(dual_func){}
+    }
+
+    if ((flags & LCD_PIC_DIRTY) && g_lcd_async_valid && g_lcd_async_last &&
+        g_lcd_async_area[0] == x && g_lcd_async_area[1] == y &&
+        g_lcd_async_area[2] == dw && g_lcd_async_area[3] == dh)
+    {
+        // only send the span between the first and last changed band
+        bool dirty = false;
+        for (uint32_t band = 0; band < dh; band += LCD_ASYNC_BAND_ROWS)
+        {
+            uint32_t rows = (dh - band < LCD_ASYNC_BAND_ROWS) ? (dh - band) : LCD_ASYNC_BAND_ROWS;
+            uint32_t offset = band * dw;
+            if (memcmp(job->dst + offset, g_lcd_async_last + offset, rows * dw * 2) != 0)
+            {
+                if (!dirty)
+                    y0 = band;
+                y1 = band + rows;
+                dirty = true;
+            }
+        }
+        if (!dirty)
+            return 0;
+    }
+
+    lcd_set_area(x, y + y0, x + dw - 1, y + y1 - 1);
+    tft_write_word_async((uint32_t*)(job->dst + y0 * dw), dw * (y1 - y0) / 2);
+    g_lcd_async_last = job->dst;
+    g_lcd_async_valid = true;
+    g_lcd_async_area[0] = x;
+    g_lcd_async_area[1] = y;
+    g_lcd_async_area[2] = dw;
+    g_lcd_async_area[3] = dh;
+    return 0;
+}
+
 static void lcd_ram_cpyimg(char* lcd, int lcdw, char* img, int imgw, int imgh, int x, int y)
 {
 	int i;
@@ -668,8 +888,11 @@ lcd_t lcd_mcu = {
     .draw_point     = mcu_lcd_draw_point,
     // .draw_string    = mcu_lcd_draw_string,
 	.draw_picture  = mcu_lcd_draw_picture,
+	.draw_picture_native = mcu_lcd_draw_picture_native,
 	.draw_pic_roi  = mcu_lcd_draw_pic_roi,
 	.draw_pic_gray = mcu_lcd_draw_pic_gray,
 	.draw_pic_grayroi = mcu_lcd_draw_pic_grayroi,
+	.draw_pic_async = mcu_lcd_draw_pic_async,
+	.wait_idle = mcu_lcd_wait_idle,
 	.fill_rectangle	= mcu_lcd_fill_rectangle,
 };
@@ -1,10 +1,38 @@
 #include "st7789.h"
 #include "sipeed_spi.h"
 #include "sleep.h"
+#include "sysctl.h"
 #include "lcd.h"
 
 static bool standard_spi = false;
 static spi_work_mode_t standard_work_mode = SPI_WORK_MODE_0;
+static volatile bool tft_busy = false; // tft_write_word_async transfer in flight
+
+// 800x480 rgb565 at a 10MHz standard SPI clock takes ~0.6s
+#define TFT_DMA_TIMEOUT_US 1000000
+
+static int tft_dma_done(void *ctx)
+{
+    tft_busy = false;
+    return 0;
+}
+
+// 0, or -1 when the completion interrupt never came, the channel is stopped then
+// so the next transfer can start
+int tft_wait_idle(void)
+{
+    uint64_t start = sysctl_get_time_us();
+    while (tft_busy)
+    {
+        if (sysctl_get_time_us() - start > TFT_DMA_TIMEOUT_US)
+        {
+            dmac_channel_disable(SPI_DMA_CH);
+            tft_busy = false;
+            return -1;
+        }
+    }
+    return 0;
+}
 
 static void init_dcx(void)
 {
@@ -35,11 +63,13 @@ static void set_rst(uint8_t val)
 
 void tft_set_clk_freq(uint32_t freq)
 {
+    tft_wait_idle();
     spi_set_clk_rate(SPI_CHANNEL, freq);
 }
 
 void tft_hard_init(uint32_t freq, bool oct)
 {
+    tft_wait_idle();
     standard_spi = !oct;
     init_dcx();
     init_rst();
@@ -64,6 +94,7 @@ void tft_hard_init(uint32_t freq, bool oct)
 
 void tft_write_command(uint8_t cmd)
 {
+    tft_wait_idle();
     set_dcx_control();
     if(!standard_spi)
     {
@@ -81,6 +112,7 @@ void tft_write_command(uint8_t cmd)
 
 void tft_write_byte(uint8_t *data_buf, uint32_t length)
 {
+    tft_wait_idle();
     set_dcx_data();
     if(!standard_spi)
     {
@@ -98,6 +130,7 @@ void tft_write_byte(uint8_t *data_buf, uint32_t length)
 
 void tft_write_half(uint16_t *data_buf, uint32_t length)
 {
+    tft_wait_idle();
     set_dcx_data();
     if(!standard_spi)
     {
@@ -115,6 +148,7 @@ void tft_write_half(uint16_t *data_buf, uint32_t length)
 
 void tft_write_word(uint32_t *data_buf, uint32_t length)
 {
+    tft_wait_idle();
     set_dcx_data();
     if(!standard_spi)
     {
@@ -131,8 +165,40 @@ void tft_write_word(uint32_t *data_buf, uint32_t length)
     }
 }
 
+// Like tft_write_word but returns once the DMA is started, data_buf must stay
+// untouched until tft_wait_idle(). Every other tft_* call waits for it first.
+void tft_write_word_async(uint32_t *data_buf, uint32_t length)
+{
+    tft_wait_idle();
+    set_dcx_data();
+    if(!standard_spi)
+    {
+        spi_init(SPI_CHANNEL, SPI_WORK_MODE_0, SPI_FF_OCTAL, 32, 0);
+        spi_init_non_standard(SPI_CHANNEL, 0 /*instrction length*/, 32 /*address length*/, 0 /*wait cycles*/,
+                            SPI_AITM_AS_FRAME_FORMAT /*spi address trans mode*/);
+    }
+    else
+    {
+        spi_init(SPI_CHANNEL, standard_work_mode, SPI_FF_STANDARD, 32, 0);
+    }
+    spi_data_t data = {
+        .tx_channel = SPI_DMA_CH,
+        .tx_buf = data_buf,
+        .tx_len = length,
+        .transfer_mode = SPI_TMOD_TRANS,
+    };
+    plic_interrupt_t cb = {
+        .callback = tft_dma_done,
+        .ctx = NULL,
+        .priority = 1,
+    };
+    tft_busy = true;
+    spi_handle_data_dma(SPI_CHANNEL, LCD_SPI_SLAVE_SELECT, data, &cb);
+}
+
 void tft_fill_data(uint32_t *data_buf, uint32_t length)
 {
+    tft_wait_idle();
     set_dcx_data();
     if(!standard_spi)
     {
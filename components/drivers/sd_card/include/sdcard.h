@@ -2,6 +2,7 @@
 #define __SDCARD_H__
 
 #include <stdint.h>
+#include "sdcard_blk.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -109,6 +110,17 @@ extern "C"
     uint8_t sd_write_sector(uint8_t *data_buff, uint32_t sector, uint32_t count);
     uint8_t sd_read_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count);
     uint8_t sd_write_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count);
+    /* LRU cache with sequential read-ahead on top of the DMA functions */
+    uint8_t sd_read_sector_cached(uint8_t *data_buff, uint32_t sector, uint32_t count);
+    uint8_t sd_write_sector_cached(uint8_t *data_buff, uint32_t sector, uint32_t count);
+    void sd_cache_invalidate(void);
+    /* queue an async read/write, done on the SD task with CONFIG_SPI_SD_CARD_PREFETCH_TASK, otherwise right away */
+    int sd_submit(sd_blk_req_t *req);
+    /* SD_DMA_CH and DMAC_CHANNEL1 are shared with the w25qxx flash and the W5500, and the SD task
+       runs on the other core. Every transfer on them holds this recursive lock, it is free until
+       the SD cache is first used and does nothing without threads */
+    void sd_dma_lock(void);
+    void sd_dma_unlock(void);
 
 #ifdef __cplusplus
 }
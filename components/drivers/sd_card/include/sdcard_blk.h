@@ -0,0 +1,112 @@
+#ifndef __SDCARD_BLK_H__
+#define __SDCARD_BLK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SD_BLK_SECTOR_SIZE   512
+#define SD_BLK_CACHE_LINES   16 // LRU sectors kept in RAM
+#define SD_BLK_READ_AHEAD    8  // sectors fetched with one CMD18 on a sequential miss
+#define SD_BLK_DIRECT_MIN    8  // requests this long bypass the cache
+#define SD_BLK_QUEUE_LEN     8
+
+    /* same shape as sd_read_sector_dma/sd_write_sector_dma, return 0 on success */
+    typedef uint8_t (*sd_blk_io_t)(uint8_t *buff, uint32_t sector, uint32_t count);
+
+    typedef struct
+    {
+        void (*lock)(void *arg);
+        void (*unlock)(void *arg);
+        void (*kick)(void *arg); /* wake the worker after a submit, NULL runs the queue in the caller */
+        void *arg;
+    } sd_blk_hooks_t;
+
+    typedef enum
+    {
+        SD_BLK_REQ_READ = 0,
+        SD_BLK_REQ_WRITE,
+        SD_BLK_REQ_PREFETCH, /* fill the cache only, buff is unused */
+    } sd_blk_req_op_t;
+
+    typedef enum
+    {
+        SD_BLK_REQ_IDLE = 0,
+        SD_BLK_REQ_QUEUED,
+        SD_BLK_REQ_DONE,
+    } sd_blk_req_state_t;
+
+    typedef struct sd_blk_req
+    {
+        uint8_t op;
+        volatile uint8_t state;
+        uint8_t result; /* backend return code, valid once state is SD_BLK_REQ_DONE */
+        uint8_t *buff;
+        uint32_t sector;
+        uint32_t count;
+        void (*done)(struct sd_blk_req *req, void *arg); /* called from the context that ran it */
+        void *arg;
+    } sd_blk_req_t;
+
+    typedef struct
+    {
+        uint32_t sector;
+        uint32_t stamp;
+        bool valid;
+    } sd_blk_line_t;
+
+    typedef struct
+    {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t read_ahead; /* sectors fetched ahead of the request */
+        uint32_t prefetch;   /* sectors fetched by the worker while the reader was busy */
+        uint32_t direct;     /* requests that bypassed the cache */
+        uint32_t io_read;    /* backend calls */
+        uint32_t io_write;
+    } sd_blk_stats_t;
+
+    typedef struct
+    {
+        sd_blk_io_t read;
+        sd_blk_io_t write;
+        sd_blk_hooks_t hooks;
+        sd_blk_line_t lines[SD_BLK_CACHE_LINES];
+        uint8_t *cache;   /* SD_BLK_CACHE_LINES sectors */
+        uint8_t *staging; /* SD_BLK_READ_AHEAD contiguous sectors for one multi-block read */
+        uint32_t sectors; /* card size, read-ahead stops there. 0 if unknown */
+        uint32_t stamp;
+        uint32_t next_sector; /* where a sequential reader continues */
+        sd_blk_req_t prefetch; /* next window of a sequential reader, queued when there is a worker */
+        sd_blk_req_t *queue[SD_BLK_QUEUE_LEN];
+        volatile uint8_t head;
+        volatile uint8_t tail;
+        sd_blk_stats_t stats;
+    } sd_blk_t;
+
+    /* returns 0, or -1 if the cache memory could not be allocated */
+    int sd_blk_init(sd_blk_t *blk, sd_blk_io_t read, sd_blk_io_t write, const sd_blk_hooks_t *hooks);
+    void sd_blk_deinit(sd_blk_t *blk);
+    void sd_blk_invalidate(sd_blk_t *blk);
+
+    /* a sequential reader gets its next window queued, so with a worker the card
+       is read while the caller decodes the current one */
+    uint8_t sd_blk_read(sd_blk_t *blk, uint8_t *buff, uint32_t sector, uint32_t count);
+    /* write-through, cached copies of the written sectors are updated */
+    uint8_t sd_blk_write(sd_blk_t *blk, uint8_t *buff, uint32_t sector, uint32_t count);
+
+    /* queue req, returns -1 if the queue is full. buff must stay valid until the request is done */
+    int sd_blk_submit(sd_blk_t *blk, sd_blk_req_t *req);
+    /* run queued requests, returns how many were run. Called by the worker, or by submit without one */
+    int sd_blk_process(sd_blk_t *blk);
+    bool sd_blk_pending(sd_blk_t *blk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
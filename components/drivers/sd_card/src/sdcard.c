@@ -10,6 +10,12 @@
 #include "syslog.h"
 #include "utils.h"
 #include "global_config.h"
+#include "sdcard_blk.h"
+#if CONFIG_MAIXPY_THREAD_ENABLE
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#endif
 
 #define MAIX_SDCARD_DEBUG 0
 #if MAIX_SDCARD_DEBUG == 1
@@ -48,6 +54,8 @@
 #define SD_CMD58 58  /*!< CMD58 = 0x58 */
 #define SD_CMD59 59  /*!< CMD59 = 0x59 */
 
+#define SD_STOP_DATA_MULTIPLE_BLOCK_WRITE 0xFD /*!< Data token stop byte, Stop Multiple Block Write */
+
 sdcard_config_t config = { // see struct sdcard_config_t
 #ifdef CONFIG_BOARD_M5STICK
     33, 31, 30, 32, SD_CS_PIN,
@@ -456,7 +464,7 @@ static uint8_t sd_get_cardinfo(SD_CardInfo *cardinfo)
  *         - 0xFF: Sequence failed
  *         - 0: Sequence succeed
  */
-uint8_t sd_init(void)
+static uint8_t sd_init_nolock(void)
 {
     uint8_t frame[10], index, result;
     cardinfo.active = 0;
@@ -567,6 +575,7 @@ uint8_t sd_init(void)
     if (0 == sd_get_cardinfo(&cardinfo))
     {
         cardinfo.active = 1;
+        sd_cache_invalidate();
         return 0;
     }
     return 0xFF;
@@ -581,7 +590,7 @@ uint8_t sd_init(void)
  *         - 0xFF: Sequence failed
  *         - 0: Sequence succeed
  */
-uint8_t sd_read_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
+static uint8_t sd_read_sector_nolock(uint8_t *data_buff, uint32_t sector, uint32_t count)
 {
     uint8_t frame[2], flag;
     /*!< Send CMD17 (SD_CMD17) to read one block */
@@ -633,7 +642,7 @@ uint8_t sd_read_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
  *         - 0xFF: Sequence failed
  *         - 0: Sequence succeed
  */
-uint8_t sd_write_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
+static uint8_t sd_write_sector_nolock(uint8_t *data_buff, uint32_t sector, uint32_t count)
 {
     configASSERT(((uint32_t)data_buff) % 4 == 0);
     uint8_t frame[2] = {0xFF};
@@ -678,7 +687,7 @@ uint8_t sd_write_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
     return 0;
 }
 
-uint8_t sd_read_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
+static uint8_t sd_read_sector_dma_nolock(uint8_t *data_buff, uint32_t sector, uint32_t count)
 {
     uint8_t frame[2], flag;
     if (1 == sd_version)
@@ -724,28 +733,41 @@ uint8_t sd_read_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
     return count > 0 ? 0xFF : 0;
 }
 
-uint8_t sd_write_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
+static uint8_t sd_wait_ready(void)
+{
+    uint8_t response;
+    uint32_t timeout = 0xFFFFF;
+    do
+    {
+        sd_read_data(&response, 1);
+    } while (response != 0xFF && --timeout);
+    return response == 0xFF ? 0 : 0xFF;
+}
+
+static uint8_t sd_write_sector_dma_nolock(uint8_t *data_buff, uint32_t sector, uint32_t count)
 {
     uint8_t frame[2] = {0xFF};
-    uint32_t shift = 0;
-    frame[1] = SD_START_DATA_SINGLE_BLOCK_WRITE;
-    uint32_t i = 0;
     if (1 == sd_version)
         sector = sector << 9;
-    while (count--)
+    if (count == 1)
+    {
+        frame[1] = SD_START_DATA_SINGLE_BLOCK_WRITE;
+        sd_send_cmd(SD_CMD24, sector, 1);
+    }
+    else
+    {
+        /*!< One CMD25 for the whole run, the card programs while the next block is sent */
+        frame[1] = SD_START_DATA_MULTIPLE_BLOCK_WRITE;
+        sd_send_cmd(SD_CMD25, sector, 1);
+    }
+    /*!< Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
+    if (sd_get_response() != 0x00)
+    {
+        sd_end_cmd();
+        return 0xFF;
+    }
+    while (count)
     {
-        if (1 == sd_version)
-            shift = i << 9;
-        else
-            shift = i;
-        sd_send_cmd(SD_CMD24, sector + shift, 1);
-        /*!< Check if the SD acknowledged the write block command: R1 response (0x00: no errors) */
-        if (sd_get_response() != 0x00)
-        {
-            sd_end_cmd();
-            return 0xFF;
-        }
-
         /*!< Send the data token to signify the start of the data */
         sd_write_data(frame, 2);
         /*!< Write the block data to SD : write count data by block */
@@ -755,14 +777,182 @@ uint8_t sd_write_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
         data_buff += 512;
         /*!< Read data response */
         if (sd_get_dataresponse() != 0x00)
-        {
-            sd_end_cmd();
-            return 0xFF;
-        }
-        i++;
+            break;
+        count--;
+    }
+    if (frame[1] == SD_START_DATA_MULTIPLE_BLOCK_WRITE)
+    {
+        /*!< Stop token ends the transfer, then wait for the card to finish programming */
+        frame[0] = SD_STOP_DATA_MULTIPLE_BLOCK_WRITE;
+        sd_write_data(frame, 1);
+        sd_read_data(frame, 1);
+        sd_wait_ready();
     }
     sd_end_cmd();
     sd_end_cmd();
     /*!< Returns the reponse */
-    return 0;
+    return count > 0 ? 0xFF : 0;
+}
+
+/*
+ * Cached block device used by FatFs, see sdcard_blk.h.
+ * With CONFIG_SPI_SD_CARD_PREFETCH_TASK requests submitted with sd_submit() run on their own
+ * task on core 0, which also reads the next window of a sequential reader while it decodes
+ * the last one. Otherwise they run in the caller.
+ */
+static sd_blk_t sd_blk;
+static bool sd_blk_ready = false;
+
+#if CONFIG_MAIXPY_THREAD_ENABLE
+// the cache and DMAC_CHANNEL0/1, recursive so the cache can call the locked SD functions
+static SemaphoreHandle_t sd_dma_mutex = NULL;
+
+void sd_dma_lock(void)
+{
+    if (sd_dma_mutex)
+        xSemaphoreTakeRecursive(sd_dma_mutex, portMAX_DELAY);
+}
+
+void sd_dma_unlock(void)
+{
+    // a lock taken before the mutex existed has nothing to give back, the give just fails
+    if (sd_dma_mutex)
+        xSemaphoreGiveRecursive(sd_dma_mutex);
+}
+
+static void sd_blk_mutex_lock(void *arg)
+{
+    xSemaphoreTakeRecursive(sd_dma_mutex, portMAX_DELAY);
+}
+
+static void sd_blk_mutex_unlock(void *arg)
+{
+    xSemaphoreGiveRecursive(sd_dma_mutex);
+}
+#else
+void sd_dma_lock(void)
+{
+}
+
+void sd_dma_unlock(void)
+{
+}
+#endif
+
+uint8_t sd_init(void)
+{
+    sd_dma_lock();
+    uint8_t ret = sd_init_nolock();
+    sd_dma_unlock();
+    return ret;
+}
+
+uint8_t sd_read_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    sd_dma_lock();
+    uint8_t ret = sd_read_sector_nolock(data_buff, sector, count);
+    sd_dma_unlock();
+    return ret;
+}
+
+uint8_t sd_write_sector(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    sd_dma_lock();
+    uint8_t ret = sd_write_sector_nolock(data_buff, sector, count);
+    sd_dma_unlock();
+    return ret;
+}
+
+uint8_t sd_read_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    sd_dma_lock();
+    uint8_t ret = sd_read_sector_dma_nolock(data_buff, sector, count);
+    sd_dma_unlock();
+    return ret;
+}
+
+uint8_t sd_write_sector_dma(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    sd_dma_lock();
+    uint8_t ret = sd_write_sector_dma_nolock(data_buff, sector, count);
+    sd_dma_unlock();
+    return ret;
+}
+
+#if CONFIG_MAIXPY_THREAD_ENABLE && CONFIG_SPI_SD_CARD_PREFETCH_TASK
+static TaskHandle_t sd_blk_task = NULL;
+
+static void sd_blk_worker(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        sd_blk_process(&sd_blk);
+    }
+}
+
+static void sd_blk_kick(void *arg)
+{
+    if (sd_blk_task == NULL)
+    {
+        xTaskCreateAtProcessor(0, sd_blk_worker, "sd_blk", 1024, NULL, 4, &sd_blk_task);
+        if (sd_blk_task == NULL) // no worker, serve it here
+        {
+            sd_blk_process(&sd_blk);
+            return;
+        }
+    }
+    xTaskNotifyGive(sd_blk_task);
+}
+#endif
+
+static bool sd_cache_init(void)
+{
+    sd_blk_hooks_t hooks = {0};
+#if CONFIG_MAIXPY_THREAD_ENABLE
+    if (sd_dma_mutex == NULL)
+        sd_dma_mutex = xSemaphoreCreateRecursiveMutex();
+    if (sd_dma_mutex == NULL)
+        return false;
+    hooks.lock = sd_blk_mutex_lock;
+    hooks.unlock = sd_blk_mutex_unlock;
+#if CONFIG_SPI_SD_CARD_PREFETCH_TASK
+    hooks.kick = sd_blk_kick;
+#endif
+#endif
+    // the cache holds the lock around its I/O
+    if (sd_blk_init(&sd_blk, sd_read_sector_dma_nolock, sd_write_sector_dma_nolock, &hooks) != 0)
+        return false;
+    sd_blk.sectors = cardinfo.CardCapacity / 512;
+    sd_blk_ready = true;
+    return true;
+}
+
+void sd_cache_invalidate(void)
+{
+    if (!sd_blk_ready)
+        return;
+    sd_blk_invalidate(&sd_blk);
+    sd_blk.sectors = cardinfo.CardCapacity / 512;
+}
+
+uint8_t sd_read_sector_cached(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    if (!sd_blk_ready && !sd_cache_init())
+        return sd_read_sector_dma(data_buff, sector, count);
+    return sd_blk_read(&sd_blk, data_buff, sector, count);
+}
+
+uint8_t sd_write_sector_cached(uint8_t *data_buff, uint32_t sector, uint32_t count)
+{
+    if (!sd_blk_ready && !sd_cache_init())
+        return sd_write_sector_dma(data_buff, sector, count);
+    return sd_blk_write(&sd_blk, data_buff, sector, count);
+}
+
+int sd_submit(sd_blk_req_t *req)
+{
+    if (!sd_blk_ready && !sd_cache_init())
+        return -1;
+    return sd_blk_submit(&sd_blk, req);
 }
@@ -0,0 +1,295 @@
+#include "sdcard_blk.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void sd_blk_lock(sd_blk_t *blk)
+{
+    if (blk->hooks.lock)
+        blk->hooks.lock(blk->hooks.arg);
+}
+
+static void sd_blk_unlock(sd_blk_t *blk)
+{
+    if (blk->hooks.unlock)
+        blk->hooks.unlock(blk->hooks.arg);
+}
+
+static int sd_blk_find(sd_blk_t *blk, uint32_t sector)
+{
+    for (int i = 0; i < SD_BLK_CACHE_LINES; i++)
+    {
+        if (blk->lines[i].valid && blk->lines[i].sector == sector)
+            return i;
+    }
+    return -1;
+}
+
+static int sd_blk_victim(sd_blk_t *blk)
+{
+    int victim = 0;
+    for (int i = 0; i < SD_BLK_CACHE_LINES; i++)
+    {
+        if (!blk->lines[i].valid)
+            return i;
+        if (blk->lines[i].stamp < blk->lines[victim].stamp)
+            victim = i;
+    }
+    return victim;
+}
+
+static int sd_blk_insert(sd_blk_t *blk, uint32_t sector, const uint8_t *data)
+{
+    int i = sd_blk_find(blk, sector);
+    if (i < 0)
+        i = sd_blk_victim(blk);
+    memcpy(blk->cache + i * SD_BLK_SECTOR_SIZE, data, SD_BLK_SECTOR_SIZE);
+    blk->lines[i].sector = sector;
+    blk->lines[i].stamp = ++blk->stamp;
+    blk->lines[i].valid = true;
+    return i;
+}
+
+int sd_blk_init(sd_blk_t *blk, sd_blk_io_t read, sd_blk_io_t write, const sd_blk_hooks_t *hooks)
+{
+    memset(blk, 0, sizeof(sd_blk_t));
+    blk->cache = (uint8_t *)malloc(SD_BLK_CACHE_LINES * SD_BLK_SECTOR_SIZE);
+    blk->staging = (uint8_t *)malloc(SD_BLK_READ_AHEAD * SD_BLK_SECTOR_SIZE);
+    if (!blk->cache || !blk->staging)
+    {
+        sd_blk_deinit(blk);
+        return -1;
+    }
+    blk->read = read;
+    blk->write = write;
+    if (hooks)
+        blk->hooks = *hooks;
+    blk->next_sector = UINT32_MAX;
+    return 0;
+}
+
+void sd_blk_deinit(sd_blk_t *blk)
+{
+    free(blk->cache);
+    free(blk->staging);
+    blk->cache = NULL;
+    blk->staging = NULL;
+    memset(blk->lines, 0, sizeof(blk->lines));
+}
+
+// read sectors that are not cached yet into the cache, used by the worker for read-ahead
+static uint8_t sd_blk_fill(sd_blk_t *blk, uint32_t sector, uint32_t count)
+{
+    uint8_t ret = 0;
+    sd_blk_lock(blk);
+    while (count && sd_blk_find(blk, sector) >= 0)
+    {
+        sector++;
+        count--;
+    }
+    if (blk->sectors && sector + count > blk->sectors)
+        count = sector < blk->sectors ? blk->sectors - sector : 0;
+    if (count)
+    {
+        ret = blk->read(blk->staging, sector, count);
+        blk->stats.io_read++;
+        if (ret == 0)
+        {
+            for (uint32_t k = 0; k < count; k++)
+                sd_blk_insert(blk, sector + k, blk->staging + k * SD_BLK_SECTOR_SIZE);
+            blk->stats.prefetch += count;
+        }
+    }
+    sd_blk_unlock(blk);
+    return ret;
+}
+
+// queue the window after what the sequential reader has cached, only worth it with a worker
+static void sd_blk_prefetch(sd_blk_t *blk)
+{
+    if (!blk->hooks.kick || blk->prefetch.state == SD_BLK_REQ_QUEUED)
+        return;
+    sd_blk_lock(blk);
+    uint32_t sector = blk->next_sector;
+    while (sector - blk->next_sector < SD_BLK_READ_AHEAD && sd_blk_find(blk, sector) >= 0)
+        sector++;
+    bool enough = (sector - blk->next_sector >= SD_BLK_READ_AHEAD) ||
+                  (blk->sectors && sector >= blk->sectors);
+    sd_blk_unlock(blk);
+    if (enough)
+        return;
+    blk->prefetch.op = SD_BLK_REQ_PREFETCH;
+    blk->prefetch.buff = NULL;
+    blk->prefetch.sector = sector;
+    blk->prefetch.count = SD_BLK_READ_AHEAD;
+    blk->prefetch.done = NULL;
+    sd_blk_submit(blk, &blk->prefetch);
+}
+
+void sd_blk_invalidate(sd_blk_t *blk)
+{
+    sd_blk_lock(blk);
+    memset(blk->lines, 0, sizeof(blk->lines));
+    blk->next_sector = UINT32_MAX;
+    sd_blk_unlock(blk);
+}
+
+uint8_t sd_blk_read(sd_blk_t *blk, uint8_t *buff, uint32_t sector, uint32_t count)
+{
+    uint8_t ret = 0;
+    sd_blk_lock(blk);
+    bool stream = (sector == blk->next_sector);
+    bool sequential = stream;
+    // a long read goes straight to the caller, unless its start was prefetched
+    if (count >= SD_BLK_DIRECT_MIN && sd_blk_find(blk, sector) < 0)
+    {
+        // lines are write-through copies, a direct read cannot make them stale
+        ret = blk->read(buff, sector, count);
+        blk->stats.io_read++;
+        blk->stats.direct++;
+        blk->next_sector = sector + count;
+        sd_blk_unlock(blk);
+        if (sequential && ret == 0)
+            sd_blk_prefetch(blk);
+        return ret;
+    }
+    while (count)
+    {
+        int i = sd_blk_find(blk, sector);
+        if (i >= 0)
+        {
+            memcpy(buff, blk->cache + i * SD_BLK_SECTOR_SIZE, SD_BLK_SECTOR_SIZE);
+            // a sequential reader is done with the sector, it goes before FAT and directory lines
+            blk->lines[i].stamp = sequential ? 0 : ++blk->stamp;
+            blk->stats.hits++;
+            buff += SD_BLK_SECTOR_SIZE;
+            sector++;
+            count--;
+            continue;
+        }
+        blk->stats.misses++;
+        stream = true;
+        if (count >= SD_BLK_DIRECT_MIN)
+        {
+            // past the prefetched part, the rest goes straight to the caller
+            ret = blk->read(buff, sector, count);
+            blk->stats.io_read++;
+            blk->stats.direct++;
+            if (ret == 0)
+            {
+                sector += count;
+                count = 0;
+            }
+            break;
+        }
+        // fetch the rest of the request in one go, and a full window when the reader is sequential
+        uint32_t n = count;
+        if (sector == blk->next_sector && n < SD_BLK_READ_AHEAD)
+        {
+            n = SD_BLK_READ_AHEAD;
+            if (blk->sectors && sector + n > blk->sectors)
+                n = (blk->sectors - sector > count) ? blk->sectors - sector : count;
+        }
+        ret = blk->read(blk->staging, sector, n);
+        blk->stats.io_read++;
+        if (ret != 0 && n > count)
+        {
+            n = count;
+            ret = blk->read(blk->staging, sector, n);
+            blk->stats.io_read++;
+        }
+        if (ret != 0)
+            break;
+        uint32_t use = n < count ? n : count;
+        memcpy(buff, blk->staging, use * SD_BLK_SECTOR_SIZE);
+        for (uint32_t k = 0; k < n; k++)
+        {
+            int i = sd_blk_insert(blk, sector + k, blk->staging + k * SD_BLK_SECTOR_SIZE);
+            if (sequential && k < use)
+                blk->lines[i].stamp = 0;
+        }
+        blk->stats.read_ahead += n - use;
+        buff += use * SD_BLK_SECTOR_SIZE;
+        sector += use;
+        count -= use;
+    }
+    // cache hits elsewhere (FAT, directory) must not break the stream being followed
+    if (stream)
+        blk->next_sector = sector;
+    sd_blk_unlock(blk);
+    if (sequential && ret == 0)
+        sd_blk_prefetch(blk);
+    return ret;
+}
+
+uint8_t sd_blk_write(sd_blk_t *blk, uint8_t *buff, uint32_t sector, uint32_t count)
+{
+    sd_blk_lock(blk);
+    uint8_t ret = blk->write(buff, sector, count);
+    blk->stats.io_write++;
+    for (uint32_t k = 0; k < count; k++)
+    {
+        int i = sd_blk_find(blk, sector + k);
+        if (i < 0)
+            continue;
+        if (ret == 0)
+            memcpy(blk->cache + i * SD_BLK_SECTOR_SIZE, buff + k * SD_BLK_SECTOR_SIZE, SD_BLK_SECTOR_SIZE);
+        else // the card may hold either version now
+            blk->lines[i].valid = false;
+    }
+    sd_blk_unlock(blk);
+    return ret;
+}
+
+int sd_blk_submit(sd_blk_t *blk, sd_blk_req_t *req)
+{
+    sd_blk_lock(blk);
+    uint8_t next = (blk->tail + 1) % SD_BLK_QUEUE_LEN;
+    if (next == blk->head)
+    {
+        sd_blk_unlock(blk);
+        return -1;
+    }
+    req->state = SD_BLK_REQ_QUEUED;
+    blk->queue[blk->tail] = req;
+    blk->tail = next;
+    sd_blk_unlock(blk);
+    if (blk->hooks.kick)
+        blk->hooks.kick(blk->hooks.arg);
+    else
+        sd_blk_process(blk);
+    return 0;
+}
+
+int sd_blk_process(sd_blk_t *blk)
+{
+    int num = 0;
+    while (1)
+    {
+        sd_blk_lock(blk);
+        if (blk->head == blk->tail)
+        {
+            sd_blk_unlock(blk);
+            break;
+        }
+        sd_blk_req_t *req = blk->queue[blk->head];
+        blk->head = (blk->head + 1) % SD_BLK_QUEUE_LEN;
+        sd_blk_unlock(blk);
+
+        if (req->op == SD_BLK_REQ_PREFETCH)
+            req->result = sd_blk_fill(blk, req->sector, req->count);
+        else if (req->op == SD_BLK_REQ_WRITE)
+            req->result = sd_blk_write(blk, req->buff, req->sector, req->count);
+        else
+            req->result = sd_blk_read(blk, req->buff, req->sector, req->count);
+        req->state = SD_BLK_REQ_DONE;
+        if (req->done)
+            req->done(req, req->arg);
+        num++;
+    }
+    return num;
+}
+
+bool sd_blk_pending(sd_blk_t *blk)
+{
+    return blk->head != blk->tail;
+}
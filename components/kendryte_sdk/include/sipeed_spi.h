@@ -100,6 +100,15 @@ void sipeed_spi_send_data_normal_dma(sipeed_dmac_channel_number_t channel_num,
 											  sipeed_size_t tx_len, 
 											  sipeed_spi_transfer_width_t spi_transfer_width);
 
+void sipeed_spi_receive_data_normal_dma(sipeed_dmac_channel_number_t dma_send_channel_num,
+										 sipeed_dmac_channel_number_t dma_receive_channel_num,
+										 sipeed_spi_device_num_t spi_num,
+										 sipeed_spi_chip_select_t chip_select,
+										 const void *cmd_buff,
+										 sipeed_size_t cmd_len,
+										 void *rx_buff,
+										 sipeed_size_t rx_len);
+
 sipeed_uint32_t sipeed_spi_set_clk_rate(sipeed_spi_device_num_t spi_num, sipeed_uint32_t spi_clk);
 
 void sipeed_spi_transfer_data_standard(spi_device_num_t spi_num, spi_chip_select_t chip_select, const uint8_t *tx_buff,uint8_t *rx_buff,  size_t tx_len, size_t rx_len);
@@ -31,7 +31,7 @@ static void fft_init(uint8_t point, uint8_t mode, uint16_t shift, uint8_t is_dma
     fft->fft_ctrl.fft_data_mode = data_mode;
 }
 
-void fft_complex_uint16_dma(dmac_channel_number_t dma_send_channel_num, dmac_channel_number_t dma_receive_channel_num,
+void fft_complex_uint16_dma_start(dmac_channel_number_t dma_send_channel_num, dmac_channel_number_t dma_receive_channel_num,
                         uint16_t shift, fft_direction_t direction, const uint64_t *input, size_t point_num, uint64_t *output)
 {
     fft_point_t point = FFT_512;
@@ -62,6 +62,12 @@ void fft_complex_uint16_dma(dmac_channel_number_t dma_send_channel_num, dmac_cha
         DMAC_MSIZE_4, DMAC_TRANS_WIDTH_64, point_num>>1);
     dmac_set_single_mode(dma_send_channel_num, input, (void *)(&fft->fft_input_fifo), DMAC_ADDR_INCREMENT, DMAC_ADDR_NOCHANGE,
         DMAC_MSIZE_4, DMAC_TRANS_WIDTH_64, point_num>>1);
+}
+
+void fft_complex_uint16_dma(dmac_channel_number_t dma_send_channel_num, dmac_channel_number_t dma_receive_channel_num,
+                        uint16_t shift, fft_direction_t direction, const uint64_t *input, size_t point_num, uint64_t *output)
+{
+    fft_complex_uint16_dma_start(dma_send_channel_num, dma_receive_channel_num, shift, direction, input, point_num, output);
     dmac_wait_done(dma_receive_channel_num);
 }
 
@@ -239,6 +239,21 @@ void fft_complex_uint16_dma(dmac_channel_number_t dma_send_channel_num,
     size_t point_num,
     uint64_t *output);
 
+/**
+ * @brief       Start a FFT without waiting for it to finish
+ *
+ * @note        Same as fft_complex_uint16_dma, wait with dmac_wait_done(dma_receive_channel_num)
+ *              before touching output or starting the next one. input may be refilled
+ *              for the next transform while this one runs once dma_send_channel_num is idle.
+ */
+void fft_complex_uint16_dma_start(dmac_channel_number_t dma_send_channel_num,
+    dmac_channel_number_t dma_receive_channel_num,
+    uint16_t shift,
+    fft_direction_t direction,
+    const uint64_t *input,
+    size_t point_num,
+    uint64_t *output);
+
 #ifdef __cplusplus
 }
 #endif
@@ -666,6 +666,20 @@ typedef struct
 
 typedef void(*kpu_done_callback_t)(void* userdata);
 
+/* read size bytes at offset of a kmodel image, return 0 on success */
+typedef int (*kpu_model_read_t)(void *userdata, uint32_t offset, uint8_t *buffer, uint32_t size);
+
+typedef struct kpu_model_pager kpu_model_pager_t;
+
+typedef struct
+{
+    uint32_t resident_bytes;  /* layer bodies kept in SRAM */
+    uint32_t resident_layers;
+    uint32_t staging_bytes;   /* buffer the other layers are read into */
+    uint32_t streamed_bytes;  /* read from storage during the last run */
+    uint32_t read_errors;
+} kpu_model_paged_stats_t;
+
 typedef struct
 {
     int is_nncase;
@@ -686,6 +700,8 @@ typedef struct
             dmac_channel_number_t dma_ch;
             kpu_done_callback_t done_callback;
             void *userdata;
+            kpu_model_pager_t *pager; /* NULL when the whole model is in model_buffer */
+            uint32_t dequantize_skipped; /* trailing dequantize layers kpu_run_kmodel leaves out */
         };
 
         struct
@@ -927,6 +943,55 @@ void kpu_dequantize(const uint8_t *src, const quantize_param_t *src_param, size_
  */
 int kpu_load_kmodel(kpu_model_context_t *ctx, const uint8_t *buffer);
 
+/**
+ * @brief       Kpu load kmodel without keeping the whole image in memory
+ *
+ * Only the header, outputs, layer headers and main memory are allocated.
+ * The smallest layer bodies are kept resident up to cache_size bytes,
+ * the rest are read into one staging buffer before the layer runs.
+ * A run stops before a layer that has to be read and calls done_callback,
+ * kpu_model_paged_resume reads it from task context and goes on.
+ * Only kmodel v3 is supported.
+ *
+ * @param[in]   ctx                                 Kmodel object
+ * @param[in]   read                                Reads the image, only called from task context
+ * @param[in]   userdata                            Data of read
+ * @param[in]   cache_size                          Bytes of resident layer bodies
+ *
+ * @return      result
+ *     - 0      Success
+ *     - -2     Not a kmodel v3, or weights outside of their layer body
+ *     - Other  Fail.
+ */
+int kpu_load_kmodel_paged(kpu_model_context_t *ctx, kpu_model_read_t read, void *userdata, uint32_t cache_size);
+
+/**
+ * @brief       Kpu continue a paged run that stopped for a layer body
+ *
+ * Call it after every done_callback of a run until it returns 0 or less,
+ * always 0 for a model that is not paged.
+ *
+ * @param[in]   ctx                                 Kmodel object
+ *
+ * @return      result
+ *     - 1      The body was read and the run goes on, wait for done_callback again
+ *     - 0      The run is finished
+ *     - -1     The read failed, the run is abandoned
+ */
+int kpu_model_paged_resume(kpu_model_context_t *ctx);
+
+/**
+ * @brief       Kpu paged kmodel statistics
+ *
+ * @param[in]   ctx                                 Kmodel object
+ * @param[out]  stats                               Statistics
+ *
+ * @return      result
+ *     - 0      Success
+ *     - Other  Fail, the model is not paged
+ */
+int kpu_get_paged_stats(kpu_model_context_t *ctx, kpu_model_paged_stats_t *stats);
+
 /**
  * @brief       Kpu free kmodel buffer
  *
@@ -949,6 +1014,51 @@ void kpu_model_free(kpu_model_context_t *ctx);
  */
 int kpu_get_output(kpu_model_context_t *ctx, uint32_t index, uint8_t **data, size_t *size);
 
+/**
+ * @brief       Kpu get the uint8 tensor an output is dequantized from
+ *
+ * Only for an output written by a dequantize layer, float = data * q.scale + q.bias.
+ * data is in main memory and valid until the next run.
+ *
+ * @param[in]   ctx                                 Kmodel object
+ * @param[in]   index                               Output index
+ * @param[out]  data                                Quantized data
+ * @param[out]  count                               Number of values
+ * @param[out]  q                                   Quantization of data
+ *
+ * @return      result
+ *     - 0      Success
+ *     - Other  Fail, not a dequantized output, or the float output overwrites data
+ */
+int kpu_get_output_quant(kpu_model_context_t *ctx, uint32_t index, uint8_t **data, size_t *count, kpu_model_quant_param_t *q);
+
+/**
+ * @brief       Kpu leave the trailing dequantize layers out of kpu_run_kmodel
+ *
+ * While they are skipped the float outputs they write are not updated,
+ * read kpu_get_output_quant or call kpu_dequantize_output first.
+ *
+ * @param[in]   ctx                                 Kmodel object
+ * @param[in]   skip                                1 to skip, 0 to run them again
+ *
+ * @return      result
+ *     - >=0    Number of layers skipped
+ *     - Other  Fail.
+ */
+int kpu_skip_dequantize(kpu_model_context_t *ctx, int skip);
+
+/**
+ * @brief       Kpu run the skipped dequantize layer of an output, after a run
+ *
+ * @param[in]   ctx                                 Kmodel object
+ * @param[in]   index                               Output index
+ *
+ * @return      result
+ *     - 0      Success, the float output is up to date
+ *     - Other  Fail.
+ */
+int kpu_dequantize_output(kpu_model_context_t *ctx, uint32_t index);
+
 /**
  * @brief       Kpu run kmodel
  *
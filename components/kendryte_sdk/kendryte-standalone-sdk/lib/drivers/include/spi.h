@@ -423,6 +423,24 @@ void spi_send_data_normal_dma(dmac_channel_number_t channel_num, spi_device_num_
                               spi_chip_select_t chip_select,
                               const void *tx_buff, size_t tx_len, spi_transfer_width_t spi_transfer_width);
 
+/**
+ * @brief       Spi receive data by dma, command and data one word per frame
+ *
+ * @param[in]   dma_send_channel_num        Dmac write channel number
+ * @param[in]   dma_receive_channel_num     Dmac read channel number
+ * @param[in]   spi_num                     Spi bus number
+ * @param[in]   chip_select                 Spi chip select
+ * @param[in]   cmd_buff                    Spi command buffer point
+ * @param[in]   cmd_len                     Spi command length in frames
+ * @param[in]   rx_buff                     Spi receive buffer point
+ * @param[in]   rx_len                      Spi receive length in frames
+ *
+ */
+void spi_receive_data_normal_dma(dmac_channel_number_t dma_send_channel_num,
+                                 dmac_channel_number_t dma_receive_channel_num,
+                                 spi_device_num_t spi_num, spi_chip_select_t chip_select, const void *cmd_buff,
+                                 size_t cmd_len, void *rx_buff, size_t rx_len);
+
 /**
  * @brief       Spi normal send by dma
  *
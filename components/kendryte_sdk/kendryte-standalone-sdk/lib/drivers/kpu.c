@@ -1315,12 +1315,96 @@ static void kpu_logistic(const kpu_model_logistic_layer_argument_t *arg, kpu_mod
         dest[oc] = 1.f / (1.f + expf(-src[oc]));
 }
 
+#define KPU_PAGE_ALIGN 64
+
+typedef struct
+{
+    uint32_t offset;   /* of the body in the image */
+    uint8_t *resident; /* aligned copy, NULL if the body is streamed */
+    void *alloc;
+} kpu_model_page_t;
+
+struct kpu_model_pager
+{
+    kpu_model_read_t read;
+    void *userdata;
+    uint8_t *staging;
+    void *staging_alloc;
+    uint32_t staging_size;
+    uint32_t staging_layer; /* layer held by staging, UINT32_MAX if none */
+    volatile int waiting;   /* the run stopped before current_layer, its body is not read yet */
+    uintptr_t base;         /* image address the offsets of the current layer resolve against */
+    kpu_model_paged_stats_t stats;
+    kpu_model_page_t pages[0];
+};
+
+/* keep (address - offset) aligned like the start of a loaded image */
+static uint8_t *kpu_page_alloc(uint32_t offset, uint32_t size, void **alloc)
+{
+    *alloc = malloc(size + KPU_PAGE_ALIGN * 2);
+    if (!*alloc)
+        return NULL;
+    uintptr_t p = ((uintptr_t)*alloc + KPU_PAGE_ALIGN - 1) & ~(uintptr_t)(KPU_PAGE_ALIGN - 1);
+    return (uint8_t *)(p + (offset & (KPU_PAGE_ALIGN - 1)));
+}
+
+/* body of a layer already in memory, NULL if it has to be read first */
+static const uint8_t *kpu_pager_body(kpu_model_context_t *ctx, uint32_t index)
+{
+    kpu_model_pager_t *pager = ctx->pager;
+    kpu_model_page_t *page = pager->pages + index;
+    uint8_t *body = page->resident;
+    if (!body)
+    {
+        if (pager->staging_layer != index)
+            return NULL;
+        body = pager->staging + (page->offset & (KPU_PAGE_ALIGN - 1));
+    }
+    pager->base = (uintptr_t)body - page->offset;
+    return body;
+}
+
+/* task context only, the read may take the flash driver */
+static const uint8_t *kpu_pager_load(kpu_model_context_t *ctx, uint32_t index)
+{
+    kpu_model_pager_t *pager = ctx->pager;
+    kpu_model_page_t *page = pager->pages + index;
+    if (!page->resident && pager->staging_layer != index)
+    {
+        uint8_t *body = pager->staging + (page->offset & (KPU_PAGE_ALIGN - 1));
+        uint32_t size = ctx->layer_headers[index].body_size;
+        pager->staging_layer = UINT32_MAX;
+        if (pager->read(pager->userdata, page->offset, body, size) != 0)
+        {
+            pager->stats.read_errors++;
+            return NULL;
+        }
+        pager->staging_layer = index;
+        pager->stats.streamed_bytes += size;
+    }
+    return kpu_pager_body(ctx, index);
+}
+
+static uintptr_t kpu_model_layer_base(kpu_model_context_t *ctx)
+{
+    return ctx->pager ? ctx->pager->base : (uintptr_t)ctx->model_buffer;
+}
+
+static void kpu_pager_free(kpu_model_pager_t *pager, uint32_t layers)
+{
+    for (uint32_t i = 0; i < layers; i++)
+        free(pager->pages[i].alloc);
+    free(pager->staging_alloc);
+    free(pager);
+}
+
 static void kpu_conv(const kpu_model_conv_layer_argument_t *arg, kpu_model_context_t *ctx)
 {
-    volatile kpu_layer_argument_t layer = *(const volatile kpu_layer_argument_t *)(ctx->model_buffer + arg->layer_offset);
-    layer.kernel_load_cfg.data.para_start_addr = (uintptr_t)(ctx->model_buffer + arg->weights_offset);
-    layer.kernel_pool_type_cfg.data.bwsx_base_addr = (uintptr_t)(ctx->model_buffer + arg->bn_offset);
-    layer.kernel_calc_type_cfg.data.active_addr = (uintptr_t)(ctx->model_buffer + arg->act_offset);
+    uintptr_t base = kpu_model_layer_base(ctx);
+    volatile kpu_layer_argument_t layer = *(const volatile kpu_layer_argument_t *)(base + arg->layer_offset);
+    layer.kernel_load_cfg.data.para_start_addr = base + arg->weights_offset;
+    layer.kernel_pool_type_cfg.data.bwsx_base_addr = base + arg->bn_offset;
+    layer.kernel_calc_type_cfg.data.active_addr = base + arg->act_offset;
 
     if (arg->flags & KLF_MAIN_MEM_OUT)
     {
@@ -1340,7 +1424,7 @@ static void kpu_conv(const kpu_model_conv_layer_argument_t *arg, kpu_model_conte
         };
         layer.dma_parameter.data.send_data_out = 1;
         sysctl_dma_select(dma_ch, SYSCTL_DMA_SELECT_AI_RX_REQ);
-        if (ctx->current_layer != ctx->layers_length)
+        if (ctx->current_layer != ctx->layers_length - ctx->dequantize_skipped)
             dmac_set_irq(dma_ch, ai_step, ctx, 1);
         else
             dmac_set_irq(dma_ch, (plic_irq_callback_t)kpu_kmodel_done, ctx, 1);
@@ -1427,6 +1511,8 @@ int kpu_load_kmodel(kpu_model_context_t *ctx, const uint8_t *buffer)
     if (header->version == 3 && header->arch == 0)
     {
         ctx->is_nncase = 0;
+        ctx->pager = NULL;
+        ctx->dequantize_skipped = 0;
         ctx->model_buffer = buffer;
         ctx->output_count = header->output_count;
         ctx->outputs = (const kpu_model_output_t *)(base_addr + sizeof(kpu_kmodel_header_t));
@@ -1453,6 +1539,120 @@ int kpu_load_kmodel(kpu_model_context_t *ctx, const uint8_t *buffer)
     return 0;
 }
 
+int kpu_load_kmodel_paged(kpu_model_context_t *ctx, kpu_model_read_t read, void *userdata, uint32_t cache_size)
+{
+    kpu_kmodel_header_t header;
+    if (read(userdata, 0, (uint8_t *)&header, sizeof(header)) != 0)
+        return -1;
+    /* nncase models address their constants directly, they need kpu_load_kmodel */
+    if (header.version != 3 || header.arch != 0)
+        return -2;
+
+    uint32_t layers = header.layers_length;
+    uint32_t head_size = sizeof(kpu_kmodel_header_t) + sizeof(kpu_model_output_t) * header.output_count
+        + sizeof(kpu_model_layer_header_t) * layers;
+    uint8_t *head = (uint8_t *)malloc(head_size);
+    kpu_model_pager_t *pager = (kpu_model_pager_t *)calloc(1, sizeof(kpu_model_pager_t) + sizeof(kpu_model_page_t) * layers);
+    uint32_t *order = (uint32_t *)malloc(sizeof(uint32_t) * layers);
+    int ret = -1;
+    if (!head || !pager || !order || read(userdata, 0, head, head_size) != 0)
+        goto error;
+
+    const kpu_model_layer_header_t *layer_headers = (const kpu_model_layer_header_t *)(head + head_size - sizeof(kpu_model_layer_header_t) * layers);
+    uint32_t offset = head_size;
+    for (uint32_t i = 0; i < layers; i++)
+    {
+        uint32_t size = layer_headers[i].body_size;
+        pager->pages[i].offset = offset;
+        /* a conv layer is relocated as a whole, its tables must live in its own body */
+        if (layer_headers[i].type == KL_K210_CONV)
+        {
+            kpu_model_conv_layer_argument_t arg;
+            if (read(userdata, offset, (uint8_t *)&arg, sizeof(arg)) != 0)
+                goto error;
+            uint32_t end = offset + size;
+            if (arg.layer_offset < offset || arg.layer_offset + sizeof(kpu_layer_argument_t) > end
+                || arg.weights_offset < offset || arg.weights_offset >= end
+                || arg.bn_offset < offset || arg.bn_offset >= end
+                || arg.act_offset < offset || arg.act_offset >= end)
+            {
+                ret = -2;
+                goto error;
+            }
+        }
+        offset += size;
+
+        /* insertion sort by size, the smallest bodies are kept resident first */
+        uint32_t j = i;
+        for (; j > 0 && layer_headers[order[j - 1]].body_size > size; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    uint32_t budget = cache_size;
+    for (uint32_t k = 0; k < layers; k++)
+    {
+        kpu_model_page_t *page = pager->pages + order[k];
+        uint32_t size = layer_headers[order[k]].body_size;
+        if (size > budget)
+            break;
+        page->resident = kpu_page_alloc(page->offset, size, &page->alloc);
+        if (!page->resident || read(userdata, page->offset, page->resident, size) != 0)
+            goto error;
+        budget -= size;
+        pager->stats.resident_bytes += size;
+        pager->stats.resident_layers++;
+    }
+    for (uint32_t i = 0; i < layers; i++)
+    {
+        if (!pager->pages[i].resident && layer_headers[i].body_size > pager->staging_size)
+            pager->staging_size = layer_headers[i].body_size;
+    }
+    if (pager->staging_size)
+    {
+        /* bodies are placed at their offset modulo KPU_PAGE_ALIGN, see kpu_pager_load */
+        pager->staging_alloc = malloc(pager->staging_size + KPU_PAGE_ALIGN * 2);
+        if (!pager->staging_alloc)
+            goto error;
+        pager->staging = (uint8_t *)(((uintptr_t)pager->staging_alloc + KPU_PAGE_ALIGN - 1) & ~(uintptr_t)(KPU_PAGE_ALIGN - 1));
+    }
+    pager->stats.staging_bytes = pager->staging_size;
+    pager->staging_layer = UINT32_MAX;
+    pager->waiting = 0;
+    pager->read = read;
+    pager->userdata = userdata;
+
+    ctx->main_buffer = (uint8_t *)malloc(header.main_mem_usage);
+    if (!ctx->main_buffer)
+        goto error;
+    ctx->is_nncase = 0;
+    ctx->pager = pager;
+    ctx->dequantize_skipped = 0;
+    ctx->model_buffer = head;
+    ctx->output_count = header.output_count;
+    ctx->outputs = (const kpu_model_output_t *)(head + sizeof(kpu_kmodel_header_t));
+    ctx->layer_headers = layer_headers;
+    ctx->layers_length = layers;
+    ctx->body_start = NULL;
+    free(order);
+    return 0;
+
+error:
+    if (pager)
+        kpu_pager_free(pager, layers);
+    free(head);
+    free(order);
+    return ret;
+}
+
+int kpu_get_paged_stats(kpu_model_context_t *ctx, kpu_model_paged_stats_t *stats)
+{
+    if (ctx->is_nncase || !ctx->pager)
+        return -1;
+    *stats = ctx->pager->stats;
+    return 0;
+}
+
 int kpu_get_output(kpu_model_context_t *ctx, uint32_t index, uint8_t **data, size_t *size)
 {
     if(ctx->is_nncase)
@@ -1467,6 +1667,100 @@ int kpu_get_output(kpu_model_context_t *ctx, uint32_t index, uint8_t **data, siz
     return 0;
 }
 
+static int kpu_dequantize_argument(kpu_model_context_t *ctx, uint32_t layer, kpu_model_dequantize_layer_argument_t *arg)
+{
+    const kpu_model_layer_header_t *layer_header = ctx->layer_headers + layer;
+    if (layer_header->type != KL_DEQUANTIZE || layer_header->body_size < sizeof(*arg))
+        return -1;
+    if (ctx->pager)
+    {
+        const kpu_model_page_t *page = ctx->pager->pages + layer;
+        if (page->resident)
+            memcpy(arg, page->resident, sizeof(*arg));
+        else if (ctx->pager->read(ctx->pager->userdata, page->offset, (uint8_t *)arg, sizeof(*arg)) != 0)
+            return -1;
+        return 0;
+    }
+    const uint8_t *body = ctx->body_start;
+    for (uint32_t i = 0; i < layer; i++)
+        body += ctx->layer_headers[i].body_size;
+    memcpy(arg, body, sizeof(*arg));
+    return 0;
+}
+
+/* the trailing dequantize layer writing output index, nothing runs after it */
+static int kpu_output_dequantize_layer(kpu_model_context_t *ctx, uint32_t index, kpu_model_dequantize_layer_argument_t *arg)
+{
+    if (ctx->is_nncase || index >= ctx->output_count)
+        return -1;
+    uint32_t address = ctx->outputs[index].address;
+    for (uint32_t layer = ctx->layers_length; layer-- > 1;)
+    {
+        if (kpu_dequantize_argument(ctx, layer, arg) != 0)
+            return -1;
+        if (arg->main_mem_out_address == address)
+            return layer;
+    }
+    return -1;
+}
+
+int kpu_get_output_quant(kpu_model_context_t *ctx, uint32_t index, uint8_t **data, size_t *count, kpu_model_quant_param_t *q)
+{
+    kpu_model_dequantize_layer_argument_t arg;
+    int layer = kpu_output_dequantize_layer(ctx, index, &arg);
+    if (layer < 0)
+        return -1;
+    if (layer < ctx->layers_length - ctx->dequantize_skipped)
+    {
+        uint32_t in_end = arg.main_mem_in_address + arg.count;
+        uint32_t out_end = arg.main_mem_out_address + arg.count * sizeof(float);
+        if (arg.main_mem_in_address < out_end && arg.main_mem_out_address < in_end)
+            return -1;
+    }
+    *data = ctx->main_buffer + arg.main_mem_in_address;
+    *count = arg.count;
+    *q = arg.quant_param;
+    return 0;
+}
+
+int kpu_skip_dequantize(kpu_model_context_t *ctx, int skip)
+{
+    if (ctx->is_nncase)
+        return -1;
+    uint32_t skipped = 0;
+    if (skip)
+    {
+        kpu_model_dequantize_layer_argument_t arg;
+        /* the first layer always runs */
+        while (skipped + 1 < ctx->layers_length
+            && kpu_dequantize_argument(ctx, ctx->layers_length - skipped - 1, &arg) == 0)
+        {
+            uint32_t i;
+            for (i = 0; i < ctx->output_count; i++)
+            {
+                if (ctx->outputs[i].address == arg.main_mem_out_address)
+                    break;
+            }
+            if (i == ctx->output_count)
+                break;
+            skipped++;
+        }
+    }
+    ctx->dequantize_skipped = skipped;
+    return skipped;
+}
+
+int kpu_dequantize_output(kpu_model_context_t *ctx, uint32_t index)
+{
+    kpu_model_dequantize_layer_argument_t arg;
+    int layer = kpu_output_dequantize_layer(ctx, index, &arg);
+    if (layer < 0)
+        return -1;
+    if (layer >= ctx->layers_length - ctx->dequantize_skipped)
+        kpu_kmodel_dequantize(&arg, ctx);
+    return 0;
+}
+
 void kpu_model_free(kpu_model_context_t *ctx)
 {
     if(ctx->is_nncase)
@@ -1474,6 +1768,13 @@ void kpu_model_free(kpu_model_context_t *ctx)
 
     free(ctx->main_buffer);
     ctx->main_buffer = NULL;
+    if (ctx->pager)
+    {
+        kpu_pager_free(ctx->pager, ctx->layers_length);
+        free((void *)ctx->model_buffer);
+        ctx->pager = NULL;
+        ctx->model_buffer = NULL;
+    }
 }
 
 #if KPU_DEBUG
@@ -1536,7 +1837,7 @@ static const char *str_layer_type(uint32_t type)
 }
 #endif
 
-static int kpu_kmodel_done(kpu_model_context_t *ctx)
+static void kpu_kmodel_irq_off(void)
 {
     kpu->interrupt_clear.data = (kpu_config_interrupt_t)
     {
@@ -1550,6 +1851,11 @@ static int kpu_kmodel_done(kpu_model_context_t *ctx)
         .layer_cfg_almost_empty_int = 1,
         .layer_cfg_almost_full_int = 1
     };
+}
+
+static int kpu_kmodel_done(kpu_model_context_t *ctx)
+{
+    kpu_kmodel_irq_off();
 #if KPU_DEBUG
     uint32_t cnt_layer_id = ctx->current_layer - 1;
     uint64_t time = sysctl_get_time_us();
@@ -1578,6 +1884,20 @@ static int ai_step(void *userdata)
     const uint8_t *layer_body = ctx->current_body;
     const kpu_model_layer_header_t *cnt_layer_header = ctx->layer_headers + cnt_layer_id;
     ctx->current_body += cnt_layer_header->body_size;
+    if (ctx->pager)
+    {
+        layer_body = kpu_pager_body(ctx, cnt_layer_id);
+        if (!layer_body)
+        {
+            /* no flash reads in interrupts, kpu_model_paged_resume reads it and goes on */
+            ctx->current_layer = cnt_layer_id;
+            ctx->current_body -= cnt_layer_header->body_size;
+            kpu_kmodel_irq_off();
+            ctx->pager->waiting = 1;
+            ctx->done_callback(ctx->userdata);
+            return 0;
+        }
+    }
 
 #if KPU_DEBUG
     uint64_t time = sysctl_get_time_us();
@@ -1664,7 +1984,7 @@ static int ai_step(void *userdata)
             assert(!"Layer is not supported.");
     }
 
-    if (cnt_layer_id != (ctx->layers_length - 1))
+    if (cnt_layer_id != (ctx->layers_length - ctx->dequantize_skipped - 1))
         ai_step(userdata);
     else
         kpu_kmodel_done(ctx);
@@ -1678,6 +1998,17 @@ static void ai_step_not_isr(void *userdata)
     sysctl_enable_irq();
 }
 
+int kpu_model_paged_resume(kpu_model_context_t *ctx)
+{
+    if (ctx->is_nncase || !ctx->pager || !ctx->pager->waiting)
+        return 0;
+    ctx->pager->waiting = 0;
+    if (!kpu_pager_load(ctx, ctx->current_layer))
+        return -1;
+    ai_step_not_isr(ctx);
+    return 1;
+}
+
 int kpu_run_kmodel(kpu_model_context_t *ctx, const uint8_t *src, dmac_channel_number_t dma_ch, kpu_done_callback_t done_callback, void *userdata)
 {
     if(ctx->is_nncase)
@@ -1688,6 +2019,15 @@ int kpu_run_kmodel(kpu_model_context_t *ctx, const uint8_t *src, dmac_channel_nu
     ctx->userdata = userdata;
     ctx->current_layer = 0;
     ctx->current_body = ctx->body_start;
+    const uint8_t *first_body = ctx->body_start;
+    if (ctx->pager)
+    {
+        ctx->pager->stats.streamed_bytes = 0;
+        ctx->pager->waiting = 0;
+        first_body = kpu_pager_load(ctx, 0);
+        if (!first_body)
+            return -1;
+    }
 #if KPU_DEBUG
     last_time = 0;
     total_time = 0;
@@ -1721,8 +2061,8 @@ int kpu_run_kmodel(kpu_model_context_t *ctx, const uint8_t *src, dmac_channel_nu
     {
         case KL_K210_CONV:
         {
-            const kpu_model_conv_layer_argument_t *first_layer = (const kpu_model_conv_layer_argument_t *)ctx->body_start;
-            kpu_layer_argument_t layer_arg = *(volatile kpu_layer_argument_t *)(ctx->model_buffer + first_layer->layer_offset);
+            const kpu_model_conv_layer_argument_t *first_layer = (const kpu_model_conv_layer_argument_t *)first_body;
+            kpu_layer_argument_t layer_arg = *(volatile kpu_layer_argument_t *)(kpu_model_layer_base(ctx) + first_layer->layer_offset);
 
             if((layer_arg.image_size.data.i_row_wid + 1) % 64 != 0)
             {
@@ -1737,7 +2077,7 @@ int kpu_run_kmodel(kpu_model_context_t *ctx, const uint8_t *src, dmac_channel_nu
         break;
         case KL_FULLY_CONNECTED:
         {
-            const kpu_model_fully_connected_layer_argument_t *first_layer = (const kpu_model_fully_connected_layer_argument_t *)ctx->body_start;
+            const kpu_model_fully_connected_layer_argument_t *first_layer = (const kpu_model_fully_connected_layer_argument_t *)first_body;
             kpu_kmodel_input_float((const float *)src, (float *)(ctx->main_buffer + first_layer->main_mem_in_address), first_layer->in_channels);
             ai_step_not_isr(ctx);
         }
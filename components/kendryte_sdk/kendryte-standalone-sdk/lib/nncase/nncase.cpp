@@ -40,22 +40,8 @@ class nncase_context
 public:
     int load_kmodel(const uint8_t *buffer)
     {
-        int ret = interpreter_.try_load_model(buffer) ? 0 : -1;
-
-        uint32_t size = interpreter_.model_size(buffer);
-        uint8_t *buffer_iomem = (uint8_t *)((uintptr_t)buffer);
-        const uint8_t *buffer_cache = buffer;
-        memcpy(buffer_iomem, buffer_cache, size);
-        for (int i = 0; i < size; i++)
-        {
-            if (buffer_iomem[i] != buffer_cache[i])
-            {
-                printf("flush model fail:%d %x %x \n", i, buffer_iomem[i], buffer_cache[i]);
-                while (1)
-                    ;
-            }
-        }
-        return ret;
+        // the model is read through the same address the loader wrote it to, nothing to flush
+        return interpreter_.try_load_model(buffer) ? 0 : -1;
     }
 
     int get_output(uint32_t index, uint8_t **data, size_t *size)
@@ -92,6 +92,14 @@ void sipeed_spi_send_data_normal_dma(sipeed_dmac_channel_number_t channel_num, s
 
 }
 
+void sipeed_spi_receive_data_normal_dma(sipeed_dmac_channel_number_t dma_send_channel_num,
+                                 sipeed_dmac_channel_number_t dma_receive_channel_num,
+                                 sipeed_spi_device_num_t spi_num, sipeed_spi_chip_select_t chip_select, const void *cmd_buff,
+                                 sipeed_size_t cmd_len, void *rx_buff, sipeed_size_t rx_len)
+{
+    spi_receive_data_normal_dma(dma_send_channel_num, dma_receive_channel_num, spi_num, chip_select, cmd_buff, cmd_len, rx_buff, rx_len);
+}
+
 sipeed_uint32_t sipeed_spi_set_clk_rate(sipeed_spi_device_num_t spi_num, sipeed_uint32_t spi_clk)
 {
     return spi_set_clk_rate( spi_num, spi_clk);
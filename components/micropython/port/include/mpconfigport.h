@@ -326,6 +326,30 @@ extern const struct _mp_obj_module_t video_module;
 #define MAIXPY_PY_VIDEO_DEF 
 #endif
 
+// mjpeg http stream
+#ifndef CONFIG_MAIXPY_MJPEG_STREAM_ENABLE
+#define CONFIG_MAIXPY_MJPEG_STREAM_ENABLE   (0)
+#endif //CONFIG_MAIXPY_MJPEG_STREAM_ENABLE
+#if CONFIG_MAIXPY_MJPEG_STREAM_ENABLE
+extern const struct _mp_obj_module_t mjpeg_stream_module;
+#define MAIXPY_PY_MJPEG_STREAM_DEF \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_mjpeg_stream), (mp_obj_t)&mjpeg_stream_module },
+#else
+#define MAIXPY_PY_MJPEG_STREAM_DEF 
+#endif
+
+// camera -> kpu -> lcd pipeline
+#ifndef CONFIG_MAIXPY_PIPELINE_ENABLE
+#define CONFIG_MAIXPY_PIPELINE_ENABLE   (0)
+#endif //CONFIG_MAIXPY_PIPELINE_ENABLE
+#if CONFIG_MAIXPY_PIPELINE_ENABLE
+extern const struct _mp_obj_module_t pipeline_module;
+#define MAIXPY_PY_PIPELINE_DEF \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_pipeline), (mp_obj_t)&pipeline_module },
+#else
+#define MAIXPY_PY_PIPELINE_DEF 
+#endif
+
 // nes game emulator
 #ifndef CONFIG_MAIXPY_NES_ENABLE
 #endif //CONFIG_MAIXPY_NES_ENABLE
@@ -425,6 +449,8 @@ extern const struct _mp_obj_module_t mp_module_touchscreen;
     MAIXPY_PY_SPEECH_RECOGNIZER_DEF \
     MAIXPY_PY_NES_DEF \
     MAIXPY_PY_VIDEO_DEF \
+    MAIXPY_PY_MJPEG_STREAM_DEF \
+    MAIXPY_PY_PIPELINE_DEF \
     MAIXPY_PY_LVGL_DEF \
     MAIXPY_PY_LODEPNG_DEF \
     MAIXPY_PY_TOUCHSCREEN_DEF
@@ -179,10 +179,310 @@ STATIC mp_obj_t Maix_fft_amplitude(const mp_obj_t list_obj)
 }
 MP_DEFINE_CONST_FUN_OBJ_1(Maix_fft_amplitude_obj, Maix_fft_amplitude);
 
+//----------------plan: many frames, buffers allocated once------------------------
+
+typedef enum _fft_plan_window_t{
+    FFT_WINDOW_NONE = 0,
+    FFT_WINDOW_HANN,
+    FFT_WINDOW_HAMMING,
+}fft_plan_window_t;
+
+typedef enum _fft_plan_output_t{
+    FFT_OUT_COMPLEX = 0,    //'h', R,I for every bin
+    FFT_OUT_MAGNITUDE,      //'H', first points/2 bins
+    FFT_OUT_POWER,          //'I', first points/2 bins
+}fft_plan_output_t;
+
+typedef struct _Maix_fft_plan_obj_t {
+    mp_obj_base_t base;
+    uint16_t points;
+    uint16_t shift;
+    uint8_t direction;
+    uint8_t output;
+    bool overlap;
+    int16_t* window;        //Q15, NULL for none
+    uint64_t* dma_in[2];
+    uint64_t* dma_out[2];
+} Maix_fft_plan_obj_t;
+
+const mp_obj_type_t Maix_fft_plan_type;
+
+static inline int16_t fft_plan_sample(const void* src, uint8_t size, size_t index)
+{
+    if(size == 2)
+        return ((const int16_t*)src)[index];
+    return (int16_t)((const uint32_t*)src)[index];//same as run(), low 16 bits of an I2S word
+}
+
+//repack one frame for the accelerator, windowing on the way
+STATIC void fft_plan_load(Maix_fft_plan_obj_t* plan, const void* src, uint8_t size, size_t start, uint64_t* dst)
+{
+    fft_data_t* input_data = (fft_data_t*)dst;
+    for(int i = 0; i < plan->points / 2; ++i)
+    {
+        int32_t r1 = fft_plan_sample(src, size, start + 2*i);
+        int32_t r2 = fft_plan_sample(src, size, start + 2*i + 1);
+        if(plan->window)
+        {
+            r1 = (r1 * plan->window[2*i]) >> 15;
+            r2 = (r2 * plan->window[2*i+1]) >> 15;
+        }
+        input_data[i].R1 = r1;
+        input_data[i].I1 = 0;
+        input_data[i].R2 = r2;
+        input_data[i].I2 = 0;
+    }
+}
+
+static inline uint32_t fft_plan_isqrt(uint32_t x)
+{
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+    while(bit > x)
+        bit >>= 2;
+    while(bit)
+    {
+        if(x >= res + bit)
+        {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        }
+        else
+            res >>= 1;
+        bit >>= 2;
+    }
+    return res;
+}
+
+STATIC void fft_plan_store(Maix_fft_plan_obj_t* plan, const uint64_t* src, void* out, size_t frame)
+{
+    const fft_data_t* output_data = (const fft_data_t*)src;
+    if(plan->output == FFT_OUT_COMPLEX)
+    {
+        int16_t* dst = (int16_t*)out + frame * plan->points * 2;
+        for(int i = 0; i < plan->points / 2; i++)
+        {
+            dst[4*i] = output_data[i].R1;
+            dst[4*i+1] = output_data[i].I1;
+            dst[4*i+2] = output_data[i].R2;
+            dst[4*i+3] = output_data[i].I2;
+        }
+        return;
+    }
+    uint16_t bins = plan->points / 2;
+    for(int i = 0; i < bins / 2; i++)
+    {
+        int32_t r1 = output_data[i].R1, i1 = output_data[i].I1;
+        int32_t r2 = output_data[i].R2, i2 = output_data[i].I2;
+        uint32_t p1 = (uint32_t)(r1 * r1) + (uint32_t)(i1 * i1);//up to 2^31, no room for sign
+        uint32_t p2 = (uint32_t)(r2 * r2) + (uint32_t)(i2 * i2);
+        if(plan->output == FFT_OUT_POWER)
+        {
+            uint32_t* dst = (uint32_t*)out + frame * bins;
+            dst[2*i] = p1;
+            dst[2*i+1] = p2;
+        }
+        else
+        {
+            uint16_t* dst = (uint16_t*)out + frame * bins;
+            dst[2*i] = fft_plan_isqrt(p1);
+            dst[2*i+1] = fft_plan_isqrt(p2);
+        }
+    }
+}
+
+STATIC mp_obj_t Maix_fft_plan(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    enum{ARG_points,
+         ARG_window,
+         ARG_output,
+         ARG_shift,
+         ARG_direction,
+         ARG_overlap,
+    };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_points, MP_ARG_INT, {.u_int = 512} },
+        { MP_QSTR_window, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = FFT_WINDOW_HANN} },
+        { MP_QSTR_output, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = FFT_OUT_POWER} },
+        { MP_QSTR_shift, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_direction, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = FFT_DIR_FORWARD} },
+        { MP_QSTR_overlap, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+    uint32_t points = args[ARG_points].u_int;
+    if(points != 64 && points != 128 && points != 256 && points != 512)
+    {
+        mp_raise_ValueError("[CANMV]FFT:invalid points");
+    }
+    if(args[ARG_window].u_int > FFT_WINDOW_HAMMING)
+    {
+        mp_raise_ValueError("[CANMV]FFT:invalid window");
+    }
+    if(args[ARG_output].u_int > FFT_OUT_POWER)
+    {
+        mp_raise_ValueError("[CANMV]FFT:invalid output");
+    }
+
+    Maix_fft_plan_obj_t* plan = m_new_obj(Maix_fft_plan_obj_t);
+    plan->base.type = &Maix_fft_plan_type;
+    plan->points = points;
+    plan->shift = args[ARG_shift].u_int;
+    plan->direction = args[ARG_direction].u_int;
+    plan->output = args[ARG_output].u_int;
+    plan->overlap = args[ARG_overlap].u_bool;
+    plan->window = NULL;
+    if(args[ARG_window].u_int != FFT_WINDOW_NONE)
+    {
+        float a0 = args[ARG_window].u_int == FFT_WINDOW_HANN ? 0.5f : 0.54f;
+        plan->window = m_new(int16_t, points);
+        for(int i = 0; i < points; i++)//periodic form, right for spectral analysis
+            plan->window[i] = (int16_t)(32767.0f * (a0 - (1.0f - a0) * cosf(2.0f * (float)M_PI * i / points)));
+    }
+    for(int i = 0; i < 2; i++)
+    {
+        plan->dma_in[i] = m_new(uint64_t, points / 2);
+        plan->dma_out[i] = m_new(uint64_t, points / 2);
+    }
+    return MP_OBJ_FROM_PTR(plan);
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(Maix_fft_plan_obj, 0, Maix_fft_plan);
+
+//run(input, output=None, hop=points, frames=0)
+//input is a buffer of 16-bit samples ('h'/'H' arrays) or 32-bit I2S words (anything else, as run()).
+//Returns the output array, frames are back to back in it
+STATIC mp_obj_t Maix_fft_plan_run(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    Maix_fft_plan_obj_t* plan = MP_OBJ_TO_PTR(pos_args[0]);
+    enum{ARG_input,
+         ARG_output,
+         ARG_hop,
+         ARG_frames,
+    };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_input, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_output, MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_hop, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_frames, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t in_info;
+    mp_get_buffer_raise(args[ARG_input].u_obj, &in_info, MP_BUFFER_READ);
+    uint8_t size = (in_info.typecode == 'h' || in_info.typecode == 'H') ? 2 : 4;
+    size_t samples = in_info.len / size;
+    size_t hop = args[ARG_hop].u_int > 0 ? args[ARG_hop].u_int : plan->points;
+    if(samples < plan->points)
+    {
+        mp_raise_ValueError("[CANMV]FFT:input shorter than one frame");
+    }
+    size_t frames = (samples - plan->points) / hop + 1;
+    if(args[ARG_frames].u_int > 0 && args[ARG_frames].u_int < frames)
+        frames = args[ARG_frames].u_int;
+
+    size_t bins = plan->output == FFT_OUT_COMPLEX ? plan->points * 2 : plan->points / 2;
+    uint8_t out_size = plan->output == FFT_OUT_POWER ? 4 : 2;
+    mp_obj_t out_obj = args[ARG_output].u_obj;
+    void* out;
+    if(out_obj == mp_const_none)
+    {
+        mp_obj_array_t* out_array = m_new_obj(mp_obj_array_t);
+        out_array->base.type = &mp_type_array;
+        out_array->typecode = plan->output == FFT_OUT_POWER ? 'I' : (plan->output == FFT_OUT_MAGNITUDE ? 'H' : 'h');
+        out_array->free = 0;
+        out_array->len = frames * bins;
+        out_array->items = m_new(uint8_t, frames * bins * out_size);
+        out = out_array->items;
+        out_obj = MP_OBJ_FROM_PTR(out_array);
+    }
+    else
+    {
+        mp_buffer_info_t out_info;
+        mp_get_buffer_raise(out_obj, &out_info, MP_BUFFER_WRITE);
+        if(out_info.len < frames * bins * out_size)
+        {
+            mp_raise_ValueError("[CANMV]FFT:output buffer too small");
+        }
+        out = out_info.buf;
+    }
+
+    //with overlap, frame N+1 is windowed into the other input buffer and frame N-1 is
+    //converted out of the other output buffer while the accelerator works on frame N
+    fft_plan_load(plan, in_info.buf, size, 0, plan->dma_in[0]);
+    for(size_t f = 0; f < frames; f++)
+    {
+        int cur = plan->overlap ? (f & 1) : 0;
+        fft_complex_uint16_dma_start(DMAC_CHANNEL3, DMAC_CHANNEL4, plan->shift, plan->direction, plan->dma_in[cur], plan->points, plan->dma_out[cur]);
+        if(plan->overlap)
+        {
+            if(f + 1 < frames)
+                fft_plan_load(plan, in_info.buf, size, (f + 1) * hop, plan->dma_in[cur ^ 1]);
+            if(f > 0)
+                fft_plan_store(plan, plan->dma_out[cur ^ 1], out, f - 1);
+            dmac_wait_done(DMAC_CHANNEL4);
+        }
+        else
+        {
+            dmac_wait_done(DMAC_CHANNEL4);
+            fft_plan_store(plan, plan->dma_out[0], out, f);
+            if(f + 1 < frames)
+                fft_plan_load(plan, in_info.buf, size, (f + 1) * hop, plan->dma_in[0]);
+        }
+    }
+    if(plan->overlap)
+        fft_plan_store(plan, plan->dma_out[(frames - 1) & 1], out, frames - 1);
+    return out_obj;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(Maix_fft_plan_run_obj, 2, Maix_fft_plan_run);
+
+//number of frames run() produces for `samples` input samples
+STATIC mp_obj_t Maix_fft_plan_frames(size_t n_args, const mp_obj_t *args)
+{
+    Maix_fft_plan_obj_t* plan = MP_OBJ_TO_PTR(args[0]);
+    mp_int_t samples = mp_obj_get_int(args[1]);
+    mp_int_t hop = n_args > 2 ? mp_obj_get_int(args[2]) : plan->points;
+    if(hop <= 0)
+        hop = plan->points;
+    if(samples < plan->points)
+        return MP_OBJ_NEW_SMALL_INT(0);
+    return mp_obj_new_int((samples - plan->points) / hop + 1);
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(Maix_fft_plan_frames_obj, 2, 3, Maix_fft_plan_frames);
+
+STATIC void Maix_fft_plan_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    Maix_fft_plan_obj_t* plan = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "[CANMV]FFT plan:(points=%u, window=%s, output=%u, overlap=%u)",
+        plan->points, plan->window ? "yes" : "none", plan->output, plan->overlap);
+}
+
+STATIC const mp_rom_map_elem_t Maix_fft_plan_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_run), MP_ROM_PTR(&Maix_fft_plan_run_obj) },
+    { MP_ROM_QSTR(MP_QSTR_frames), MP_ROM_PTR(&Maix_fft_plan_frames_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(Maix_fft_plan_dict, Maix_fft_plan_locals_dict_table);
+
+const mp_obj_type_t Maix_fft_plan_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_FFTPlan,
+    .print = Maix_fft_plan_print,
+    .locals_dict = (mp_obj_dict_t*)&Maix_fft_plan_dict,
+};
+
 STATIC const mp_rom_map_elem_t Maix_fft_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_run), MP_ROM_PTR(&Maix_fft_run_obj) },
     { MP_ROM_QSTR(MP_QSTR_freq), MP_ROM_PTR(&Maix_fft_freq_obj) },
     { MP_ROM_QSTR(MP_QSTR_amplitude), MP_ROM_PTR(&Maix_fft_amplitude_obj) },
+    { MP_ROM_QSTR(MP_QSTR_plan), MP_ROM_PTR(&Maix_fft_plan_obj) },
+
+    { MP_ROM_QSTR(MP_QSTR_WINDOW_NONE), MP_ROM_INT(FFT_WINDOW_NONE) },
+    { MP_ROM_QSTR(MP_QSTR_WINDOW_HANN), MP_ROM_INT(FFT_WINDOW_HANN) },
+    { MP_ROM_QSTR(MP_QSTR_WINDOW_HAMMING), MP_ROM_INT(FFT_WINDOW_HAMMING) },
+    { MP_ROM_QSTR(MP_QSTR_OUT_COMPLEX), MP_ROM_INT(FFT_OUT_COMPLEX) },
+    { MP_ROM_QSTR(MP_QSTR_OUT_MAGNITUDE), MP_ROM_INT(FFT_OUT_MAGNITUDE) },
+    { MP_ROM_QSTR(MP_QSTR_OUT_POWER), MP_ROM_INT(FFT_OUT_POWER) },
     
 };
 
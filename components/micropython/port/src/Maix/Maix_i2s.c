@@ -15,6 +15,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "i2s.h"
@@ -24,9 +25,11 @@
 #include "py/obj.h"
 #include "py/runtime.h"
 #include "py/mphal.h"
+#include "py/mperrno.h"
 
 #include "modMaix.h"
 #include "py_audio.h"
+#include "audio_out.h"
 #include "Maix_i2s.h"
 #define MAX_SAMPLE_RATE (4*1024*1024)
 #define MAX_SAMPLE_POINTS (64*1024)
@@ -103,6 +106,8 @@ STATIC mp_obj_t Maix_i2s_make_new(const mp_obj_type_t *type, size_t n_args, size
     self->base.type = &Maix_i2s_type;
     self->i2s_num = i2s_num;
     self->sample_rate = 0;
+    self->ring = NULL;
+    self->ring_audio = NULL;
     memset(&self->channel,0,4 * sizeof(i2s_channle_t));
 
     // init instance
@@ -225,6 +230,7 @@ STATIC mp_obj_t Maix_i2s_set_sample_rate(void* self_, mp_obj_t sample_rate)
     {
         self->sample_rate = res / 64;
     }
+    audio_out_set_rate(self->i2s_num, self->sample_rate);
     return mp_const_true;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(Maix_i2s_set_sample_rate_obj,Maix_i2s_set_sample_rate);
@@ -298,6 +304,205 @@ STATIC mp_obj_t Maix_i2s_wait_record(void*self_)
 }
 MP_DEFINE_CONST_FUN_OBJ_1(Maix_i2s_wait_record_obj, Maix_i2s_wait_record);
 
+//----------------continuous capture------------------------
+
+STATIC int Maix_i2s_ring_irq(void *ctx)
+{
+    i2s_ring_t* ring = (i2s_ring_t*)ctx;
+    if(!ring->running)
+        return 0;
+    uint8_t done = ring->dma_block;
+    ring->state[done] = I2S_BLOCK_READY;
+    ring->fifo[(ring->fifo_head + ring->fifo_len) % ring->blocks] = done;
+    ring->fifo_len++;
+    ring->captured++;
+
+    int next = -1;
+    for(int i = 1; i < ring->blocks; i++)
+    {
+        uint8_t b = (done + i) % ring->blocks;
+        if(ring->state[b] == I2S_BLOCK_FREE)
+        {
+            next = b;
+            break;
+        }
+    }
+    if(next < 0)//reader is behind, drop the oldest complete block
+    {
+        next = ring->fifo[ring->fifo_head];
+        ring->fifo_head = (ring->fifo_head + 1) % ring->blocks;
+        ring->fifo_len--;
+        ring->overruns++;
+    }
+    ring->state[next] = I2S_BLOCK_DMA;
+    ring->dma_block = next;
+    i2s_receive_data_dma(ring->i2s_num, ring->buf + next * ring->block_points, ring->block_points, ring->dma);
+    return 0;
+}
+
+STATIC void Maix_i2s_capture_free(Maix_i2s_obj_t* self)
+{
+    i2s_ring_t* ring = self->ring;
+    if(ring == NULL)
+        return;
+    ring->running = false;//the irq stops chaining blocks
+    //let the block in flight finish, but only while the channel still runs, and not for
+    //longer than two blocks take: a stopped I2S clock would leave it running forever
+    uint32_t rate = self->sample_rate ? self->sample_rate : 8000;
+    uint64_t deadline = sysctl_get_time_us() + 2ULL * ring->block_points * 1000000 / rate;
+    while(!dmac_is_idle(ring->dma) && sysctl_get_time_us() < deadline)
+        ;
+    dmac_channel_disable(ring->dma);
+    dmac_free_irq(ring->dma);
+    if(self->ring_audio)
+    {
+        for(int i = 0; i < ring->blocks; i++)
+        {
+            Maix_audio_obj_t* audio_obj = MP_OBJ_TO_PTR(self->ring_audio[i]);
+            audio_obj->audio.buf = NULL;
+            audio_obj->audio.points = 0;
+        }
+        m_del(mp_obj_t, self->ring_audio, ring->blocks);
+        self->ring_audio = NULL;
+    }
+    free(ring->buf);
+    free(ring);
+    self->ring = NULL;
+}
+
+STATIC mp_obj_t Maix_i2s_capture(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    Maix_i2s_obj_t *self = pos_args[0];
+    enum{ARG_points,
+         ARG_blocks,
+         ARG_dma,
+    };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_points, MP_ARG_INT, {.u_int = 1024} },
+        { MP_QSTR_blocks, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 4} },
+        { MP_QSTR_dma, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = DMAC_CHANNEL2} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    uint32_t points = args[ARG_points].u_int;
+    uint32_t blocks = args[ARG_blocks].u_int;
+    if(points == 0 || points > MAX_SAMPLE_POINTS)
+        mp_raise_ValueError("[CANMV]I2S:invalid buffer length");
+    if(blocks < 2 || blocks > I2S_RING_MAX_BLOCKS)
+        mp_raise_ValueError("[CANMV]I2S:blocks must be 2-16");
+    if(args[ARG_dma].u_int >= DMAC_CHANNEL_MAX)
+        mp_raise_ValueError("[CANMV]I2S:invalid dma channel");
+
+    Maix_i2s_capture_free(self);
+    //the DMA keeps writing after the I2S object is dropped until stopped, so stay out of the GC heap
+    i2s_ring_t* ring = (i2s_ring_t*)malloc(sizeof(i2s_ring_t));
+    if(ring == NULL)
+        mp_raise_OSError(MP_ENOMEM);
+    memset(ring, 0, sizeof(i2s_ring_t));
+    ring->buf = (uint32_t*)malloc(blocks * points * sizeof(uint32_t));
+    if(ring->buf == NULL)
+    {
+        free(ring);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    ring->i2s_num = self->i2s_num;
+    ring->dma = args[ARG_dma].u_int;
+    ring->block_points = points;
+    ring->blocks = blocks;
+    ring->held = -1;
+    self->ring = ring;
+
+    self->ring_audio = m_new(mp_obj_t, blocks);
+    for(int i = 0; i < blocks; i++)
+    {
+        Maix_audio_obj_t *audio_obj = m_new_obj(Maix_audio_obj_t);
+        memset(audio_obj, 0, sizeof(Maix_audio_obj_t));
+        audio_obj->base.type = &Maix_audio_type;
+        audio_obj->audio.type = I2S_AUDIO;
+        audio_obj->audio.dev = self;
+        audio_obj->audio.buf = ring->buf + i * points;
+        audio_obj->audio.points = points;
+        self->ring_audio[i] = MP_OBJ_FROM_PTR(audio_obj);
+    }
+
+    ring->running = true;
+    ring->state[0] = I2S_BLOCK_DMA;
+    ring->dma_block = 0;
+    dmac_irq_register(ring->dma, Maix_i2s_ring_irq, ring, 1);
+    i2s_receive_data_dma(ring->i2s_num, ring->buf, points, ring->dma);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(Maix_i2s_capture_obj, 1, Maix_i2s_capture);
+
+//returns the oldest complete block as an Audio that points into the ring (no copy),
+//valid until the next capture_read. None on timeout
+STATIC mp_obj_t Maix_i2s_capture_read(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    Maix_i2s_obj_t *self = pos_args[0];
+    enum{ARG_timeout,
+    };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timeout, MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    i2s_ring_t* ring = self->ring;
+    if(ring == NULL)
+        mp_raise_msg(&mp_type_OSError, "[CANMV]I2S:capture not started");
+
+    mp_int_t timeout = args[ARG_timeout].u_int;
+    mp_uint_t start = mp_hal_ticks_ms();
+    int block = -1;
+    while(1)
+    {
+        mp_uint_t atomic_state = MICROPY_BEGIN_ATOMIC_SECTION();
+        if(ring->held >= 0)
+        {
+            ring->state[ring->held] = I2S_BLOCK_FREE;
+            ring->held = -1;
+        }
+        if(ring->fifo_len)
+        {
+            block = ring->fifo[ring->fifo_head];
+            ring->fifo_head = (ring->fifo_head + 1) % ring->blocks;
+            ring->fifo_len--;
+            ring->state[block] = I2S_BLOCK_HELD;
+            ring->held = block;
+        }
+        MICROPY_END_ATOMIC_SECTION(atomic_state);
+        if(block >= 0)
+            break;
+        if(timeout >= 0 && mp_hal_ticks_ms() - start >= timeout)
+            return mp_const_none;
+        MICROPY_EVENT_POLL_HOOK
+    }
+    return self->ring_audio[block];
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(Maix_i2s_capture_read_obj, 1, Maix_i2s_capture_read);
+
+//(captured blocks, overruns, blocks ready to read)
+STATIC mp_obj_t Maix_i2s_capture_stats(void*self_)
+{
+    Maix_i2s_obj_t* self = (Maix_i2s_obj_t*)self_;
+    i2s_ring_t* ring = self->ring;
+    mp_obj_t tuple[3] = {
+        mp_obj_new_int_from_uint(ring ? ring->captured : 0),
+        mp_obj_new_int_from_uint(ring ? ring->overruns : 0),
+        MP_OBJ_NEW_SMALL_INT(ring ? ring->fifo_len : 0),
+    };
+    return mp_obj_new_tuple(3, tuple);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(Maix_i2s_capture_stats_obj, Maix_i2s_capture_stats);
+
+STATIC mp_obj_t Maix_i2s_capture_stop(void*self_)
+{
+    Maix_i2s_capture_free((Maix_i2s_obj_t*)self_);
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(Maix_i2s_capture_stop_obj, Maix_i2s_capture_stop);
+
 STATIC mp_obj_t Maix_i2s_play(void*self_, mp_obj_t audio_obj)
 {
     Maix_i2s_obj_t* self = (Maix_i2s_obj_t*)self_;
@@ -310,6 +515,7 @@ MP_DEFINE_CONST_FUN_OBJ_2(Maix_i2s_play_obj,Maix_i2s_play);
 STATIC mp_obj_t Maix_i2s_deinit(void*self_)
 {
     Maix_i2s_obj_t* self = (Maix_i2s_obj_t*)self_;
+    Maix_i2s_capture_free(self);
     m_del(uint32_t,self->buf,self->points_num);
     m_del_obj(Maix_i2s_obj_t,self);
     return mp_const_none;
@@ -328,6 +534,10 @@ STATIC const mp_rom_map_elem_t Maix_i2s_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_record),          MP_ROM_PTR(&Maix_i2s_record_obj) },
     { MP_ROM_QSTR(MP_QSTR_wait_record),          MP_ROM_PTR(&Maix_i2s_wait_record_obj) },
     { MP_ROM_QSTR(MP_QSTR_play),            MP_ROM_PTR(&Maix_i2s_play_obj) },
+    { MP_ROM_QSTR(MP_QSTR_capture),         MP_ROM_PTR(&Maix_i2s_capture_obj) },
+    { MP_ROM_QSTR(MP_QSTR_capture_read),    MP_ROM_PTR(&Maix_i2s_capture_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_capture_stats),   MP_ROM_PTR(&Maix_i2s_capture_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_capture_stop),    MP_ROM_PTR(&Maix_i2s_capture_stop_obj) },
     //advance interface , some user don't use it
     // { MP_ROM_QSTR(MP_QSTR_set_dma_divede_16), MP_ROM_PTR(&Maix_i2s_set_dma_divede_16_obj) },
     // { MP_ROM_QSTR(MP_QSTR_set_dma_divede_16), MP_ROM_PTR(&Maix_i2s_get_dma_divede_16_obj) },
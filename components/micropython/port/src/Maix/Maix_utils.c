@@ -58,7 +58,7 @@ MP_DEFINE_CONST_FUN_OBJ_0(py_heap_free_obj, py_heap_free);
 STATIC mp_obj_t py_flash_read(mp_obj_t addr, mp_obj_t len_in) {
     size_t length = mp_obj_get_int(len_in);
     byte* data = m_new(byte, length);
-    w25qxx_status_t status = w25qxx_read_data_dma(mp_obj_get_int(addr), data, (uint32_t)length, W25QXX_QUAD_FAST);
+    w25qxx_status_t status = w25qxx_cache_read(mp_obj_get_int(addr), data, (uint32_t)length);
     if(status != W25QXX_OK)
     {
         mp_raise_OSError(MP_EIO);
@@ -68,6 +68,21 @@ STATIC mp_obj_t py_flash_read(mp_obj_t addr, mp_obj_t len_in) {
 
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_flash_read_obj, py_flash_read);
 
+// (erases, erase_requests, page_programs, writes) since boot, for flash wear monitoring
+STATIC mp_obj_t py_flash_stats(void) {
+    w25qxx_cache_stats_t stats;
+    w25qxx_cache_get_stats(&stats);
+    mp_obj_t tuple[4] = {
+        mp_obj_new_int_from_uint(stats.erases),
+        mp_obj_new_int_from_uint(stats.erase_requests),
+        mp_obj_new_int_from_uint(stats.page_programs),
+        mp_obj_new_int_from_uint(stats.writes),
+    };
+    return mp_obj_new_tuple(4, tuple);
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_flash_stats_obj, py_flash_stats);
+
 static const mp_map_elem_t locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__),        MP_OBJ_NEW_QSTR(MP_QSTR_utils) },
     { MP_ROM_QSTR(MP_QSTR_gc_heap_size),    (mp_obj_t)(&py_gc_heap_size_obj) },
@@ -75,6 +90,7 @@ static const mp_map_elem_t locals_dict_table[] = {
     // { MP_ROM_QSTR(MP_QSTR_malloc),    (mp_obj_t)(&py_malloc_obj) },
     // { MP_ROM_QSTR(MP_QSTR_free),    (mp_obj_t)(&py_free_obj) },
     { MP_ROM_QSTR(MP_QSTR_flash_read),    (mp_obj_t)(&py_flash_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_flash_stats),    (mp_obj_t)(&py_flash_stats_obj) },
     // { MP_ROM_QSTR(MP_QSTR_flash_write),    (mp_obj_t)(&py_flash_write_obj) },
 };
 STATIC MP_DEFINE_CONST_DICT(locals_dict, locals_dict_table);
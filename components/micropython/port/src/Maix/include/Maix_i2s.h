@@ -1,8 +1,37 @@
 #ifndef MICROPY_MAIX_I2S_H
 #define MICROPY_MAIX_I2S_H
 
+#include <stdbool.h>
 #include "py/obj.h"
 #include "i2s.h"
+#include "dmac.h"
+
+#define I2S_RING_MAX_BLOCKS 16
+
+typedef enum _i2s_block_state_t{
+    I2S_BLOCK_FREE = 0,
+    I2S_BLOCK_DMA,      //being filled
+    I2S_BLOCK_READY,    //complete, waiting for capture_read
+    I2S_BLOCK_HELD,     //handed out by capture_read, kept until the next read
+}i2s_block_state_t;
+
+//continuous capture, DMA moves from block to block and never waits for the reader
+typedef struct _i2s_ring_t{
+    i2s_device_number_t i2s_num;
+    dmac_channel_number_t dma;
+    uint32_t* buf;              //blocks * block_points words
+    uint32_t block_points;
+    uint8_t blocks;
+    volatile uint8_t state[I2S_RING_MAX_BLOCKS];
+    volatile uint8_t fifo[I2S_RING_MAX_BLOCKS];  //ready blocks, oldest first
+    volatile uint8_t fifo_head;
+    volatile uint8_t fifo_len;
+    volatile uint8_t dma_block;
+    int8_t held;
+    volatile bool running;
+    volatile uint32_t captured;
+    volatile uint32_t overruns;  //ready blocks overwritten before they were read
+}i2s_ring_t;
 typedef struct _i2s_channle_t{
     i2s_word_length_t resolution;
     i2s_word_select_cycles_t cycles;
@@ -19,5 +48,7 @@ typedef struct _Maix_i2s_obj_t {
     uint32_t* buf;
     i2s_word_select_cycles_t cycles;
     uint32_t chn_mask;
+    i2s_ring_t* ring;
+    mp_obj_t* ring_audio;       //one Audio per block, pointing into the ring
 } Maix_i2s_obj_t;
 #endif
\ No newline at end of file
@@ -32,6 +32,11 @@
 
 #include "yolo2_region_layer.h"
 #include "kpu_algorithm.h"
+#include "kpu_gallery.h"
+#include "Maix_kpu.h"
+#if CONFIG_MAIXPY_PIPELINE_ENABLE
+#include "pipeline.h"
+#endif
 
 #include "vfs_wrapper.h"
 #include "py_image.h"
@@ -49,6 +54,7 @@
 extern int load_file_from_flash(uint32_t addr, uint8_t *data_buf, uint32_t length);
 extern int load_file_from_ff(const char *path, void* buffer, size_t model_size);
 extern mp_uint_t get_file_size(const char *path);
+extern int load_kmodel_from_flash(void *userdata, uint32_t offset, uint8_t *buffer, uint32_t size);
 
 typedef struct _kpu_km_ptr_t
 {
@@ -61,6 +67,8 @@ static kpu_km_ptr_t g_km_ptr_t = {
     .index = 0,
 };
 
+static volatile uint32_t g_kpu_pipelined = 0; // models in a running pipeline, it owns the KPU
+
 typedef struct _k210_kpu_obj_t
 {
     mp_obj_base_t base; 
@@ -68,6 +76,10 @@ typedef struct _k210_kpu_obj_t
     size_t     model_size;
     mp_obj_t   model_buffer;
     mp_obj_t   model_path;
+    bool       paged;     // weights stay in flash, model_buffer belongs to kmodel_ctx
+    volatile bool pipelined; // kmodel_ctx and yolo2_rl are used by a running pipeline
+    bool       dequantized; // the run leaves output dequantize layers out, floats are made on demand
+    uint32_t   read_errors;
     uint32_t   inputs;
     mp_obj_t   inputs_addr;
     uint32_t   outputs;
@@ -106,6 +118,16 @@ static void ai_done(void *ctx)
     g_ai_done_flag = 1;
 }
 
+// output 0 as floats, its dequantize layer is run the first time after a run
+static float* kpu_output_float(k210_kpu_obj_t *km)
+{
+    if(!km->dequantized){
+        kpu_dequantize_output(km->kmodel_ctx, 0);
+        km->dequantized = true;
+    }
+    return (float*)km->output[0];
+}
+
 //manage kpu model buffer ptr, situation as a whole
 static int kpu_model_buffer_add_ptr(void *ptr)
 {
@@ -158,6 +180,10 @@ STATIC mp_obj_t k210_kpu_make_new(const mp_obj_type_t *type, size_t n_args, size
     self->model_size = 0;
     self->model_buffer = NULL;
     self->model_path = NULL;
+    self->paged = false;
+    self->pipelined = false;
+    self->dequantized = false;
+    self->read_errors = 0;
     self->output = NULL;
     self->output_size = NULL;
     self->inputs = 0;
@@ -176,10 +202,12 @@ STATIC mp_obj_t py_kpu_load_kmodel(size_t n_args, const mp_obj_t *pos_args, mp_m
     {
         ARG_path,
         ARG_size,
+        ARG_cache_size,
     };
     static const mp_arg_t allowed_args[] = {
         {MP_QSTR_path, MP_ARG_OBJ, {.u_obj = mp_const_none}},
         {MP_QSTR_size, MP_ARG_INT, {.u_int = 0}},
+        {MP_QSTR_cache_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1}},
     };
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
@@ -187,6 +215,10 @@ STATIC mp_obj_t py_kpu_load_kmodel(size_t n_args, const mp_obj_t *pos_args, mp_m
         mp_raise_ValueError("invalid path input");
     }
 
+    if(args[ARG_cache_size].u_int >= 0 && mp_obj_get_type(args[ARG_path].u_obj) != &mp_type_int){
+        mp_raise_ValueError("cache_size needs a flash address");
+    }
+
     if(mp_obj_get_type(args[ARG_path].u_obj) == &mp_type_str)
     {
         const char *path = mp_obj_str_get_str(args[ARG_path].u_obj);
@@ -218,16 +250,30 @@ STATIC mp_obj_t py_kpu_load_kmodel(size_t n_args, const mp_obj_t *pos_args, mp_m
         path_addr = mp_obj_get_int(args[ARG_path].u_obj);
         km->model_path = (mp_obj_t)path_addr;
         km->model_size = args[ARG_size].u_int;
-        km->model_buffer = malloc(km->model_size);
-        if (!km->model_buffer) {
-            mp_raise_msg(&mp_type_MemoryError, "model buffer memory allocation failed");
-            return mp_const_none;
+        if(args[ARG_cache_size].u_int >= 0)
+        {
+            // weights are read from flash by layer, only headers and main memory take SRAM
+            int ret = kpu_load_kmodel_paged(km->kmodel_ctx, load_kmodel_from_flash, (void *)(uintptr_t)path_addr, args[ARG_cache_size].u_int);
+            if(ret == -2)
+                mp_raise_ValueError("only kmodel v3 can be loaded with cache_size");
+            if(ret != 0)
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to init model"));
+            km->paged = true;
+            km->model_buffer = (mp_obj_t)km->kmodel_ctx->model_buffer;
         }
-        if(load_file_from_flash( path_addr, km->model_buffer, km->model_size) != 0)
+        else
         {
-            free(km->model_buffer);
-            km->model_buffer = NULL;
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to read file"));
+            km->model_buffer = malloc(km->model_size);
+            if (!km->model_buffer) {
+                mp_raise_msg(&mp_type_MemoryError, "model buffer memory allocation failed");
+                return mp_const_none;
+            }
+            if(load_file_from_flash( path_addr, km->model_buffer, km->model_size) != 0)
+            {
+                free(km->model_buffer);
+                km->model_buffer = NULL;
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to read file"));
+            }
         }
     }
     else
@@ -235,7 +281,7 @@ STATIC mp_obj_t py_kpu_load_kmodel(size_t n_args, const mp_obj_t *pos_args, mp_m
         mp_raise_ValueError("path error!");
     }
 
-    if (kpu_load_kmodel(km->kmodel_ctx, km->model_buffer) != 0){
+    if (!km->paged && kpu_load_kmodel(km->kmodel_ctx, km->model_buffer) != 0){
         free(km->model_buffer);
         km->model_buffer = NULL;
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to init model"));
@@ -245,6 +291,7 @@ STATIC mp_obj_t py_kpu_load_kmodel(size_t n_args, const mp_obj_t *pos_args, mp_m
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to add kpu_model_buffer"));
     }
     mp_printf(&mp_plat_print, "model load succeed\r\n");  //debug
+    kpu_skip_dequantize(km->kmodel_ctx, 1); // no-op on nncase models
     if(km->kmodel_ctx->is_nncase){
         km->inputs = ((struct model_header*)km->model_buffer)->inputs;
         km->outputs = ((struct model_header*)km->model_buffer)->outputs;
@@ -278,6 +325,8 @@ STATIC mp_obj_t py_kpu_run_with_output(size_t n_args, const mp_obj_t *pos_args,
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
+    if(g_kpu_pipelined)
+        mp_raise_msg(&mp_type_OSError, "KPU is used by a pipeline");
 ////////// kpu run
     if(args[ARG_input].u_obj == mp_const_none){
         mp_raise_ValueError("invalid input");
@@ -293,7 +342,7 @@ STATIC mp_obj_t py_kpu_run_with_output(size_t n_args, const mp_obj_t *pos_args,
         }
     }
     else if(mp_obj_get_type(args[ARG_input].u_obj) == &py_image_type){
-        image_t* kimage = py_image_cobj(args[ARG_input].u_obj);
+        image_t* kimage = py_image_cobj_raw(args[ARG_input].u_obj); // only pix_ai is used, no need to swap pixels
         if(kimage->pix_ai == NULL)
             mp_raise_msg(&mp_type_OSError, "Image formart error, use pix_to_ai() method to convert for kpu");
         km->inputs_addr = kimage->pix_ai;
@@ -310,12 +359,24 @@ STATIC mp_obj_t py_kpu_run_with_output(size_t n_args, const mp_obj_t *pos_args,
         mp_raise_msg(&mp_type_OSError, "Model Buffer maybe dirty!");
     }
 
-    while (!g_ai_done_flag);
-    g_ai_done_flag = 0;
+    int paged_ret;
+    do {
+        while (!g_ai_done_flag);
+        g_ai_done_flag = 0;
+        // a paged model stops before each layer read from flash, the read is done here
+        paged_ret = kpu_model_paged_resume(km->kmodel_ctx);
+    } while (paged_ret > 0);
 
     dmac_free_irq(dma_ch);
 
     wait_kpu_done = 0;
+    km->dequantized = false;
+
+    kpu_model_paged_stats_t paged_stats;
+    if(km->paged && kpu_get_paged_stats(km->kmodel_ctx, &paged_stats) == 0 && paged_stats.read_errors != km->read_errors){
+        km->read_errors = paged_stats.read_errors;
+        mp_raise_msg(&mp_type_OSError, "Failed to read model from flash");
+    }
 
 /////////// kpu get output
     mp_obj_list_t *ret_list = NULL;
@@ -326,8 +387,9 @@ STATIC mp_obj_t py_kpu_run_with_output(size_t n_args, const mp_obj_t *pos_args,
         ret_list = m_new(mp_obj_list_t, 1);
         mp_obj_list_init(ret_list, 0);
 
+        float *output = kpu_output_float(km);
         for(int j = 0; j < (km->output_size[0])/sizeof(float); j++){
-            mp_obj_list_append(ret_list, mp_obj_new_float( ((float*)km->output[0])[j] ));
+            mp_obj_list_append(ret_list, mp_obj_new_float(output[j]));
         }
     }
     else if(args[ARG_get_feature].u_bool){
@@ -338,7 +400,13 @@ STATIC mp_obj_t py_kpu_run_with_output(size_t n_args, const mp_obj_t *pos_args,
         if(output_count > MAX_FEATURE_LEN){
 		    mp_raise_ValueError("feature len out of 256\r\n");
 	    }
-        l2normalize((float*)km->output[0], feature_tmp, output_count);
+        uint8_t *quant;
+        size_t quant_count;
+        kpu_model_quant_param_t q;
+        if(!km->dequantized && kpu_get_output_quant(km->kmodel_ctx, 0, &quant, &quant_count, &q) == 0)
+            l2normalize_quant(quant, q.scale, q.bias, feature_tmp, output_count);
+        else
+            l2normalize(kpu_output_float(km), feature_tmp, output_count);
 
         for(int j = 0; j < output_count; j++){
             mp_obj_list_append(ret_list, mp_obj_new_float(feature_tmp[j]) );
@@ -389,6 +457,8 @@ STATIC mp_obj_t py_init_yolo2(size_t n_args, const mp_obj_t *pos_args, mp_map_t
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
+    if(km->pipelined)
+        mp_raise_msg(&mp_type_OSError, "model is running in a pipeline");
     float threshold = 0.7;
     float nms_value = 0.4;
     float *anchor;
@@ -411,20 +481,33 @@ STATIC mp_obj_t py_init_yolo2(size_t n_args, const mp_obj_t *pos_args, mp_map_t
         //anchor = default_anchor;
         mp_raise_ValueError("need input anchor");
     }
-    km->yolo2_rl = m_new(yolo2_region_layer_t,1);
-    km->yolo2_rl->anchor_number = args[ARG_anchor_num].u_int;
-    km->yolo2_rl->anchor = anchor;
-    km->yolo2_rl->threshold = threshold;
-    km->yolo2_rl->nms_value = nms_value;
-    km->yolo2_rl->classes = args[ARG_classes].u_int;
-    km->yolo2_rl->image_width = args[ARG_img_w].u_int;
-    km->yolo2_rl->image_height = args[ARG_img_h].u_int;
-    yolo_region_layer_init(km->yolo2_rl,
+    yolo2_region_layer_t *rl = m_new(yolo2_region_layer_t,1);
+    rl->anchor_number = args[ARG_anchor_num].u_int;
+    rl->anchor = anchor;
+    rl->threshold = threshold;
+    rl->nms_value = nms_value;
+    rl->classes = args[ARG_classes].u_int;
+    rl->image_width = args[ARG_img_w].u_int;
+    rl->image_height = args[ARG_img_h].u_int;
+    if(yolo_region_layer_init(rl,
                         args[ARG_layer_w].u_int,
                         args[ARG_layer_h].u_int, 
                         0,
                         args[ARG_net_w].u_int,
-                        args[ARG_net_h].u_int);
+                        args[ARG_net_h].u_int) != 0)
+    {
+        // the layer in use, if any, stays as it was
+        m_del(float,anchor,rl->anchor_number);
+        m_del(yolo2_region_layer_t,rl,1);
+        mp_raise_msg(&mp_type_MemoryError, "yolo2 region layer memory allocation failed");
+    }
+    if(km->yolo2_rl)
+    {
+        yolo_region_layer_deinit(km->yolo2_rl);
+        m_del(float,km->yolo2_rl->anchor,km->yolo2_rl->anchor_number);
+        m_del(yolo2_region_layer_t,km->yolo2_rl,1);
+    }
+    km->yolo2_rl = rl;
 
     return mp_const_none;
 }
@@ -474,11 +557,26 @@ STATIC mp_obj_t py_regionlayer_yolo2(mp_obj_t self_in)
 {
     k210_kpu_obj_t *km = (k210_kpu_obj_t *)self_in;
 
+    if(km->pipelined)
+        mp_raise_msg(&mp_type_OSError, "model is running in a pipeline");
+    if(!km->yolo2_rl)
+        mp_raise_ValueError("init_yolo2 first");
     mp_obj_list_t *rect = m_new(mp_obj_list_t, 1);
     mp_obj_list_init(rect, 0);
  
-    km->yolo2_rl->input = (float*)(km->output[0]);
-    yolo_region_layer_run(km->yolo2_rl);
+    uint8_t *quant;
+    size_t quant_count;
+    kpu_model_quant_param_t q;
+    if(!km->dequantized && kpu_get_output_quant(km->kmodel_ctx, 0, &quant, &quant_count, &q) == 0
+        && quant_count >= km->yolo2_rl->output_number)
+    {
+        yolo_region_layer_run_quant(km->yolo2_rl, quant, &q);
+    }
+    else
+    {
+        km->yolo2_rl->input = kpu_output_float(km);
+        yolo_region_layer_run(km->yolo2_rl);
+    }
     yolo_region_layer_get_rect(km->yolo2_rl, rect);
 
     return MP_OBJ_FROM_PTR(rect);
@@ -551,7 +649,7 @@ STATIC mp_obj_t py_lp_recog(mp_obj_t self_in)
     mp_obj_list_t *ret_list = m_new(mp_obj_list_t, sizeof(mp_obj_list_t));
     mp_obj_list_init(ret_list, 0);
     if(km->user_buffer)
-        lp_recog_process((float*)km->output[0], km->output_size[0]/sizeof(float), (float*)km->user_buffer, ret_list);
+        lp_recog_process(kpu_output_float(km), km->output_size[0]/sizeof(float), (float*)km->user_buffer, ret_list);
     else
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "not find lp weight data, please load"));
 
@@ -695,12 +793,17 @@ STATIC mp_obj_t py_kpu_deinit(mp_obj_t self_in)
     if(mp_obj_get_type(self_in) == &k210_kpu_type)
     {
         k210_kpu_obj_t *km = (k210_kpu_obj_t *)self_in;
+#if CONFIG_MAIXPY_PIPELINE_ENABLE
+        if(km->pipelined)
+            pipeline_stop_all(); // its tasks are still running this model
+#endif
         if(km->user_buffer){
             free(km->user_buffer);
             km->user_buffer = NULL;
         }
         if(km->model_buffer){
-            free(km->model_buffer);
+            if(!km->paged)
+                free(km->model_buffer);
             km->model_buffer = NULL;
             kpu_model_free(km->kmodel_ctx);
             kpu_model_buffer_del_ptr(km);
@@ -710,10 +813,14 @@ STATIC mp_obj_t py_kpu_deinit(mp_obj_t self_in)
             return mp_const_false;
 
         m_del_obj(kpu_model_context_t,km->kmodel_ctx);
-        yolo_region_layer_deinit(km->yolo2_rl);
-        m_del(float,km->yolo2_rl->anchor,km->yolo2_rl->anchor_number);
-        // m_del(float,km->yolo2_rl->anchor,1);
-        m_del(yolo2_region_layer_t,km->yolo2_rl,1);
+        if(km->yolo2_rl)
+        {
+            yolo_region_layer_deinit(km->yolo2_rl);
+            m_del(float,km->yolo2_rl->anchor,km->yolo2_rl->anchor_number);
+            // m_del(float,km->yolo2_rl->anchor,1);
+            m_del(yolo2_region_layer_t,km->yolo2_rl,1);
+            km->yolo2_rl = NULL;
+        }
         m_del(size_t,km->output_size,km->outputs);
         m_del(mp_obj_t,km->output,km->outputs);
         return mp_const_true;
@@ -722,6 +829,281 @@ STATIC mp_obj_t py_kpu_deinit(mp_obj_t self_in)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_kpu_deinit_obj, py_kpu_deinit);
 
+kpu_model_context_t* maix_kpu_get_model(mp_obj_t obj, yolo2_region_layer_t** yolo2_rl)
+{
+    if(!mp_obj_is_type(obj, &k210_kpu_type))
+        return NULL;
+    k210_kpu_obj_t *km = (k210_kpu_obj_t *)obj;
+    if(km->model_buffer == NULL)
+        return NULL;
+    *yolo2_rl = km->yolo2_rl;
+    return km->kmodel_ctx;
+}
+
+void maix_kpu_set_pipelined(mp_obj_t obj, bool pipelined)
+{
+    if(!mp_obj_is_type(obj, &k210_kpu_type))
+        return;
+    k210_kpu_obj_t *km = (k210_kpu_obj_t *)obj;
+    if(km->pipelined != pipelined)
+        g_kpu_pipelined += pipelined ? 1 : -1;
+    km->pipelined = pipelined;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// KPU.Gallery: enrolled features searched natively, one matrix instead of a list per person
+
+#define GALLERY_FILE_MAGIC   0x4755504B   // "KPUG"
+#define GALLERY_FILE_VERSION 1
+
+typedef struct _k210_kpu_gallery_obj_t
+{
+    mp_obj_base_t base;
+    kpu_gallery_t gallery;
+} k210_kpu_gallery_obj_t;
+
+const mp_obj_type_t k210_kpu_gallery_type;
+
+// list of dim floats, as run_with_output(get_feature=True) gives
+static void gallery_get_feature(k210_kpu_gallery_obj_t *self, mp_obj_t feature_obj, float *feature)
+{
+    size_t len = 0;
+    mp_obj_t *items = NULL;
+    mp_obj_get_array(feature_obj, &len, &items);
+    if(len != self->gallery.dim){
+        mp_raise_ValueError("feature len error");
+    }
+    for(size_t i = 0; i < len; i++){
+        feature[i] = mp_obj_get_float(items[i]);
+    }
+}
+
+STATIC mp_obj_t py_gallery_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args)
+{
+    enum
+    {
+        ARG_dim,
+        ARG_capacity,
+        ARG_int8,
+    };
+    static const mp_arg_t allowed_args[] = {
+        {MP_QSTR_dim, MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0}},
+        {MP_QSTR_capacity, MP_ARG_INT, {.u_int = 0}},
+        {MP_QSTR_int8, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true}},
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if(args[ARG_dim].u_int <= 0 || args[ARG_dim].u_int > MAX_FEATURE_LEN){
+        mp_raise_ValueError("dim must be 1 to 256");
+    }
+    if(args[ARG_capacity].u_int < 0){
+        mp_raise_ValueError("capacity error");
+    }
+    k210_kpu_gallery_obj_t *self = m_new_obj_with_finaliser(k210_kpu_gallery_obj_t);
+    self->base.type = &k210_kpu_gallery_type;
+    if(kpu_gallery_init(&self->gallery, args[ARG_dim].u_int, args[ARG_capacity].u_int, args[ARG_int8].u_bool) != 0){
+        mp_raise_msg(&mp_type_MemoryError, "gallery memory allocation failed");
+    }
+    return MP_OBJ_FROM_PTR(self);
+}
+
+// add(feature, label), label is any int, one person may have several features
+STATIC mp_obj_t py_gallery_add(mp_obj_t self_in, mp_obj_t feature_obj, mp_obj_t label_obj)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    float feature[MAX_FEATURE_LEN];
+
+    gallery_get_feature(self, feature_obj, feature);
+    int row = kpu_gallery_add(&self->gallery, feature, mp_obj_get_int(label_obj));
+    if(row < 0){
+        mp_raise_msg(&mp_type_MemoryError, "gallery memory allocation failed");
+    }
+    return mp_obj_new_int(row);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(py_gallery_add_obj, py_gallery_add);
+
+// remove(label), every feature of label, returns how many
+STATIC mp_obj_t py_gallery_remove(mp_obj_t self_in, mp_obj_t label_obj)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    return mp_obj_new_int(kpu_gallery_remove(&self->gallery, mp_obj_get_int(label_obj)));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_gallery_remove_obj, py_gallery_remove);
+
+// search(feature, k=1) -> [(label, score), ...] best first, score as feature_compare() gives
+STATIC mp_obj_t py_gallery_search(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)pos_args[0];
+    enum
+    {
+        ARG_feature,
+        ARG_k,
+    };
+    static const mp_arg_t allowed_args[] = {
+        {MP_QSTR_feature, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none}},
+        {MP_QSTR_k, MP_ARG_INT, {.u_int = 1}},
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args-1, pos_args+1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    float feature[MAX_FEATURE_LEN];
+    gallery_get_feature(self, args[ARG_feature].u_obj, feature);
+    int k = args[ARG_k].u_int;
+    if(k <= 0){
+        mp_raise_ValueError("k must be > 0");
+    }
+    if((uint32_t)k > self->gallery.number){
+        k = self->gallery.number;
+    }
+
+    mp_obj_t ret_list = mp_obj_new_list(0, NULL);
+    if(k == 0){
+        return ret_list;
+    }
+    kpu_gallery_match_t *matches = m_new(kpu_gallery_match_t, k);
+    int num = kpu_gallery_search(&self->gallery, feature, matches, k);
+    for(int i = 0; i < num; i++){
+        mp_obj_t tuple[2] = {
+            mp_obj_new_int(matches[i].label),
+            mp_obj_new_float((0.5 + 0.5 * matches[i].similarity) * 100),
+        };
+        mp_obj_list_append(ret_list, mp_obj_new_tuple(2, tuple));
+    }
+    m_del(kpu_gallery_match_t, matches, k);
+    return ret_list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_gallery_search_obj, 2, py_gallery_search);
+
+STATIC mp_obj_t py_gallery_save(mp_obj_t self_in, mp_obj_t path_obj)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    kpu_gallery_t *g = &self->gallery;
+    mp_obj_t fp;
+
+    // *_raise close the file before they raise
+    file_write_open_raise(&fp, mp_obj_str_get_str(path_obj));
+    write_long_raise(fp, GALLERY_FILE_MAGIC);
+    write_long_raise(fp, GALLERY_FILE_VERSION);
+    write_long_raise(fp, g->dim);
+    write_long_raise(fp, g->number);
+    write_long_raise(fp, g->int8);
+    if(g->number){
+        write_data_raise(fp, g->labels, g->number * sizeof(int32_t));
+        write_data_raise(fp, g->data, g->number * kpu_gallery_row_size(g));
+    }
+    int err = file_close(fp);
+    if(err != 0){
+        mp_raise_OSError(err);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_gallery_save_obj, py_gallery_save);
+
+// load(path), replaces every feature, dim and int8 come from the file
+STATIC mp_obj_t py_gallery_load(mp_obj_t self_in, mp_obj_t path_obj)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    uint32_t magic, version, dim, number, int8;
+    kpu_gallery_t g;
+    mp_obj_t fp;
+
+    file_read_open_raise(&fp, mp_obj_str_get_str(path_obj));
+    read_long_raise(fp, &magic);
+    read_long_raise(fp, &version);
+    read_long_raise(fp, &dim);
+    read_long_raise(fp, &number);
+    read_long_raise(fp, &int8);
+    if(magic != GALLERY_FILE_MAGIC || version != GALLERY_FILE_VERSION || int8 > 1
+        || dim == 0 || dim > MAX_FEATURE_LEN){
+        file_close(fp);
+        mp_raise_ValueError("not a gallery file");
+    }
+    // number comes from the file, it must fit in memory sizes and in the file itself
+    mp_uint_t entry_size = dim * (int8 ? sizeof(int8_t) : sizeof(float)) + sizeof(int32_t);
+    mp_uint_t body_size = file_size(fp) - 5 * sizeof(uint32_t);
+    if(number > SIZE_MAX / entry_size || number * entry_size > body_size){
+        file_close(fp);
+        mp_raise_ValueError("gallery file is truncated");
+    }
+    int ret = kpu_gallery_init(&g, dim, number, int8);
+    if(ret != 0){
+        file_close(fp);
+        if(ret == -2)
+            mp_raise_ValueError("not a gallery file");
+        mp_raise_msg(&mp_type_MemoryError, "gallery memory allocation failed");
+    }
+    mp_uint_t labels_size = number * sizeof(int32_t), data_size = number * kpu_gallery_row_size(&g);
+    mp_uint_t labels_read = 0, data_read = 0;
+    int err = 0;
+    if(number){
+        err = file_read(fp, g.labels, labels_size, &labels_read);
+        if(err == 0)
+            err = file_read(fp, g.data, data_size, &data_read);
+    }
+    file_close(fp);
+    if(err != 0 || labels_read != labels_size || data_read != data_size){
+        kpu_gallery_deinit(&g);
+        if(err != 0)
+            mp_raise_OSError(err);
+        mp_raise_ValueError("gallery file is truncated");
+    }
+    g.number = number;
+    kpu_gallery_deinit(&self->gallery);
+    self->gallery = g;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_gallery_load_obj, py_gallery_load);
+
+STATIC mp_obj_t py_gallery_deinit(mp_obj_t self_in)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    kpu_gallery_deinit(&self->gallery);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_gallery_deinit_obj, py_gallery_deinit);
+
+STATIC mp_obj_t py_gallery_unary_op(mp_unary_op_t op, mp_obj_t self_in)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    switch (op) {
+        case MP_UNARY_OP_LEN:
+            return mp_obj_new_int(self->gallery.number);
+        default:
+            return MP_OBJ_NULL; // op not supported
+    }
+}
+
+STATIC void py_gallery_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    k210_kpu_gallery_obj_t *self = (k210_kpu_gallery_obj_t *)self_in;
+    kpu_gallery_t *g = &self->gallery;
+    mp_printf(print, "type        : gallery (KPU) \n");
+    mp_printf(print, "dim         : %d\n", g->dim);
+    mp_printf(print, "features    : %d\n", g->number);
+    mp_printf(print, "storage     : %s, %d bytes\n", g->int8 ? "int8" : "float", g->capacity * (kpu_gallery_row_size(g) + sizeof(int32_t)));
+}
+
+STATIC const mp_rom_map_elem_t k210_kpu_gallery_locals_dict_table[] = {
+    {MP_ROM_QSTR(MP_QSTR_add), MP_ROM_PTR(&py_gallery_add_obj)},
+    {MP_ROM_QSTR(MP_QSTR_remove), MP_ROM_PTR(&py_gallery_remove_obj)},
+    {MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&py_gallery_search_obj)},
+    {MP_ROM_QSTR(MP_QSTR_save), MP_ROM_PTR(&py_gallery_save_obj)},
+    {MP_ROM_QSTR(MP_QSTR_load), MP_ROM_PTR(&py_gallery_load_obj)},
+    {MP_ROM_QSTR(MP_QSTR_deinit), MP_ROM_PTR(&py_gallery_deinit_obj)},
+    {MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&py_gallery_deinit_obj)},
+};
+STATIC MP_DEFINE_CONST_DICT(k210_kpu_gallery_dict, k210_kpu_gallery_locals_dict_table);
+
+const mp_obj_type_t k210_kpu_gallery_type = {
+    {&mp_type_type},
+    .name = MP_QSTR_Gallery,
+    .print = py_gallery_print,
+    .make_new = py_gallery_make_new,
+    .unary_op = py_gallery_unary_op,
+    .locals_dict = (mp_obj_dict_t *)&k210_kpu_gallery_dict,
+};
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -732,6 +1114,12 @@ STATIC void k210_kpu_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
     mp_printf(print, "model_size  : %d\n", km->model_size);
     mp_printf(print, "inputs      : %d\n", km->inputs);
     mp_printf(print, "outputs     : %d\n", km->outputs);
+    kpu_model_paged_stats_t stats;
+    if(km->paged && kpu_get_paged_stats(km->kmodel_ctx, &stats) == 0){
+        mp_printf(print, "resident    : %d layers, %d bytes\n", stats.resident_layers, stats.resident_bytes);
+        mp_printf(print, "staging     : %d bytes\n", stats.staging_bytes);
+        mp_printf(print, "streamed    : %d bytes in last run\n", stats.streamed_bytes);
+    }
 
 }
 
@@ -744,6 +1132,7 @@ STATIC const mp_rom_map_elem_t k210_kpu_locals_dict_table[] = {
     {MP_ROM_QSTR(MP_QSTR_sigmoid),  MP_ROM_PTR(&py_sigmoid_obj) },
     {MP_ROM_QSTR(MP_QSTR_softmax),  MP_ROM_PTR(&py_softmax_obj) },
     {MP_ROM_QSTR(MP_QSTR_feature_compare),  MP_ROM_PTR(&py_feature_compare_obj) },
+    {MP_ROM_QSTR(MP_QSTR_Gallery),  MP_ROM_PTR(&k210_kpu_gallery_type) },
 #ifdef LP_RECOG_EN 
     {MP_ROM_QSTR(MP_QSTR_lp_recog_load_weight_data),  MP_ROM_PTR(&py_lp_recog_load_weight_data_obj) },
     {MP_ROM_QSTR(MP_QSTR_lp_recog),  MP_ROM_PTR(&py_lp_recog_obj) },
@@ -0,0 +1,21 @@
+#ifndef _MAIX_KPU_H
+#define _MAIX_KPU_H
+
+#include <stdbool.h>
+#include "py/obj.h"
+#include "kpu.h"
+#include "yolo2_region_layer.h"
+
+/**
+ * model of a KPU object for native users that run it outside of python (pipeline)
+ * @param yolo2_rl set to the region layer from init_yolo2(), NULL if there is none
+ * @return NULL if obj is not a KPU object or no model is loaded
+ */
+kpu_model_context_t* maix_kpu_get_model(mp_obj_t obj, yolo2_region_layer_t** yolo2_rl);
+/**
+ * while set, regionlayer_yolo2() raises and so does run_with_output() of any model,
+ * the KPU, the model and its region layer belong to a native user, deinit() stops it first
+ */
+void maix_kpu_set_pipelined(mp_obj_t obj, bool pipelined);
+
+#endif /* _MAIX_KPU_H */
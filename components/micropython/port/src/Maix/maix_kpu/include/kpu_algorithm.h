@@ -10,8 +10,12 @@
 #define LP_RECOG_EN
 
 uint32_t l2normalize(float *x, float *dx, int len);
+// same on uint8 values that dequantize to x * scale + bias, len up to 65536
+uint32_t l2normalize_quant(const uint8_t *x, float scale, float bias, float *dx, int len);
 void maix_kpu_helper_softmax(float *x, float *dx, uint32_t len);
 
+float feature_dot(const float *a, const float *b, int len);
+int32_t feature_dot_int8(const int8_t *a, const int8_t *b, int len);
 float calCosinDistance(float *faceFeature0P, float *faceFeature1P, int featureLen);
 void lp_recog_process(const float *features, uint32_t size, const float *weight_data, mp_obj_list_t* result_list);
 
@@ -0,0 +1,40 @@
+#ifndef _KPU_GALLERY_H
+#define _KPU_GALLERY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// enrolled features, L2 normalized, one row each in a single matrix
+typedef struct
+{
+    uint32_t dim;
+    uint32_t number;
+    uint32_t capacity;  // rows allocated
+    bool int8;          // rows are round(x * 127), else float
+    int32_t *labels;
+    void *data;         // number * dim
+} kpu_gallery_t;
+
+typedef struct
+{
+    int32_t label;
+    uint32_t index;     // row, changes when rows are removed
+    float similarity;   // cosine, -1 to 1
+} kpu_gallery_match_t;
+
+#define KPU_GALLERY_INT8_SCALE 127
+
+// return 0, -1 on ENOMEM, -2 if dim is 0 or over MAX_FEATURE_LEN
+int kpu_gallery_init(kpu_gallery_t *g, uint32_t dim, uint32_t capacity, bool int8);
+void kpu_gallery_deinit(kpu_gallery_t *g);
+// room for capacity rows, never shrinks below number, return 0 or -1 on ENOMEM
+int kpu_gallery_reserve(kpu_gallery_t *g, uint32_t capacity);
+int kpu_gallery_row_size(kpu_gallery_t *g);
+// feature of dim values, normalized before it is stored, return its row or -1 on ENOMEM
+int kpu_gallery_add(kpu_gallery_t *g, const float *feature, int32_t label);
+// every row of label, the last rows move into their place, return how many
+uint32_t kpu_gallery_remove(kpu_gallery_t *g, int32_t label);
+// k most similar rows to feature, best first, return how many were written
+int kpu_gallery_search(kpu_gallery_t *g, const float *feature, kpu_gallery_match_t *matches, int k);
+
+#endif /* _KPU_GALLERY_H */
@@ -5,6 +5,9 @@
 #include "kpu.h"
 #include "objlist.h"
 
+// (box, class) pairs kept per run, the best ones if more pass threshold
+#define YOLO2_MAX_CANDIDATES 256
+
 typedef struct
 {
     uint32_t obj_number;
@@ -35,13 +38,28 @@ typedef struct
     uint32_t layer_height;
     uint32_t boxes_number;
     uint32_t output_number;
-    void *boxes;
     float *input;
-    float *output;
-    float *probs_buf;
-    float **probs;
+    float obj_cutoff;           // objectness logit of threshold, cells not above it are skipped
+    uint32_t candidate_max;
+    uint32_t candidate_number;  // (box, class) pairs above threshold in the last run
+    void *candidates;
+    uint32_t result_number;     // boxes left by nms, in box order
+    uint16_t *results;          // index into candidates
+    float *class_buf;           // softmax of one cell
+    float *lut;                 // yolo_region_layer_run_quant: sigmoid(x), exp(x), exp(x - max) by uint8 value
+    kpu_model_quant_param_t lut_q; // quantization lut was built for
 } yolo2_region_layer_t;
 
+typedef struct
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t w;
+    uint32_t h;
+    uint32_t class_id;
+    float prob;
+} yolo2_rect_t;
+
 //typedef void(*callback_draw_box)(uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, uint32_t class, float prob);
 static inline float sigmoid(float x)
 {
@@ -49,7 +67,12 @@ static inline float sigmoid(float x)
 }
 int yolo_region_layer_init(yolo2_region_layer_t *rl, int width, int height, int channels, int origin_width, int origin_height);
 void yolo_region_layer_deinit(yolo2_region_layer_t *rl);
+// threshold must be set before init, the objectness cutoff is derived from it
 void yolo_region_layer_run(yolo2_region_layer_t *rl);
+// same on the uint8 tensor the KPU gives before dequantize (kpu_get_output_quant), input is not used
+void yolo_region_layer_run_quant(yolo2_region_layer_t *rl, const uint8_t *input, const kpu_model_quant_param_t *q);
 void yolo_region_layer_get_rect(yolo2_region_layer_t *rl, mp_obj_list_t* out_box);
+// same boxes as yolo_region_layer_get_rect without MicroPython objects, returns how many were written
+int yolo_region_layer_get_rects(yolo2_region_layer_t *rl, yolo2_rect_t *rects, int max);
 
 #endif // _YOLO2_REGION_LAYER
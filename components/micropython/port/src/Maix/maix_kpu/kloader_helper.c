@@ -24,9 +24,7 @@
 int load_file_from_flash(uint32_t addr, uint8_t *data_buf, uint32_t length){
     // w25qxx_init(3, 0, 25000000);
     //w25qxx_read_data(addr, data_buf, length);
-    sys_spiffs_read(addr, length, data_buf);
-
-    return 0;
+    return sys_spiffs_read(addr, length, data_buf) == 0 ? 0 : -1;
 }
 
 int load_file_from_ff(const char *path, void* buffer, size_t model_size)
@@ -55,3 +53,9 @@ mp_uint_t get_file_size(const char *path)
     file_close(fp);
     return size;
 }
+
+// kpu_model_read_t over a kmodel stored at a raw flash address, userdata holds that address
+int load_kmodel_from_flash(void *userdata, uint32_t offset, uint8_t *buffer, uint32_t size)
+{
+    return load_file_from_flash((uint32_t)(uintptr_t)userdata + offset, buffer, size);
+}
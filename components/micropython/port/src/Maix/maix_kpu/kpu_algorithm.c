@@ -38,6 +38,27 @@ uint32_t l2normalize(float *x, float *dx, int len)
     return 0;
 }
 
+// L2 归一化, 输入为 KPU 反量化前的 uint8 输出 (值为 x * scale + bias)
+uint32_t l2normalize_quant(const uint8_t *x, float scale, float bias, float *dx, int len)
+{
+    int f;
+    uint32_t sum_q = 0;
+    uint32_t sum_q2 = 0;
+    for(f = 0; f < len; ++f)
+    {
+        sum_q += x[f];
+        sum_q2 += x[f] * x[f];
+    }
+    // sum((x * scale + bias)^2) 展开后各项可能相互抵消, 用 double 计算
+    double sum = (double)scale * scale * sum_q2 + 2.0 * scale * bias * sum_q + (double)len * bias * bias;
+    float inv = sum > 0 ? (float)(1.0 / sqrt(sum)) : 0;
+    for(f = 0; f < len; ++f)
+    {
+        dx[f] = (x[f] * scale + bias) * inv;
+    }
+    return 0;
+}
+
 void maix_kpu_helper_softmax(float *x, float *dx, uint32_t len)
 {
     float max_value = x[0];
@@ -64,6 +85,42 @@ void maix_kpu_helper_softmax(float *x, float *dx, uint32_t len)
     }
 }
 
+// 点积, 4 路展开, 各路独立累加
+float feature_dot(const float *a, const float *b, int len)
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for(; i + 4 <= len; i += 4)
+    {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for(; i < len; i++)
+    {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+// int8 点积, 8 路展开, 每项不超过 127 * 127, len 到 2^16 都不会溢出
+int32_t feature_dot_int8(const int8_t *a, const int8_t *b, int len)
+{
+    int32_t s0 = 0, s1 = 0;
+    int i = 0;
+    for(; i + 8 <= len; i += 8)
+    {
+        s0 += a[i] * b[i] + a[i + 1] * b[i + 1] + a[i + 2] * b[i + 2] + a[i + 3] * b[i + 3];
+        s1 += a[i + 4] * b[i + 4] + a[i + 5] * b[i + 5] + a[i + 6] * b[i + 6] + a[i + 7] * b[i + 7];
+    }
+    for(; i < len; i++)
+    {
+        s0 += a[i] * b[i];
+    }
+    return s0 + s1;
+}
+
 float calCosinDistance(float *faceFeature0P, float *faceFeature1P, int featureLen)
 {
     float coorFeature = 0;
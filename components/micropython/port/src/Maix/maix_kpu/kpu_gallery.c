@@ -0,0 +1,167 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "kpu_gallery.h"
+#include "kpu_algorithm.h"
+
+int kpu_gallery_row_size(kpu_gallery_t *g)
+{
+    return g->dim * (g->int8 ? sizeof(int8_t) : sizeof(float));
+}
+
+int kpu_gallery_init(kpu_gallery_t *g, uint32_t dim, uint32_t capacity, bool int8)
+{
+    memset(g, 0, sizeof(kpu_gallery_t));
+    if (dim == 0 || dim > MAX_FEATURE_LEN)
+        return -2;
+    g->dim = dim;
+    g->int8 = int8;
+    return kpu_gallery_reserve(g, capacity);
+}
+
+void kpu_gallery_deinit(kpu_gallery_t *g)
+{
+    free(g->labels);
+    free(g->data);
+    g->labels = NULL;
+    g->data = NULL;
+    g->number = 0;
+    g->capacity = 0;
+}
+
+int kpu_gallery_reserve(kpu_gallery_t *g, uint32_t capacity)
+{
+    if (capacity < g->number)
+        capacity = g->number;
+    if (capacity == g->capacity)
+        return 0;
+    if (capacity > SIZE_MAX / (kpu_gallery_row_size(g) + sizeof(int32_t)))
+        return -1;
+    if (capacity == 0)
+    {
+        kpu_gallery_deinit(g);
+        return 0;
+    }
+    int32_t *labels = realloc(g->labels, capacity * sizeof(int32_t));
+    if (labels == NULL)
+        return -1;
+    g->labels = labels;
+    void *data = realloc(g->data, capacity * kpu_gallery_row_size(g));
+    if (data == NULL)
+        return -1;
+    g->data = data;
+    g->capacity = capacity;
+    return 0;
+}
+
+// normalized feature in the row format, row holds dim floats
+static void kpu_gallery_make_row(kpu_gallery_t *g, const float *feature, void *row)
+{
+    float *x = (float *)row;
+
+    l2normalize((float *)feature, x, g->dim);
+    if (!g->int8)
+        return;
+    int8_t *q = (int8_t *)row;
+    for (uint32_t i = 0; i < g->dim; i++)
+    {
+        // in place, q[i] is written after x[i] was read and never past it
+        float v = x[i] * KPU_GALLERY_INT8_SCALE;
+        if (!(v > -KPU_GALLERY_INT8_SCALE))
+            v = -KPU_GALLERY_INT8_SCALE;
+        if (v > KPU_GALLERY_INT8_SCALE)
+            v = KPU_GALLERY_INT8_SCALE;
+        q[i] = (int8_t)lrintf(v);
+    }
+}
+
+int kpu_gallery_add(kpu_gallery_t *g, const float *feature, int32_t label)
+{
+    if (g->number == g->capacity)
+    {
+        // grow by half, rows are added one by one when people enroll
+        uint32_t capacity = g->capacity + g->capacity / 2;
+        if (capacity < g->capacity + 16)
+            capacity = g->capacity + 16;
+        if (kpu_gallery_reserve(g, capacity) != 0)
+            return -1;
+    }
+    float row[MAX_FEATURE_LEN];
+    kpu_gallery_make_row(g, feature, row);
+    uint32_t size = kpu_gallery_row_size(g);
+    memcpy((uint8_t *)g->data + g->number * size, row, size);
+    g->labels[g->number] = label;
+    return g->number++;
+}
+
+uint32_t kpu_gallery_remove(kpu_gallery_t *g, int32_t label)
+{
+    uint32_t size = kpu_gallery_row_size(g);
+    uint32_t removed = 0;
+    uint32_t i = 0;
+
+    while (i < g->number)
+    {
+        if (g->labels[i] != label)
+        {
+            i++;
+            continue;
+        }
+        g->number--;
+        if (i != g->number)
+        {
+            g->labels[i] = g->labels[g->number];
+            memcpy((uint8_t *)g->data + i * size, (uint8_t *)g->data + g->number * size, size);
+        }
+        removed++;
+    }
+    return removed;
+}
+
+static void kpu_gallery_insert(kpu_gallery_match_t *matches, int *num, int k, const kpu_gallery_match_t *m)
+{
+    int i = *num;
+
+    if (i == k)
+    {
+        if (!(m->similarity > matches[k - 1].similarity))
+            return;
+        i--;
+    }
+    else
+        (*num)++;
+    while (i > 0 && m->similarity > matches[i - 1].similarity)
+    {
+        matches[i] = matches[i - 1];
+        i--;
+    }
+    matches[i] = *m;
+}
+
+// one pass over the matrix, the k best are kept in order by insertion
+int kpu_gallery_search(kpu_gallery_t *g, const float *feature, kpu_gallery_match_t *matches, int k)
+{
+    uint32_t dim = g->dim;
+    float row[MAX_FEATURE_LEN];
+    kpu_gallery_match_t m;
+    int num = 0;
+
+    if (k <= 0)
+        return 0;
+    kpu_gallery_make_row(g, feature, row);
+    for (uint32_t i = 0; i < g->number; i++)
+    {
+        if (g->int8)
+            m.similarity = feature_dot_int8((const int8_t *)row, (const int8_t *)g->data + i * dim, dim)
+                           * (1.f / (KPU_GALLERY_INT8_SCALE * KPU_GALLERY_INT8_SCALE));
+        else
+            m.similarity = feature_dot(row, (const float *)g->data + i * dim, dim);
+        if (num == k && !(m.similarity > matches[k - 1].similarity))
+            continue;
+        m.label = g->labels[i];
+        m.index = i;
+        kpu_gallery_insert(matches, &num, k, &m);
+    }
+    return num;
+}
@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "yolo2_region_layer.h"
 
 typedef struct
@@ -27,17 +28,22 @@ typedef struct
     float h;
 } box_t;
 
+// one (box, class) pair above threshold
 typedef struct
 {
-    int index;
-    int class;
-    float **probs;
-} sortable_box_t;
+    box_t box;
+    float prob;
+    uint32_t index;     // box number, anchor * layer_width * layer_height + cell
+    uint16_t class;
+    bool suppressed;
+} candidate_t;
 
+#define YOLO2_LUT_SIZE 256
 
 int yolo_region_layer_init(yolo2_region_layer_t *rl, int width, int height, int channels, int origin_width, int origin_height)
 {
     int flag = 0;
+    uint32_t classes = (rl->classes == 0) ? 1 : rl->classes;
 
     rl->coords = 4;
     //rl->image_width = 320;
@@ -50,69 +56,77 @@ int yolo_region_layer_init(yolo2_region_layer_t *rl, int width, int height, int
     rl->boxes_number = (rl->layer_width * rl->layer_height * rl->anchor_number); 
     rl->output_number = (rl->boxes_number * (rl->classes + rl->coords + 1));
 
-    rl->output = malloc(rl->output_number * sizeof(float));
-    if (rl->output == NULL)
+    // prob = sigmoid(objectness) * class prob <= sigmoid(objectness), a cell whose objectness
+    // logit is not above logit(threshold) can't pass for any class. The small margin keeps
+    // rounding on the safe side, the probability itself is still compared to threshold.
+    if (rl->threshold <= 0)
+        rl->obj_cutoff = -INFINITY;
+    else if (rl->threshold >= 1)
+        rl->obj_cutoff = INFINITY;
+    else
+        rl->obj_cutoff = logf(rl->threshold / (1 - rl->threshold)) - 1e-3f;
+
+    rl->candidate_max = rl->boxes_number * classes;
+    if (rl->candidate_max > YOLO2_MAX_CANDIDATES)
+        rl->candidate_max = YOLO2_MAX_CANDIDATES;
+    rl->candidate_number = 0;
+    rl->result_number = 0;
+    rl->results = NULL;
+    rl->class_buf = NULL;
+    rl->lut = NULL;
+    rl->lut_q.scale = 0;
+    rl->lut_q.bias = 0;
+    rl->candidates = malloc(rl->candidate_max * sizeof(candidate_t));
+    if (rl->candidates == NULL)
     {
         flag = -1;
         goto malloc_error;
     }
-    rl->boxes = malloc(rl->boxes_number * sizeof(box_t));
-    if (rl->boxes == NULL)
+    rl->results = malloc(rl->candidate_max * sizeof(uint16_t));
+    if (rl->results == NULL)
     {
         flag = -2;
         goto malloc_error;
     }
-    rl->probs_buf = malloc(rl->boxes_number * (rl->classes + 1) * sizeof(float));
-    if (rl->probs_buf == NULL)
+    rl->class_buf = malloc(classes * sizeof(float));
+    if (rl->class_buf == NULL)
     {
         flag = -3;
         goto malloc_error;
     }
-    rl->probs = malloc(rl->boxes_number * sizeof(float *));
-    if (rl->probs == NULL)
+    rl->lut = malloc(YOLO2_LUT_SIZE * 3 * sizeof(float));
+    if (rl->lut == NULL)
     {
         flag = -4;
         goto malloc_error;
     }
-    for (uint32_t i = 0; i < rl->boxes_number; i++)
-        rl->probs[i] = &(rl->probs_buf[i * (rl->classes + 1)]);
     return 0;
 malloc_error:
-    free(rl->output);
-    free(rl->boxes);
-    free(rl->probs_buf);
-    free(rl->probs);
+    free(rl->candidates);
+    free(rl->results);
+    free(rl->class_buf);
+    free(rl->lut);
+    rl->candidates = NULL;
+    rl->results = NULL;
+    rl->class_buf = NULL;
+    rl->lut = NULL;
     return flag;
 }
 
 void yolo_region_layer_deinit(yolo2_region_layer_t *rl)
 {
-    free(rl->output);
-    free(rl->boxes);
-    free(rl->probs_buf);
-    free(rl->probs);
+    free(rl->candidates);
+    free(rl->results);
+    free(rl->class_buf);
+    free(rl->lut);
+    rl->candidates = NULL;
+    rl->results = NULL;
+    rl->class_buf = NULL;
+    rl->lut = NULL;
 }
 
-
-static void activate_array(yolo2_region_layer_t *rl, int index, int n)
-{
-    float *output = &rl->output[index];
-    float *input = &rl->input[index];
-
-    for (int i = 0; i < n; ++i)
-        output[i] = sigmoid(input[i]);
-}
-
-static int entry_index(yolo2_region_layer_t *rl, int location, int entry)
-{
-    int wh = rl->layer_width * rl->layer_height;
-    int n   = location / wh;
-    int loc = location % wh;
-
-    return n * wh * (rl->coords + rl->classes + 1) + entry * wh + loc;
-}
-
-static void softmax(yolo2_region_layer_t *rl, float *input, int n, int stride, float *output)
+// classes of one cell, every stride floats
+static void softmax(float *input, int n, int stride, float *output)
 {
     int i;
     float diff;
@@ -130,50 +144,41 @@ static void softmax(yolo2_region_layer_t *rl, float *input, int n, int stride, f
         diff = input[i * stride] - largest_i;
         e = expf(diff);
         sum += e;
-        output[i * stride] = e;
+        output[i] = e;
     }
     for (i = 0; i < n; ++i)
-        output[i * stride] /= sum;
+        output[i] /= sum;
 }
 
-static void softmax_cpu(yolo2_region_layer_t *rl, float *input, int n, int batch, int batch_offset, int groups, int stride, float *output)
+// same on uint8 values, exp of (value - max) comes from lut_exp_diff by max - value
+static void softmax_quant(const uint8_t *input, int n, int stride, const float *lut_exp_diff, float *output)
 {
-    int g, b;
-
-    for (b = 0; b < batch; ++b) {
-        for (g = 0; g < groups; ++g)
-            softmax(rl, input + b * batch_offset + g, n, stride, output + b * batch_offset + g);
-    }
-}
-
-static void forward_region_layer(yolo2_region_layer_t *rl)
-{
-    int index;
-
-    for (index = 0; index < rl->output_number; index++)
-        rl->output[index] = rl->input[index];
+    int i;
+    float e;
+    float sum = 0;
+    uint8_t largest_i = input[0];
 
-    for (int n = 0; n < rl->anchor_number; ++n)
+    for (i = 0; i < n; ++i)
     {
-        index = entry_index(rl, n * rl->layer_width * rl->layer_height, 0);
-        activate_array(rl, index, 2 * rl->layer_width * rl->layer_height);
-        index = entry_index(rl, n * rl->layer_width * rl->layer_height, 4);
-        activate_array(rl, index, rl->layer_width * rl->layer_height);
+        if (input[i * stride] > largest_i)
+            largest_i = input[i * stride];
     }
 
-    index = entry_index(rl, 0, rl->coords + 1);
-    softmax_cpu(rl, rl->input + index, rl->classes, rl->anchor_number,
-            rl->output_number / rl->anchor_number, rl->layer_width * rl->layer_height,
-            rl->layer_width * rl->layer_height, rl->output + index);
+    for (i = 0; i < n; ++i) {
+        e = lut_exp_diff[largest_i - input[i * stride]];
+        sum += e;
+        output[i] = e;
+    }
+    for (i = 0; i < n; ++i)
+        output[i] /= sum;
 }
 
-static void correct_region_boxes(yolo2_region_layer_t *rl, box_t *boxes)
+static void correct_region_box(yolo2_region_layer_t *rl, box_t *b)
 {
     uint32_t net_width = rl->net_width;
     uint32_t net_height = rl->net_height;
     uint32_t image_width = rl->image_width;
     uint32_t image_height = rl->image_height;
-    uint32_t boxes_number = rl->boxes_number;
     int new_w = 0;
     int new_h = 0;
 
@@ -185,108 +190,189 @@ static void correct_region_boxes(yolo2_region_layer_t *rl, box_t *boxes)
         new_h = net_height;
         new_w = (image_width * net_height) / image_height;
     }
-    for (int i = 0; i < boxes_number; ++i) {
-        box_t b = boxes[i];
-
-        b.x = (b.x - (net_width - new_w) / 2. / net_width) /
-              ((float)new_w / net_width);
-        b.y = (b.y - (net_height - new_h) / 2. / net_height) /
-              ((float)new_h / net_height);
-        b.w *= (float)net_width / new_w;
-        b.h *= (float)net_height / new_h;
-        boxes[i] = b;
+    b->x = (b->x - (net_width - new_w) / 2. / net_width) /
+           ((float)new_w / net_width);
+    b->y = (b->y - (net_height - new_h) / 2. / net_height) /
+           ((float)new_h / net_height);
+    b->w *= (float)net_width / new_w;
+    b->h *= (float)net_height / new_h;
+}
+
+// a is reported before b: higher prob first, then lower box, then lower class
+static inline bool candidate_before(const candidate_t *a, const candidate_t *b)
+{
+    if (a->prob != b->prob)
+        return a->prob > b->prob;
+    if (a->index != b->index)
+        return a->index < b->index;
+    return a->class < b->class;
+}
+
+// heap with the candidate reported last on top
+static void candidate_sift_down(candidate_t *c, uint32_t i, uint32_t n)
+{
+    while (1)
+    {
+        uint32_t last = i;
+        uint32_t l = 2 * i + 1;
+        uint32_t r = l + 1;
+
+        if (l < n && candidate_before(c + last, c + l))
+            last = l;
+        if (r < n && candidate_before(c + last, c + r))
+            last = r;
+        if (last == i)
+            return;
+        candidate_t t = c[i];
+        c[i] = c[last];
+        c[last] = t;
+        i = last;
     }
 }
 
-static box_t get_region_box(float *x, float *biases, int n, int index, int i, int j, int w, int h, int stride)
+static void candidate_push(yolo2_region_layer_t *rl, const candidate_t *cand)
 {
-    volatile box_t b;
+    candidate_t *c = (candidate_t *)rl->candidates;
+    uint32_t i = rl->candidate_number;
 
-    b.x = (i + x[index + 0 * stride]) / w;
-    b.y = (j + x[index + 1 * stride]) / h;
-    b.w = expf(x[index + 2 * stride]) * biases[2 * n] / w;
-    b.h = expf(x[index + 3 * stride]) * biases[2 * n + 1] / h;
-    return b;
+    if (i == rl->candidate_max)
+    {
+        // full, keep the best candidate_max pairs
+        if (!candidate_before(cand, c))
+            return;
+        c[0] = *cand;
+        candidate_sift_down(c, 0, i);
+        return;
+    }
+    c[i] = *cand;
+    rl->candidate_number++;
+    while (i > 0)
+    {
+        uint32_t parent = (i - 1) / 2;
+        if (!candidate_before(c + parent, c + i))
+            break;
+        candidate_t t = c[i];
+        c[i] = c[parent];
+        c[parent] = t;
+        i = parent;
+    }
 }
 
-static void get_region_boxes(yolo2_region_layer_t *rl, float *predictions, float **probs, box_t *boxes)
+// box of cell i of anchor n from its activated values, then its (box, class) pairs above threshold,
+// class_buf holds the softmax of the cell
+static void region_cell_candidates(yolo2_region_layer_t *rl, uint32_t n, uint32_t i, float scale,
+                                   float sx, float sy, float ew, float eh)
 {
     uint32_t layer_width = rl->layer_width;
     uint32_t layer_height = rl->layer_height;
-    uint32_t anchor_number = rl->anchor_number;
-    uint32_t classes = (rl->classes==0) ? 1 : rl->classes;
+    uint32_t classes = rl->classes;
+    float threshold = rl->threshold;
+    candidate_t cand;
+
+    cand.box.x = ((i % layer_width) + sx) / layer_width;
+    cand.box.y = ((i / layer_width) + sy) / layer_height;
+    cand.box.w = ew * rl->anchor[2 * n] / layer_width;
+    cand.box.h = eh * rl->anchor[2 * n + 1] / layer_height;
+    correct_region_box(rl, &cand.box);
+    cand.index = n * layer_width * layer_height + i;
+    cand.suppressed = false;
+
+    if (classes == 0)
+    {
+        cand.prob = scale;
+        cand.class = 0;
+        candidate_push(rl, &cand);
+        return;
+    }
+    for (uint32_t j = 0; j < classes; ++j)
+    {
+        float prob = scale * rl->class_buf[j];
+
+        if (prob > threshold)
+        {
+            cand.prob = prob;
+            cand.class = j;
+            candidate_push(rl, &cand);
+        }
+    }
+}
+
+// threshold on the objectness logit first, only cells that can pass are decoded
+static void get_region_candidates(yolo2_region_layer_t *rl)
+{
+    uint32_t wh = rl->layer_width * rl->layer_height;
+    uint32_t classes = rl->classes;
     uint32_t coords = rl->coords;
     float threshold = rl->threshold;
+    float obj_cutoff = rl->obj_cutoff;
 
-    for (int i = 0; i < layer_width * layer_height; ++i)
+    rl->candidate_number = 0;
+    for (uint32_t n = 0; n < rl->anchor_number; ++n)
     {
-        int row = i / layer_width;
-        int col = i % layer_width;
+        float *x = rl->input + n * wh * (coords + classes + 1);
+        float *obj = x + coords * wh;
 
-        for (int n = 0; n < anchor_number; ++n)
+        for (uint32_t i = 0; i < wh; ++i)
         {
-            int index = n * layer_width * layer_height + i;
-
-            for (int j = 0; j < classes; ++j)
-                probs[index][j] = 0;
-            int obj_index = entry_index(rl, n * layer_width * layer_height + i, coords);
-            int box_index = entry_index(rl, n * layer_width * layer_height + i, 0);
-            float scale  = predictions[obj_index];
-
-            boxes[index] = get_region_box(predictions, rl->anchor, n, box_index, col, row,
-                layer_width, layer_height, layer_width * layer_height);
-
-            float max = 0;
-            if(rl->classes > 0){
-                for (int j = 0; j < classes; ++j)
-                {
-                    int class_index = entry_index(rl, n * layer_width * layer_height + i, coords + 1 + j);
-                    float prob = scale * predictions[class_index];
-
-                    probs[index][j] = (prob > threshold) ? prob : 0;
-                    if (prob > max)
-                        max = prob;
-                }
-                probs[index][classes] = max;
-            }
-            else{
-                float prob = scale;
-
-                probs[index][0] = (prob > threshold) ? prob : 0;
-                if (prob > max)
-                    max = prob;
-                probs[index][0] = max;
-            }
+            if (!(obj[i] > obj_cutoff))
+                continue;
+            float scale = sigmoid(obj[i]);
+            if (!(scale > threshold))
+                continue;
+            if (classes)
+                softmax(obj + wh + i, classes, wh, rl->class_buf);
+            region_cell_candidates(rl, n, i, scale, sigmoid(x[i]), sigmoid(x[wh + i]),
+                                   expf(x[2 * wh + i]), expf(x[3 * wh + i]));
         }
     }
-    correct_region_boxes(rl, boxes);
 }
 
-static int nms_comparator(void *pa, void *pb)
+// every function of one value the decode needs, for the 256 values of q
+static void region_layer_build_lut(yolo2_region_layer_t *rl, const kpu_model_quant_param_t *q)
 {
-    sortable_box_t a = *(sortable_box_t *)pa;
-    sortable_box_t b = *(sortable_box_t *)pb;
-    float diff = a.probs[a.index][b.class] - b.probs[b.index][b.class];
-
-    if (diff < 0)
-        return 1;
-    else if (diff > 0)
-        return -1;
-    return 0;
+    float *lut_sigmoid = rl->lut;
+    float *lut_exp = lut_sigmoid + YOLO2_LUT_SIZE;
+    float *lut_exp_diff = lut_exp + YOLO2_LUT_SIZE;
+
+    for (int i = 0; i < YOLO2_LUT_SIZE; ++i)
+    {
+        float x = i * q->scale + q->bias;
+
+        lut_sigmoid[i] = sigmoid(x);
+        lut_exp[i] = expf(x);
+        lut_exp_diff[i] = expf(-i * q->scale);
+    }
+    rl->lut_q = *q;
 }
 
-static int nms_comparator_0(void *pa, void *pb)
+// objectness through the sigmoid table, only cells that pass are decoded
+static void get_region_candidates_quant(yolo2_region_layer_t *rl, const uint8_t *input)
 {
-    sortable_box_t a = *(sortable_box_t *)pa;
-    sortable_box_t b = *(sortable_box_t *)pb;
-    //float diff = a.probs[a.index][b.class] - b.probs[b.index][b.class];
-    float diff = a.probs[a.index][0] - b.probs[b.index][0];
-
-    if (diff < 0)
-        return 1;
-    else if (diff > 0)
-        return -1;
-    return 0;
+    uint32_t wh = rl->layer_width * rl->layer_height;
+    uint32_t classes = rl->classes;
+    uint32_t coords = rl->coords;
+    float threshold = rl->threshold;
+    const float *lut_sigmoid = rl->lut;
+    const float *lut_exp = lut_sigmoid + YOLO2_LUT_SIZE;
+    const float *lut_exp_diff = lut_exp + YOLO2_LUT_SIZE;
+
+    rl->candidate_number = 0;
+    for (uint32_t n = 0; n < rl->anchor_number; ++n)
+    {
+        const uint8_t *x = input + n * wh * (coords + classes + 1);
+        const uint8_t *obj = x + coords * wh;
+
+        for (uint32_t i = 0; i < wh; ++i)
+        {
+            float scale = lut_sigmoid[obj[i]];
+            if (!(scale > threshold))
+                continue;
+            if (classes)
+                softmax_quant(obj + wh + i, classes, wh, lut_exp_diff, rl->class_buf);
+            region_cell_candidates(rl, n, i, scale, lut_sigmoid[x[i]], lut_sigmoid[x[wh + i]],
+                                   lut_exp[x[2 * wh + i]], lut_exp[x[3 * wh + i]]);
+        }
+    }
 }
 
 static float overlap(float x1, float w1, float x2, float w2)
@@ -324,143 +410,117 @@ static float box_iou(box_t a, box_t b)
     return box_intersection(a, b) / box_union(a, b);
 }
 
-static void do_nms_sort(yolo2_region_layer_t *rl, box_t *boxes, float **probs)
+// class-aware greedy nms on the candidates, best class of every box left goes to results
+static void do_nms(yolo2_region_layer_t *rl)
 {
-    uint32_t boxes_number = rl->boxes_number;
-    uint32_t classes = (rl->classes==0) ? 1 : rl->classes;
+    candidate_t *c = (candidate_t *)rl->candidates;
+    uint16_t *results = rl->results;
+    uint32_t n = rl->candidate_number;
     float nms_value = rl->nms_value;
-    int i, j, k;
-    sortable_box_t s[boxes_number];
+    uint32_t num = 0;
 
-    for (i = 0; i < boxes_number; ++i)
+    // heap sort, the last reported goes to the end
+    for (uint32_t end = n; end > 1; --end)
     {
-        s[i].index = i;
-        s[i].class = 0;
-        s[i].probs = probs;
+        candidate_t t = c[0];
+        c[0] = c[end - 1];
+        c[end - 1] = t;
+        candidate_sift_down(c, 0, end - 1);
     }
 
-    for (k = 0; k < classes; ++k)
+    for (uint32_t i = 0; i < n; ++i)
     {
-        for (i = 0; i < boxes_number; ++i)
-            s[i].class = k;
-        if(rl->classes > 0)
-            qsort(s, boxes_number, sizeof(sortable_box_t), nms_comparator);
-        else
-            qsort(s, boxes_number, sizeof(sortable_box_t), nms_comparator_0);
-        for (i = 0; i < boxes_number; ++i)
+        if (c[i].suppressed)
+            continue;
+        for (uint32_t j = i + 1; j < n; ++j)
         {
-            if (probs[s[i].index][k] == 0)
-                continue;
-            box_t a = boxes[s[i].index];
-
-            for (j = i + 1; j < boxes_number; ++j)
-            {
-                box_t b = boxes[s[j].index];
-
-                if (box_iou(a, b) > nms_value)
-                    probs[s[j].index][k] = 0;
-            }
+            if (c[j].class == c[i].class && !c[j].suppressed && box_iou(c[i].box, c[j].box) > nms_value)
+                c[j].suppressed = true;
         }
     }
-}
-
-static int max_index(float *a, int n)
-{
-    int i, max_i = 0;
-    float max = a[0];
 
-    for (i = 1; i < n; ++i)
+    for (uint32_t i = 0; i < n; ++i)
     {
-        if (a[i] > max)
-        {
-            max   = a[i];
-            max_i = i;
-        }
+        if (c[i].suppressed)
+            continue;
+        // sorted by prob, the first one of a box is its best class
+        uint32_t k = num;
+        while (k > 0 && c[results[k - 1]].index > c[i].index)
+            k--;
+        if (k > 0 && c[results[k - 1]].index == c[i].index)
+            continue;
+        for (uint32_t m = num; m > k; --m)
+            results[m] = results[m - 1];
+        results[k] = i;
+        num++;
     }
-    return max_i;
+    rl->result_number = num;
 }
 
-static void region_layer_output(yolo2_region_layer_t *rl, obj_info_t *obj_info)
+static void region_layer_rect(yolo2_region_layer_t *rl, const candidate_t *c, yolo2_rect_t *rect)
 {
-    uint32_t obj_number = 0;
     uint32_t image_width = rl->image_width;
     uint32_t image_height = rl->image_height;
-    uint32_t boxes_number = rl->boxes_number;
-    float threshold = rl->threshold;
-    box_t *boxes = (box_t *)rl->boxes;
-    
-    for (int i = 0; i < rl->boxes_number; ++i)
-    {
-        int class  = max_index(rl->probs[i], rl->classes);
-        float prob = rl->probs[i][class];
-
-        if (prob > threshold)
-        {
-            box_t *b = boxes + i;
-            obj_info->obj[obj_number].x1 = b->x * image_width - (b->w * image_width / 2);
-            obj_info->obj[obj_number].y1 = b->y * image_height - (b->h * image_height / 2);
-            obj_info->obj[obj_number].x2 = b->x * image_width + (b->w * image_width / 2);
-            obj_info->obj[obj_number].y2 = b->y * image_height + (b->h * image_height / 2);
-            obj_info->obj[obj_number].class_id = class;
-            obj_info->obj[obj_number].prob = prob;
-            obj_number++;
-        }
-    }
-    obj_info->obj_number = obj_number;
+    const box_t *b = &c->box;
+
+    uint32_t x1 = b->x * image_width - (b->w * image_width / 2);
+    uint32_t y1 = b->y * image_height - (b->h * image_height / 2);
+    uint32_t x2 = b->x * image_width + (b->w * image_width / 2);
+    uint32_t y2 = b->y * image_height + (b->h * image_height / 2);
+    rect->x = x1;
+    rect->y = y1;
+    rect->w = x2 - x1;
+    rect->h = y2 - y1;
+    rect->class_id = c->class;
+    rect->prob = c->prob;
 }
 
 void yolo_region_layer_get_rect(yolo2_region_layer_t *rl, mp_obj_list_t* out_box)
 {
-    //uint32_t obj_number = 0;
-    uint32_t image_width = rl->image_width;
-    uint32_t image_height = rl->image_height;
-    //uint32_t boxes_number = rl->boxes_number;
-    float threshold = rl->threshold;
-    box_t *boxes = (box_t *)rl->boxes;
-    uint32_t out[4];
-    
-    for (int i = 0; i < rl->boxes_number; ++i)
-    {
-        int class  = max_index(rl->probs[i], rl->classes);
-        float prob = rl->probs[i][class];
+    candidate_t *c = (candidate_t *)rl->candidates;
+    yolo2_rect_t rect;
 
-        if (prob > threshold)
-        {
-            box_t *b = boxes + i;
-            uint32_t x1 = b->x * image_width - (b->w * image_width / 2);
-            uint32_t y1 = b->y * image_height - (b->h * image_height / 2);
-            uint32_t x2 = b->x * image_width + (b->w * image_width / 2);
-            uint32_t y2 = b->y * image_height + (b->h * image_height / 2);
-            out[0] = x1;//(x1 >= 320 ? 319 : x1); 
-            out[1] = y1;//(y1 >= 240 ? 239 : y1); 
-            out[2] = x2-x1;//(x2 >= 320 ? 319 : x2); 
-            out[3] = y2-y1;//(y2 >= 240 ? 239 : y2);
-
-            //out[4] = class;
-            //out[5] = prob;
-            //obj_number++;
-            mp_obj_list_t *ret_list = m_new(mp_obj_list_t, 1);
-            mp_obj_list_init(ret_list, 0);
-            mp_obj_list_append(ret_list, mp_obj_new_int(out[0]));
-            mp_obj_list_append(ret_list, mp_obj_new_int(out[1]));
-            mp_obj_list_append(ret_list, mp_obj_new_int(out[2]));
-            mp_obj_list_append(ret_list, mp_obj_new_int(out[3]));
-            mp_obj_list_append(ret_list, mp_obj_new_int(class));
-            mp_obj_list_append(ret_list, mp_obj_new_float(prob));
-
-            mp_obj_list_append(out_box, ret_list);   
-        }
+    for (uint32_t i = 0; i < rl->result_number; ++i)
+    {
+        region_layer_rect(rl, c + rl->results[i], &rect);
+
+        mp_obj_list_t *ret_list = m_new(mp_obj_list_t, 1);
+        mp_obj_list_init(ret_list, 0);
+        mp_obj_list_append(ret_list, mp_obj_new_int(rect.x));
+        mp_obj_list_append(ret_list, mp_obj_new_int(rect.y));
+        mp_obj_list_append(ret_list, mp_obj_new_int(rect.w));
+        mp_obj_list_append(ret_list, mp_obj_new_int(rect.h));
+        mp_obj_list_append(ret_list, mp_obj_new_int(rect.class_id));
+        mp_obj_list_append(ret_list, mp_obj_new_float(rect.prob));
+
+        mp_obj_list_append(out_box, ret_list);   
     }
-    //obj_info->obj_number = obj_number;
 }
 
-//void region_layer_run(yolo2_region_layer_t *rl, obj_info_t *obj_info)
+int yolo_region_layer_get_rects(yolo2_region_layer_t *rl, yolo2_rect_t *rects, int max)
+{
+    candidate_t *c = (candidate_t *)rl->candidates;
+    int num = 0;
+
+    for (uint32_t i = 0; i < rl->result_number && num < max; ++i)
+        region_layer_rect(rl, c + rl->results[i], rects + num++);
+    return num;
+}
+
+// no allocation, the work grows with the cells above threshold, not with the layer size
 void yolo_region_layer_run(yolo2_region_layer_t *rl)
 {
-    forward_region_layer(rl);
-    get_region_boxes(rl, rl->output, rl->probs, rl->boxes);
-    do_nms_sort(rl, rl->boxes, rl->probs);
-    //region_layer_output(rl, obj_info);
+    get_region_candidates(rl);
+    do_nms(rl);
+}
+
+// no float copy of the tensor, the tables are built again only when q changes
+void yolo_region_layer_run_quant(yolo2_region_layer_t *rl, const uint8_t *input, const kpu_model_quant_param_t *q)
+{
+    if (q->scale != rl->lut_q.scale || q->bias != rl->lut_q.bias)
+        region_layer_build_lut(rl, q);
+    get_region_candidates_quant(rl, input);
+    do_nms(rl);
 }
 
 /*
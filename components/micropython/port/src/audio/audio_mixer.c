@@ -0,0 +1,237 @@
+#include <string.h>
+#include "audio_mixer.h"
+
+#define MIXER_Q16_ONE (1u << 16)
+
+static audio_mixer_source_t* audio_mixer_get(audio_mixer_t* mixer, int id)
+{
+	if(id < 0 || id >= AUDIO_MIXER_MAX_SOURCES)
+		return NULL;
+	return &mixer->source[id];
+}
+
+static uint32_t audio_mixer_step(uint32_t in_rate, uint32_t out_rate)
+{
+	if(out_rate == 0)
+		return MIXER_Q16_ONE;
+	return (uint32_t)(((uint64_t)in_rate << 16) / out_rate);
+}
+
+static inline int16_t audio_mixer_sat16(int32_t v)
+{
+	if(v > 32767)
+		return 32767;
+	if(v < -32768)
+		return -32768;
+	return (int16_t)v;
+}
+
+void audio_mixer_init(audio_mixer_t* mixer, uint32_t out_rate)
+{
+	memset(mixer, 0, sizeof(audio_mixer_t));
+	mixer->out_rate = out_rate;
+}
+
+void audio_mixer_set_rate(audio_mixer_t* mixer, uint32_t out_rate)
+{
+	mixer->out_rate = out_rate;
+	for(int i = 0; i < AUDIO_MIXER_MAX_SOURCES; i++)
+	{
+		audio_mixer_source_t* src = &mixer->source[i];
+		if(src->used)
+			src->step = audio_mixer_step(src->rate, out_rate);
+	}
+}
+
+int audio_mixer_open(audio_mixer_t* mixer, uint32_t rate, uint8_t channels, int16_t* fifo, uint32_t fifo_frames)
+{
+	if(!fifo || rate == 0 || (channels != 1 && channels != 2))
+		return -1;
+	if(fifo_frames < 2 || (fifo_frames & (fifo_frames - 1)))
+		return -1;
+	for(int i = 0; i < AUDIO_MIXER_MAX_SOURCES; i++)
+	{
+		audio_mixer_source_t* src = &mixer->source[i];
+		if(src->used)
+			continue;
+		memset(src, 0, sizeof(audio_mixer_source_t));
+		src->fifo = fifo;
+		src->fifo_frames = fifo_frames;
+		src->rate = rate;
+		src->channels = channels;
+		src->step = audio_mixer_step(rate, mixer->out_rate);
+		src->gain = AUDIO_MIXER_GAIN_ONE;
+		src->used = true; // last, the mixer may be running
+		return i;
+	}
+	return -1;
+}
+
+void audio_mixer_close(audio_mixer_t* mixer, int id)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(src)
+		src->used = false;
+}
+
+void audio_mixer_set_gain(audio_mixer_t* mixer, int id, int32_t gain)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(!src)
+		return;
+	if(gain < 0)
+		gain = 0;
+	if(gain > AUDIO_MIXER_GAIN_ONE)
+		gain = AUDIO_MIXER_GAIN_ONE;
+	src->gain = gain;
+}
+
+void audio_mixer_end(audio_mixer_t* mixer, int id)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(src)
+		src->eof = true;
+}
+
+uint32_t audio_mixer_pending(audio_mixer_t* mixer, int id)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(!src || !src->used)
+		return 0;
+	return src->head - src->tail;
+}
+
+uint32_t audio_mixer_space(audio_mixer_t* mixer, int id)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(!src || !src->used || src->eof)
+		return 0;
+	return src->fifo_frames - (src->head - src->tail);
+}
+
+bool audio_mixer_drained(audio_mixer_t* mixer, int id)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(!src || !src->used)
+		return true;
+	return src->eof && src->head == src->tail;
+}
+
+bool audio_mixer_active(audio_mixer_t* mixer)
+{
+	for(int i = 0; i < AUDIO_MIXER_MAX_SOURCES; i++)
+	{
+		if(mixer->source[i].used)
+			return true;
+	}
+	return false;
+}
+
+uint32_t audio_mixer_write(audio_mixer_t* mixer, int id, const int16_t* pcm, uint32_t frames)
+{
+	audio_mixer_source_t* src = audio_mixer_get(mixer, id);
+	if(!src || !src->used || src->eof)
+		return 0;
+	uint32_t head = src->head;
+	uint32_t space = src->fifo_frames - (head - src->tail);
+	uint32_t mask = src->fifo_frames - 1;
+	if(frames > space)
+		frames = space;
+	for(uint32_t i = 0; i < frames; i++)
+	{
+		int16_t* dst = src->fifo + ((head + i) & mask) * 2;
+		if(src->channels == 1)
+		{
+			dst[0] = pcm[i];
+			dst[1] = pcm[i];
+		}
+		else
+		{
+			dst[0] = pcm[i * 2];
+			dst[1] = pcm[i * 2 + 1];
+		}
+	}
+	src->head = head + frames; // publish after the data is in place
+	return frames;
+}
+
+/* add one source into acc (frames * 2, L R). Returns false when it ran dry */
+static bool audio_mixer_source_mix(audio_mixer_source_t* src, int32_t* acc, uint32_t frames)
+{
+	uint32_t head = src->head;
+	uint32_t tail = src->tail;
+	uint32_t mask = src->fifo_frames - 1;
+	uint32_t phase = src->phase;
+	uint32_t step = src->step;
+	int32_t gain = src->gain;
+	bool eof = src->eof;
+	uint32_t i;
+
+	for(i = 0; i < frames; i++)
+	{
+		uint32_t avail = head - tail;
+		if(avail == 0)
+			break;
+		const int16_t* a = src->fifo + (tail & mask) * 2;
+		int32_t l = a[0];
+		int32_t r = a[1];
+		if(phase)
+		{
+			// interpolation needs the next frame too, the last one of a stream is held
+			if(avail < 2 && !eof)
+				break;
+			if(avail >= 2)
+			{
+				const int16_t* b = src->fifo + ((tail + 1) & mask) * 2;
+				l += (int32_t)(((int64_t)(b[0] - l) * phase) >> 16);
+				r += (int32_t)(((int64_t)(b[1] - r) * phase) >> 16);
+			}
+		}
+		acc[i * 2]     += (l * gain) >> 15;
+		acc[i * 2 + 1] += (r * gain) >> 15;
+		phase += step;
+		tail += phase >> 16;
+		phase &= MIXER_Q16_ONE - 1;
+		if(tail - src->tail > head - src->tail) // a step above 1.0 can jump past the written frames
+			tail = head;
+	}
+	src->phase = phase;
+	src->tail = tail;
+	return i == frames;
+}
+
+void audio_mixer_mix(audio_mixer_t* mixer, uint32_t* out, uint32_t frames)
+{
+	// sum in int32 a small block at a time, saturate once at the end
+	int32_t acc[64 * 2];
+	while(frames)
+	{
+		uint32_t n = frames > 64 ? 64 : frames;
+		bool any = false;
+		memset(acc, 0, n * 2 * sizeof(int32_t));
+		for(int s = 0; s < AUDIO_MIXER_MAX_SOURCES; s++)
+		{
+			audio_mixer_source_t* src = &mixer->source[s];
+			if(!src->used)
+				continue;
+			any = true;
+			if(!audio_mixer_source_mix(src, acc, n) && !src->eof)
+				src->underruns++;
+		}
+		if(any)
+		{
+			for(uint32_t i = 0; i < n; i++)
+			{
+				uint16_t l = (uint16_t)audio_mixer_sat16(acc[i * 2]);
+				uint16_t r = (uint16_t)audio_mixer_sat16(acc[i * 2 + 1]);
+				out[i] = ((uint32_t)r << 16) | l;
+			}
+		}
+		else
+		{
+			memset(out, 0, n * sizeof(uint32_t));
+		}
+		out += n;
+		frames -= n;
+	}
+}
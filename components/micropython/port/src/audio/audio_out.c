@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2s.h"
+#include "dmac.h"
+
+#include "audio_out.h"
+
+static audio_mixer_t audio_out_mix;
+static uint32_t* audio_out_buf = NULL; // AUDIO_OUT_BLOCK_NUM blocks of I2S words
+static int16_t* audio_out_fifo[AUDIO_MIXER_MAX_SOURCES];
+static i2s_device_number_t audio_out_i2s;
+static volatile bool audio_out_on = false;
+static volatile uint8_t audio_out_playing;
+
+static int on_irq_audio_transfer(void *ctx)
+{
+	if(!audio_out_on)
+		return 0;
+	// the next block was mixed while this one played, keep the I2S fed first
+	uint8_t done = audio_out_playing;
+	uint8_t next = (done + 1) % AUDIO_OUT_BLOCK_NUM;
+	i2s_send_data_dma(audio_out_i2s, audio_out_buf + next * AUDIO_OUT_BLOCK_FRAMES,
+						AUDIO_OUT_BLOCK_FRAMES, AUDIO_OUT_DMA_CHANNEL);
+	audio_out_playing = next;
+	audio_mixer_mix(&audio_out_mix, audio_out_buf + done * AUDIO_OUT_BLOCK_FRAMES, AUDIO_OUT_BLOCK_FRAMES);
+	return 0;
+}
+
+int audio_out_start(i2s_device_number_t i2s_num, uint32_t rate)
+{
+	if(audio_out_on)
+		return (audio_out_i2s == i2s_num) ? 0 : -1;
+	if(!audio_out_buf)
+	{
+		audio_out_buf = (uint32_t*)malloc(AUDIO_OUT_BLOCK_NUM * AUDIO_OUT_BLOCK_FRAMES * sizeof(uint32_t));
+		if(!audio_out_buf)
+			return -2;
+	}
+	if(!audio_mixer_active(&audio_out_mix))
+		audio_mixer_init(&audio_out_mix, rate);
+	else
+		audio_mixer_set_rate(&audio_out_mix, rate);
+	audio_out_i2s = i2s_num;
+	i2s_set_dma_divide_16(i2s_num, 1); // one word is a 16-bit L/R pair
+	for(int i = 0; i < AUDIO_OUT_BLOCK_NUM; i++)
+		audio_mixer_mix(&audio_out_mix, audio_out_buf + i * AUDIO_OUT_BLOCK_FRAMES, AUDIO_OUT_BLOCK_FRAMES);
+	audio_out_playing = 0;
+	audio_out_on = true;
+	dmac_set_irq(AUDIO_OUT_DMA_CHANNEL, on_irq_audio_transfer, NULL, 1);
+	i2s_send_data_dma(i2s_num, audio_out_buf, AUDIO_OUT_BLOCK_FRAMES, AUDIO_OUT_DMA_CHANNEL);
+	return 0;
+}
+
+void audio_out_stop(void)
+{
+	if(!audio_out_on)
+		return;
+	audio_out_on = false; // the IRQ of the block in flight does not queue another
+	dmac_wait_done(AUDIO_OUT_DMA_CHANNEL);
+	dmac_irq_unregister(AUDIO_OUT_DMA_CHANNEL);
+	free(audio_out_buf);
+	audio_out_buf = NULL;
+}
+
+bool audio_out_running(void)
+{
+	return audio_out_on;
+}
+
+void audio_out_set_rate(i2s_device_number_t i2s_num, uint32_t rate)
+{
+	if(audio_out_on && audio_out_i2s == i2s_num)
+		audio_mixer_set_rate(&audio_out_mix, rate);
+}
+
+int audio_out_open(uint32_t rate, uint8_t channels)
+{
+	int16_t* fifo = (int16_t*)malloc(AUDIO_OUT_FIFO_FRAMES * 2 * sizeof(int16_t));
+	int id = fifo ? audio_mixer_open(&audio_out_mix, rate, channels, fifo, AUDIO_OUT_FIFO_FRAMES) : -2;
+	if(id < 0)
+	{
+		free(fifo);
+		if(!audio_mixer_active(&audio_out_mix)) // started for this source only
+			audio_out_stop();
+		return (id == -2) ? -2 : -1;
+	}
+	audio_out_fifo[id] = fifo;
+	return id;
+}
+
+void audio_out_close(int id)
+{
+	if(id < 0 || id >= AUDIO_MIXER_MAX_SOURCES)
+		return;
+	audio_mixer_close(&audio_out_mix, id); // the IRQ skips it from here on
+	free(audio_out_fifo[id]);
+	audio_out_fifo[id] = NULL;
+	if(!audio_mixer_active(&audio_out_mix))
+		audio_out_stop();
+}
+
+audio_mixer_t* audio_out_mixer(void)
+{
+	return &audio_out_mix;
+}
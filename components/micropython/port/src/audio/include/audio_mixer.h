@@ -0,0 +1,64 @@
+#ifndef _AUDIO_MIXER_H
+#define _AUDIO_MIXER_H
+
+/* Fixed-point mixer for the I2S output.
+
+ Every source has its own PCM FIFO at its own rate and channel count (16-bit, 1 or 2 channels).
+ audio_mixer_mix() pulls one block at the output rate: each source is resampled by linear
+ interpolation (Q16 phase), scaled by a Q15 gain, summed and saturated, and written as I2S
+ words (left in the low half, right in the high half, what i2s_play sends for 16-bit stereo).
+
+ One producer (the player) and one consumer (the DMA IRQ) per source, no locks needed.
+ No MicroPython or SDK dependency, so it builds on a PC as well.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AUDIO_MIXER_MAX_SOURCES 4
+#define AUDIO_MIXER_GAIN_ONE    32768   // Q15 1.0
+
+typedef struct _audio_mixer_source_t
+{
+	int16_t* fifo;              // fifo_frames stereo frames, L R
+	uint32_t fifo_frames;       // power of two
+	volatile uint32_t head;     // frames written, free running
+	volatile uint32_t tail;     // frames consumed, free running
+	uint32_t rate;
+	uint32_t step;              // source frames per output frame, Q16
+	uint32_t phase;             // Q16, between fifo[tail] and fifo[tail+1]
+	volatile int32_t gain;      // Q15, 0 .. AUDIO_MIXER_GAIN_ONE
+	uint8_t channels;
+	volatile bool used;
+	volatile bool eof;          // no more writes, play out what is left
+	uint32_t underruns;         // output blocks the source ran dry in
+} audio_mixer_source_t;
+
+typedef struct _audio_mixer_t
+{
+	uint32_t out_rate;
+	audio_mixer_source_t source[AUDIO_MIXER_MAX_SOURCES];
+} audio_mixer_t;
+
+void audio_mixer_init(audio_mixer_t* mixer, uint32_t out_rate);
+void audio_mixer_set_rate(audio_mixer_t* mixer, uint32_t out_rate);
+
+/* fifo holds fifo_frames stereo frames (fifo_frames * 2 int16), fifo_frames a power of two.
+   returns the source id, or -1 when all sources are in use or the arguments are bad */
+int audio_mixer_open(audio_mixer_t* mixer, uint32_t rate, uint8_t channels, int16_t* fifo, uint32_t fifo_frames);
+void audio_mixer_close(audio_mixer_t* mixer, int id);
+void audio_mixer_set_gain(audio_mixer_t* mixer, int id, int32_t gain);
+void audio_mixer_end(audio_mixer_t* mixer, int id);
+
+uint32_t audio_mixer_space(audio_mixer_t* mixer, int id);
+uint32_t audio_mixer_pending(audio_mixer_t* mixer, int id);
+bool audio_mixer_drained(audio_mixer_t* mixer, int id);
+bool audio_mixer_active(audio_mixer_t* mixer);
+
+/* pcm in the source layout (interleaved when stereo), returns the frames taken */
+uint32_t audio_mixer_write(audio_mixer_t* mixer, int id, const int16_t* pcm, uint32_t frames);
+
+/* fill out with frames I2S words, silence where no source has data */
+void audio_mixer_mix(audio_mixer_t* mixer, uint32_t* out, uint32_t frames);
+
+#endif /* _AUDIO_MIXER_H */
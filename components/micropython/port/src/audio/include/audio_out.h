@@ -0,0 +1,37 @@
+#ifndef _AUDIO_OUT_H
+#define _AUDIO_OUT_H
+
+/* I2S playback through audio_mixer.
+
+ One DMA ring (AUDIO_OUT_DMA_CHANNEL) plays whatever the mixer produces, players just open a
+ source and keep its FIFO filled. The ring starts with the first source and stops after the last
+ one is closed, so the WAV player and the AVI player can run at the same time.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2s.h"
+#include "dmac.h"
+#include "audio_mixer.h"
+
+#define AUDIO_OUT_DMA_CHANNEL  DMAC_CHANNEL4
+#define AUDIO_OUT_BLOCK_FRAMES 256          // 5.8ms at 44.1kHz
+#define AUDIO_OUT_BLOCK_NUM    2
+#define AUDIO_OUT_FIFO_FRAMES  2048         // per source, power of two
+
+/* rate: output rate, the I2S device must be set to it. Ignored when already running on i2s_num.
+   returns 0, -1 when running on another device, -2 out of memory */
+int audio_out_start(i2s_device_number_t i2s_num, uint32_t rate);
+void audio_out_stop(void);
+bool audio_out_running(void);
+/* the I2S device rate changed, resample the sources to it */
+void audio_out_set_rate(i2s_device_number_t i2s_num, uint32_t rate);
+
+/* returns the source id, -1 when no source is free, -2 out of memory.
+   On failure the output is stopped again if nothing else plays */
+int audio_out_open(uint32_t rate, uint8_t channels);
+/* stops the output after the last source */
+void audio_out_close(int id);
+audio_mixer_t* audio_out_mixer(void);
+
+#endif /* _AUDIO_OUT_H */
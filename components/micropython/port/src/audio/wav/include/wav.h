@@ -28,8 +28,9 @@ Finally, the data chunk contains the sample data:
 */
 
 #include "stdint.h"
+#include "audio_out.h"
 
-#define WAV_PLAY_DMA_CHANNEL DMAC_CHANNEL4
+#define WAV_PLAY_DMA_CHANNEL AUDIO_OUT_DMA_CHANNEL
 #define WAV_RECORD_DMA_CHANNEL DMAC_CHANNEL3
 
 //---------------------------------decode-----------------------------
@@ -42,7 +43,6 @@ typedef struct _wav_audio_buf_t
 } wav_audio_buf_t __attribute__((aligned(8)));
 
 /* Audio file information structure */
-#define MAX_PLAY_BUF_NUM 4
 typedef struct _wav_decode_t
 {
 	uint16_t numchannels;
@@ -52,9 +52,8 @@ typedef struct _wav_decode_t
 	uint16_t bitspersample;
 	uint32_t datasize;
   /* play */
-  uint32_t read_order;
-  uint32_t play_order;
-  wav_audio_buf_t audio_buf[MAX_PLAY_BUF_NUM];
+  int source;      // audio_out source, -1 if not opened
+  bool eof;        // file read to the end, source draining
 }wav_decode_t __attribute__((aligned(8)));
 
 /* Error Identification structure */
@@ -74,6 +73,7 @@ typedef enum _wav_err_t
 	UNSUPPORETD_BITS_PER_SAMPLE,   //11
 	UNVALID_LIST_SIZE,			   //12
 	UNVALID_DATA_ID,			   //13
+	UNVALID_BLOCK_ALIGN,		   //14
 }wav_err_t;
 
 wav_err_t wav_init(wav_decode_t *wav_obj,void* head, uint32_t head_size, uint32_t file_size, uint32_t* head_len);
@@ -29,18 +29,6 @@
 
 #define WAV_BUF_SIZE (4*1024)
 
-static int on_irq_audio_transfer(void *ctx)
-{
-	audio_t* audio_obj =  (audio_t*)ctx;
-	wav_decode_t* wav_play_obj = audio_obj->play_obj;
-    // printk("[CANMV]: play_order %d ok\r\n",wav_play_obj->play_order);
-    wav_play_obj->audio_buf[wav_play_obj->play_order].empty = true;
-	wav_play_obj->play_order++;
-    if(wav_play_obj->play_order > MAX_PLAY_BUF_NUM - 1)
-        wav_play_obj->play_order = 0;
-    return 0;
-}
-
 static int on_irq_audio_receive(void *ctx)
 {
 	audio_t* audio_obj =  (audio_t*)ctx;
@@ -91,6 +79,8 @@ wav_err_t wav_init(wav_decode_t *wav_obj,void* head, uint32_t head_size, uint32_
 
 	index += 2;
 	wav_obj->samplerate = LG_READ_WORD(index);//sample rate
+	if (wav_obj->samplerate == 0)
+		return UNSUPPORETD_SAMPLE_RATE;
 
 	index += 4;
 	wav_obj->byterate = LG_READ_WORD(index);//bytearte
@@ -98,8 +88,10 @@ wav_err_t wav_init(wav_decode_t *wav_obj,void* head, uint32_t head_size, uint32_
 	wav_obj->blockalign = LG_READ_HALF(index);//block align
 	index += 2;
 	wav_obj->bitspersample = LG_READ_HALF(index);//bits_per_sample
-	if (wav_obj->bitspersample != 8 && wav_obj->bitspersample != 16 && wav_obj->bitspersample != 24)
+	if (wav_obj->bitspersample != 8 && wav_obj->bitspersample != 16 && wav_obj->bitspersample != 24)//wav_to_s16 converts these
 		return UNSUPPORETD_BITS_PER_SAMPLE;
+	if (wav_obj->blockalign != wav_obj->numchannels * (wav_obj->bitspersample / 8))//wav_play reads whole frames of this size
+		return UNVALID_BLOCK_ALIGN;
 
 	index += 2;
 	if (BG_READ_WORD(index) == LIST_ID)//extend format block
@@ -138,9 +130,11 @@ mp_obj_t wav_play_process(audio_t* audio,uint32_t file_size)
 	{
 		mp_printf(&mp_plat_print, "[CANMV]: Can not create decode object\r\n");
 		m_del(mp_obj_list_t,ret_list,1);
-		m_del(wav_decode_t,audio->play_obj,1);
 		vfs_internal_close(audio->fp,&close_code);
+		mp_raise_OSError(MP_ENOMEM);
 	}
+	((wav_decode_t*)audio->play_obj)->source = -1;
+	((wav_decode_t*)audio->play_obj)->eof = false;
 	uint32_t head_max_len = audio->points*(sizeof(uint32_t));
 	/* uint32_t read_num = */vfs_internal_read(audio->fp,audio->buf, head_max_len,&err_code);//read head
 	if(err_code != 0)
@@ -158,7 +152,13 @@ mp_obj_t wav_play_process(audio_t* audio,uint32_t file_size)
 		mp_printf(&mp_plat_print, "[CANMV]: wav error code : %d\r\n",status);
 		m_del(mp_obj_list_t,ret_list,1);
 		m_del(wav_decode_t,audio->play_obj,1);
+		audio->play_obj = NULL;//wav_finish would free and close them again
 		vfs_internal_close(audio->fp,&close_code);
+		audio->fp = MP_OBJ_NULL;
+		if(status == UNSUPPORETD_BITS_PER_SAMPLE)
+			mp_raise_ValueError("only 8, 16 and 24 bit PCM wav is supported");
+		if(status == UNVALID_BLOCK_ALIGN || status == UNSUPPORETD_SAMPLE_RATE)
+			mp_raise_ValueError("invalid wav format chunk");
 		mp_raise_msg(&mp_type_OSError,"wav init error");
 	}
 	wav_decode_t* wav_fmt = audio->play_obj;
@@ -187,97 +187,78 @@ mp_obj_t wav_play_process(audio_t* audio,uint32_t file_size)
 	}
 	memset(audio->buf, 0, audio->points * sizeof(uint32_t));//clear buffer
 
+	Maix_i2s_obj_t* i2s_dev = audio->dev;
 	wav_decode_t* wav_play_obj = audio->play_obj;
-	for(int i = 0; i < MAX_PLAY_BUF_NUM; i++)//init wav buf
+	// set_sample_rate() usually comes after this, audio_out follows it then
+	uint32_t out_rate = i2s_dev->sample_rate ? i2s_dev->sample_rate : wav_play_obj->samplerate;
+	if(audio_out_start(i2s_dev->i2s_num, out_rate) != 0)
 	{
-		wav_play_obj->audio_buf[i].buf = malloc(WAV_BUF_SIZE);
-		if(!wav_play_obj->audio_buf[i].buf)
-		{
-			wav_finish(audio);
+		wav_finish(audio);
+		mp_raise_msg(&mp_type_OSError, "audio output busy on another i2s");
+	}
+	wav_play_obj->source = audio_out_open(wav_play_obj->samplerate, wav_play_obj->numchannels);
+	if(wav_play_obj->source < 0)
+	{
+		int err = wav_play_obj->source;
+		wav_finish(audio);
+		if(err == -2)
 			mp_raise_OSError(MP_ENOMEM);
-		}
-		wav_play_obj->audio_buf[i].len = WAV_BUF_SIZE;
-		wav_play_obj->audio_buf[i].empty = true;
+		mp_raise_msg(&mp_type_OSError, "too many audio playing");
 	}
-	wav_play_obj->play_order = 0;
-	wav_play_obj->read_order = 0;
-	dmac_set_irq(WAV_PLAY_DMA_CHANNEL, on_irq_audio_transfer, (void*)audio, 1);
 	return MP_OBJ_FROM_PTR(ret_list);
 }
 
+/* samples of bits width to int16 in place. 8-bit data sits at the end of buf so it can grow forward */
+static void wav_to_s16(int16_t* dst, const uint8_t* src, uint32_t samples, uint16_t bits)
+{
+	if(bits == 8)
+	{
+		for(uint32_t i = 0; i < samples; i++)
+			dst[i] = (int16_t)(((int)src[i] - 128) << 8);
+	}
+	else if(bits == 24)
+	{
+		for(uint32_t i = 0; i < samples; i++)
+			dst[i] = (int16_t)(src[i * 3 + 1] | (src[i * 3 + 2] << 8));
+	}
+}
+
 mp_obj_t wav_play(audio_t* audio)
 {
 	wav_decode_t* play_obj = audio->play_obj; //get format
-	wav_decode_t* wav_play_obj = play_obj;
-	Maix_i2s_obj_t* i2s_dev = audio->dev;//get device
+	audio_mixer_t* mixer = audio_out_mixer();
 	uint32_t read_num = 0;
 	int err_code = 0;
-	if(play_obj->audio_buf[play_obj->read_order].empty)//empty ,altread to read
-	{
-		short MSB_audio = 0;
-		short LSB_audio = 0;
-		
-		play_obj->audio_buf[play_obj->read_order].empty = false;
 
-		// mp_printf(&mp_plat_print, "[CANMV]: read_order = %d\r\n",play_obj->read_order);
-		if(play_obj->numchannels == 1)//TODO: optimize mono
-		{
-			read_num = vfs_internal_read(audio->fp, 
-										play_obj->audio_buf[play_obj->read_order].buf+audio->points * sizeof(uint32_t)/2, 
-										audio->points * sizeof(uint32_t)/2, 
-										&err_code);//read data
-		}
-		else
-		{
-			read_num = vfs_internal_read(audio->fp, 
-										play_obj->audio_buf[play_obj->read_order].buf, 
-										audio->points * sizeof(uint32_t), 
-										&err_code);//read data
-		}
-		if(err_code != 0)
-			mp_raise_msg(&mp_type_OSError, "read file error");
-		if(read_num==0)
-			return mp_obj_new_int(0);
-		if(play_obj->numchannels == 1)//TODO: optimize mono
-		{
-			int16_t* src = (int16_t*)(play_obj->audio_buf[play_obj->read_order].buf + audio->points * sizeof(uint32_t)/2);
-			uint32_t* dst = (uint32_t*)(play_obj->audio_buf[play_obj->read_order].buf);
-			for(int i=0; i<read_num/sizeof(int16_t); ++i)
-			{
-				src[i] = (int16_t)(src[i] * audio->volume / 100);
-				dst[i] = ((uint32_t)src[i]<<16) | ((uint32_t)src[i] & 0xFFFF);
-			}
-			play_obj->audio_buf[play_obj->read_order].len = read_num*2;
-		}
-		else
-		{
-			uint32_t* audio_buf = (uint32_t*)play_obj->audio_buf[play_obj->read_order].buf;
-			for(int i = 0; i < read_num / sizeof(uint32_t); i++)//Currently only supports two-channel wav files
-			{
-				LSB_audio = audio_buf[i];
-				LSB_audio = (short)(LSB_audio * audio->volume / 100);
-				MSB_audio = audio_buf[i] >> 16;
-				MSB_audio = (short)(MSB_audio * audio->volume / 100);
-				audio_buf[i] = ( (uint32_t)MSB_audio << 16 ) | ((uint32_t)LSB_audio & 0xFFFF);
-			}
-			play_obj->audio_buf[play_obj->read_order].len = read_num;
-		}
-		play_obj->read_order++;
-		if(play_obj->read_order > MAX_PLAY_BUF_NUM - 1)
-        	play_obj->read_order = 0;
-	}
-	if(!wav_play_obj->audio_buf[wav_play_obj->play_order].empty)//not empty ,already to play
+	audio_mixer_set_gain(mixer, play_obj->source, (int32_t)(audio->volume * AUDIO_MIXER_GAIN_ONE / 100));
+	if(play_obj->eof)
+		return mp_obj_new_int(audio_mixer_drained(mixer, play_obj->source) ? 0 : 1);
+
+	// as much as the source FIFO takes and audio->buf holds once widened to 16 bits
+	uint32_t frame_bytes = play_obj->numchannels * sizeof(int16_t);
+	if(play_obj->blockalign > frame_bytes)
+		frame_bytes = play_obj->blockalign;
+	uint32_t frames = audio_mixer_space(mixer, play_obj->source);
+	if(frames > audio->points * sizeof(uint32_t) / frame_bytes)
+		frames = audio->points * sizeof(uint32_t) / frame_bytes;
+	if(frames == 0)
+		return mp_obj_new_int(1);
+	uint32_t len = frames * play_obj->blockalign;
+	uint8_t* buf = (uint8_t*)audio->buf;
+	if(play_obj->bitspersample == 8)
+		buf += audio->points * sizeof(uint32_t) - len;
+	read_num = vfs_internal_read(audio->fp, buf, len, &err_code);//read data
+	if(err_code != 0)
+		mp_raise_msg(&mp_type_OSError, "read file error");
+	frames = read_num / play_obj->blockalign;
+	if(frames == 0)
 	{
-		// mp_printf(&mp_plat_print, "[CANMV]: play_order = %d\r\n",wav_play_obj->play_order);
-		i2s_play(i2s_dev->i2s_num,
-					WAV_PLAY_DMA_CHANNEL,
-					wav_play_obj->audio_buf[wav_play_obj->play_order].buf,
-					wav_play_obj->audio_buf[wav_play_obj->play_order].len,
-					wav_play_obj->audio_buf[wav_play_obj->play_order].len / sizeof(uint32_t),
-					wav_play_obj->bitspersample,
-					2);
-					// wav_play_obj->numchannels);//play readed data//TODO: fix mono
+		play_obj->eof = true;
+		audio_mixer_end(mixer, play_obj->source);
+		return mp_obj_new_int(audio_mixer_drained(mixer, play_obj->source) ? 0 : 1);
 	}
+	wav_to_s16((int16_t*)audio->buf, buf, frames * play_obj->numchannels, play_obj->bitspersample);
+	audio_mixer_write(mixer, play_obj->source, (int16_t*)audio->buf, frames);
 	return mp_obj_new_int(1);
 }
 
@@ -410,14 +391,9 @@ void wav_finish(audio_t* audio)
 	if(audio->play_obj != NULL)
 	{
 		wav_decode_t* wav_play_obj = audio->play_obj;
-		for(int i = 0; i < MAX_PLAY_BUF_NUM; i++)//init wav buf
-		{
-			if(wav_play_obj->audio_buf[i].buf)
-			{
-				free(wav_play_obj->audio_buf[i].buf);
-				wav_play_obj->audio_buf[i].buf = NULL;
-			}
-		}
+		if(wav_play_obj->source >= 0)
+			audio_out_close(wav_play_obj->source);
+		wav_play_obj->source = -1;
 		m_del(wav_decode_t,audio->play_obj,1);
 		audio->play_obj = NULL;
 		if(audio->fp != MP_OBJ_NULL)
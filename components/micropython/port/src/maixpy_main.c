@@ -95,10 +95,14 @@
 #include "framebuffer.h"
 #include "sensor.h"
 #include "omv.h"
+#include "vfs_wrapper.h"
 #include "sipeed_conv.h"
 #include "ide_dbg.h"
 #include "global_config.h"
 #include "Maix_config.h"
+#if CONFIG_MAIXPY_PIPELINE_ENABLE
+#include "pipeline.h"
+#endif
 
 /********* others *******/
 #include "boards.h"
@@ -252,14 +256,8 @@ MP_NOINLINE STATIC spiffs_user_mount_t *init_flash_spiffs()
   vfs_spiffs->cfg.phys_erase_block = CONFIG_SPIFFS_EREASE_SIZE;
   vfs_spiffs->cfg.log_block_size = CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE;
   vfs_spiffs->cfg.log_page_size = CONFIG_SPIFFS_LOGICAL_PAGE_SIZE;
-  int res = SPIFFS_mount(&(vfs_spiffs->fs),
-                         &(vfs_spiffs->cfg),
-                         spiffs_work_buf,
-                         spiffs_fds,
-                         sizeof(spiffs_fds),
-                         spiffs_cache_buf,
-                         sizeof(spiffs_cache_buf),
-                         0);
+  spiffs_mount_opt_default(&vfs_spiffs->opt);
+  int res = spiffs_vfs_mount_fs(vfs_spiffs);
   if (FORMAT_FS_FORCE || res != SPIFFS_OK || res == SPIFFS_ERR_NOT_A_FS)
   {
     SPIFFS_unmount(&vfs_spiffs->fs);
@@ -271,14 +269,7 @@ MP_NOINLINE STATIC spiffs_user_mount_t *init_flash_spiffs()
     {
       return false;
     }
-    res = SPIFFS_mount(&vfs_spiffs->fs,
-                       &vfs_spiffs->cfg,
-                       spiffs_work_buf,
-                       spiffs_fds,
-                       sizeof(spiffs_fds),
-                       spiffs_cache_buf,
-                       sizeof(spiffs_cache_buf),
-                       0);
+    res = spiffs_vfs_mount_fs(vfs_spiffs);
     printk("[CANMV]:Spiffs Mount %s \n", res ? "failed" : "successful");
     if (!res)
     {
@@ -726,13 +717,18 @@ soft_reset:
       {
         mp_obj_print_exception(&mp_plat_print, (mp_obj_t)nlr.ret_val);
       }
+      file_buffer_deinit();
       ide_dbg_on_script_end();
     }
   } while (MP_STATE_PORT(Maix_stdio_uart)->ide_debug_mode);
 
+#if CONFIG_MAIXPY_PIPELINE_ENABLE
+  pipeline_stop_all(); // its tasks use objects gc_sweep_all is about to free
+#endif
 #if MICROPY_PY_THREAD
   mp_thread_deinit();
 #endif
+  file_buffer_deinit();
 #if MICROPY_ENABLE_GC
   gc_sweep_all();
 #endif
@@ -0,0 +1,100 @@
+#ifndef __MJPEG_STREAM_H
+#define __MJPEG_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// multipart/x-mixed-replace MJPEG over HTTP, independent of the socket backend
+
+#define MJPEG_STREAM_MAX_SLOTS     8
+#define MJPEG_STREAM_MAX_CLIENTS   4
+#define MJPEG_STREAM_BOUNDARY      "mjpegframe"
+#define MJPEG_STREAM_SEND_BUDGET   (8*1024) // max bytes written per client per poll
+
+/**
+ * write at most len bytes without blocking
+ * @return bytes written, 0 if it would block, <0 if the client is gone
+ */
+typedef int (*mjpeg_stream_send_t)(void* sock, const uint8_t* buf, uint32_t len);
+// called once a client is removed, e.g. to close its socket
+typedef void (*mjpeg_stream_close_t)(void* sock);
+
+typedef struct{
+    uint8_t*  data;
+    uint32_t  size;      // jpeg bytes in data, 0 while being filled
+    uint32_t  seq;       // frame number, 0 if never filled
+    uint8_t   refs;      // clients sending from this slot
+} mjpeg_stream_slot_t;
+
+typedef enum{
+    MJPEG_STREAM_CLIENT_FREE = 0,
+    MJPEG_STREAM_CLIENT_HEADER,   // HTTP response header
+    MJPEG_STREAM_CLIENT_IDLE,     // waiting for a frame newer than last_seq
+    MJPEG_STREAM_CLIENT_PART,     // part header of slot
+    MJPEG_STREAM_CLIENT_JPEG,     // jpeg data of slot
+    MJPEG_STREAM_CLIENT_TRAILER,  // CRLF after the jpeg data
+} mjpeg_stream_client_state_t;
+
+typedef struct{
+    void*     sock;
+    uint8_t   state;
+    int8_t    slot;
+    uint16_t  head_len;
+    uint32_t  offset;    // bytes of the current piece already sent
+    uint32_t  last_seq;  // last frame started
+    uint32_t  frames;    // frames sent
+    uint32_t  dropped;   // frames skipped because the client was still busy
+    char      head[128];
+} mjpeg_stream_client_t;
+
+typedef struct{
+    mjpeg_stream_slot_t   slots[MJPEG_STREAM_MAX_SLOTS];
+    mjpeg_stream_client_t clients[MJPEG_STREAM_MAX_CLIENTS];
+    uint8_t               slot_num;
+    uint32_t              slot_size;
+    int8_t                newest;   // slot with the newest complete frame, -1 if none
+    int8_t                filling;  // slot handed out by acquire, -1 if none
+    uint32_t              seq;
+    uint32_t              frames;   // frames committed
+    uint32_t              dropped;  // frames not queued, no free slot or too big
+    mjpeg_stream_send_t   send;
+    mjpeg_stream_close_t  close;
+} mjpeg_stream_t;
+
+/**
+ * @param slot_num frames kept in the ring, at least clients + 2 never drops at the producer
+ * @return 0 if success, or error code(>0 from errno.h)
+ */
+int mjpeg_stream_init(mjpeg_stream_t* s, uint8_t slot_num, uint32_t slot_size,
+                      mjpeg_stream_send_t send, mjpeg_stream_close_t close);
+/**
+ * remove (and close) every client, then free the ring
+ */
+void mjpeg_stream_deinit(mjpeg_stream_t* s);
+/**
+ * free the ring and forget the clients without calling close,
+ * for finalisers where the client sockets may already be gone
+ */
+void mjpeg_stream_release(mjpeg_stream_t* s);
+/**
+ * get a free slot to put the next jpeg into, no client is reading it
+ * @return NULL if every slot is held by a client, the frame should be skipped
+ */
+uint8_t* mjpeg_stream_acquire(mjpeg_stream_t* s, uint32_t* capacity);
+/**
+ * publish the acquired slot as newest frame, size 0 (e.g. encoder overflow) gives it back
+ */
+void mjpeg_stream_commit(mjpeg_stream_t* s, uint32_t size);
+/**
+ * @return client index or -1 if there is no room
+ */
+int mjpeg_stream_add_client(mjpeg_stream_t* s, void* sock);
+void mjpeg_stream_remove_client(mjpeg_stream_t* s, int index);
+/**
+ * push pending data to every client without blocking, clients that fail are removed
+ * @return number of connected clients
+ */
+int mjpeg_stream_poll(mjpeg_stream_t* s);
+int mjpeg_stream_client_num(mjpeg_stream_t* s);
+
+#endif
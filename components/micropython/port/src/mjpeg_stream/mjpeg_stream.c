@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "mjpeg_stream.h"
+
+static const char mjpeg_stream_http_header[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_STREAM_BOUNDARY "\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+int mjpeg_stream_init(mjpeg_stream_t* s, uint8_t slot_num, uint32_t slot_size,
+                      mjpeg_stream_send_t send, mjpeg_stream_close_t close)
+{
+    memset(s, 0, sizeof(mjpeg_stream_t));
+    if(slot_num < 2 || slot_num > MJPEG_STREAM_MAX_SLOTS || slot_size == 0 || !send)
+        return EINVAL;
+    s->slot_num = slot_num;
+    s->slot_size = slot_size;
+    s->newest = -1;
+    s->filling = -1;
+    s->send = send;
+    s->close = close;
+    for(uint8_t i=0; i<slot_num; ++i)
+    {
+        s->slots[i].data = (uint8_t*)malloc(slot_size);
+        if(!s->slots[i].data)
+        {
+            mjpeg_stream_deinit(s);
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+void mjpeg_stream_deinit(mjpeg_stream_t* s)
+{
+    for(int i=0; i<MJPEG_STREAM_MAX_CLIENTS; ++i)
+        mjpeg_stream_remove_client(s, i);
+    mjpeg_stream_release(s);
+}
+
+void mjpeg_stream_release(mjpeg_stream_t* s)
+{
+    memset(s->clients, 0, sizeof(s->clients));
+    for(int i=0; i<MJPEG_STREAM_MAX_SLOTS; ++i)
+    {
+        if(s->slots[i].data)
+            free(s->slots[i].data);
+        s->slots[i].data = NULL;
+    }
+    s->slot_num = 0;
+    s->newest = -1;
+    s->filling = -1;
+}
+
+uint8_t* mjpeg_stream_acquire(mjpeg_stream_t* s, uint32_t* capacity)
+{
+    int8_t pick = -1;
+    // reuse the oldest frame nobody is reading, never the newest one
+    for(int8_t i=0; i<s->slot_num; ++i)
+    {
+        mjpeg_stream_slot_t* slot = &s->slots[i];
+        if(i == s->newest || slot->refs)
+            continue;
+        if(pick < 0 || slot->seq < s->slots[pick].seq)
+            pick = i;
+    }
+    if(pick < 0)
+    {
+        ++s->dropped;
+        return NULL;
+    }
+    s->slots[pick].size = 0;
+    s->slots[pick].seq = 0;
+    s->filling = pick;
+    if(capacity)
+        *capacity = s->slot_size;
+    return s->slots[pick].data;
+}
+
+void mjpeg_stream_commit(mjpeg_stream_t* s, uint32_t size)
+{
+    if(s->filling < 0)
+        return;
+    if(size == 0 || size > s->slot_size)
+    {
+        ++s->dropped;
+        s->filling = -1;
+        return;
+    }
+    mjpeg_stream_slot_t* slot = &s->slots[s->filling];
+    slot->size = size;
+    slot->seq = ++s->seq;
+    s->newest = s->filling;
+    s->filling = -1;
+    ++s->frames;
+}
+
+int mjpeg_stream_add_client(mjpeg_stream_t* s, void* sock)
+{
+    for(int i=0; i<MJPEG_STREAM_MAX_CLIENTS; ++i)
+    {
+        mjpeg_stream_client_t* c = &s->clients[i];
+        if(c->state != MJPEG_STREAM_CLIENT_FREE)
+            continue;
+        memset(c, 0, sizeof(mjpeg_stream_client_t));
+        c->sock = sock;
+        c->slot = -1;
+        // a new client starts at the newest frame, not at the first one ever sent
+        c->last_seq = (s->newest >= 0) ? s->slots[s->newest].seq - 1 : s->seq;
+        c->state = MJPEG_STREAM_CLIENT_HEADER;
+        return i;
+    }
+    return -1;
+}
+
+void mjpeg_stream_remove_client(mjpeg_stream_t* s, int index)
+{
+    if(index < 0 || index >= MJPEG_STREAM_MAX_CLIENTS)
+        return;
+    mjpeg_stream_client_t* c = &s->clients[index];
+    if(c->state == MJPEG_STREAM_CLIENT_FREE)
+        return;
+    if(c->slot >= 0)
+        --s->slots[c->slot].refs;
+    c->slot = -1;
+    c->state = MJPEG_STREAM_CLIENT_FREE;
+    if(s->close)
+        s->close(c->sock);
+    c->sock = NULL;
+}
+
+int mjpeg_stream_client_num(mjpeg_stream_t* s)
+{
+    int num = 0;
+    for(int i=0; i<MJPEG_STREAM_MAX_CLIENTS; ++i)
+    {
+        if(s->clients[i].state != MJPEG_STREAM_CLIENT_FREE)
+            ++num;
+    }
+    return num;
+}
+
+// send the rest of buf from c->offset, returns 1 when done, 0 if blocked, <0 on error
+static int mjpeg_stream_send_piece(mjpeg_stream_t* s, mjpeg_stream_client_t* c, const uint8_t* buf, uint32_t len, uint32_t* budget)
+{
+    while(c->offset < len)
+    {
+        if(*budget == 0)
+            return 0;
+        uint32_t n = len - c->offset;
+        if(n > *budget)
+            n = *budget;
+        int ret = s->send(c->sock, buf + c->offset, n);
+        if(ret < 0)
+            return ret;
+        if(ret == 0)
+            return 0;
+        c->offset += ret;
+        *budget -= ret;
+    }
+    c->offset = 0;
+    return 1;
+}
+
+static int mjpeg_stream_client_poll(mjpeg_stream_t* s, mjpeg_stream_client_t* c)
+{
+    uint32_t budget = MJPEG_STREAM_SEND_BUDGET;
+    int ret = 1;
+    while(ret > 0)
+    {
+        switch(c->state)
+        {
+        case MJPEG_STREAM_CLIENT_HEADER:
+            ret = mjpeg_stream_send_piece(s, c, (const uint8_t*)mjpeg_stream_http_header,
+                                          sizeof(mjpeg_stream_http_header) - 1, &budget);
+            if(ret > 0)
+                c->state = MJPEG_STREAM_CLIENT_IDLE;
+            break;
+        case MJPEG_STREAM_CLIENT_IDLE:
+        {
+            if(s->newest < 0 || s->slots[s->newest].seq == c->last_seq)
+                return 0;
+            // always jump to the newest frame, whatever came in between is stale for this client
+            mjpeg_stream_slot_t* slot = &s->slots[s->newest];
+            if(c->frames)
+                c->dropped += slot->seq - c->last_seq - 1;
+            c->slot = s->newest;
+            c->last_seq = slot->seq;
+            ++slot->refs;
+            c->head_len = snprintf(c->head, sizeof(c->head),
+                                   "--" MJPEG_STREAM_BOUNDARY "\r\n"
+                                   "Content-Type: image/jpeg\r\n"
+                                   "Content-Length: %u\r\n"
+                                   "\r\n", (unsigned int)slot->size);
+            c->state = MJPEG_STREAM_CLIENT_PART;
+            break;
+        }
+        case MJPEG_STREAM_CLIENT_PART:
+            ret = mjpeg_stream_send_piece(s, c, (const uint8_t*)c->head, c->head_len, &budget);
+            if(ret > 0)
+                c->state = MJPEG_STREAM_CLIENT_JPEG;
+            break;
+        case MJPEG_STREAM_CLIENT_JPEG:
+            ret = mjpeg_stream_send_piece(s, c, s->slots[c->slot].data, s->slots[c->slot].size, &budget);
+            if(ret > 0)
+            {
+                --s->slots[c->slot].refs;
+                c->slot = -1;
+                c->state = MJPEG_STREAM_CLIENT_TRAILER;
+            }
+            break;
+        case MJPEG_STREAM_CLIENT_TRAILER:
+            ret = mjpeg_stream_send_piece(s, c, (const uint8_t*)"\r\n", 2, &budget);
+            if(ret > 0)
+            {
+                ++c->frames;
+                c->state = MJPEG_STREAM_CLIENT_IDLE;
+            }
+            break;
+        default:
+            return 0;
+        }
+    }
+    return ret;
+}
+
+int mjpeg_stream_poll(mjpeg_stream_t* s)
+{
+    for(int i=0; i<MJPEG_STREAM_MAX_CLIENTS; ++i)
+    {
+        mjpeg_stream_client_t* c = &s->clients[i];
+        if(c->state == MJPEG_STREAM_CLIENT_FREE)
+            continue;
+        if(mjpeg_stream_client_poll(s, c) < 0)
+            mjpeg_stream_remove_client(s, i);
+    }
+    return mjpeg_stream_client_num(s);
+}
@@ -0,0 +1,226 @@
+
+
+#include <mp.h>
+#include "py/stream.h"
+#include "py/mperrno.h"
+#include "mjpeg_stream.h"
+#include "fb_alloc.h"
+#include "imlib.h"
+#include "py_image.h"
+#include "py_helper.h"
+#include "py_assert.h"
+
+
+typedef struct {
+    mp_obj_base_t  base;
+    mjpeg_stream_t obj;
+    int            quality;
+} py_mjpeg_stream_obj_t;
+
+const mp_obj_type_t py_mjpeg_stream_server_type;
+
+static int py_mjpeg_stream_send(void* sock, const uint8_t* buf, uint32_t len)
+{
+    int err = 0;
+    mp_obj_t sock_obj = (mp_obj_t)sock;
+    mp_uint_t ret = mp_get_stream(sock_obj)->write(sock_obj, buf, len, &err);
+    if(ret == MP_STREAM_ERROR)
+        return (err == MP_EAGAIN || err == MP_ETIMEDOUT) ? 0 : -1;
+    return ret;
+}
+
+static void py_mjpeg_stream_close(void* sock)
+{
+    int err = 0;
+    mp_obj_t sock_obj = (mp_obj_t)sock;
+    mp_get_stream(sock_obj)->ioctl(sock_obj, MP_STREAM_CLOSE, 0, &err);
+}
+
+static void py_mjpeg_stream_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mjpeg_stream_t* s = &self->obj;
+    mp_printf(print, "[CanMV] mjpeg_stream: buffers:%d, buffer_size:%d, quality:%d, clients:%d, frames:%d, dropped:%d",
+                s->slot_num, s->slot_size, self->quality, mjpeg_stream_client_num(s), s->frames, s->dropped);
+}
+
+STATIC mp_obj_t py_mjpeg_stream_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args)
+{
+    enum { ARG_buffers, ARG_buffer_size, ARG_quality };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buffers, MP_ARG_INT, {.u_int = 3} },
+        { MP_QSTR_buffer_size, MP_ARG_INT, {.u_int = 64*1024} },
+        { MP_QSTR_quality, MP_ARG_INT, {.u_int = 70} },
+    };
+    mp_arg_val_t vals[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args), allowed_args, vals);
+    PY_ASSERT_TRUE_MSG((1 <= vals[ARG_quality].u_int) && (vals[ARG_quality].u_int <= 100), "Error: 1 <= quality <= 100!");
+    PY_ASSERT_TRUE_MSG(vals[ARG_buffer_size].u_int > 0, "buffer_size error");
+
+    py_mjpeg_stream_obj_t* self = m_new_obj_with_finaliser(py_mjpeg_stream_obj_t);
+    self->base.type = &py_mjpeg_stream_server_type;
+    self->quality = vals[ARG_quality].u_int;
+    int err = mjpeg_stream_init(&self->obj, vals[ARG_buffers].u_int, vals[ARG_buffer_size].u_int,
+                                py_mjpeg_stream_send, py_mjpeg_stream_close);
+    if(err != 0)
+        mp_raise_OSError(err);
+    return MP_OBJ_FROM_PTR(self);
+}
+
+// hand over an accepted socket, it is switched to non-blocking and closed when the client drops
+STATIC mp_obj_t py_mjpeg_stream_add_client(mp_obj_t self_in, mp_obj_t sock)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mp_get_stream_raise(sock, MP_STREAM_OP_WRITE | MP_STREAM_OP_IOCTL);
+    mp_obj_t dest[3];
+    mp_load_method(sock, MP_QSTR_setblocking, dest);
+    dest[2] = mp_const_false;
+    mp_call_method_n_kw(1, 0, dest);
+    int index = mjpeg_stream_add_client(&self->obj, (void*)sock);
+    if(index < 0)
+        mp_raise_OSError(MP_ENOMEM);
+    mjpeg_stream_poll(&self->obj);
+    return mp_obj_new_int(index);
+}
+
+// encode img into the ring and send what the clients can take, never waits for a client
+STATIC mp_obj_t py_mjpeg_stream_push(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)args[0];
+    image_t *arg_img = py_image_cobj(args[1]);
+    int arg_q = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quality), self->quality);
+    PY_ASSERT_TRUE_MSG((1 <= arg_q) && (arg_q <= 100), "Error: 1 <= quality <= 100!");
+    bool queued = false;
+
+    // nobody watching, skip the encoding
+    if(mjpeg_stream_client_num(&self->obj) == 0)
+        return mp_const_false;
+
+    uint32_t capacity = 0;
+    uint8_t* slot = mjpeg_stream_acquire(&self->obj, &capacity);
+    if(slot)
+    {
+        uint32_t len = 0;
+        if(IM_IS_JPEG(arg_img))
+        {
+            len = arg_img->bpp;
+            if(len <= capacity)
+                memcpy(slot, arg_img->pixels, len);
+        }
+        else
+        {
+            // the encoder needs a large scratch buffer, only the result goes into the ring
+            uint64_t size;
+            fb_alloc_mark();
+            uint8_t *buffer = fb_alloc_all(&size);
+            image_t out = { .w=arg_img->w, .h=arg_img->h, .bpp=size, .data=buffer };
+            if(!jpeg_compress(arg_img, &out, arg_q, false) && out.bpp <= capacity)
+            {
+                len = out.bpp;
+                memcpy(slot, buffer, len);
+            }
+            fb_free();
+            fb_alloc_free_till_mark();
+        }
+        queued = (len > 0 && len <= capacity);
+        mjpeg_stream_commit(&self->obj, queued ? len : 0);
+    }
+    mjpeg_stream_poll(&self->obj);
+    return mp_obj_new_bool(queued);
+}
+
+STATIC mp_obj_t py_mjpeg_stream_poll(mp_obj_t self_in)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    return mp_obj_new_int(mjpeg_stream_poll(&self->obj));
+}
+
+STATIC mp_obj_t py_mjpeg_stream_clients(mp_obj_t self_in)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    return mp_obj_new_int(mjpeg_stream_client_num(&self->obj));
+}
+
+// (frames, dropped, [(client, frames, dropped), ...])
+STATIC mp_obj_t py_mjpeg_stream_stats(mp_obj_t self_in)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mjpeg_stream_t* s = &self->obj;
+    mp_obj_t clients = mp_obj_new_list(0, NULL);
+    for(int i=0; i<MJPEG_STREAM_MAX_CLIENTS; ++i)
+    {
+        mjpeg_stream_client_t* c = &s->clients[i];
+        if(c->state == MJPEG_STREAM_CLIENT_FREE)
+            continue;
+        mp_obj_list_append(clients, mp_obj_new_tuple(3, (mp_obj_t[]){mp_obj_new_int(i),
+                                                                     mp_obj_new_int_from_uint(c->frames),
+                                                                     mp_obj_new_int_from_uint(c->dropped)}));
+    }
+    return mp_obj_new_tuple(3, (mp_obj_t[]){mp_obj_new_int_from_uint(s->frames),
+                                            mp_obj_new_int_from_uint(s->dropped),
+                                            clients});
+}
+
+STATIC mp_obj_t py_mjpeg_stream_remove_client(mp_obj_t self_in, mp_obj_t index)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mjpeg_stream_remove_client(&self->obj, mp_obj_get_int(index));
+    return mp_const_none;
+}
+
+STATIC mp_obj_t py_mjpeg_stream_deinit(mp_obj_t self_in)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mjpeg_stream_deinit(&self->obj);
+    return mp_const_none;
+}
+
+// the sockets are collected in the same sweep, only deinit() may close them
+STATIC mp_obj_t py_mjpeg_stream_del(mp_obj_t self_in)
+{
+    py_mjpeg_stream_obj_t *self = (py_mjpeg_stream_obj_t*)self_in;
+    mjpeg_stream_release(&self->obj);
+    return mp_const_none;
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_mjpeg_stream_add_client_obj, py_mjpeg_stream_add_client);
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(py_mjpeg_stream_remove_client_obj, py_mjpeg_stream_remove_client);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_mjpeg_stream_push_obj, 2, py_mjpeg_stream_push);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_stream_poll_obj, py_mjpeg_stream_poll);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_stream_clients_obj, py_mjpeg_stream_clients);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_stream_stats_obj, py_mjpeg_stream_stats);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_stream_deinit_obj, py_mjpeg_stream_deinit);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_mjpeg_stream_del_obj, py_mjpeg_stream_del);
+
+static const mp_rom_map_elem_t py_mjpeg_stream_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___del__),       MP_ROM_PTR(&py_mjpeg_stream_del_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit),        MP_ROM_PTR(&py_mjpeg_stream_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_add_client),    MP_ROM_PTR(&py_mjpeg_stream_add_client_obj) },
+    { MP_ROM_QSTR(MP_QSTR_remove_client), MP_ROM_PTR(&py_mjpeg_stream_remove_client_obj) },
+    { MP_ROM_QSTR(MP_QSTR_push),          MP_ROM_PTR(&py_mjpeg_stream_push_obj) },
+    { MP_ROM_QSTR(MP_QSTR_poll),          MP_ROM_PTR(&py_mjpeg_stream_poll_obj) },
+    { MP_ROM_QSTR(MP_QSTR_clients),       MP_ROM_PTR(&py_mjpeg_stream_clients_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats),         MP_ROM_PTR(&py_mjpeg_stream_stats_obj) },
+};
+
+MP_DEFINE_CONST_DICT(py_mjpeg_stream_locals_dict, py_mjpeg_stream_locals_dict_table);
+
+const mp_obj_type_t py_mjpeg_stream_server_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Server,
+    .print = py_mjpeg_stream_print,
+    .make_new = py_mjpeg_stream_make_new,
+    .locals_dict = (mp_obj_dict_t*)&py_mjpeg_stream_locals_dict,
+};
+
+static const mp_rom_map_elem_t mjpeg_stream_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_mjpeg_stream) },
+    { MP_ROM_QSTR(MP_QSTR_Server),   MP_ROM_PTR(&py_mjpeg_stream_server_type) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mjpeg_stream_module_globals, mjpeg_stream_module_globals_table);
+
+const mp_obj_module_t mjpeg_stream_module = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mjpeg_stream_module_globals,
+};
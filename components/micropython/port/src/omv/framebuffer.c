@@ -9,6 +9,7 @@
 #include "imlib.h"
 #include "omv_boardconfig.h"
 #include "framebuffer.h"
+#include "sensor.h"
 
 mutex_t lock_tmp;
 static framebuffer_t _fb_framebuffer0={0,0,0,0,0,0,0,0,0,NULL,NULL,NULL,NULL};
@@ -101,6 +102,7 @@ void fb_update_jpeg_buffer()
 #else
                 src.pixels=MAIN_FB()->pixels;
 #endif
+                sensor_pixels_canonical(&src);
             }
             image_t dst = {.w=MAIN_FB()->w, .h=MAIN_FB()->h, .bpp=(OMV_JPEG_BUF_SIZE-64),  .pixels=JPEG_FB()->pixels};
 
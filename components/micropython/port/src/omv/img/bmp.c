@@ -194,6 +194,7 @@ void bmp_read(image_t *img, const char *path)
     {
         mp_raise_OSError(err);
     }
+    file_buffer_on(file);
     bmp_read_geometry(file, img, &rs);
     if (!img->pixels)
         img->pixels = xalloc(img->w * img->h * img->bpp);
@@ -201,6 +202,7 @@ void bmp_read(image_t *img, const char *path)
     {
         if( (img->w * img->h * img->bpp) > MAIN_FB()->w_max * MAIN_FB()->h_max * OMV_INIT_BPP )
         {
+            file_close(file);
             mp_raise_OSError(MP_EINVAL);    
         }
     }
@@ -214,9 +216,10 @@ void bmp_read(image_t *img, const char *path)
         {
             xfree(img->pixels);
         }
-        vfs_internal_close(file, &err);
+        file_close(file);
         mp_raise_OSError(MP_EIO);
     }
+    file_buffer_off(file);
     vfs_internal_close(file, &err);
 }
 
@@ -229,6 +232,7 @@ void bmp_write_subimg(image_t *img, const char *path, rectangle_t *r)
     mp_obj_t file = vfs_internal_open(path, "wb", &err);
     if(file == MP_OBJ_NULL || err != 0)
         mp_raise_OSError(err);
+    file_buffer_on(file);
 
     if (IM_IS_GS(img)) {
         const int row_bytes = (((rect.w * 8) + 31) / 32) * 4;
@@ -305,5 +309,6 @@ void bmp_write_subimg(image_t *img, const char *path, rectangle_t *r)
             }
         }
     }
+    file_buffer_off(file);
     vfs_internal_close(file, &err);
 }
@@ -170,13 +170,13 @@ int imlib_load_cascade_from_file(cascade_t *cascade, const char *path)
     FRESULT res=FR_OK;
 
     file_read_open_raise(&fp, path);
-    file_buffer_on(&fp);
+    file_buffer_on(fp);
 
     /* read detection window size */
-    read_data(&fp, &cascade->window, sizeof(cascade->window));
+    read_data(fp, &cascade->window, sizeof(cascade->window));
 
     /* read num stages */
-    read_data(&fp, &cascade->n_stages, sizeof(cascade->n_stages));
+    read_data(fp, &cascade->n_stages, sizeof(cascade->n_stages));
 
     cascade->stages_array = xalloc (sizeof(*cascade->stages_array) * cascade->n_stages);
     cascade->stages_thresh_array = xalloc (sizeof(*cascade->stages_thresh_array) * cascade->n_stages);
@@ -187,7 +187,7 @@ int imlib_load_cascade_from_file(cascade_t *cascade, const char *path)
     }
 
     /* read num features in each stages */
-    read_data(&fp, cascade->stages_array, sizeof(uint8_t) * cascade->n_stages);
+    read_data(fp, cascade->stages_array, sizeof(uint8_t) * cascade->n_stages);
 
     /* sum num of features in each stages*/
     for (i=0, cascade->n_features=0; i<cascade->n_stages; i++) {
@@ -209,19 +209,19 @@ int imlib_load_cascade_from_file(cascade_t *cascade, const char *path)
     }
 
     /* read stages thresholds */
-    read_data(&fp, cascade->stages_thresh_array, sizeof(int16_t)*cascade->n_stages);
+    read_data(fp, cascade->stages_thresh_array, sizeof(int16_t)*cascade->n_stages);
 
     /* read features thresholds */
-    read_data(&fp, cascade->tree_thresh_array, sizeof(*cascade->tree_thresh_array)*cascade->n_features);
+    read_data(fp, cascade->tree_thresh_array, sizeof(*cascade->tree_thresh_array)*cascade->n_features);
 
     /* read alpha 1 */
-    read_data(&fp, cascade->alpha1_array, sizeof(*cascade->alpha1_array)*cascade->n_features);
+    read_data(fp, cascade->alpha1_array, sizeof(*cascade->alpha1_array)*cascade->n_features);
 
     /* read alpha 2 */
-    read_data(&fp, cascade->alpha2_array, sizeof(*cascade->alpha2_array)*cascade->n_features);
+    read_data(fp, cascade->alpha2_array, sizeof(*cascade->alpha2_array)*cascade->n_features);
 
     /* read num rectangles per feature*/
-    read_data(&fp, cascade->num_rectangles_array, sizeof(*cascade->num_rectangles_array)*cascade->n_features);
+    read_data(fp, cascade->num_rectangles_array, sizeof(*cascade->num_rectangles_array)*cascade->n_features);
 
     /* sum num of recatngles per feature*/
     for (i=0, cascade->n_rectangles=0; i<cascade->n_features; i++) {
@@ -238,14 +238,14 @@ int imlib_load_cascade_from_file(cascade_t *cascade, const char *path)
     }
 
     /* read rectangles weights */
-    read_data(&fp, cascade->weights_array, sizeof(*cascade->weights_array)*cascade->n_rectangles);
+    read_data(fp, cascade->weights_array, sizeof(*cascade->weights_array)*cascade->n_rectangles);
 
     /* read rectangles num rectangles * 4 points */
-    read_data(&fp, cascade->rectangles_array, sizeof(*cascade->rectangles_array)*cascade->n_rectangles *4);
+    read_data(fp, cascade->rectangles_array, sizeof(*cascade->rectangles_array)*cascade->n_rectangles *4);
 
 error:
-    file_buffer_off(&fp);
-    file_close(&fp);
+    file_buffer_off(fp);
+    file_close(fp);
     return res;
 }
 
@@ -440,12 +440,12 @@ static save_image_format_t imblib_parse_extension(image_t *img, const char *path
     return FORMAT_DONT_CARE;
 }
 
-bool imlib_read_geometry(mp_obj_t fp, image_t *img, const char *path, img_read_settings_t *rs)
+bool imlib_read_geometry(mp_obj_t *fp, image_t *img, const char *path, img_read_settings_t *rs)
 {
     file_read_open_raise(fp, path);
     char magic[2];
-    read_data(fp, &magic, 2);
-    file_close(fp);
+    read_data(*fp, &magic, 2);
+    file_close(*fp);
 
     bool vflipped = false;
     if ((magic[0]=='P')
@@ -453,13 +453,13 @@ bool imlib_read_geometry(mp_obj_t fp, image_t *img, const char *path, img_read_s
     ||  (magic[1]=='5') || (magic[1]=='6'))) { // PPM
         rs->format = FORMAT_PNM;
         file_read_open_raise(fp, path);
-        file_buffer_on(fp); // REMEMBER TO TURN THIS OFF LATER!
-        ppm_read_geometry(fp, img, path, &rs->ppm_rs);
+        file_buffer_on(*fp); // REMEMBER TO TURN THIS OFF LATER!
+        ppm_read_geometry(*fp, img, path, &rs->ppm_rs);
     } else if ((magic[0]=='B') && (magic[1]=='M')) { // BMP
         rs->format = FORMAT_BMP;
         file_read_open_raise(fp, path);
-        file_buffer_on(fp); // REMEMBER TO TURN THIS OFF LATER!
-        vflipped = bmp_read_geometry(fp, img, &rs->bmp_rs);
+        file_buffer_on(*fp); // REMEMBER TO TURN THIS OFF LATER!
+        vflipped = bmp_read_geometry(*fp, img, &rs->bmp_rs);
     } else {
         fs_unsupported_format(NULL);
     }
@@ -467,7 +467,7 @@ bool imlib_read_geometry(mp_obj_t fp, image_t *img, const char *path, img_read_s
     return vflipped;
 }
 
-static void imlib_read_pixels(FIL *fp, image_t *img, int line_start, int line_end, img_read_settings_t *rs)
+static void imlib_read_pixels(mp_obj_t fp, image_t *img, int line_start, int line_end, img_read_settings_t *rs)
 {
     switch (rs->format) {
         case FORMAT_BMP:
@@ -490,12 +490,12 @@ void imlib_image_operation(image_t *img, const char *path, image_t *other, int s
         // the line operation on each line in that window before moving to the
         // next window. The vflipped part is here because BMP files can be saved
         // vertically flipped resulting in us reading the image backwards.
-        FIL fp;
+        mp_obj_t fp;
         image_t temp;
         img_read_settings_t rs;
         bool vflipped = imlib_read_geometry(&fp, &temp, path, &rs);
         if (!IM_EQUAL(img, &temp)) {
-            fs_not_equal(&fp);
+            fs_not_equal(fp);
         }
         // When processing vertically flipped images the read function will fill
         // the window up from the bottom. The read function assumes that the
@@ -510,7 +510,7 @@ void imlib_image_operation(image_t *img, const char *path, image_t *other, int s
         }
         for (int i=0; i<img->h; i+=temp.h) { // goes past end
             int can_do = IM_MIN(temp.h, img->h-i);
-            imlib_read_pixels(&fp, &temp, 0, can_do, &rs);
+            imlib_read_pixels(fp, &temp, 0, can_do, &rs);
             for (int j=0; j<can_do; j++) {
                 if (!vflipped) {
                     op(img, i+j, temp.pixels+(temp.w*temp.bpp*j), data, false);
@@ -519,8 +519,8 @@ void imlib_image_operation(image_t *img, const char *path, image_t *other, int s
                 }
             }
         }
-        file_buffer_off(&fp);
-        file_close(&fp);
+        file_buffer_off(fp);
+        file_close(fp);
         fb_free();
     } else if (other) {
         if (!IM_EQUAL(img, other)) {
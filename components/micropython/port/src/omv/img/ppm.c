@@ -113,12 +113,12 @@ void ppm_read(image_t *img, const char *path)
     mp_obj_t fp;
     ppm_read_settings_t rs;
     file_read_open_raise(&fp, path);
-    file_buffer_on(&fp);
-    ppm_read_geometry(&fp, img, path, &rs);
+    file_buffer_on(fp);
+    ppm_read_geometry(fp, img, path, &rs);
     if (!img->pixels) img->pixels = xalloc(img->w * img->h * img->bpp);
-    ppm_read_pixels(&fp, img, 0, img->h, &rs);
-    file_buffer_off(&fp);
-    file_close(&fp);
+    ppm_read_pixels(fp, img, 0, img->h, &rs);
+    file_buffer_off(fp);
+    file_close(fp);
 }
 
 void ppm_write_subimg(image_t *img, const char *path, rectangle_t *r)
@@ -128,24 +128,24 @@ void ppm_write_subimg(image_t *img, const char *path, rectangle_t *r)
     mp_obj_t fp;
     file_write_open_raise(&fp, path);
 
-    file_buffer_on(&fp);
+    file_buffer_on(fp);
     if (IM_IS_GS(img)) {
         char buffer[20]; // exactly big enough for 5-digit w/h
         int len = snprintf(buffer, 20, "P5\n%d %d\n255\n", rect.w, rect.h);
-        write_data(&fp, buffer, len);
+        write_data(fp, buffer, len);
         if ((rect.x == 0) && (rect.w == img->w)) {
-            write_data(&fp, // Super Fast - Zoom, Zoom!
+            write_data(fp, // Super Fast - Zoom, Zoom!
                        img->pixels + (rect.y * img->w),
                        rect.w * rect.h);
         } else {
             for (int i = 0; i < rect.h; i++) {
-                write_data(&fp, img->pixels+((rect.y+i)*img->w)+rect.x, rect.w);
+                write_data(fp, img->pixels+((rect.y+i)*img->w)+rect.x, rect.w);
             }
         }
     } else {
         char buffer[20]; // exactly big enough for 5-digit w/h
         int len = snprintf(buffer, 20, "P6\n%d %d\n255\n", rect.w, rect.h);
-        write_data(&fp, buffer, len);
+        write_data(fp, buffer, len);
         for (int i = 0; i < rect.h; i++) {
             for (int j = 0; j < rect.w; j++) {
                 int pixel = IM_GET_RGB565_PIXEL(img, (rect.x + j), (rect.y + i));
@@ -153,11 +153,11 @@ void ppm_write_subimg(image_t *img, const char *path, rectangle_t *r)
                 buff[0] = IM_R528(IM_R565(pixel));
                 buff[1] = IM_G628(IM_G565(pixel));
                 buff[2] = IM_B528(IM_B565(pixel));
-                write_data(&fp, buff, 3);
+                write_data(fp, buff, 3);
             }
         }
     }
-    file_buffer_off(&fp);
+    file_buffer_off(fp);
 
-    file_close(&fp);
+    file_close(fp);
 }
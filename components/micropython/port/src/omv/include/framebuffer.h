@@ -12,7 +12,11 @@
 #include "mutex.h"
 #include "imlib_config.h"
 #include "global_config.h"
+#if defined(CONFIG_MAIXPY_OMV_SENSOR_BUFF_NUM) && CONFIG_MAIXPY_OMV_SENSOR_BUFF_NUM > 2
+#define SENSOR_BUFFER_NUM CONFIG_MAIXPY_OMV_SENSOR_BUFF_NUM
+#else
 #define SENSOR_BUFFER_NUM 2
+#endif
 
 typedef struct framebuffer {
     int x,y;
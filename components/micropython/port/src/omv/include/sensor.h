@@ -114,6 +114,14 @@ typedef enum {
 typedef bool (*streaming_cb_t)(image_t *image);
 
 
+// Capture info of the frame last returned by snapshot.
+typedef struct {
+    uint32_t seq;               // Sensor frame number since reset, gaps are dropped frames.
+    uint64_t timestamp_us;      // mp_hal_ticks_us() when the DVP finished writing it.
+    uint64_t age_us;            // How long ago that was.
+    uint32_t dropped;           // Frames sent by the sensor but never converted since reset.
+} sensor_frame_info_t;
+
 typedef struct _sensor sensor_t;
 typedef struct _sensor {
     uint16_t chip_id;           // Sensor ID.
@@ -124,6 +132,7 @@ typedef struct _sensor {
     bool     reset_set;         // reset called
     bool     size_set;          // set_framesie called
     bool     double_buff;
+    uint8_t  buff_num;          // Frame ring depth, 1 when double_buff is off.
 
     uint32_t vsync_pin;         // VSYNC GPIO output pin.
     polarity_t pwdn_pol; // PWDN polarity (TODO move to hw_flags)
@@ -137,6 +146,7 @@ typedef struct _sensor {
     gainceiling_t gainceiling;  // AGC gainceiling
     bool hmirror;
     bool vflip;
+    bool native_order;          // Keep RGB565 frames in DVP u32 order, swap lazily.
 
     // Sensor function pointers
     int  (*reset)               (sensor_t *sensor);
@@ -180,7 +190,8 @@ int binocular_sensor_reset(mp_int_t freq);
 void sensor_init0();
 
 // Reset the sensor to its default state.
-int sensor_reset(mp_int_t freq, bool default_freq, bool set_regs, bool double_buff, uint8_t choice);
+// buff_num > 1 captures into a ring of that many frames (CONFIG_MAIXPY_OMV_DOUBLE_BUFF only).
+int sensor_reset(mp_int_t freq, bool default_freq, bool set_regs, uint8_t buff_num, uint8_t choice);
 
 // destroy resources created by sensor
 void sensor_deinit();
@@ -271,5 +282,22 @@ int sensor_run(int enable);
 
 bool is_img_data_in_main_fb(uint8_t* data);
 
+// Read pixel i of a native DVP order RGB565 buffer as canonical RGB565,
+// pixel pairs are swapped in each u32 and bytes swapped in each pixel.
+#define SENSOR_NATIVE_RGB565_PIXEL(pixels, i) \
+    __builtin_bswap16(((uint16_t *)(pixels))[(i) ^ 1])
+
+// Enable/disable native DVP pixel order, snapshot skips the per-frame byte swap.
+int sensor_set_native_order(int enable);
+
+// Returns true if pixels is a frame buffer still in native DVP (u32 LE) order.
+bool sensor_pixels_native(uint8_t* pixels);
+
+// Swap a native order frame buffer to canonical RGB565 in place, no-op otherwise.
+void sensor_pixels_canonical(image_t *image);
+
+// Get sequence number, capture time and age of the last snapshot frame, plus the drop count.
+int sensor_get_frame_info(sensor_frame_info_t *info);
+
 #endif /* __SENSOR_H__ */
 
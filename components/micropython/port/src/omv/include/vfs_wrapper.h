@@ -16,6 +16,8 @@ bool file_eof(mp_obj_t fp);
 int file_seek_raise(mp_obj_t fp, mp_int_t offset, uint8_t whence);
 mp_uint_t file_save_data(const char* path, uint8_t* data, mp_uint_t length, int* error_code);
 mp_uint_t file_size(mp_obj_t fp);
+void file_buffer_init0();
+void file_buffer_deinit();
 void file_buffer_on(mp_obj_t fp);
 void file_buffer_off(mp_obj_t fp);
 
@@ -2,6 +2,7 @@
 #include "omv.h"
 #include "ide_dbg.h"
 #include "sensor.h"
+#include "vfs_wrapper.h"
 
 bool omv_init_once()
 {
@@ -12,6 +13,7 @@ bool omv_init()
 {
     bool ret = true;
     fb_alloc_init0();
+    file_buffer_init0();
     sensor_init0();
     ret = ide_debug_init0();
     return ret;
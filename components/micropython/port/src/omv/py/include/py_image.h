@@ -13,6 +13,8 @@
 mp_obj_t py_image(int width, int height, int bpp, void *pixels);
 mp_obj_t py_image_from_struct(image_t *img);
 void *py_image_cobj(mp_obj_t img_obj);
+// Like py_image_cobj, but pixels may still be in native DVP order (see sensor_pixels_native).
+void *py_image_cobj_raw(mp_obj_t img_obj);
 int py_image_descriptor_from_roi(image_t *img, const char *path, rectangle_t *roi);
 bool py_image_obj_is_image(mp_obj_t obj);
 #endif // __PY_IMAGE_H__
@@ -35,7 +35,7 @@ static mp_obj_t py_gif_open(size_t n_args, const mp_obj_t *args, mp_map_t *kw_ar
     gif->base.type = &py_gif_type;
 
     file_write_open(&gif->fp, mp_obj_str_get_str(args[0]));
-    gif_open(&gif->fp, gif->width, gif->height, gif->color, gif->loop);
+    gif_open(gif->fp, gif->width, gif->height, gif->color, gif->loop);
     return gif;
 }
 
@@ -60,7 +60,7 @@ static mp_obj_t py_gif_format(mp_obj_t gif_obj)
 static mp_obj_t py_gif_size(mp_obj_t gif_obj)
 {
     py_gif_obj_t *arg_gif = gif_obj;
-    return mp_obj_new_int(file_size(&arg_gif->fp));
+    return mp_obj_new_int(file_size(arg_gif->fp));
 }
 
 static mp_obj_t py_gif_loop(mp_obj_t gif_obj)
@@ -80,14 +80,14 @@ static mp_obj_t py_gif_add_frame(size_t n_args, const mp_obj_t *args, mp_map_t *
 
     int delay = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_delay), 10);
 
-    gif_add_frame(&arg_gif->fp, arg_img, delay);
+    gif_add_frame(arg_gif->fp, arg_img, delay);
     return mp_const_none;
 }
 
 static mp_obj_t py_gif_close(mp_obj_t gif_obj)
 {
     py_gif_obj_t *arg_gif = gif_obj;
-    gif_close(&arg_gif->fp);
+    gif_close(arg_gif->fp);
     return mp_const_none;
 }
 
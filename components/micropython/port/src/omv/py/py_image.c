@@ -252,6 +252,14 @@ typedef struct _py_image_obj_t {
 } py_image_obj_t MICROPY_OBJ_BASE_ALIGNMENT;
 
 void *py_image_cobj(mp_obj_t img_obj)
+{
+    PY_ASSERT_TYPE(img_obj, &py_image_type);
+    image_t *img = &((py_image_obj_t *)img_obj)->_cobj;
+    sensor_pixels_canonical(img);
+    return img;
+}
+
+void *py_image_cobj_raw(mp_obj_t img_obj)
 {
     PY_ASSERT_TYPE(img_obj, &py_image_type);
     return &((py_image_obj_t *)img_obj)->_cobj;
@@ -302,6 +310,7 @@ static void py_image_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
 static mp_obj_t py_image_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value)
 {
     py_image_obj_t *self = self_in;
+    sensor_pixels_canonical(&self->_cobj);
     if (value == MP_OBJ_NULL) { // delete
     } else if (value == MP_OBJ_SENTINEL) { // load
         switch (self->_cobj.bpp) {
@@ -500,6 +509,7 @@ static mp_obj_t py_image_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value
 static mp_int_t py_image_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags)
 {
     py_image_obj_t *self = self_in;
+    sensor_pixels_canonical(&self->_cobj);
     if (flags == MP_BUFFER_READ) {
         bufinfo->buf = self->_cobj.data;
         bufinfo->len = image_size(&self->_cobj);
@@ -5780,7 +5790,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(py_image_resize_obj, py_image_resize);
 
 static mp_obj_t py_image_pix_to_ai(mp_obj_t img_obj)
 {
-	image_t* img = (image_t *) py_image_cobj(img_obj);
+	image_t* img = (image_t *) py_image_cobj_raw(img_obj);
+	bool native = sensor_pixels_native(img->pixels);
 	uint16_t w = img->w;
 	uint16_t h = img->h;
 	switch (img->bpp)
@@ -5810,6 +5821,17 @@ static mp_obj_t py_image_pix_to_ai(mp_obj_t img_obj)
 		uint16_t* in = (uint16_t*)img->pixels;
 		uint32_t index;
 
+		if(native) // swizzle while converting, frame stays in DVP order
+		{
+			for(index=0; index < w*h; index++)
+			{
+				uint16_t pixel = SENSOR_NATIVE_RGB565_PIXEL(in, index);
+				r[index] = COLOR_RGB565_TO_R8(pixel);
+				g[index] = COLOR_RGB565_TO_G8(pixel);
+				b[index] = COLOR_RGB565_TO_B8(pixel);
+			}
+			return mp_const_none;
+		}
 		for(index=0; index < w*h; index++)
 		{
 			r[index] = COLOR_RGB565_TO_R8(in[index]);
@@ -15,6 +15,7 @@
 #include "py_assert.h"
 #include "py_helper.h"
 #include "py_image.h"
+#include "sensor.h"
 #include "lcd.h"
 #include "sleep.h"
 #include "fpioa.h"
@@ -382,9 +383,82 @@ static mp_obj_t py_lcd_get_backlight()
     return mp_const_none;
 }
 
+// fit scaled size *d of roi *r starting at screen offset o, crop the roi by the part that falls off
+static void py_lcd_fit_scaled(int o, int screen, int *d, int16_t *r, int16_t *rl)
+{
+    if (o + *d > screen)
+    {
+        int keep = (*rl) * (screen - o) / (*d);
+        if (keep < 1)
+            keep = 1;
+        *r += (*rl - keep) / 2;
+        *rl = keep;
+        *d = screen - o;
+    }
+}
+
+static mp_obj_t py_lcd_display_async(image_t *img, rectangle_t *rect, point_t *oft, mp_obj_t size_obj, bool block, uint32_t flags)
+{
+    static rectangle_t last_area = {0};
+    int dw = rect->w, dh = rect->h;
+    int x = oft->x, y = oft->y;
+    bool center = (oft->x < 0 || oft->y < 0);
+
+    if (size_obj)
+    {
+        mp_obj_t *size;
+        mp_obj_get_array_fixed_n(size_obj, 2, &size);
+        dw = mp_obj_get_int(size[0]);
+        dh = mp_obj_get_int(size[1]);
+        PY_ASSERT_TRUE_MSG(dw > 0 && dh > 0, "Invalid size");
+    }
+    if (center)
+    {
+        x = (dw < width_curr) ? (width_curr - dw) / 2 : 0;
+        y = (dh < height_curr) ? (height_curr - dh) / 2 : 0;
+    }
+    PY_ASSERT_TRUE_MSG(x < width_curr && y < height_curr, "Offset out of screen");
+    py_lcd_fit_scaled(x, width_curr, &dw, &rect->x, &rect->w);
+    py_lcd_fit_scaled(y, height_curr, &dh, &rect->y, &rect->h);
+    // the transfer moves whole u32 words, keep rows an even number of pixels
+    dw &= ~1;
+    PY_ASSERT_TRUE_MSG(dw > 0, "Invalid size");
+
+    if (IM_IS_GS(img))
+        flags |= LCD_PIC_GRAY;
+    else if (sensor_pixels_native(img->pixels))
+        flags |= LCD_PIC_NATIVE;
+
+    if (center && (!(flags & LCD_PIC_DIRTY) || last_area.x != x || last_area.y != y ||
+                   last_area.w != dw || last_area.h != dh))
+    {
+        // pads only need drawing once while a dirty picture stays in place
+        lcd->fill_rectangle(0, 0, width_curr, y, BLACK);
+        lcd->fill_rectangle(0, y + dh, width_curr, height_curr, BLACK);
+        lcd->fill_rectangle(0, y, x, y + dh, BLACK);
+        lcd->fill_rectangle(x + dw, y, width_curr, y + dh, BLACK);
+    }
+    last_area.x = x;
+    last_area.y = y;
+    last_area.w = dw;
+    last_area.h = dh;
+
+    int ret = lcd->draw_pic_async(x, y, dw, dh, img->w, img->h, rect->x, rect->y, rect->w, rect->h,
+                                  (uint8_t *)(img->pixels), flags);
+    if (ret != 0)
+    {
+        mp_raise_OSError(ret);
+    }
+    if (block && lcd->wait_idle && lcd->wait_idle() != 0)
+    {
+        mp_raise_OSError(MP_ETIMEDOUT);
+    }
+    return mp_const_none;
+}
+
 static mp_obj_t py_lcd_display(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
-    image_t *arg_img = py_image_cobj(args[0]);
+    image_t *arg_img = py_image_cobj_raw(args[0]);
     PY_ASSERT_TRUE_MSG(IM_IS_MUTABLE(arg_img), "Image format is not supported.");
 
     rectangle_t rect;
@@ -396,6 +470,19 @@ static mp_obj_t py_lcd_display(size_t n_args, const mp_obj_t *args, mp_map_t *kw
     py_helper_keyword_rectangle_roi(arg_img, n_args, args, 1, kw_args, &rect);
     py_helper_keyword_xy(arg_img, n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_oft), &oft);
 
+    // size=(w, h) scales the roi, block=False returns while DMA sends the frame,
+    // dirty=True sends only the row bands that changed since the last such call
+    mp_obj_t size_obj = py_helper_keyword_object(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_size));
+    bool block = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_block), true);
+    bool bilinear = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_bilinear), false);
+    bool dirty = py_helper_keyword_int(n_args, args, n_args, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_dirty), false);
+    if ((size_obj || !block || dirty) && type != DEV_NONE)
+    {
+        PY_ASSERT_TRUE_MSG(lcd->draw_pic_async != NULL, "size/block/dirty not supported on this lcd");
+        return py_lcd_display_async(arg_img, &rect, &oft, size_obj, block,
+                                    (bilinear ? LCD_PIC_BILINEAR : 0) | (dirty ? LCD_PIC_DIRTY : 0));
+    }
+
     // Fit X. bigger or smaller, cut or pad to center
     if (oft.x < 0 || oft.y < 0)
     {
@@ -432,6 +519,13 @@ static mp_obj_t py_lcd_display(size_t n_args, const mp_obj_t *args, mp_map_t *kw
     }
     is_cut = ((rect.x != 0) || (rect.y != 0) ||
               (rect.w != arg_img->w) || (rect.h != arg_img->h));
+    // full frames in native DVP order go out untouched, anything else needs canonical pixels
+    bool native = !is_cut && lcd->draw_picture_native && !((rect.w * rect.h) % 2) &&
+                  sensor_pixels_native(arg_img->pixels);
+    if (!native)
+    {
+        sensor_pixels_canonical(arg_img);
+    }
     switch (type)
     {
     case DEV_NONE:
@@ -470,6 +564,10 @@ static mp_obj_t py_lcd_display(size_t n_args, const mp_obj_t *args, mp_map_t *kw
             {
                 lcd->draw_pic_gray(l_pad, t_pad, rect.w, rect.h, (uint8_t *)(arg_img->pixels));
             }
+            else if (native)
+            {
+                lcd->draw_picture_native(l_pad, t_pad, rect.w, rect.h, (uint8_t *)(arg_img->pixels));
+            }
             else
             {
                 lcd->draw_picture(l_pad, t_pad, rect.w, rect.h, (uint8_t *)(arg_img->pixels));
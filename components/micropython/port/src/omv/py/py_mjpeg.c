@@ -35,7 +35,7 @@ static mp_obj_t py_mjpeg_open(size_t n_args, const mp_obj_t *args, mp_map_t *kw_
     mjpeg->base.type = &py_mjpeg_type;
 
     file_write_open(&mjpeg->fp, mp_obj_str_get_str(args[0]));
-    mjpeg_open(&mjpeg->fp, mjpeg->width, mjpeg->height);
+    mjpeg_open(mjpeg->fp, mjpeg->width, mjpeg->height);
     return mjpeg;
 }
 
@@ -67,14 +67,14 @@ static mp_obj_t py_mjpeg_add_frame(size_t n_args, const mp_obj_t *args, mp_map_t
 
     int arg_q = py_helper_keyword_int(n_args, args, 2, kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_quality), 50);
     arg_q = IM_MIN(IM_MAX(arg_q, 1), 100);
-    mjpeg_add_frame(&arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, arg_img, arg_q);
+    mjpeg_add_frame(arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, arg_img, arg_q);
     return mp_const_none;
 }
 
 static mp_obj_t py_mjpeg_close(mp_obj_t mjpeg_obj, mp_obj_t fps_obj)
 {
     py_mjpeg_obj_t *arg_mjpeg = mjpeg_obj;
-    mjpeg_close(&arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, mp_obj_get_float(fps_obj));
+    mjpeg_close(arg_mjpeg->fp, &arg_mjpeg->frames, &arg_mjpeg->bytes, mp_obj_get_float(fps_obj));
     return mp_const_none;
 }
 
@@ -39,7 +39,7 @@ static mp_obj_t py_sensor_reset(size_t n_args, const mp_obj_t *args, mp_map_t *k
     mp_int_t freq = OMV_XCLK_FREQUENCY;
     bool default_freq = true;
     bool set_regs = true;
-    bool dual_buff = false;
+    mp_int_t buff_num = 1;
     uint8_t choice = 0;
     if (kw_arg)
     {
@@ -57,11 +57,17 @@ static mp_obj_t py_sensor_reset(size_t n_args, const mp_obj_t *args, mp_map_t *k
         choice = mp_obj_get_int(kw_arg->value);
     }
     kw_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_dual_buff), MP_MAP_LOOKUP);
+    if (kw_arg && mp_obj_is_true(kw_arg->value))
+    {
+        buff_num = 2;
+    }
+    kw_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_buff_num), MP_MAP_LOOKUP);
     if (kw_arg)
     {
-        dual_buff = mp_obj_is_true(kw_arg->value);
+        buff_num = mp_obj_get_int(kw_arg->value);
+        PY_ASSERT_TRUE_MSG(buff_num >= 1 && buff_num <= SENSOR_BUFFER_NUM, "buff_num out of range");
     }
-    PY_ASSERT_FALSE_MSG(sensor_reset(freq, default_freq, set_regs, dual_buff, choice) != 0, "Reset Failed");
+    PY_ASSERT_FALSE_MSG(sensor_reset(freq, default_freq, set_regs, buff_num, choice) != 0, "Reset Failed");
     return mp_const_none;
 }
 
@@ -531,6 +537,22 @@ static mp_obj_t py_sensor_get_rgb_gain_db()
     return mp_obj_new_tuple(3, (mp_obj_t[]){mp_obj_new_float(r_gain_db), mp_obj_new_float(g_gain_db), mp_obj_new_float(b_gain_db)});
 }
 
+static mp_obj_t py_sensor_set_native_order(mp_obj_t enable)
+{
+    sensor_set_native_order(mp_obj_is_true(enable));
+    return mp_const_none;
+}
+
+static mp_obj_t py_sensor_get_frame_info()
+{
+    sensor_frame_info_t info;
+    sensor_get_frame_info(&info);
+    return mp_obj_new_tuple(4, (mp_obj_t[]){mp_obj_new_int_from_uint(info.seq),
+                                            mp_obj_new_int_from_ull(info.timestamp_us),
+                                            mp_obj_new_int_from_ull(info.age_us),
+                                            mp_obj_new_int_from_uint(info.dropped)});
+}
+
 static mp_obj_t py_sensor_set_hmirror(mp_obj_t enable)
 {
     if (sensor_set_hmirror(mp_obj_is_true(enable)) != 0)
@@ -632,6 +654,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_sensor_set_auto_exposure_obj, 1, py_sensor_
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_exposure_us_obj, py_sensor_get_exposure_us);
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_sensor_set_auto_whitebal_obj, 1, py_sensor_set_auto_whitebal);
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_rgb_gain_db_obj, py_sensor_get_rgb_gain_db);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_native_order_obj, py_sensor_set_native_order);
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(py_sensor_get_frame_info_obj, py_sensor_get_frame_info);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_hmirror_obj, py_sensor_set_hmirror);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_vflip_obj, py_sensor_set_vflip);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_sensor_set_special_effect_obj, py_sensor_set_special_effect);
@@ -724,6 +748,8 @@ STATIC const mp_map_elem_t globals_dict_table[] = {
     {MP_OBJ_NEW_QSTR(MP_QSTR_get_exposure_us),      (mp_obj_t)&py_sensor_get_exposure_us_obj},
     {MP_OBJ_NEW_QSTR(MP_QSTR_set_auto_whitebal),    (mp_obj_t)&py_sensor_set_auto_whitebal_obj},
     {MP_OBJ_NEW_QSTR(MP_QSTR_get_rgb_gain_db),      (mp_obj_t)&py_sensor_get_rgb_gain_db_obj},
+    {MP_OBJ_NEW_QSTR(MP_QSTR_set_native_order),     (mp_obj_t)&py_sensor_set_native_order_obj},
+    {MP_OBJ_NEW_QSTR(MP_QSTR_get_frame_info),       (mp_obj_t)&py_sensor_get_frame_info_obj},
     {MP_OBJ_NEW_QSTR(MP_QSTR_set_hmirror),          (mp_obj_t)&py_sensor_set_hmirror_obj},
     {MP_OBJ_NEW_QSTR(MP_QSTR_set_vflip),            (mp_obj_t)&py_sensor_set_vflip_obj},
     {MP_OBJ_NEW_QSTR(MP_QSTR_set_special_effect),   (mp_obj_t)&py_sensor_set_special_effect_obj},
@@ -30,6 +30,11 @@
 #include "ov5640.h"
 #include "ov5642.h"
 #include "Maix_config.h"
+#if MICROPY_PY_THREAD
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#endif
 
 extern volatile dvp_t *const dvp;
 
@@ -40,6 +45,7 @@ extern volatile dvp_t *const dvp;
 #define OV_CHIP_ID2_16BIT (0x300B)
 #define MAX_XFER_SIZE (0xFFFC * 4)
 #define systick_sleep mp_hal_delay_ms
+#define SENSOR_FRAME_TIMEOUT_MS (300)
 
 sensor_t sensor = {0};
 volatile static uint8_t g_dvp_finish_flag = 0;
@@ -47,7 +53,19 @@ volatile static uint8_t g_dvp_finish_flag = 0;
 volatile uint8_t g_sensor_buff_index_in = 0, g_sensor_buff_index_out = 0;
 static volatile bool buff_ready = false;
 #endif
+// capture bookkeeping kept by the DVP IRQ, one entry per ring slot
+static volatile bool g_dvp_converting = false;
+static volatile uint32_t g_sensor_frame_seq = 0;  // frames the sensor started sending since reset
+static volatile uint32_t g_sensor_frame_drop = 0; // of those, frames never converted into a slot
+static volatile uint32_t g_sensor_slot_seq[SENSOR_BUFFER_NUM];
+static volatile uint64_t g_sensor_slot_us[SENSOR_BUFFER_NUM];
+static sensor_frame_info_t g_sensor_last_frame; // the frame snapshot handed out last
+#if MICROPY_PY_THREAD
+static SemaphoreHandle_t g_sensor_frame_sem = NULL;
+#endif
 static bool g_set_pixformat_regs = true;
+// frame buffers handed out by snapshot in native DVP order, not swapped yet
+static uint8_t *volatile g_native_pixels[SENSOR_BUFFER_NUM] = {NULL};
 
 static volatile int line = 0;
 uint8_t _line_buf;
@@ -152,6 +170,28 @@ void sensor_load_config(struct sensor_config_t *sensor_cfg)
     }
 }
 
+static inline void sensor_irq_frame_start(uint8_t slot)
+{
+    g_sensor_slot_seq[slot] = g_sensor_frame_seq;
+    g_dvp_converting = true;
+    dvp_start_convert();
+}
+
+static inline void sensor_irq_frame_done(uint8_t slot)
+{
+    g_sensor_slot_us[slot] = mp_hal_ticks_us();
+    g_dvp_converting = false;
+#if MICROPY_PY_THREAD
+    if (g_sensor_frame_sem)
+    {
+        BaseType_t woken = pdFALSE;
+        xSemaphoreGiveFromISR(g_sensor_frame_sem, &woken);
+        if (woken == pdTRUE)
+            portYIELD();
+    }
+#endif
+}
+
 static int sensor_irq(void *ctx)
 {
 #if CONFIG_MAIXPY_OMV_DOUBLE_BUFF
@@ -161,75 +201,60 @@ static int sensor_irq(void *ctx)
         {
             //frame end
             dvp_clear_interrupt(DVP_STS_FRAME_START | DVP_STS_FRAME_FINISH);
-            if ((g_sensor_buff_index_in + 1) % SENSOR_BUFFER_NUM == g_sensor_buff_index_out)
+            if (g_dvp_converting)
             {
-                buff_ready = true;
-            }
-            else
-            {
-                g_sensor_buff_index_in = (g_sensor_buff_index_in + 1) % SENSOR_BUFFER_NUM;
-                buff_ready = false;
+                sensor_irq_frame_done(g_sensor_buff_index_in);
+                if ((g_sensor_buff_index_in + 1) % sensor.buff_num == g_sensor_buff_index_out)
+                {
+                    // ring full, keep this slot and stop converting until snapshot frees one
+                    buff_ready = true;
+                }
+                else
+                {
+                    g_sensor_buff_index_in = (g_sensor_buff_index_in + 1) % sensor.buff_num;
+                    buff_ready = false;
+                }
             }
-            // g_dvp_finish_flag = 1;
         }
         else
         {
             //frame start
-            if (g_sensor_buff_index_in == g_sensor_buff_index_out)
+            g_sensor_frame_seq++;
+            if (!buff_ready)
             {
-                if (!buff_ready)
-                {
-                    // g_dvp_finish_flag = 0;
-                    // printk("--%d\r\n",g_sensor_buff_index_in);
-                    dvp_set_ai_addr((uint32_t)MAIN_FB()->pix_ai[g_sensor_buff_index_in], (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h), (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h * 2));
-                    dvp_set_display_addr((uint32_t)MAIN_FB()->pixels[g_sensor_buff_index_in]);
-                    dvp_start_convert();
-                }
+                dvp_set_ai_addr((uint32_t)MAIN_FB()->pix_ai[g_sensor_buff_index_in], (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h), (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h * 2));
+                dvp_set_display_addr((uint32_t)MAIN_FB()->pixels[g_sensor_buff_index_in]);
+                sensor_irq_frame_start(g_sensor_buff_index_in);
             }
             else
             {
-                if (!buff_ready)
-                {
-                    // g_dvp_finish_flag = 0;
-                    // printk("==%d\r\n",g_sensor_buff_index_in);
-                    dvp_set_ai_addr((uint32_t)MAIN_FB()->pix_ai[g_sensor_buff_index_in], (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h), (uint32_t)(MAIN_FB()->pix_ai[g_sensor_buff_index_in] + MAIN_FB()->w * MAIN_FB()->h * 2));
-                    dvp_set_display_addr((uint32_t)MAIN_FB()->pixels[g_sensor_buff_index_in]);
-                    dvp_start_convert();
-                }
+                g_sensor_frame_drop++;
             }
             dvp_clear_interrupt(DVP_STS_FRAME_START);
         }
+        return 0;
     }
-    else
-    {
-        if (dvp_get_interrupt(DVP_STS_FRAME_FINISH))
-        {
-            //frame end
-            dvp_clear_interrupt(DVP_STS_FRAME_START | DVP_STS_FRAME_FINISH);
-            g_dvp_finish_flag = 1;
-        }
-        else
-        {                               //frame start
-            if (g_dvp_finish_flag == 0) //only we finish the convert, do transmit again
-                dvp_start_convert();    //so we need deal img ontime, or skip one framebefore next
-            dvp_clear_interrupt(DVP_STS_FRAME_START);
-        }
-    }
-#else
+#endif
     // sensor_t *sensor = ctx;
     if (dvp_get_interrupt(DVP_STS_FRAME_FINISH))
     {
         //frame end
         dvp_clear_interrupt(DVP_STS_FRAME_START | DVP_STS_FRAME_FINISH);
-        g_dvp_finish_flag = 1;
+        if (g_dvp_converting)
+        {
+            sensor_irq_frame_done(0);
+            g_dvp_finish_flag = 1;
+        }
     }
     else
     {                               //frame start
+        g_sensor_frame_seq++;
         if (g_dvp_finish_flag == 0) //only we finish the convert, do transmit again
-            dvp_start_convert();    //so we need deal img ontime, or skip one framebefore next
+            sensor_irq_frame_start(0); //so we need deal img ontime, or skip one framebefore next
+        else
+            g_sensor_frame_drop++;
         dvp_clear_interrupt(DVP_STS_FRAME_START);
     }
-#endif
     return 0;
 }
 
@@ -694,6 +719,10 @@ int sensor_init_irq()
     plic_set_priority(IRQN_DVP_INTERRUPT, 2);
     /* set irq handle */
     plic_irq_register(IRQN_DVP_INTERRUPT, sensor_irq, (void *)&sensor);
+#if MICROPY_PY_THREAD
+    if (g_sensor_frame_sem == NULL)
+        g_sensor_frame_sem = xSemaphoreCreateBinary();
+#endif
 
     plic_irq_disable(IRQN_DVP_INTERRUPT);
     dvp_clear_interrupt(DVP_STS_FRAME_START | DVP_STS_FRAME_FINISH);
@@ -702,17 +731,30 @@ int sensor_init_irq()
     return 0;
 }
 
-int sensor_reset(mp_int_t freq, bool default_freq, bool set_regs, bool double_buff, uint8_t choice_dev)
+int sensor_reset(mp_int_t freq, bool default_freq, bool set_regs, uint8_t buff_num, uint8_t choice_dev)
 {
 #if CONFIG_MAIXPY_OMV_DOUBLE_BUFF
     g_sensor_buff_index_out = 0;
     g_sensor_buff_index_in = 0;
     buff_ready = false;
+    if (buff_num > SENSOR_BUFFER_NUM)
+        buff_num = SENSOR_BUFFER_NUM;
+#else
+    buff_num = 1;
 #endif
+    if (buff_num < 1)
+        buff_num = 1;
+    g_dvp_converting = false;
+    g_sensor_frame_seq = 0;
+    g_sensor_frame_drop = 0;
+    memset(&g_sensor_last_frame, 0, sizeof(g_sensor_last_frame));
     sensor.reset_set = false;
     sensor.vflip = false;
     sensor.hmirror = false;
-    sensor.double_buff = double_buff;
+    sensor.native_order = false;
+    memset((void *)g_native_pixels, 0, sizeof(g_native_pixels));
+    sensor.double_buff = buff_num > 1;
+    sensor.buff_num = buff_num;
     sensor.choice_dev = choice_dev;
     sensor_init_fb(); //init FB
     if (sensor_init_dvp(freq, default_freq) != 0)
@@ -915,6 +957,20 @@ int binocular_sensor_scan()
 
 int binocular_sensor_reset(mp_int_t freq)
 {
+    // one frame buffer, the two sensors take turns on the same DVP
+#if CONFIG_MAIXPY_OMV_DOUBLE_BUFF
+    g_sensor_buff_index_out = 0;
+    g_sensor_buff_index_in = 0;
+    buff_ready = false;
+#endif
+    g_dvp_converting = false;
+    g_sensor_frame_seq = 0;
+    g_sensor_frame_drop = 0;
+    memset(&g_sensor_last_frame, 0, sizeof(g_sensor_last_frame));
+    sensor.native_order = false;
+    memset((void *)g_native_pixels, 0, sizeof(g_native_pixels));
+    sensor.double_buff = false;
+    sensor.buff_num = 1;
     sensor_init_fb(); //init FB
     sensor_load_config(&sensor_config);
 
@@ -1166,10 +1222,7 @@ int sensor_set_framesize(framesize_t framesize, bool set_regs)
     if (MAIN_FB()->w != w_old || MAIN_FB()->h != h_old)
     {
 #if CONFIG_MAIXPY_OMV_DOUBLE_BUFF
-        uint8_t buff_size = SENSOR_BUFFER_NUM;
-        if (!sensor.double_buff)
-            buff_size = 1;
-        for (int i = 0; i < buff_size; ++i)
+        for (int i = 0; i < sensor.buff_num; ++i)
         {
             if (MAIN_FB()->pixels[i])
                 free(MAIN_FB()->pixels[i]);
@@ -1593,6 +1646,52 @@ int reverse_u32pixel(uint32_t *addr, uint32_t length)
     return 0;
 }
 
+static void sensor_pixels_set_native(uint8_t *pixels, bool native)
+{
+    int free_slot = -1;
+    for (int i = 0; i < SENSOR_BUFFER_NUM; ++i)
+    {
+        if (g_native_pixels[i] == pixels)
+        {
+            if (!native)
+                g_native_pixels[i] = NULL;
+            return;
+        }
+        if (g_native_pixels[i] == NULL && free_slot < 0)
+            free_slot = i;
+    }
+    if (native && free_slot >= 0)
+        g_native_pixels[free_slot] = pixels;
+}
+
+bool sensor_pixels_native(uint8_t *pixels)
+{
+    if (pixels == NULL)
+        return false;
+    for (int i = 0; i < SENSOR_BUFFER_NUM; ++i)
+    {
+        if (g_native_pixels[i] == pixels)
+            return true;
+    }
+    return false;
+}
+
+void sensor_pixels_canonical(image_t *image)
+{
+    // the swap skipped by snapshot, fused into the first consumer that needs canonical order
+    if (image->bpp == IMAGE_BPP_RGB565 && sensor_pixels_native(image->pixels))
+    {
+        sensor_pixels_set_native(image->pixels, false);
+        reverse_u32pixel((uint32_t *)(image->pixels), image->w * image->h / 2);
+    }
+}
+
+int sensor_set_native_order(int enable)
+{
+    sensor.native_order = (enable == 0) ? false : true;
+    return 0;
+}
+
 int sensor_flush(void)
 { //flush old frame, let dvp capture new image
     //use it when you don't snap for a while.
@@ -1601,6 +1700,44 @@ int sensor_flush(void)
     return 0;
 }
 
+// Sleep until the DVP IRQ reports a finished frame, false once timeout_ms passed since start.
+static bool sensor_wait_frame(uint32_t start, uint32_t timeout_ms)
+{
+    uint32_t elapsed = systick_current_millis() - start;
+    if (elapsed > timeout_ms)
+        return false;
+#if MICROPY_PY_THREAD
+    if (g_sensor_frame_sem && xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        TickType_t ticks = pdMS_TO_TICKS(timeout_ms - elapsed);
+        // native tasks (pipeline) snapshot too, they do not hold the GIL
+        bool py_thread = mp_thread_get_state() != NULL;
+        if (py_thread)
+            MP_THREAD_GIL_EXIT();
+        xSemaphoreTake(g_sensor_frame_sem, ticks ? ticks : 1);
+        if (py_thread)
+            MP_THREAD_GIL_ENTER();
+        return true;
+    }
+#endif
+    _ndelay(50);
+    return true;
+}
+
+static void sensor_set_last_frame(uint8_t slot)
+{
+    g_sensor_last_frame.seq = g_sensor_slot_seq[slot];
+    g_sensor_last_frame.timestamp_us = g_sensor_slot_us[slot];
+}
+
+int sensor_get_frame_info(sensor_frame_info_t *info)
+{
+    *info = g_sensor_last_frame;
+    info->dropped = g_sensor_frame_drop;
+    info->age_us = info->seq ? (mp_hal_ticks_us() - info->timestamp_us) : 0;
+    return 0;
+}
+
 int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_cb, bool update_jb)
 {
     if (!sensor->reset_set || !sensor->size_set)
@@ -1686,10 +1823,10 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
         {
             if (g_sensor_buff_index_out != g_sensor_buff_index_in)
             {
-                g_sensor_buff_index_out = (g_sensor_buff_index_out + 1) % SENSOR_BUFFER_NUM;
+                g_sensor_buff_index_out = (g_sensor_buff_index_out + 1) % sensor->buff_num;
                 if ((g_sensor_buff_index_out == g_sensor_buff_index_in) && buff_ready)
                 {
-                    g_sensor_buff_index_in = (g_sensor_buff_index_in + 1) % SENSOR_BUFFER_NUM;
+                    g_sensor_buff_index_in = (g_sensor_buff_index_in + 1) % sensor->buff_num;
                     buff_ready = false;
                 }
             }
@@ -1701,10 +1838,10 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
             uint32_t start = systick_current_millis();
             while ((g_sensor_buff_index_in == g_sensor_buff_index_out) && (!buff_ready)) // rempty
             {
-                _ndelay(50);
-                if (systick_current_millis() - start > 300) //wait for 30ms
+                if (!sensor_wait_frame(start, SENSOR_FRAME_TIMEOUT_MS))
                     return -1;
             }
+            sensor_set_last_frame(g_sensor_buff_index_out);
             // Set the user image.
             image->w = MAIN_FB()->w;
             image->h = MAIN_FB()->h;
@@ -1719,10 +1856,10 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
             uint32_t start = systick_current_millis();
             while (g_dvp_finish_flag == 0)
             {
-                _ndelay(50);
-                if (systick_current_millis() - start > 300) //wait for 30ms
+                if (!sensor_wait_frame(start, SENSOR_FRAME_TIMEOUT_MS))
                     return -1;
             }
+            sensor_set_last_frame(0);
             // Set the user image.
             image->w = MAIN_FB()->w;
             image->h = MAIN_FB()->h;
@@ -1736,10 +1873,10 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
         uint32_t start = systick_current_millis();
         while (g_dvp_finish_flag == 0)
         {
-            _ndelay(50);
-            if (systick_current_millis() - start > 300) //wait for 30ms
+            if (!sensor_wait_frame(start, SENSOR_FRAME_TIMEOUT_MS))
                 return -1;
         }
+        sensor_set_last_frame(0);
         // Set the user image.
         image->w = MAIN_FB()->w;
         image->h = MAIN_FB()->h;
@@ -1757,8 +1894,14 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
         {
             image->pixels = image->pix_ai;
         }
+        else if (sensor->native_order)
+        {
+            // leave it as DVP wrote it, lcd.display sends it as is, others swap on first access
+            sensor_pixels_set_native(image->pixels, true);
+        }
         else
         {
+            sensor_pixels_set_native(image->pixels, false);
             reverse_u32pixel((uint32_t *)(image->pixels), (MAIN_FB()->w) * (MAIN_FB()->h) / 2);
         }
 
@@ -1779,10 +1922,7 @@ int sensor_snapshot(sensor_t *sensor, image_t *image, streaming_cb_t streaming_c
 bool is_img_data_in_main_fb(uint8_t *data)
 {
 #if CONFIG_MAIXPY_OMV_DOUBLE_BUFF
-    uint8_t buff_size = SENSOR_BUFFER_NUM;
-    if (sensor.double_buff)
-        buff_size = 2;
-    for (uint8_t i = 0; i < buff_size; ++i)
+    for (uint8_t i = 0; i < sensor.buff_num; ++i)
     {
         if ((MAIN_FB()->pixels[i] != NULL) &&
             (data >= MAIN_FB()->pixels[i]) &&
@@ -1,13 +1,224 @@
 #include "vfs_wrapper.h"
 #include "py/stream.h"
+#include "py/mperrno.h"
 #include "extmod/vfs.h"
 #include "py/runtime.h"
+#include <stdlib.h>
+
+/************ File buffer ************/
+// One window is 8 SD sectors or 16 SPIFFS pages / one flash erase sector,
+// so flushes and refills hit the media in whole blocks.
+#define FILE_BUFFER_SIZE    4096
+#define FILE_BUFFER_MAX     4
+
+typedef enum {
+    FILE_BUFFER_IDLE = 0,
+    FILE_BUFFER_READ,
+    FILE_BUFFER_WRITE,
+} file_buffer_mode_t;
+
+typedef struct {
+    mp_obj_t fp;
+    uint8_t* buf;
+    uint32_t size;      // window size, the first one is cut short to reach a block boundary
+    uint32_t pos;       // read/write index in the window
+    uint32_t len;       // valid read-ahead bytes
+    uint8_t  mode;
+} file_buffer_t;
+
+static file_buffer_t file_buffers[FILE_BUFFER_MAX];
+
+void file_buffer_init0()
+{
+    memset(file_buffers, 0, sizeof(file_buffers));
+}
+
+static file_buffer_t* file_buffer_find(mp_obj_t fp)
+{
+    for(int i=0; i<FILE_BUFFER_MAX; ++i)
+    {
+        if(file_buffers[i].fp && file_buffers[i].fp == fp)
+            return &file_buffers[i];
+    }
+    return NULL;
+}
+
+static void file_buffer_align(file_buffer_t* b)
+{
+    int err;
+    struct mp_stream_seek_t seek = { .offset = 0, .whence = VFS_SEEK_CUR };
+    mp_stream_p_t* stream = (mp_stream_p_t*)((mp_obj_base_t*)b->fp)->type->protocol;
+    b->size = FILE_BUFFER_SIZE;
+    if(stream->ioctl(b->fp, MP_STREAM_SEEK, (uintptr_t)&seek, &err) != MP_STREAM_ERROR)
+        b->size -= seek.offset % FILE_BUFFER_SIZE;
+}
+
+// write back pending data, or give back unread read-ahead, so the file position is the logical one
+static int file_buffer_sync(file_buffer_t* b)
+{
+    int err = 0;
+    if(b->mode == FILE_BUFFER_WRITE && b->pos)
+    {
+        mp_uint_t len = vfs_internal_write(b->fp, b->buf, b->pos, &err);
+        if(err == 0 && len != b->pos)
+            err = MP_EIO;
+    }
+    else if(b->mode == FILE_BUFFER_READ && b->len > b->pos)
+    {
+        vfs_internal_seek(b->fp, -(mp_int_t)(b->len - b->pos), VFS_SEEK_CUR, &err);
+    }
+    if(b->mode != FILE_BUFFER_IDLE)
+        file_buffer_align(b);
+    b->pos = 0;
+    b->len = 0;
+    b->mode = FILE_BUFFER_IDLE;
+    return err;
+}
+
+// buffers come from the heap, not fb_alloc, so they can be turned off in any
+// order without touching what the caller has on the fb_alloc stack
+static void file_buffer_release(file_buffer_t* b)
+{
+    free(b->buf);
+    b->fp = NULL;
+    b->buf = NULL;
+}
+
+// drop the buffer without writing it back, used before closing on an error
+static void file_buffer_drop(mp_obj_t fp)
+{
+    file_buffer_t* b = file_buffer_find(fp);
+    if(b)
+        file_buffer_release(b);
+}
+
+// a fresh file object may reuse the address of one whose buffer was never turned off
+static void file_buffer_forget(mp_obj_t fp)
+{
+    file_buffer_drop(fp);
+}
+
+// buffers only live inside one C call, any still on here were skipped by an exception
+void file_buffer_deinit()
+{
+    for(int i=0; i<FILE_BUFFER_MAX; ++i)
+    {
+        if(file_buffers[i].fp)
+            file_buffer_release(&file_buffers[i]);
+    }
+}
+
+static mp_uint_t file_buffer_read(mp_obj_t fp, void* data, mp_uint_t size, int* err)
+{
+    file_buffer_t* b = file_buffer_find(fp);
+    if(!b)
+        return vfs_internal_read(fp, data, size, err);
+    *err = 0;
+    if(b->mode == FILE_BUFFER_WRITE)
+    {
+        *err = file_buffer_sync(b);
+        if(*err != 0)
+            return 0;
+    }
+    b->mode = FILE_BUFFER_READ;
+    uint8_t* out = (uint8_t*)data;
+    mp_uint_t done = 0;
+    while(done < size)
+    {
+        if(b->pos < b->len)
+        {
+            mp_uint_t n = b->len - b->pos;
+            if(n > size - done)
+                n = size - done;
+            memcpy(out + done, b->buf + b->pos, n);
+            b->pos += n;
+            done += n;
+        }
+        else if(size - done >= b->size)
+        {
+            // big reads skip the copy, whole windows straight into the caller's memory
+            mp_uint_t n = (size - done) - (size - done) % b->size;
+            mp_uint_t len = vfs_internal_read(fp, out + done, n, err);
+            if(*err != 0)
+                break;
+            done += len;
+            b->size = FILE_BUFFER_SIZE;
+            if(len != n)
+                break;
+        }
+        else
+        {
+            b->pos = 0;
+            b->len = vfs_internal_read(fp, b->buf, b->size, err);
+            b->size = FILE_BUFFER_SIZE;
+            if(*err != 0 || b->len == 0)
+            {
+                b->len = 0;
+                break;
+            }
+        }
+    }
+    return done;
+}
+
+static mp_uint_t file_buffer_write(mp_obj_t fp, const void* data, mp_uint_t size, int* err)
+{
+    file_buffer_t* b = file_buffer_find(fp);
+    if(!b)
+        return vfs_internal_write(fp, (void*)data, size, err);
+    *err = 0;
+    if(b->mode == FILE_BUFFER_READ)
+    {
+        *err = file_buffer_sync(b);
+        if(*err != 0)
+            return 0;
+    }
+    b->mode = FILE_BUFFER_WRITE;
+    const uint8_t* in = (const uint8_t*)data;
+    mp_uint_t done = 0;
+    while(done < size)
+    {
+        if(b->pos == 0 && size - done >= b->size)
+        {
+            mp_uint_t n = (size - done) - (size - done) % b->size;
+            mp_uint_t len = vfs_internal_write(fp, (void*)(in + done), n, err);
+            if(*err != 0)
+                break;
+            done += len;
+            b->size = FILE_BUFFER_SIZE;
+            if(len != n)
+            {
+                *err = MP_EIO;
+                break;
+            }
+            continue;
+        }
+        mp_uint_t n = b->size - b->pos;
+        if(n > size - done)
+            n = size - done;
+        memcpy(b->buf + b->pos, in + done, n);
+        b->pos += n;
+        done += n;
+        if(b->pos == b->size)
+        {
+            mp_uint_t len = vfs_internal_write(fp, b->buf, b->pos, err);
+            if(*err == 0 && len != b->pos)
+                *err = MP_EIO;
+            b->pos = 0;
+            b->size = FILE_BUFFER_SIZE;
+            if(*err != 0)
+                break;
+        }
+    }
+    return done;
+}
 
 /************ File OP ************/
 int file_write_open(mp_obj_t* fp, const char *path)
 {
     int err;
     *fp = vfs_internal_open(path, "wb", &err);
+    file_buffer_forget(*fp);
     return err;
 }
 
@@ -17,6 +228,7 @@ int file_write_open_raise(mp_obj_t* fp, const char *path)
     *fp = vfs_internal_open(path, "wb", &err);
     if(*fp == MP_OBJ_NULL || err != 0)
         mp_raise_OSError(err);
+    file_buffer_forget(*fp);
     return err;
 }
 
@@ -24,6 +236,7 @@ int file_read_open(mp_obj_t* fp, const char *path)
 {
     int err;
     *fp = vfs_internal_open(path, "rb", &err);
+    file_buffer_forget(*fp);
     return err;
 }
 
@@ -33,21 +246,37 @@ int file_read_open_raise(mp_obj_t* fp, const char *path)
     *fp = vfs_internal_open(path, "rb", &err);
     if(*fp == MP_OBJ_NULL || err != 0)
         mp_raise_OSError(err);
+    file_buffer_forget(*fp);
     return err;
 }
 
 
 int file_close(mp_obj_t fp)
 {
-    int err;
+    int err, sync_err = 0;
+    file_buffer_t* b = file_buffer_find(fp);
+    if(b)
+    {
+        sync_err = file_buffer_sync(b);
+        file_buffer_release(b);
+    }
     vfs_internal_close(fp, &err);
-    return err;
+    return sync_err ? sync_err : err;
 }
 
 int file_seek(mp_obj_t fp, mp_int_t offset, uint8_t whence)
 {
     int err;
+    file_buffer_t* b = file_buffer_find(fp);
+    if(b)
+    {
+        err = file_buffer_sync(b);
+        if(err != 0)
+            return err;
+    }
     vfs_internal_seek(fp, offset, whence, &err);
+    if(b)
+        file_buffer_align(b);
     return err;
 }
 
@@ -55,6 +284,9 @@ bool file_eof(mp_obj_t fp)
 {
     //TODO: recode this function
     int err;
+    file_buffer_t* b = file_buffer_find(fp);
+    if(b)
+        file_buffer_sync(b);
     mp_uint_t size = vfs_internal_size(fp);
     mp_uint_t curr = vfs_internal_seek(fp, 0, VFS_SEEK_CUR, &err);
     return curr<size;
@@ -62,10 +294,10 @@ bool file_eof(mp_obj_t fp)
 
 int file_seek_raise(mp_obj_t fp, mp_int_t offset, uint8_t whence)
 {
-    int err;
-    vfs_internal_seek(fp, offset, whence, &err);
+    int err = file_seek(fp, offset, whence);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -87,18 +319,48 @@ mp_uint_t file_save_data(const char* path, uint8_t* data, mp_uint_t length, int*
 
 mp_uint_t file_size(mp_obj_t fp)
 {
+    file_buffer_t* b = file_buffer_find(fp);
+    if(b && b->mode == FILE_BUFFER_WRITE)
+        file_buffer_sync(b);
 	return vfs_internal_size(fp);
 }
 
-
+// file_close() and the raise helpers turn the buffer off too
 void file_buffer_on(mp_obj_t fp)
 {
-	//TODO
+    if(file_buffer_find(fp))
+        return;
+    file_buffer_t* b = NULL;
+    for(int i=0; !b && i<FILE_BUFFER_MAX; ++i)
+    {
+        if(!file_buffers[i].fp)
+            b = &file_buffers[i];
+    }
+    if(!b) // all in use, stay unbuffered
+        return;
+    b->buf = malloc(FILE_BUFFER_SIZE);
+    if(!b->buf) // out of memory, stay unbuffered
+        return;
+    b->fp = fp;
+    b->pos = 0;
+    b->len = 0;
+    b->mode = FILE_BUFFER_IDLE;
+    file_buffer_align(b);
 }
 
 void file_buffer_off(mp_obj_t fp)
 {
-	//TODO
+    int err;
+    file_buffer_t* b = file_buffer_find(fp);
+    if(!b)
+        return;
+    err = file_buffer_sync(b);
+    file_buffer_release(b);
+    if(err != 0)
+    {
+        vfs_internal_close(fp, &err);
+        mp_raise_OSError(err);
+    }
 }
 
 /************ Raise ************/
@@ -106,7 +368,10 @@ NORETURN static void fs_fail(mp_obj_t fp, int res)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, ffs_strerror(res)));
 }
 
@@ -114,7 +379,10 @@ NORETURN static void fs_read_fail(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to read requested bytes!"));
 }
 
@@ -122,7 +390,10 @@ NORETURN static void fs_write_fail(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Failed to write requested bytes!"));
 }
 
@@ -130,7 +401,10 @@ NORETURN static void fs_expect_fail(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Unexpected value read!"));
 }
 
@@ -138,7 +412,10 @@ NORETURN void fs_unsupported_format(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Unsupported format!"));
 }
 
@@ -146,7 +423,10 @@ NORETURN void fs_file_corrupted(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "File corrupted!"));
 }
 
@@ -154,7 +434,10 @@ NORETURN void fs_not_equal(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Images not equal!"));
 }
 
@@ -162,7 +445,10 @@ NORETURN void fs_no_intersection(mp_obj_t fp)
 {
     int err;
     if(fp)
+    {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
+    }
     nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "No intersection!"));
 }
 
@@ -171,6 +457,7 @@ int file_corrupted_raise(mp_obj_t fp)
     int err;
     if(fp)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
     }
 	mp_raise_ValueError("file_corrupted_raise!");
@@ -189,16 +476,17 @@ const char *ffs_strerror(int res)
 int read_byte(mp_obj_t fp, uint8_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 1, &err);
+    file_buffer_read(fp, (void*)value, 1, &err);
     return err;
 }
 
 int read_byte_raise(mp_obj_t fp, uint8_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 1, &err);
+    file_buffer_read(fp, (void*)value, 1, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -216,23 +504,24 @@ int read_byte_ignore(mp_obj_t fp)
 {
     uint8_t tmp;
     int err;
-    vfs_internal_read(fp, (void*)&tmp, 1, &err);
+    file_buffer_read(fp, (void*)&tmp, 1, &err);
     return err;
 }
 
 int write_byte(mp_obj_t fp, uint8_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 1, &err);
+    file_buffer_write(fp, &value, 1, &err);
     return err;
 }
 
 int write_byte_raise(mp_obj_t fp, uint8_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 1, &err);
+    file_buffer_write(fp, &value, 1, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -243,16 +532,17 @@ int write_byte_raise(mp_obj_t fp, uint8_t value)
 int read_word(mp_obj_t fp, uint16_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 2, &err);
+    file_buffer_read(fp, (void*)value, 2, &err);
     return err;
 }
 
 int read_word_raise(mp_obj_t fp, uint16_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 2, &err);
+    file_buffer_read(fp, (void*)value, 2, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -270,23 +560,24 @@ int read_word_ignore(mp_obj_t fp)
 {
     uint16_t tmp;
     int err;
-    vfs_internal_read(fp, (void*)&tmp, 2, &err);
+    file_buffer_read(fp, (void*)&tmp, 2, &err);
     return err;
 }
 
 int write_word(mp_obj_t fp, uint16_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 2, &err);
+    file_buffer_write(fp, &value, 2, &err);
     return err;
 }
 
 int write_word_raise(mp_obj_t fp, uint16_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 2, &err);
+    file_buffer_write(fp, &value, 2, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -297,16 +588,17 @@ int write_word_raise(mp_obj_t fp, uint16_t value)
 int read_long(mp_obj_t fp, uint32_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 4, &err);
+    file_buffer_read(fp, (void*)value, 4, &err);
     return err;
 }
 
 int read_long_raise(mp_obj_t fp, uint32_t* value)
 {
     int err;
-    vfs_internal_read(fp, (void*)value, 4, &err);
+    file_buffer_read(fp, (void*)value, 4, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -324,23 +616,24 @@ int read_long_ignore(mp_obj_t fp)
 {
     uint32_t tmp;
     int err;
-    vfs_internal_read(fp, (void*)&tmp, 4, &err);
+    file_buffer_read(fp, (void*)&tmp, 4, &err);
     return err;
 }
 
 int write_long(mp_obj_t fp, uint32_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 4, &err);
+    file_buffer_write(fp, &value, 4, &err);
     return err;
 }
 
 int write_long_raise(mp_obj_t fp, uint32_t value)
 {
     int err;
-    vfs_internal_write(fp, (void*)&value, 4, &err);
+    file_buffer_write(fp, &value, 4, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -351,23 +644,24 @@ int write_long_raise(mp_obj_t fp, uint32_t value)
 int read_data(mp_obj_t fp, void *data, mp_uint_t size)
 {
     int err;
-    vfs_internal_read(fp, data, size, &err);
+    file_buffer_read(fp, data, size, &err);
     return err;
 }
 
 int file_read(mp_obj_t fp, void *data, mp_uint_t size, mp_uint_t* size_out)
 {
     int err;
-    *size_out = vfs_internal_read(fp, data, size, &err);
+    *size_out = file_buffer_read(fp, data, size, &err);
     return err;
 }
 
 int read_data_raise(mp_obj_t fp, void *data, mp_uint_t size)
 {
     int err;
-    vfs_internal_read(fp, data, size, &err);
+    file_buffer_read(fp, data, size, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
@@ -377,23 +671,24 @@ int read_data_raise(mp_obj_t fp, void *data, mp_uint_t size)
 int write_data(mp_obj_t fp, const void *data, mp_uint_t size)
 {
     int err;
-    vfs_internal_write(fp, (void*)data, size, &err);
+    file_buffer_write(fp, data, size, &err);
     return err;
 }  
 
 int file_write(mp_obj_t fp, void *data, mp_uint_t size, mp_uint_t* size_out)
 {
     int err;
-    *size_out = vfs_internal_write(fp, data, size, &err);
+    *size_out = file_buffer_write(fp, data, size, &err);
     return err;
 }
 
 int write_data_raise(mp_obj_t fp, const void *data, mp_uint_t size)
 {
     int err;
-    vfs_internal_write(fp, (void*)data, size, &err);
+    file_buffer_write(fp, data, size, &err);
 	if (err != 0)
     {
+        file_buffer_drop(fp);
         vfs_internal_close(fp, &err);
         mp_raise_OSError(err);
     }
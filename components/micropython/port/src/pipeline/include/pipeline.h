@@ -0,0 +1,115 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frame pipeline: stages connected by fixed-depth queues of preallocated slots.
+// Every stage is a FreeRTOS task that takes a slot from its input queue, runs on it
+// and hands it to the next stage, the last one gives it back to the free queue,
+// which is the input of the first stage. No MicroPython object is touched here,
+// the tasks never take the GIL.
+
+#define PIPELINE_MAX_STAGES     6
+#define PIPELINE_MAX_SLOTS      6
+#define PIPELINE_TASK_PRIORITY  4          // same as the python threads, time sliced with them
+#define PIPELINE_STACK_SIZE     (8*1024)   // bytes
+#define PIPELINE_POLL_MS        50         // how often a waiting stage looks at the stop flag
+
+typedef struct _pipeline_t pipeline_t;
+
+typedef struct{
+    uint32_t  seq;        // frame number, given when the first stage takes the slot
+    uint64_t  start_us;   // when the first stage took it
+    void*     data;       // buffers of the user, set before start
+} pipeline_slot_t;
+
+/**
+ * @return 0 pass the slot on, >0 drop the frame (the slot goes back to free),
+ *         <0 stop the pipeline
+ */
+typedef int (*pipeline_run_t)(pipeline_t* p, pipeline_slot_t* slot, void* arg);
+typedef void (*pipeline_hook_t)(pipeline_t* p, void* arg);
+
+typedef struct{
+    uint32_t  frames;     // slots passed on
+    uint32_t  dropped;    // slots given back early
+    uint32_t  core1_busy; // runs meant for core 1 done on core 0, it was busy
+    uint32_t  last_us;    // work time of the last slot
+    uint32_t  max_us;
+    uint64_t  work_us;    // total, average = work_us / (frames + dropped)
+    uint64_t  wait_us;    // total time waiting for input
+} pipeline_stage_stats_t;
+
+typedef struct{
+    uint32_t  peak;       // most slots seen queued
+    uint32_t  puts;
+    uint64_t  sum;        // slots queued after each put, average = sum / puts
+} pipeline_queue_stats_t;
+
+typedef struct{
+    const char*      name;
+    pipeline_run_t   run;       // may run on core 1 if core1_ok
+    pipeline_run_t   after;     // optional, always on core 0, after run passed the slot
+    void*            arg;
+    uint32_t         stack_size;
+    uint8_t          core;      // 0, or 1 to hand run to the second core
+    bool             core1_ok;  // run only computes: no RTOS, heap, or python calls
+    // runtime
+    pipeline_t*      p;
+    void*            task;
+    void*            in;        // input queue of slot indices
+    pipeline_stage_stats_t stats;
+    pipeline_queue_stats_t qstats; // of in
+} pipeline_stage_t;
+
+struct _pipeline_t{
+    pipeline_stage_t  stages[PIPELINE_MAX_STAGES];
+    uint8_t           stage_num;
+    pipeline_slot_t   slots[PIPELINE_MAX_SLOTS];
+    uint8_t           slot_num;
+    pipeline_hook_t   stopped;   // after the tasks are gone, also on pipeline_stop_all
+    void*             stopped_arg;
+    volatile bool     running;
+    volatile bool     stop;
+    volatile int8_t   failed;    // stage that stopped the pipeline, -1 if none
+    void*             exit_sem;
+    uint8_t           task_num;  // tasks created, given exit_sem when they end
+    uint32_t          seq;
+    // first stage taking a slot to the last stage finishing it
+    uint32_t          latency_last;
+    uint32_t          latency_max;
+    uint64_t          latency_sum;
+    uint32_t          latency_num;
+    pipeline_t*       next;      // running pipelines
+};
+
+void pipeline_init(pipeline_t* p, uint8_t slot_num);
+/**
+ * @param stack_size bytes, 0 for PIPELINE_STACK_SIZE
+ * @return index of the stage, -1 if there are PIPELINE_MAX_STAGES already
+ */
+int pipeline_add_stage(pipeline_t* p, const char* name, pipeline_run_t run, pipeline_run_t after,
+                       void* arg, bool core1_ok, uint32_t stack_size);
+/**
+ * FreeRTOS only runs on core 0, core 1 is used through dual_func, so only stages
+ * added with core1_ok can go there
+ * @return 0 if success, or error code(>0 from errno.h)
+ */
+int pipeline_set_core(pipeline_t* p, int stage, int core);
+/**
+ * queue every slot as free and create the stage tasks
+ * @return 0 if success, or error code(>0 from errno.h)
+ */
+int pipeline_start(pipeline_t* p);
+// ask the stages to stop and wait until every task is gone, they finish the slot in hand first
+void pipeline_stop(pipeline_t* p);
+// stop every running pipeline, for soft reset and anything about to free what they use
+void pipeline_stop_all(void);
+void pipeline_reset_stats(pipeline_t* p);
+// slots in the input queue of stage right now
+uint32_t pipeline_queued(pipeline_t* p, int stage);
+// consistent copy of the counters of stage
+void pipeline_get_stats(pipeline_t* p, int stage, pipeline_stage_stats_t* stats, pipeline_queue_stats_t* qstats);
+
+#endif
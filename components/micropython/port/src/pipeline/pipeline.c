@@ -0,0 +1,301 @@
+#include <string.h>
+#include <errno.h>
+#include "pipeline.h"
+#include "py/mphal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+typedef int (*dual_func_t)(int);
+extern volatile dual_func_t dual_func;
+
+static pipeline_t* g_pipeline_running = NULL;
+
+// one run at a time on core 1, whatever pipeline it comes from
+static volatile int g_core1_claimed = 0;
+static pipeline_stage_t* volatile g_core1_stage;
+static pipeline_slot_t* volatile g_core1_slot;
+static volatile int g_core1_ret;
+static volatile bool g_core1_done;
+
+static inline uint64_t pipeline_now_us(void)
+{
+    return mp_hal_ticks_us();
+}
+
+static int pipeline_core1_entry(int core)
+{
+    pipeline_stage_t* st = g_core1_stage;
+    g_core1_ret = st->run(st->p, g_core1_slot, st->arg);
+    __sync_synchronize();
+    g_core1_done = true;
+    return 0;
+}
+
+static int pipeline_run(pipeline_stage_t* st, pipeline_slot_t* slot)
+{
+    if(st->core == 1 && __sync_lock_test_and_set(&g_core1_claimed, 1) == 0)
+    {
+        g_core1_stage = st;
+        g_core1_slot = slot;
+        g_core1_done = false;
+        __sync_synchronize();
+        // dual_func is a single slot shared with the image and lcd helpers, never wait for it
+        if(__sync_bool_compare_and_swap(&dual_func, NULL, pipeline_core1_entry))
+        {
+            while(!g_core1_done)
+                taskYIELD();
+            int ret = g_core1_ret;
+            __sync_lock_release(&g_core1_claimed);
+            return ret;
+        }
+        __sync_lock_release(&g_core1_claimed);
+    }
+    if(st->core == 1)
+        st->stats.core1_busy++;
+    return st->run(st->p, slot, st->arg);
+}
+
+static void pipeline_put(pipeline_stage_t* to, uint8_t index)
+{
+    // never blocks, every queue can hold every slot
+    xQueueSend((QueueHandle_t)to->in, &index, portMAX_DELAY);
+    uint32_t n = uxQueueMessagesWaiting((QueueHandle_t)to->in);
+    taskENTER_CRITICAL();
+    to->qstats.puts++;
+    to->qstats.sum += n;
+    if(n > to->qstats.peak)
+        to->qstats.peak = n;
+    taskEXIT_CRITICAL();
+}
+
+static void pipeline_task(void* arg)
+{
+    pipeline_stage_t* st = (pipeline_stage_t*)arg;
+    pipeline_t* p = st->p;
+    int index = st - p->stages;
+    bool last = (index == p->stage_num - 1);
+    uint8_t slot_index;
+
+    while(!p->stop)
+    {
+        uint64_t t0 = pipeline_now_us();
+        BaseType_t got = xQueueReceive((QueueHandle_t)st->in, &slot_index, pdMS_TO_TICKS(PIPELINE_POLL_MS));
+        uint64_t t1 = pipeline_now_us();
+        st->stats.wait_us += t1 - t0;
+        if(got != pdTRUE)
+            continue;
+
+        pipeline_slot_t* slot = &p->slots[slot_index];
+        if(index == 0)
+        {
+            slot->seq = ++p->seq;
+            slot->start_us = t1;
+        }
+        int ret = pipeline_run(st, slot);
+        if(ret == 0 && st->after)
+            ret = st->after(p, slot, st->arg);
+        uint64_t t2 = pipeline_now_us();
+        uint32_t us = t2 - t1;
+
+        taskENTER_CRITICAL();
+        if(ret == 0)
+            st->stats.frames++;
+        else
+            st->stats.dropped++;
+        st->stats.last_us = us;
+        st->stats.work_us += us;
+        if(us > st->stats.max_us)
+            st->stats.max_us = us;
+        if(ret == 0 && last)
+        {
+            uint32_t latency = t2 - slot->start_us;
+            p->latency_last = latency;
+            p->latency_sum += latency;
+            p->latency_num++;
+            if(latency > p->latency_max)
+                p->latency_max = latency;
+        }
+        taskEXIT_CRITICAL();
+
+        if(ret < 0)
+        {
+            p->failed = index;
+            p->stop = true;
+        }
+        pipeline_put((ret != 0 || last) ? &p->stages[0] : st + 1, slot_index);
+    }
+    xSemaphoreGive((SemaphoreHandle_t)p->exit_sem);
+    vTaskDelete(NULL);
+}
+
+void pipeline_init(pipeline_t* p, uint8_t slot_num)
+{
+    memset(p, 0, sizeof(pipeline_t));
+    if(slot_num > PIPELINE_MAX_SLOTS)
+        slot_num = PIPELINE_MAX_SLOTS;
+    p->slot_num = slot_num;
+    p->failed = -1;
+}
+
+int pipeline_add_stage(pipeline_t* p, const char* name, pipeline_run_t run, pipeline_run_t after,
+                       void* arg, bool core1_ok, uint32_t stack_size)
+{
+    if(p->stage_num >= PIPELINE_MAX_STAGES || p->running)
+        return -1;
+    pipeline_stage_t* st = &p->stages[p->stage_num];
+    memset(st, 0, sizeof(pipeline_stage_t));
+    st->name = name;
+    st->run = run;
+    st->after = after;
+    st->arg = arg;
+    st->core1_ok = core1_ok;
+    st->stack_size = stack_size ? stack_size : PIPELINE_STACK_SIZE;
+    st->p = p;
+    return p->stage_num++;
+}
+
+int pipeline_set_core(pipeline_t* p, int stage, int core)
+{
+    if(stage < 0 || stage >= p->stage_num || core < 0 || core > 1)
+        return EINVAL;
+    if(core == 1 && !p->stages[stage].core1_ok)
+        return EINVAL;
+    if(p->running)
+        return EBUSY;
+    p->stages[stage].core = core;
+    return 0;
+}
+
+static void pipeline_free_queues(pipeline_t* p)
+{
+    for(int i=0; i<p->stage_num; ++i)
+    {
+        if(p->stages[i].in)
+            vQueueDelete((QueueHandle_t)p->stages[i].in);
+        p->stages[i].in = NULL;
+    }
+    if(p->exit_sem)
+        vSemaphoreDelete((SemaphoreHandle_t)p->exit_sem);
+    p->exit_sem = NULL;
+}
+
+int pipeline_start(pipeline_t* p)
+{
+    if(p->running)
+        return EBUSY;
+    if(p->stage_num == 0 || p->slot_num == 0)
+        return EINVAL;
+    for(int i=0; i<p->stage_num; ++i)
+    {
+        p->stages[i].in = xQueueCreate(p->slot_num, sizeof(uint8_t));
+        if(!p->stages[i].in)
+        {
+            pipeline_free_queues(p);
+            return ENOMEM;
+        }
+    }
+    p->exit_sem = xSemaphoreCreateCounting(PIPELINE_MAX_STAGES, 0);
+    if(!p->exit_sem)
+    {
+        pipeline_free_queues(p);
+        return ENOMEM;
+    }
+    for(uint8_t i=0; i<p->slot_num; ++i)
+        xQueueSend((QueueHandle_t)p->stages[0].in, &i, 0);
+    pipeline_reset_stats(p);
+    p->seq = 0;
+    p->stop = false;
+    p->failed = -1;
+    p->task_num = 0;
+
+    taskENTER_CRITICAL();
+    p->running = true;
+    p->next = g_pipeline_running;
+    g_pipeline_running = p;
+    taskEXIT_CRITICAL();
+
+    for(int i=0; i<p->stage_num; ++i)
+    {
+        pipeline_stage_t* st = &p->stages[i];
+        TaskHandle_t task = NULL;
+        xTaskCreateAtProcessor(0, pipeline_task, st->name, st->stack_size / sizeof(StackType_t),
+                               st, PIPELINE_TASK_PRIORITY, &task);
+        if(!task)
+        {
+            pipeline_stop(p);
+            return ENOMEM;
+        }
+        st->task = task;
+        p->task_num++;
+    }
+    return 0;
+}
+
+void pipeline_stop(pipeline_t* p)
+{
+    // whoever takes it off the running list stops it
+    bool found = false;
+    taskENTER_CRITICAL();
+    for(pipeline_t** it = &g_pipeline_running; *it; it = &(*it)->next)
+    {
+        if(*it == p)
+        {
+            *it = p->next;
+            found = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    if(!found)
+        return;
+
+    p->stop = true;
+    for(int i=0; i<p->task_num; ++i)
+        xSemaphoreTake((SemaphoreHandle_t)p->exit_sem, portMAX_DELAY);
+    p->task_num = 0;
+    for(int i=0; i<p->stage_num; ++i)
+        p->stages[i].task = NULL;
+    pipeline_free_queues(p);
+    p->next = NULL;
+    p->running = false;
+    if(p->stopped)
+        p->stopped(p, p->stopped_arg);
+}
+
+void pipeline_stop_all(void)
+{
+    while(g_pipeline_running)
+        pipeline_stop(g_pipeline_running);
+}
+
+void pipeline_reset_stats(pipeline_t* p)
+{
+    taskENTER_CRITICAL();
+    for(int i=0; i<p->stage_num; ++i)
+    {
+        memset(&p->stages[i].stats, 0, sizeof(pipeline_stage_stats_t));
+        memset(&p->stages[i].qstats, 0, sizeof(pipeline_queue_stats_t));
+    }
+    p->latency_last = 0;
+    p->latency_max = 0;
+    p->latency_sum = 0;
+    p->latency_num = 0;
+    taskEXIT_CRITICAL();
+}
+
+uint32_t pipeline_queued(pipeline_t* p, int stage)
+{
+    if(!p->running || stage < 0 || stage >= p->stage_num)
+        return 0;
+    return uxQueueMessagesWaiting((QueueHandle_t)p->stages[stage].in);
+}
+
+void pipeline_get_stats(pipeline_t* p, int stage, pipeline_stage_stats_t* stats, pipeline_queue_stats_t* qstats)
+{
+    taskENTER_CRITICAL();
+    *stats = p->stages[stage].stats;
+    *qstats = p->stages[stage].qstats;
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,517 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <mp.h>
+#include "py/runtime.h"
+#include "py/mperrno.h"
+#include "py_assert.h"
+#include "pipeline.h"
+#include "sensor.h"
+#include "framebuffer.h"
+#include "lcd.h"
+#include "kpu.h"
+#include "dmac.h"
+#include "Maix_kpu.h"
+#include "yolo2_region_layer.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+// camera -> kpu -> yolo2 -> lcd, every stage in its own task:
+//   capture: sensor snapshot (native DVP order), copies the frame and the planar RGB888
+//            the DVP writes for the KPU (what pix_to_ai() gives) into the slot
+//   infer:   kpu_run_kmodel on the slot, output copied into the slot, the uint8 one
+//            before dequantize when the model ends with a dequantize layer
+//   decode:  yolo2 region layer, boxes into the slot, optionally drawn on the frame
+//   display: frame to the lcd as is
+// While it runs it owns the sensor, the KPU and the lcd, python must not use them.
+
+#define PIPELINE_MAX_RECTS       32
+#define PIPELINE_KPU_DMA         DMAC_CHANNEL5   // same as KPU.run_with_output()
+#define PIPELINE_KPU_TIMEOUT_MS  1000
+#define PIPELINE_RECT_THICKNESS  2
+
+enum { STAGE_CAPTURE, STAGE_INFER, STAGE_DECODE, STAGE_DISPLAY, STAGE_NUM };
+static const char* const stage_names[STAGE_NUM] = { "pl_capture", "pl_infer", "pl_decode", "pl_display" };
+
+extern sensor_t sensor;
+
+typedef struct {
+    uint8_t*      pixels;     // rgb565 in DVP order, only with display
+    uint8_t*      ai;         // planar rgb888, KPU input
+    uint8_t*      ai_mem;     // ai before alignment
+    uint8_t*      output;     // KPU output, uint8 if quant
+    uint32_t      rect_num;
+    yolo2_rect_t  rects[PIPELINE_MAX_RECTS];
+} py_pipeline_slot_t;
+
+typedef struct {
+    mp_obj_base_t         base;
+    pipeline_t            pipe;
+    mp_obj_t              kpu;        // keeps the model alive
+    kpu_model_context_t*  ctx;
+    yolo2_region_layer_t* rl;
+    py_pipeline_slot_t    slots[PIPELINE_MAX_SLOTS];
+    uint8_t               slot_num;
+    uint8_t               cores[STAGE_NUM];
+    bool                  display;
+    bool                  draw;
+    uint16_t              color;      // rgb565
+    uint16_t              w, h;       // frame size, taken at start
+    uint16_t              lcd_x, lcd_y;
+    size_t                output_size;
+    bool                  quant;      // decode from the uint8 output, dequantize is skipped
+    kpu_model_quant_param_t q;
+    SemaphoreHandle_t     kpu_done;
+    bool                  native_order; // sensor setting to restore on stop
+    // newest decoded frame
+    uint32_t              result_seq;
+    uint32_t              result_num;
+    yolo2_rect_t          result[PIPELINE_MAX_RECTS];
+} py_pipeline_obj_t;
+
+const mp_obj_type_t py_pipeline_type;
+
+static void py_pipeline_kpu_done(void* ctx)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)ctx;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(self->kpu_done, &woken);
+    if (woken == pdTRUE)
+        portYIELD();
+}
+
+static int py_pipeline_capture(pipeline_t* p, pipeline_slot_t* slot, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    py_pipeline_slot_t* s = (py_pipeline_slot_t*)slot->data;
+    image_t img = {0};
+
+    if (sensor_snapshot(&sensor, &img, NULL, false) != 0)
+        return 1; // timeout, try the next one
+    if (img.w != self->w || img.h != self->h || img.bpp != 2 || !img.pix_ai)
+        return -1; // sensor was reconfigured under us
+    memcpy(s->ai, img.pix_ai, self->w * self->h * 3);
+    if (s->pixels)
+        memcpy(s->pixels, img.pixels, self->w * self->h * 2);
+    return 0;
+}
+
+static int py_pipeline_infer(pipeline_t* p, pipeline_slot_t* slot, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    py_pipeline_slot_t* s = (py_pipeline_slot_t*)slot->data;
+    uint8_t* output;
+    size_t size;
+
+    xSemaphoreTake(self->kpu_done, 0);
+    if (kpu_run_kmodel(self->ctx, s->ai, PIPELINE_KPU_DMA, py_pipeline_kpu_done, self) != 0)
+        return -1;
+    int paged_ret;
+    do {
+        if (xSemaphoreTake(self->kpu_done, pdMS_TO_TICKS(PIPELINE_KPU_TIMEOUT_MS)) != pdTRUE)
+            return -1;
+        // paged models stop before every layer that has to be read from flash
+        paged_ret = kpu_model_paged_resume(self->ctx);
+    } while (paged_ret > 0);
+    dmac_free_irq(PIPELINE_KPU_DMA);
+    if (paged_ret < 0)
+        return -1;
+    if (self->quant)
+    {
+        kpu_model_quant_param_t q;
+        if (kpu_get_output_quant(self->ctx, 0, &output, &size, &q) != 0)
+            return -1;
+    }
+    else if (kpu_get_output(self->ctx, 0, &output, &size) != 0)
+        return -1;
+    memcpy(s->output, output, size < self->output_size ? size : self->output_size);
+    return 0;
+}
+
+// computation only, may run on core 1
+static int py_pipeline_decode(pipeline_t* p, pipeline_slot_t* slot, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    py_pipeline_slot_t* s = (py_pipeline_slot_t*)slot->data;
+
+    if (self->quant)
+    {
+        yolo_region_layer_run_quant(self->rl, s->output, &self->q);
+    }
+    else
+    {
+        self->rl->input = (float*)s->output;
+        yolo_region_layer_run(self->rl);
+    }
+    s->rect_num = yolo_region_layer_get_rects(self->rl, s->rects, PIPELINE_MAX_RECTS);
+    return 0;
+}
+
+static void py_pipeline_fill(py_pipeline_obj_t* self, uint16_t* pixels, int x0, int y0, int x1, int y1)
+{
+    uint16_t color = __builtin_bswap16(self->color);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > self->w) x1 = self->w;
+    if (y1 > self->h) y1 = self->h;
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = x0; x < x1; ++x)
+            pixels[(y * self->w + x) ^ 1] = color; // DVP order, see SENSOR_NATIVE_RGB565_PIXEL
+    }
+}
+
+static int py_pipeline_publish(pipeline_t* p, pipeline_slot_t* slot, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    py_pipeline_slot_t* s = (py_pipeline_slot_t*)slot->data;
+
+    if (self->draw && s->pixels)
+    {
+        const int t = PIPELINE_RECT_THICKNESS;
+        for (uint32_t i = 0; i < s->rect_num; ++i)
+        {
+            // rects are in the init_yolo2 image size
+            int x = (int32_t)s->rects[i].x * self->w / (int)self->rl->image_width;
+            int y = (int32_t)s->rects[i].y * self->h / (int)self->rl->image_height;
+            int w = s->rects[i].w * self->w / self->rl->image_width;
+            int h = s->rects[i].h * self->h / self->rl->image_height;
+            uint16_t* pixels = (uint16_t*)s->pixels;
+            py_pipeline_fill(self, pixels, x, y, x + w, y + t);
+            py_pipeline_fill(self, pixels, x, y + h - t, x + w, y + h);
+            py_pipeline_fill(self, pixels, x, y, x + t, y + h);
+            py_pipeline_fill(self, pixels, x + w - t, y, x + w, y + h);
+        }
+    }
+    taskENTER_CRITICAL();
+    memcpy(self->result, s->rects, s->rect_num * sizeof(yolo2_rect_t));
+    self->result_num = s->rect_num;
+    self->result_seq = slot->seq;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+static int py_pipeline_show(pipeline_t* p, pipeline_slot_t* slot, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    py_pipeline_slot_t* s = (py_pipeline_slot_t*)slot->data;
+
+    lcd->draw_picture_native(self->lcd_x, self->lcd_y, self->w, self->h, s->pixels);
+    return 0;
+}
+
+// after the tasks are gone, also when stopped by soft reset or KPU.deinit()
+static void py_pipeline_stopped(pipeline_t* p, void* arg)
+{
+    py_pipeline_obj_t* self = (py_pipeline_obj_t*)arg;
+    sensor_set_native_order(self->native_order);
+    maix_kpu_set_pipelined(self->kpu, false);
+    if (self->kpu_done)
+        vSemaphoreDelete(self->kpu_done);
+    self->kpu_done = NULL;
+}
+
+static void py_pipeline_free_slots(py_pipeline_obj_t* self)
+{
+    for (int i = 0; i < PIPELINE_MAX_SLOTS; ++i)
+    {
+        py_pipeline_slot_t* s = &self->slots[i];
+        free(s->pixels);
+        free(s->ai_mem);
+        free(s->output);
+        s->pixels = NULL;
+        s->ai_mem = NULL;
+        s->ai = NULL;
+        s->output = NULL;
+    }
+}
+
+static void py_pipeline_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    mp_printf(print, "[CanMV] pipeline: slots:%d, display:%d, cores:(%d,%d,%d,%d), running:%d",
+              self->slot_num, self->display, self->cores[STAGE_CAPTURE], self->cores[STAGE_INFER],
+              self->cores[STAGE_DECODE], self->cores[STAGE_DISPLAY], self->pipe.running && !self->pipe.stop);
+}
+
+STATIC mp_obj_t py_pipeline_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args)
+{
+    enum { ARG_kpu, ARG_slots, ARG_display, ARG_draw, ARG_color, ARG_cores };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_kpu, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_slots, MP_ARG_INT, {.u_int = 3} },
+        { MP_QSTR_display, MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_draw, MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_color, MP_ARG_INT, {.u_int = 0xF800} },
+        { MP_QSTR_cores, MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t vals[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args), allowed_args, vals);
+    PY_ASSERT_TRUE_MSG(vals[ARG_slots].u_int >= 2 && vals[ARG_slots].u_int <= PIPELINE_MAX_SLOTS,
+                       "Error: 2 <= slots <= 6!");
+
+    yolo2_region_layer_t* rl = NULL;
+    kpu_model_context_t* ctx = maix_kpu_get_model(vals[ARG_kpu].u_obj, &rl);
+    PY_ASSERT_TRUE_MSG(ctx != NULL, "kpu must be a KPU with a loaded model");
+    PY_ASSERT_TRUE_MSG(rl != NULL, "call init_yolo2() first");
+
+    py_pipeline_obj_t* self = m_new_obj_with_finaliser(py_pipeline_obj_t);
+    memset(self, 0, sizeof(py_pipeline_obj_t));
+    self->base.type = &py_pipeline_type;
+    self->kpu = vals[ARG_kpu].u_obj;
+    self->ctx = ctx;
+    self->rl = rl;
+    self->slot_num = vals[ARG_slots].u_int;
+    self->display = vals[ARG_display].u_bool;
+    self->draw = vals[ARG_draw].u_bool;
+    self->color = vals[ARG_color].u_int;
+
+    pipeline_t* p = &self->pipe;
+    pipeline_init(p, self->slot_num);
+    pipeline_add_stage(p, stage_names[STAGE_CAPTURE], py_pipeline_capture, NULL, self, false, 0);
+    pipeline_add_stage(p, stage_names[STAGE_INFER], py_pipeline_infer, NULL, self, false, 0);
+    pipeline_add_stage(p, stage_names[STAGE_DECODE], py_pipeline_decode, py_pipeline_publish, self, true, 0);
+    if (self->display)
+        pipeline_add_stage(p, stage_names[STAGE_DISPLAY], py_pipeline_show, NULL, self, false, 0);
+    p->stopped = py_pipeline_stopped;
+    p->stopped_arg = self;
+    for (int i = 0; i < p->slot_num; ++i)
+        p->slots[i].data = &self->slots[i];
+
+    if (vals[ARG_cores].u_obj != mp_const_none)
+    {
+        mp_obj_t* items;
+        size_t len;
+        mp_obj_get_array(vals[ARG_cores].u_obj, &len, &items);
+        PY_ASSERT_TRUE_MSG(len == STAGE_NUM, "cores: one core per stage (capture, infer, decode, display)");
+        for (int i = 0; i < STAGE_NUM; ++i)
+        {
+            int core = mp_obj_get_int(items[i]);
+            // FreeRTOS only runs on core 0, core 1 only takes computation through dual_func
+            int err = (i < p->stage_num) ? pipeline_set_core(p, i, core) : (core == 0 ? 0 : EINVAL);
+            if (err != 0)
+                mp_raise_ValueError(core == 1 ? "only decode can run on core 1" : "core must be 0 or 1");
+            self->cores[i] = core;
+        }
+    }
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC mp_obj_t py_pipeline_stop(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    pipeline_stop(&self->pipe);
+    return mp_const_none;
+}
+
+STATIC mp_obj_t py_pipeline_deinit(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    pipeline_stop(&self->pipe);
+    py_pipeline_free_slots(self);
+    return mp_const_none;
+}
+
+STATIC mp_obj_t py_pipeline_start(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    pipeline_t* p = &self->pipe;
+    yolo2_region_layer_t* rl = NULL;
+
+    if (p->running)
+        mp_raise_OSError(MP_EBUSY);
+    if (maix_kpu_get_model(self->kpu, &rl) != self->ctx || rl != self->rl)
+        mp_raise_msg(&mp_type_OSError, "model was unloaded or init_yolo2() called again");
+    if (sensor.pixformat != PIXFORMAT_RGB565)
+        mp_raise_ValueError("sensor must be RGB565");
+    self->w = MAIN_FB()->u;
+    self->h = MAIN_FB()->v;
+    if (self->w == 0 || self->h == 0)
+        mp_raise_msg(&mp_type_OSError, "sensor not set up");
+
+    uint8_t* output;
+    // the KPU object skips the dequantize layers, a quant output is never made float here
+    self->quant = kpu_get_output_quant(self->ctx, 0, &output, &self->output_size, &self->q) == 0;
+    if (!self->quant && (kpu_get_output(self->ctx, 0, &output, &self->output_size) != 0 || self->output_size == 0))
+        mp_raise_msg(&mp_type_OSError, "can't get model output");
+    if (self->output_size < self->rl->output_number * (self->quant ? 1 : sizeof(float)))
+        mp_raise_ValueError("model output is smaller than init_yolo2() expects");
+
+    if (self->display)
+    {
+        if (!lcd || !lcd->draw_picture_native)
+            mp_raise_ValueError("display needs an MCU lcd, call lcd.init() first");
+        uint16_t lw = lcd->get_width(), lh = lcd->get_height();
+        if (self->w > lw || self->h > lh || (self->w * self->h) % 2)
+            mp_raise_ValueError("frame does not fit the lcd");
+        self->lcd_x = (lw - self->w) / 2;
+        self->lcd_y = (lh - self->h) / 2;
+        if (lcd->wait_idle && lcd->wait_idle() != 0)
+            mp_raise_OSError(MP_ETIMEDOUT);
+        if (self->w != lw || self->h != lh)
+            lcd->clear(BLACK);
+    }
+
+    // everything a frame needs, allocated once
+    py_pipeline_free_slots(self);
+    for (int i = 0; i < self->slot_num; ++i)
+    {
+        py_pipeline_slot_t* s = &self->slots[i];
+        s->ai_mem = malloc(self->w * self->h * 3 + 63);
+        s->output = malloc(self->output_size);
+        if (self->display)
+            s->pixels = malloc(self->w * self->h * 2);
+        if (!s->ai_mem || !s->output || (self->display && !s->pixels))
+        {
+            py_pipeline_free_slots(self);
+            mp_raise_OSError(MP_ENOMEM);
+        }
+        s->ai = (uint8_t*)(((uintptr_t)s->ai_mem + 63) & ~(uintptr_t)63);
+        s->rect_num = 0;
+    }
+    self->kpu_done = xSemaphoreCreateBinary();
+    if (!self->kpu_done)
+    {
+        py_pipeline_free_slots(self);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    self->result_seq = 0;
+    self->result_num = 0;
+
+    self->native_order = sensor.native_order;
+    sensor_set_native_order(1);
+    maix_kpu_set_pipelined(self->kpu, true);
+    int err = pipeline_start(p);
+    if (err != 0)
+    {
+        py_pipeline_stopped(p, self); // may have run already, it does not mind
+        py_pipeline_free_slots(self);
+        mp_raise_OSError(err);
+    }
+    return mp_const_none;
+}
+
+// (seq, [(x, y, w, h, class, prob), ...]) of the newest decoded frame, None before the first one
+STATIC mp_obj_t py_pipeline_result(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    yolo2_rect_t rects[PIPELINE_MAX_RECTS];
+    uint32_t seq, num;
+
+    taskENTER_CRITICAL();
+    seq = self->result_seq;
+    num = self->result_num;
+    memcpy(rects, self->result, num * sizeof(yolo2_rect_t));
+    taskEXIT_CRITICAL();
+    if (seq == 0)
+        return mp_const_none;
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (uint32_t i = 0; i < num; ++i)
+    {
+        mp_obj_list_append(list, mp_obj_new_tuple(6, (mp_obj_t[]){mp_obj_new_int(rects[i].x),
+                                                                  mp_obj_new_int(rects[i].y),
+                                                                  mp_obj_new_int(rects[i].w),
+                                                                  mp_obj_new_int(rects[i].h),
+                                                                  mp_obj_new_int(rects[i].class_id),
+                                                                  mp_obj_new_float(rects[i].prob)}));
+    }
+    return mp_obj_new_tuple(2, (mp_obj_t[]){mp_obj_new_int_from_uint(seq), list});
+}
+
+/* (frames, latency_avg_us, latency_max_us, sensor_dropped, [stage, ...]), where stage is
+   (name, core, frames, dropped, work_avg_us, work_max_us, wait_avg_us,
+    queued, queued_peak, queued_avg, core1_busy), the queue being the input of the stage */
+STATIC mp_obj_t py_pipeline_stats(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    pipeline_t* p = &self->pipe;
+    sensor_frame_info_t info = {0};
+    sensor_get_frame_info(&info);
+
+    mp_obj_t stages = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < p->stage_num; ++i)
+    {
+        pipeline_stage_stats_t st;
+        pipeline_queue_stats_t qs;
+        pipeline_get_stats(p, i, &st, &qs);
+        uint32_t runs = st.frames + st.dropped;
+        mp_obj_list_append(stages, mp_obj_new_tuple(11, (mp_obj_t[]){
+            mp_obj_new_str(p->stages[i].name, strlen(p->stages[i].name)),
+            mp_obj_new_int(p->stages[i].core),
+            mp_obj_new_int_from_uint(st.frames),
+            mp_obj_new_int_from_uint(st.dropped),
+            mp_obj_new_int_from_uint(runs ? st.work_us / runs : 0),
+            mp_obj_new_int_from_uint(st.max_us),
+            mp_obj_new_int_from_uint(runs ? st.wait_us / runs : 0),
+            mp_obj_new_int_from_uint(pipeline_queued(p, i)),
+            mp_obj_new_int_from_uint(qs.peak),
+            mp_obj_new_float(qs.puts ? (float)qs.sum / qs.puts : 0.0f),
+            mp_obj_new_int_from_uint(st.core1_busy)}));
+    }
+    taskENTER_CRITICAL();
+    uint32_t num = p->latency_num;
+    uint64_t sum = p->latency_sum;
+    uint32_t max = p->latency_max;
+    taskEXIT_CRITICAL();
+    return mp_obj_new_tuple(5, (mp_obj_t[]){mp_obj_new_int_from_uint(num),
+                                            mp_obj_new_int_from_uint(num ? sum / num : 0),
+                                            mp_obj_new_int_from_uint(max),
+                                            mp_obj_new_int_from_uint(info.dropped),
+                                            stages});
+}
+
+STATIC mp_obj_t py_pipeline_reset_stats(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    pipeline_reset_stats(&self->pipe);
+    return mp_const_none;
+}
+
+// False once stopped, or a stage failed (the sensor was reconfigured, the KPU hung)
+STATIC mp_obj_t py_pipeline_running(mp_obj_t self_in)
+{
+    py_pipeline_obj_t *self = (py_pipeline_obj_t*)self_in;
+    return mp_obj_new_bool(self->pipe.running && !self->pipe.stop);
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_start_obj, py_pipeline_start);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_stop_obj, py_pipeline_stop);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_result_obj, py_pipeline_result);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_stats_obj, py_pipeline_stats);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_reset_stats_obj, py_pipeline_reset_stats);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_running_obj, py_pipeline_running);
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(py_pipeline_deinit_obj, py_pipeline_deinit);
+
+static const mp_rom_map_elem_t py_pipeline_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___del__),     MP_ROM_PTR(&py_pipeline_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_deinit),      MP_ROM_PTR(&py_pipeline_deinit_obj) },
+    { MP_ROM_QSTR(MP_QSTR_start),       MP_ROM_PTR(&py_pipeline_start_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stop),        MP_ROM_PTR(&py_pipeline_stop_obj) },
+    { MP_ROM_QSTR(MP_QSTR_result),      MP_ROM_PTR(&py_pipeline_result_obj) },
+    { MP_ROM_QSTR(MP_QSTR_stats),       MP_ROM_PTR(&py_pipeline_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reset_stats), MP_ROM_PTR(&py_pipeline_reset_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_running),     MP_ROM_PTR(&py_pipeline_running_obj) },
+};
+
+MP_DEFINE_CONST_DICT(py_pipeline_locals_dict, py_pipeline_locals_dict_table);
+
+const mp_obj_type_t py_pipeline_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Pipeline,
+    .print = py_pipeline_print,
+    .make_new = py_pipeline_make_new,
+    .locals_dict = (mp_obj_dict_t*)&py_pipeline_locals_dict,
+};
+
+static const mp_rom_map_elem_t pipeline_module_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_pipeline) },
+    { MP_ROM_QSTR(MP_QSTR_Pipeline), MP_ROM_PTR(&py_pipeline_type) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(pipeline_module_globals, pipeline_module_globals_table);
+
+const mp_obj_module_t pipeline_module = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&pipeline_module_globals,
+};
@@ -39,98 +39,6 @@ int64_t avr_mdl[mfcc_num];
 
 int64_t standard_in[mfcc_num];
 int64_t standard_mdl[mfcc_num];
-int dtw_data[vv_frm_max*vv_frm_max];
-
-struct pointOritation//节点方向，用来回溯每个W点
-{
-	int frontI, frontJ;
-};
-int g[vv_frm_max][vv_frm_max];
-struct pointOritation pOritation[vv_frm_max][vv_frm_max];//用来存放
-
-void gArray(int *p, int n, int m, int *g, struct pointOritation *pr)
-{
-	int i = 0, j = 0;
-
-	*g = (*p) * 2;//起始点（最左上角的点）
-	for (i = 1; i < m; i++) {//最上面一横
-		*(g + i) =  *(g + i - 1) + *(p + i);
-		(pr + i)->frontI = 0;
-		(pr + i)->frontJ = i - 1;
-	}
-
-	for (i = 1; i < n; i++) {//最左边的一竖
-		*(g+i*m+0) =  *(g+(i-1)*m+0)+(*(p+i*m+0));
-		(pr+i*m+0)->frontI = i-1;
-		(pr+i*m+0)->frontJ = 0;
-	}
-
-    //计算剩余网格的G值
-	for (i = 1; i < n; i++) {
-		for (j = 1; j < m; j++) {
-			int left, up, incline;
-
-			left = *(g + i*m+j-1) + *(p + i * m + j);
-			up = *(g + (i - 1) * m + j) + *(p + i * m + j);
-			incline = *(g + (i - 1) * m + j - 1) + (*(p + i * m + j)) * 2;
-
-	    //从左、上、斜三个方向选出最小的
-			int min = left;
-
-			*(g + i * m + j) = min;
-			(pr + i * m + j)->frontI = i;
-			(pr + i * m + j)->frontJ = j - 1;
-
-			if (min > up) {
-				min = up;
-				*(g + i * m + j) = min;
-				(pr + i * m + j)->frontI = i - 1;
-				(pr + i * m + j)->frontJ = j;
-			}
-			if (min > incline) {
-				min = incline;
-				*(g + i * m + j) = min;
-				(pr + i * m + j)->frontI = i - 1;
-				(pr + i * m + j)->frontJ = j - 1;
-			}
-		}
-	}
-#if 0
-    //输出G数组
-	for (i = 0; i < n; i++) {
-		for (j = 0; j < m; j++)
-			printf("%d, ", *(g+i*m+j));
-		printf("\n");
-	}
-	//输出方向数组
-	for (i = 0; i < n; i++) {
-		for (j = 0; j < m; j++)
-			printf("(%d,%d), ", (pr+i*m+j)->frontI, (pr+i*m+j)->frontJ);
-		printf("\n");
-	}
-   #endif
-}
-int printPath(struct pointOritation *po, int n, int m, int *g)
-{
-    //从最后一个点向前输出路径节点
-	int i = n-1, j = m - 1;
-	int step = 0;
-
-	while (1) {
-		int ii = (po + i * m + j)->frontI, jj = (po + i * m + j)->frontJ;
-
-		if (i == 0 && j == 0)
-			break;
- //       printf("(%d,%d):%d\n",i,j,*(g+i*m+j));
-		i = ii;
-		j = jj;
-		step++;
-	}
- //   printf("distance1 = %d\n", *(g+(n-1)*m + m -1) / step);
-	return step;
-	//printf("distance = %d\n", *(g+(n-1)*m + m -1) / step);
-}
-
 /*
  *	获取两个特征矢量之间的距离
 	参数
@@ -248,92 +156,241 @@ uint8_t dtw_limit(uint16_t x, uint16_t y)
 }
 
 /*
- *	DTW 动态时间规整
-	参数
-	ftr_in	:输入特征值
-	ftr_mdl	:特征模版
-	返回值
-	dis		:累计匹配距离
+ *	Sakoe-Chiba 带状 DTW
+	只计算第 i 行中心 i*(m-1)/(n-1) 两侧 dtw_band 帧以内的格点，只保留两行累计距离和步数。
+	局部路径与原全矩阵算法相同：左、上、斜(距离加倍)，相等时依次优先左、上、斜，
+	带宽覆盖全矩阵时结果与原算法一致。
 */
+#define dtw_band_pct	25		// 带宽，较长序列帧数的百分比
+#define dtw_band_min	4		// 最小带宽 帧
+#define dtw_inf			0xFFFFFFFF
 
-uint32_t dtw(v_ftr_tag *ftr_in, v_ftr_tag *frt_mdl)
+static uint32_t dtw_g[2][vv_frm_max];		// 累计距离
+static uint16_t dtw_step[2][vv_frm_max];	// 累计距离对应路径的步数
+static uint32_t dtw_lb[vv_frm_max + 1];		// LB_Keogh 行下界的后缀和
+static float	dtw_unit_in[vv_frm_max * mfcc_num];
+static float	dtw_unit_mdl[vv_frm_max * mfcc_num];
+
+static int dtw_radius(int n, int m)
 {
-	uint32_t dis;
-//	uint16_t x, y;
-	uint16_t step;
-	int16_t *in;
-	int16_t *mdl;
-//	uint32_t d_right_up, right, right_up; //up,
-//	uint32_t min;
-	int i, j;
+	int r = ((n > m) ? n : m) * dtw_band_pct / 100;
+	// 不小于斜率，保证相邻两行的带相连
+	if (n > 1 && r < (m + n - 3) / (n - 1))
+		r = (m + n - 3) / (n - 1);
+	return (r < dtw_band_min) ? dtw_band_min : r;
+}
 
-	in_frm_num = ftr_in->frm_num;
-	mdl_frm_num = frt_mdl->frm_num;
+static void dtw_band(int i, int n, int m, int r, int *lo, int *hi)
+{
+	int c = (n > 1) ? (i * (m - 1) + (n - 1) / 2) / (n - 1) : 0;
 
-	if ((in_frm_num > (mdl_frm_num*3)) || ((3*in_frm_num) < mdl_frm_num)) {
-		//USART1_printf("in_frm_num=%d mdl_frm_num=%d\r\n", in_frm_num,mdl_frm_num);
-		return dis_err;
-	} else {
-		// 计算约束平行四边形顶点值
-		X1 = (2*mdl_frm_num-in_frm_num)/3;
-		X2 = (4*in_frm_num-2*mdl_frm_num)/3;
-		in = ftr_in->mfcc_dat;
-		mdl = frt_mdl->mfcc_dat;
-#if 0
-		for (j = 0; j < mfcc_num; j++) {
-			avr_in[j] = 0;
-			avr_mdl[j] = 0;
-		}
+	*lo = (c - r < 0) ? 0 : c - r;
+	*hi = (n == 1 || c + r > m - 1) ? m - 1 : c + r;
+}
 
-		for (j = 0; j < mfcc_num; j++)
-			for (i = 0; i < in_frm_num; i++)
-				avr_in[j] += in[mfcc_num * i + j];
-		for (j = 0; j < mfcc_num; j++)
-			avr_in[j] = avr_in[j] / in_frm_num;
-//
-		for (j = 0; j < mfcc_num; j++)
-			for (i = 0; i < mdl_frm_num; i++)
-				avr_mdl[j] += mdl[mfcc_num * i + j];
-		for (j = 0; j < mfcc_num; j++)
-			avr_mdl[j] = avr_mdl[j] / mdl_frm_num;
-
-		dis = get_dis(in, mdl);
-		x = 1;
-		y = 1;
-		step = 1;
-#endif
-#if 0
-		for (i = 0; i < in_frm_num; i++) {
-			for (j = 0; j < mdl_frm_num; j++) {
-				printf("%d,", get_dis(mdl, in));
-				mdl += mfcc_num;
+/*
+ *	帧矢量归一化为单位矢量
+	get_dis 为 1000-1000*cos，对单位矢量即 500*|a-b|^2，可用包络求下界
+	返回值
+	0 含全零帧，无法求下界
+*/
+static int dtw_unit(const int16_t *frm, int num, float *out)
+{
+	int ok = 1;
+
+	for (int i = 0; i < num; i++, frm += mfcc_num, out += mfcc_num) {
+		float s = 0;
+		for (int k = 0; k < mfcc_num; k++)
+			s += (float)frm[k] * frm[k];
+		if (s <= 0)
+			ok = 0;
+		s = (s > 0) ? 1.0f / sqrtf(s) : 0;
+		for (int k = 0; k < mfcc_num; k++)
+			out[k] = frm[k] * s;
+	}
+	return ok;
+}
+
+/*
+ *	LB_Keogh 下界
+	每条路径至少经过每一行的一个格点，第 i 行的代价不小于该行矢量到带内列矢量包络的距离。
+	dtw_lb[i] 为第 i 行及以后各行下界之和，返回总下界
+*/
+static uint32_t dtw_lb_keogh(const float *row, int n, const float *col, int m)
+{
+	int r = dtw_radius(n, m);
+
+	dtw_lb[n] = 0;
+	for (int i = n - 1; i >= 0; i--) {
+		int lo, hi;
+		float e = 0;
+
+		dtw_band(i, n, m, r, &lo, &hi);
+		for (int k = 0; k < mfcc_num; k++) {
+			float v = row[i * mfcc_num + k];
+			float u = col[lo * mfcc_num + k], l = u;
+			for (int j = lo + 1; j <= hi; j++) {
+				float c = col[j * mfcc_num + k];
+				if (c > u)
+					u = c;
+				else if (c < l)
+					l = c;
 			}
-			mdl = frt_mdl->mfcc_dat;
-			in += mfcc_num;
-			printf("\n");
+			if (v > u)
+				e += (v - u) * (v - u);
+			else if (v < l)
+				e += (l - v) * (l - v);
 		}
-		in = ftr_in->mfcc_dat;
-		mdl = frt_mdl->mfcc_dat;
-#endif
-		for (i = 0; i < in_frm_num; i++) {
-			for (j = 0; j < mdl_frm_num; j++) {
-				//dtw_data[i][j] = get_dis(in + (i * mfcc_num), mdl + (j * mfcc_num));
-				//dtw_data[i][j] = get_dis(in, mdl);
-				*(dtw_data+i*mdl_frm_num+j) = get_dis(in, mdl);
-			//	printf("%d,", dtw_data[i*mdl_frm_num+j]);
-				mdl += mfcc_num;
+		e = e * 500 - 2;	// get_dis 取整及浮点误差
+		dtw_lb[i] = dtw_lb[i + 1] + ((e > 0) ? (uint32_t)e : 0);
+	}
+	return dtw_lb[0];
+}
+
+/*
+ *	带早停的 DTW
+	参数
+	ftr_in	:输入特征值(行)
+	ftr_mdl	:特征模版(列)
+	best	:当前最优距离，确定不会小于它时提前返回 dis_err
+	use_lb	:dtw_lb 已由 dtw_lb_keogh 按同样的两个序列算好
+	返回值
+	dis		:步长归一化的累计匹配距离
+*/
+static uint32_t dtw_bounded(v_ftr_tag *ftr_in, v_ftr_tag *frt_mdl, uint32_t best, int use_lb)
+{
+	int n = ftr_in->frm_num, m = frt_mdl->frm_num;
+	int r, lo, hi, plo = 0, phi = -1;
+	int16_t *in, *mdl = frt_mdl->mfcc_dat;
+	uint32_t *prev = dtw_g[0], *cur = dtw_g[1];
+	uint16_t *prev_s = dtw_step[0], *cur_s = dtw_step[1];
+	uint32_t max_step = n + m - 2;
+
+	if ((n > (m*3)) || ((3*n) < m) || n == 0)
+		return dis_err;
+
+	r = dtw_radius(n, m);
+	for (int i = 0; i < n; i++) {
+		uint32_t row_min = dtw_inf;
+
+		in = ftr_in->mfcc_dat + i * mfcc_num;
+		dtw_band(i, n, m, r, &lo, &hi);
+		for (int j = 0; j < m; j++)
+			cur[j] = dtw_inf;
+		for (int j = lo; j <= hi; j++) {
+			uint32_t d = get_dis(in, mdl + j * mfcc_num);
+			uint32_t min = dtw_inf, v;
+			uint16_t step = 0;
+
+			if (i == 0 && j == 0) {
+				min = d * 2;	// 起始点
+			} else {
+				if (j > lo && cur[j - 1] != dtw_inf) {	// 左
+					min = cur[j - 1] + d;
+					step = cur_s[j - 1] + 1;
+				}
+				if (j >= plo && j <= phi && prev[j] != dtw_inf) {	// 上
+					v = prev[j] + d;
+					if (v < min) {
+						min = v;
+						step = prev_s[j] + 1;
+					}
+				}
+				if (j > plo && j - 1 <= phi && prev[j - 1] != dtw_inf) {	// 斜
+					v = prev[j - 1] + d * 2;
+					if (v < min) {
+						min = v;
+						step = prev_s[j - 1] + 1;
+					}
+				}
 			}
-			//printf("\n");
-			mdl = frt_mdl->mfcc_dat;
-			in += mfcc_num;
+			cur[j] = min;
+			cur_s[j] = step;
+			if (min < row_min)
+				row_min = min;
 		}
-		gArray(dtw_data, in_frm_num, mdl_frm_num, *g, *pOritation);
-		step = printPath(*pOritation, in_frm_num, mdl_frm_num, *g);
-		//printf("step=%d\r\n",step);
-		dis = *((int *)g+(in_frm_num-1)*mdl_frm_num + mdl_frm_num - 1);
-//		printf("dis=%d step=%d dis/step=%d\r\n",dis,step,dis/step);
+		// 剩余各行只会增加距离，路径步数不超过 n+m-2
+		if (best != dis_max && row_min != dtw_inf && max_step
+			&& (row_min + (use_lb ? dtw_lb[i + 1] : 0)) / max_step >= best)
+			return dis_err;
+		if (row_min == dtw_inf)
+			return dis_err;
+		plo = lo;
+		phi = hi;
+		uint32_t *t = prev; prev = cur; cur = t;
+		uint16_t *ts = prev_s; prev_s = cur_s; cur_s = ts;
+	}
+	if (prev[m - 1] == dtw_inf)
+		return dis_err;
+	return prev_s[m - 1] ? prev[m - 1] / prev_s[m - 1] : prev[m - 1];	//步长归一化
+}
+
+/*
+ *	DTW 动态时间规整
+	参数
+	ftr_in	:输入特征值
+	ftr_mdl	:特征模版
+	返回值
+	dis		:累计匹配距离
+*/
+uint32_t dtw(v_ftr_tag *ftr_in, v_ftr_tag *frt_mdl)
+{
+	return dtw_bounded(ftr_in, frt_mdl, dis_max, 0);
+}
+
+/*
+ *	批量匹配
+	先算出每个模板的 LB_Keogh 下界，按下界从小到大做带早停的 DTW，
+	下界已不小于当前最优时其余模板全部跳过。
+	参数
+	mdls	:模板数组，只比较 save_sign == sign 的模板，模板为 dtw 的第一个参数
+	count	:模板个数
+	ftr_in	:待识别特征
+	min_dis	:输出最优距离
+	返回值
+	最优模板下标，无可比较模板时为 -1
+*/
+int dtw_match(v_ftr_tag *mdls, uint16_t count, uint16_t sign, v_ftr_tag *ftr_in, uint32_t *min_dis)
+{
+	uint32_t *lbs = (uint32_t *)malloc(count * sizeof(uint32_t));
+	int in_ok = dtw_unit(ftr_in->mfcc_dat, ftr_in->frm_num, dtw_unit_in);
+	int best = -1;
+
+	*min_dis = dis_max;
+	if (lbs == NULL)
+		return -1;
+	for (int k = 0; k < count; k++) {
+		v_ftr_tag *mdl = &mdls[k];
+		lbs[k] = dtw_inf;	// 跳过
+		if (mdl->save_sign != sign || mdl->frm_num == 0 || ftr_in->frm_num == 0)
+			continue;
+		if (in_ok && dtw_unit(mdl->mfcc_dat, mdl->frm_num, dtw_unit_mdl))
+			lbs[k] = dtw_lb_keogh(dtw_unit_mdl, mdl->frm_num, dtw_unit_in, ftr_in->frm_num)
+				/ (mdl->frm_num + ftr_in->frm_num - 2 ? mdl->frm_num + ftr_in->frm_num - 2 : 1);
+		else
+			lbs[k] = 0;
+	}
+	while (1) {
+		int k = -1;
+		for (int i = 0; i < count; i++)
+			if (lbs[i] != dtw_inf && (k < 0 || lbs[i] < lbs[k]))
+				k = i;
+		if (k < 0 || (best >= 0 && lbs[k] >= *min_dis))
+			break;
+		v_ftr_tag *mdl = &mdls[k];
+		// dtw_lb 中是上一个算过的模板的后缀和，重新计算
+		int use_lb = in_ok && dtw_unit(mdl->mfcc_dat, mdl->frm_num, dtw_unit_mdl);
+		if (use_lb)
+			dtw_lb_keogh(dtw_unit_mdl, mdl->frm_num, dtw_unit_in, ftr_in->frm_num);
+		uint32_t dis = dtw_bounded(mdl, ftr_in, *min_dis, use_lb);
+		if (dis != dis_err && dis < *min_dis) {
+			*min_dis = dis;
+			best = k;
 		}
-	return (dis/step); //步长归一化
+		lbs[k] = dtw_inf;
+	}
+	free(lbs);
+	return best;
 }
 
 
@@ -18,11 +18,9 @@
 void cr4_fft_1024_stm32(void *pssOUT, void *pssIN, uint16_t Nbin);
 void normalize(int16_t *mfcc_p, uint16_t frm_num);
 
-uint32_t fft_out[mfcc_fft_point];
-int16_t fft_in[mfcc_fft_point];
-
 #define FFT_N 512
 uint64_t fft_out_data[FFT_N / 2];
+static fft_data_t fft_in_buf[FFT_N / 2];	// FRAME_LEN 之后的部分始终为 0
 extern void fft_dma_init(void);
 extern volatile fft_t *const fft;
 
@@ -77,50 +75,178 @@ void fft_sync_data(int16_t *data, uint8_t point, fft_data_t *fft_data)
 
 
 /*
- *  cr4_fft_1024_stm32输入参数是有符号数
- *
- *  cr4_fft_1024_stm32输入参数包括实数和虚数
-    但语音数据只包括实数部分 虚数用0填充
-    fft点数超出输入数据长度时 超过部分用0填充
-
-    cr4_fft_1024_stm32输出数据包括实数和虚数
-    应该取其绝对值 即平方和的根
+ *  能量谱
+    语音数据只有实数部分 虚部用0填充 超过 FRAME_LEN 的部分用0填充
+    原来先取模 sqrtf(re*re+im*im)*10 再平方，这里直接用 (re*re+im*im)*100
+    省去每个频点一次浮点开方，结果相同(只差开方取整)
  */
-
-uint32_t *mfcc_fft(int16_t *dat_buf, uint16_t buf_len)
+static void mfcc_pow_spct(const int16_t *dat_buf, uint32_t *frq_spct)
 {
     uint16_t i;
     int32_t real, imag;
     fft_data_t output_data;
 
-    if (buf_len > mfcc_fft_point)
-        return (void *)0;
-
-    for (i = 0; i < buf_len; i++) {
-        fft_in[i] =  *(dat_buf+i);//虚部高位 实部低位
+    for (i = 0; i < FRAME_LEN / 2; i++) {
+        fft_in_buf[i].R1 = dat_buf[2 * i];
+        fft_in_buf[i].R2 = dat_buf[2 * i + 1];
     }
-    for (; i < mfcc_fft_point; i++)
-        fft_in[i] = 0;//超出部分用0填充
-
-    fft_data_t fft_in_buf[512];
-    memset(fft_in_buf, 0 , sizeof(fft_in_buf));
-    fft_sync_data(fft_in, FFT_512, fft_in_buf);
-    fft_complex_uint16_dma(DMAC_CHANNEL3, DMAC_CHANNEL4, 0x1ff, FFT_DIR_FORWARD, (uint64_t *)fft_in_buf, 512, fft_out_data);
+    fft_complex_uint16_dma(DMAC_CHANNEL3, DMAC_CHANNEL4, 0x1ff, FFT_DIR_FORWARD, (uint64_t *)fft_in_buf, FFT_N, fft_out_data);
 
     for (i = 0; i < frq_max / 2; i++) {
         output_data = *(fft_data_t *)&fft_out_data[i];
         imag = (int16_t)output_data.I1;
         real = (int16_t)output_data.R1;
-        real = real*real+imag*imag;
-        fft_out[2 * i] = sqrtf((float)real)*10;
+        frq_spct[2 * i] = (uint32_t)(real*real+imag*imag)*100;
 
         imag = (int16_t)output_data.I2;
         real = (int16_t)output_data.R2;
+        frq_spct[2 * i + 1] = (uint32_t)(real*real+imag*imag)*100;
+    }
+}
+
+/*
+ *  稀疏 Mel 矩阵
+    每个三角滤波器只记录权值非零的频点区间和所用的折线(奇/偶)
+ */
+typedef struct {
+    uint16_t lo;
+    uint16_t hi;
+    const uint16_t *w;
+} mel_band_tag;
+
+static mel_band_tag mel_band[tri_num];
+static uint8_t mel_band_ok = 0;
+
+static void mel_band_set(uint16_t h, uint16_t lo, uint16_t hi, const uint16_t *w)
+{
+    while (lo < hi && w[lo] == 0)
+        lo++;
+    while (hi > lo && w[hi - 1] == 0)
+        hi--;
+    mel_band[h].lo = lo;
+    mel_band[h].hi = hi;
+    mel_band[h].w = w;
+}
+
+static void mel_band_init(void)
+{
+    uint16_t h;
+
+    mel_band_set(0, 0, tri_cen[1], tri_even);
+    for (h = 2; h < tri_num; h += 2)
+        mel_band_set(h, tri_cen[h-1], tri_cen[h+1], tri_even);
+    for (h = 1; h < (tri_num-2); h += 2)
+        mel_band_set(h, tri_cen[h-1], tri_cen[h+1], tri_odd);
+    mel_band_set(tri_num-1, tri_cen[tri_num-2], mfcc_fft_point/2, tri_odd);
+    mel_band_ok = 1;
+}
 
-        real = real*real+imag*imag;
-        fft_out[2 * i + 1] = sqrtf((float)real)*10;
+/*
+ *  计算一帧的 MFCC
+    vc_dat  :帧起点，FRAME_LEN 个采样
+    prev    :帧起点前一个采样 用于预加重
+    mid     :零值
+    mfcc_p  :输出 mfcc_num 个系数(未归一化)
+ */
+static void mfcc_frame(const uint16_t *vc_dat, int32_t prev, int32_t mid, int16_t *mfcc_p)
+{
+    uint16_t h, i;
+    int16_t vc_temp[FRAME_LEN]; //语音暂存区
+    uint32_t frq_spct[frq_max];  //能量谱
+    uint32_t pow_spct[tri_num];  //三角滤波器输出对数功率谱
+    const int8_t *dct_p;
+    int32_t temp;
+
+    for (i = 0; i < FRAME_LEN; i++) {
+        //预加重
+        temp = ((int32_t)vc_dat[i]-mid) - hp_ratio((prev-mid));
+        prev = vc_dat[i];
+        //加汉明窗 并放大10倍
+        vc_temp[i] = (int16_t)(temp*hamm[i]/(hamm_top/10));
+    }
+
+    mfcc_pow_spct(vc_temp, frq_spct);
+
+    //加三角滤波器
+    for (h = 0; h < tri_num; h++) {
+        const mel_band_tag *band = &mel_band[h];
+        pow_spct[h] = 0;
+        for (i = band->lo; i < band->hi; i++)
+            pow_spct[h] += (frq_spct[i]*band->w[i]/(tri_top/10));
+    }
+
+    //三角滤波器输出取对数
+    for (h = 0; h < tri_num; h++)
+        pow_spct[h] = (uint32_t)(log(pow_spct[h])*100);//取对数后 乘100 提升数据有效位数
+
+    //反离散余弦变换
+    dct_p = dct_arg;
+    for (h = 0; h < mfcc_num; h++) {
+        mfcc_p[h] = 0;
+        for (i = 0; i < tri_num; i++)
+            mfcc_p[h] += (((int32_t)pow_spct[i])*((int32_t)dct_p[i])/100);
+        dct_p += tri_num;
     }
-    return fft_out;
+}
+
+/*
+ *  流式 MFCC
+    VAD 每收下一帧就算出这一帧的 MFCC，语音结束时只剩归一化，
+    不用等整段语音结束后再对每帧做 FFT。
+    帧 k 起始于 vc+k*(FRAME_LEN-frame_mov)，与 get_mfcc 的分帧相同
+ */
+void mfcc_stream_reset(mfcc_stream_tag *stream, v_ftr_tag *v_ftr, atap_tag *atap_arg)
+{
+    if (!mel_band_ok)
+        mel_band_init();
+    stream->ftr = v_ftr;
+    stream->mid = (int32_t)atap_arg->mid_val;
+    stream->frm_num = 0;
+    v_ftr->frm_num = 0;
+}
+
+static void mfcc_stream_run(mfcc_stream_tag *stream, const uint16_t *vc, uint16_t frm_num)
+{
+    if (frm_num > vv_frm_max)    // 超长的语音段最终会被丢弃，不再计算
+        frm_num = vv_frm_max;
+    while (stream->frm_num < frm_num) {
+        const uint16_t *vc_dat = vc + stream->frm_num*(FRAME_LEN-frame_mov);
+        int32_t prev = stream->frm_num ? vc_dat[-1] : stream->mid;
+        mfcc_frame(vc_dat, prev, stream->mid, stream->ftr->mfcc_dat + stream->frm_num*mfcc_num);
+        stream->frm_num++;
+    }
+}
+
+/*
+ *  vc      :VAD 收集的语音 帧数为 frm_num
+    帧数比上次少说明 VAD 丢弃了之前的语音段，重新开始
+ */
+void mfcc_stream_update(mfcc_stream_tag *stream, const uint16_t *vc, uint16_t frm_num)
+{
+    if (frm_num < stream->frm_num)
+        stream->frm_num = 0;
+    mfcc_stream_run(stream, vc, frm_num);
+}
+
+/*
+ *  语音段结束，补算尚未算出的帧并归一化
+    返回值 帧数，语音段过长时为 0
+ */
+uint16_t mfcc_stream_finish(mfcc_stream_tag *stream, valid_tag *valid)
+{
+    v_ftr_tag *v_ftr = stream->ftr;
+    uint16_t v_frm_num;
+
+    v_frm_num = (((uint32_t)(valid->end)-(uint32_t)(valid->start))/2-FRAME_LEN)/(FRAME_LEN-frame_mov)+1;
+    if (v_frm_num > vv_frm_max) {
+        v_ftr->frm_num = 0;
+    } else {
+        mfcc_stream_run(stream, valid->start, v_frm_num);
+        normalize(v_ftr->mfcc_dat, v_frm_num);
+        v_ftr->frm_num = v_frm_num;
+    }
+    stream->frm_num = 0;
+    return v_ftr->frm_num;
 }
 
 /*  MFCC：Mel频率倒谱系数
@@ -145,95 +271,10 @@ uint32_t *mfcc_fft(int16_t *dat_buf, uint16_t buf_len)
 
 void get_mfcc(valid_tag *valid, v_ftr_tag *v_ftr, atap_tag *atap_arg)
 {
-    uint16_t *vc_dat;
-    uint16_t h, i;
-    uint32_t *frq_spct;          //频谱
-    int16_t vc_temp[FRAME_LEN]; //语音暂存区
-    int32_t temp;
+    mfcc_stream_tag stream;
 
-    uint32_t pow_spct[tri_num];  //三角滤波器输出对数功率谱
-    uint16_t frm_con;
-    int16_t *mfcc_p;
-    int8_t  *dct_p;
-    int32_t mid;
-    uint16_t v_frm_num;
-
-    //USART1_printf("start=%d end=%d",(uint32_t)(valid->start),(uint32_t)(valid->end));
-    v_frm_num = (((uint32_t)(valid->end)-(uint32_t)(valid->start))/2-FRAME_LEN)/(FRAME_LEN-frame_mov)+1;
-    if (v_frm_num > vv_frm_max) {
-        // printf("frm_num=%d ", v_frm_num);
-        v_ftr->frm_num = 0;
-    } else {
-        mid = (int32_t)atap_arg->mid_val;
-        mfcc_p = v_ftr->mfcc_dat;
-        frm_con = 0;
-        //low pass filter
-    //  for (vc_dat = (uint16_t *)(valid->start); vc_dat <= ((uint16_t *)(valid->end-FRAME_LEN)); vc_dat += 1) {
-    //      *vc_dat = (uint16_t)(Fir(*vc_dat));
-
-    //  }
-        for (vc_dat = (uint16_t *)(valid->start); vc_dat <= ((uint16_t *)(valid->end-FRAME_LEN)); vc_dat += (FRAME_LEN-frame_mov)) {
-            for (i = 0; i < FRAME_LEN; i++) {
-                //预加重
-            //  printf("vc_dat[%d]=%d ",i,((int32_t)(*(vc_dat+i))-mid));
-                temp = ((int32_t)(*(vc_dat+i))-mid) - hp_ratio(((int32_t)(*(vc_dat+i-1))-mid));
-            //  printf("vc_hp[%d]=%d ",i,temp);
-                //加汉明窗 并放大10倍
-                vc_temp[i] = (int16_t)(temp*hamm[i]/(hamm_top/10));
-            //  printf("vc_hm[%d]=%d\r\n",i,vc_temp[i]);
-            }
-
-            frq_spct = mfcc_fft(vc_temp, FRAME_LEN);
-
-            for (i = 0; i < frq_max; i++) {
-                //printf("frq_spct[%d]=%d ",i,frq_spct[i]);
-                frq_spct[i] *= frq_spct[i];//能量谱
-                //printf("E_spct[%d]=%d\r\n",i,frq_spct[i]);
-            }
-
-            //加三角滤波器
-            pow_spct[0] = 0;
-            for (i = 0; i < tri_cen[1]; i++)
-                pow_spct[0] += (frq_spct[i]*tri_even[i]/(tri_top/10));
-            for (h = 2; h < tri_num; h += 2) {
-                pow_spct[h] = 0;
-                for (i = tri_cen[h-1]; i < tri_cen[h+1]; i++)
-                    pow_spct[h] += (frq_spct[i]*tri_even[i]/(tri_top/10));
-            }
-
-            for (h = 1; h < (tri_num-2); h += 2) {
-                pow_spct[h] = 0;
-                for (i = tri_cen[h-1]; i < tri_cen[h+1]; i++)
-                    pow_spct[h] += (frq_spct[i]*tri_odd[i]/(tri_top/10));
-            }
-            pow_spct[tri_num-1] = 0;
-            for (i = tri_cen[tri_num-2]; i < (mfcc_fft_point/2); i++)
-                pow_spct[tri_num-1] += (frq_spct[i]*tri_odd[i]/(tri_top/10));
-
-            //三角滤波器输出取对数
-            for (h = 0; h < tri_num; h++) {
-                //USART1_printf("pow_spct[%d]=%d ",h,pow_spct[h]);
-                pow_spct[h] = (uint32_t)(log(pow_spct[h])*100);//取对数后 乘100 提升数据有效位数
-                //USART1_printf("%d\r\n",pow_spct[h]);
-            }
-
-            //反离散余弦变换
-            dct_p = (int8_t *)dct_arg;
-            for (h = 0; h < mfcc_num; h++) {
-                mfcc_p[h] = 0;
-                for (i = 0; i < tri_num; i++)
-                    mfcc_p[h] += (((int32_t)pow_spct[i])*((int32_t)dct_p[i])/100);
-                //printf("%d,",mfcc_p[h]);
-                dct_p += tri_num;
-            }
-            //USART1_printf("\r\n");
-            mfcc_p += mfcc_num;
-            frm_con++;
-        }
-        mfcc_p = v_ftr->mfcc_dat;
-        normalize(mfcc_p, frm_con);
-        v_ftr->frm_num = frm_con;
-    }
+    mfcc_stream_reset(&stream, v_ftr, atap_arg);
+    mfcc_stream_finish(&stream, valid);
 }
 
 int16_t avg(int16_t *mfcc_p, uint16_t frm_num)
@@ -184,10 +184,22 @@ void VAD(const uint16_t *vc, uint16_t buf_len, valid_tag *valid_voice, atap_tag
 	}
 }
 
+static uint8_t	cur_stus;	// VAD2 当前语音段状态 0无声段  1前端过渡段  2语音段  3后端过渡段
+
+/*
+ *	VAD2 当前语音段已收集的帧数
+	dat	:输出语音段起点，帧 k 起始于 dat+k*(FRAME_LEN-frame_mov)
+	每收下一帧即可对它做 MFCC，不必等语音段结束
+*/
+uint16_t VAD2_frames(const uint16_t **dat)
+{
+	*dat = vad_data;
+	return cur_stus ? frm_n + 1 : 0;
+}
+
 uint8_t VAD2(const uint16_t *vc, valid_tag *valid_voice, atap_tag *atap_arg)
 {
 	uint8_t	last_sig = 0;	// 上次跃出门限带的状态 1:门限带以下；2:门限带以上
-	static uint8_t	cur_stus;	// 当前语音段状态 0无声段  1前端过渡段  2语音段  3后端过渡段
 	static uint16_t front_duration;//前端过渡段超过门限值持续帧数
 	static uint16_t back_duration;//后端过渡段低于门限值持续帧数
 	static uint8_t word_num_tmp;
@@ -11,6 +11,8 @@ extern "C" {
 
 
 uint32_t dtw(v_ftr_tag *ftr_in, v_ftr_tag *frt_mdl);
+// 在 count 个模板中找与 ftr_in 距离最小的 (save_sign == sign)，返回下标，没有则返回 -1
+int dtw_match(v_ftr_tag *mdls, uint16_t count, uint16_t sign, v_ftr_tag *ftr_in, uint32_t *min_dis);
 uint32_t get_mdl(v_ftr_tag *ftr_in1, v_ftr_tag *ftr_in2, v_ftr_tag *ftr_mdl);
 
 #ifdef __cplusplus
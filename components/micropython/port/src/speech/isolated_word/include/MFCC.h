@@ -30,7 +30,16 @@ typedef struct {
 } v_ftr_tag;								//语音特征结构体
 //#pragma pack()
 
+typedef struct {
+	v_ftr_tag *ftr;		//输出
+	int32_t mid;		//零值
+	uint16_t frm_num;	//已算出的帧数
+} mfcc_stream_tag;							//流式 MFCC 状态
+
 void get_mfcc(valid_tag *valid, v_ftr_tag *v_ftr, atap_tag *atap_arg);
+void mfcc_stream_reset(mfcc_stream_tag *stream, v_ftr_tag *v_ftr, atap_tag *atap_arg);
+void mfcc_stream_update(mfcc_stream_tag *stream, const uint16_t *vc, uint16_t frm_num);
+uint16_t mfcc_stream_finish(mfcc_stream_tag *stream, valid_tag *valid);
 
 #ifdef __cplusplus
 }
@@ -34,6 +34,7 @@ typedef struct {
 void noise_atap(const uint16_t *noise, uint16_t n_len, atap_tag *atap);
 void VAD(const uint16_t *vc, uint16_t buf_len, valid_tag *valid_voice, atap_tag *atap_arg);
 uint8_t VAD2(const uint16_t *vc, valid_tag *valid_voice, atap_tag *atap_arg);
+uint16_t VAD2_frames(const uint16_t **dat);
 
 #ifdef __cplusplus
 }
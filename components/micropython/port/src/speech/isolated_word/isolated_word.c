@@ -83,6 +83,7 @@ int iw_i2s_dma_irq(void *ctx)
     static uint16_t v_dat[atap_len];
     static valid_tag valid_voice[max_vc_con];
     static uint16_t frame_index;
+    static mfcc_stream_tag mfcc_stream;
     const uint16_t num = atap_len / frame_mov;
     switch (iw_state)
     {
@@ -144,6 +145,7 @@ int iw_i2s_dma_irq(void *ctx)
             for (i = 0; i < frame_mov; i++)
                 v_dat[i + frame_mov] = rx_buf[i + frame_mov];
         }
+        mfcc_stream_reset(&mfcc_stream, &ftr_curr, &atap_arg);
         iw_state = Speak;
     }
     case Speak: // 录音识别
@@ -167,8 +169,8 @@ int iw_i2s_dma_irq(void *ctx)
         if (VAD2(v_dat, valid_voice, &atap_arg) == 1)
         {
             // printk("vad ok\n");
-            get_mfcc(&(valid_voice[0]), &ftr_curr, &atap_arg);
-            if (ftr_curr.frm_num == 0)
+            // 前面的帧在收到时已经算好，这里只补齐并归一化
+            if (mfcc_stream_finish(&mfcc_stream, &(valid_voice[0])) == 0)
             {
                 // printk("MFCC fail ");
                 // return 0;
@@ -183,6 +185,12 @@ int iw_i2s_dma_irq(void *ctx)
             }
             break;
         }
+        else
+        {
+            const uint16_t *vc;
+            uint16_t frm_num = VAD2_frames(&vc);
+            mfcc_stream_update(&mfcc_stream, vc, frm_num);
+        }
         break;
     }
     case Done: // 完成
@@ -298,28 +306,9 @@ int iw_recognize()
 {
     if (iw_state == Done)
     {
-        int16_t min_comm = -1;
-        uint32_t min_dis = dis_max;
+        uint32_t min_dis;
         // uint32_t cycle0 = read_csr(mcycle);
-        for (uint32_t ftr_num = 0; ftr_num < ftr_size; ftr_num += 1)
-        {
-            //  ftr_mdl=(v_ftr_tag*)ftr_num;
-            v_ftr_tag *ftr_mdl = (v_ftr_tag *)(&ftr_save[ftr_num]);
-            if ((ftr_mdl->save_sign) == save_mask)
-            {
-                printk("no. %d, ftr_mdl->frm_num %d, ", ftr_num, ftr_mdl->frm_num);
-                
-                uint32_t cur_dis = dtw(ftr_mdl, &ftr_curr);
-                printk("cur_dis %d, ftr_curr.frm_num %d\n", cur_dis, ftr_curr.frm_num);
-            
-                if (cur_dis < min_dis)
-                {
-                    min_dis = cur_dis;
-                    min_comm = ftr_num;
-                    printk("min_comm: %d >\r\n", min_comm);
-                }
-            }
-        }
+        int16_t min_comm = dtw_match(ftr_save, ftr_size, save_mask, &ftr_curr, &min_dis);
         // uint32_t cycle1 = read_csr(mcycle) - cycle0;
         // printk("[INFO] recg cycle = 0x%08x\n", cycle1);
         //printk("recg end ");
@@ -273,29 +273,14 @@ STATIC mp_obj_t speech_isolated_word_recognize(mp_obj_t self_in) {
     
     if (iw_get_state() == Done)
     {
-        self->min_comm = -1;
-        self->min_dis = dis_max;
         // uint32_t cycle0 = read_csr(mcycle);
-        for (uint32_t ftr_num = 0; ftr_num < self->size; ftr_num += 1)
+        // templates are tried cheapest lower bound first, hopeless ones are skipped
+        self->min_comm = dtw_match(self->mfcc_dats, self->size, mfcc_dats_mask, &ftr_curr, &self->min_dis);
+        if (self->min_comm != -1)
         {
-            //  ftr_mdl=(v_ftr_tag*)ftr_num;
-            v_ftr_tag *ftr_mdl = (v_ftr_tag *)(&self->mfcc_dats[ftr_num]);
-            if ((ftr_mdl->save_sign) == mfcc_dats_mask)
-            {
-                printk("NO. %d, ftr_mdl->frm_num %d, ", ftr_num, ftr_mdl->frm_num);
-                
-                uint32_t cur_dis = dtw(ftr_mdl, &ftr_curr);
-                printk("cur_dis %d, ftr_curr.frm_num %d\r\n", cur_dis, ftr_curr.frm_num);
-            
-                if (cur_dis < self->min_dis)
-                {
-                    self->min_comm = ftr_num;
-                    self->min_dis = cur_dis;
-                    self->cur_frm = ftr_curr.frm_num;
-                    self->min_frm = ftr_mdl->frm_num;
-                    printk("min_comm: %d \r\n", self->min_comm);
-                }
-            }
+            self->cur_frm = ftr_curr.frm_num;
+            self->min_frm = self->mfcc_dats[self->min_comm].frm_num;
+            printk("min_comm: %d, min_dis %d\r\n", self->min_comm, self->min_dis);
         }
         // uint32_t cycle1 = read_csr(mcycle) - cycle0;
         // printk("[INFO] recg cycle = 0x%08x\n", cycle1);
@@ -167,9 +167,9 @@ uint8_t esp32_spi_get_socket(void);
 int8_t esp32_spi_socket_open(uint8_t sock_num, uint8_t *dest, uint8_t dest_type, uint16_t port, esp32_socket_mode_enum_t conn_mode);
 esp32_socket_enum_t esp32_spi_socket_status(uint8_t socket_num);
 uint8_t esp32_spi_socket_connected(uint8_t socket_num);
-uint32_t esp32_spi_socket_write(uint8_t socket_num, uint8_t *buffer, uint16_t len);
+uint32_t esp32_spi_socket_write(uint8_t socket_num, uint8_t *buffer, uint32_t len);
 int esp32_spi_socket_available(uint8_t socket_num);
-int esp32_spi_socket_read(uint8_t socket_num, uint8_t *buff, uint16_t size);
+int esp32_spi_socket_read(uint8_t socket_num, uint8_t *buff, uint32_t size);
 int8_t esp32_spi_socket_connect(uint8_t socket_num, uint8_t *dest, uint8_t dest_type, uint16_t port, esp32_socket_mode_enum_t conn_mod);
 int8_t esp32_spi_socket_close(uint8_t socket_num);
 
@@ -178,7 +178,7 @@ int8_t esp32_spi_get_adc_val(uint8_t* channels, uint8_t len, uint16_t *val);
 char *socket_enum_to_str(esp32_socket_enum_t x);
 char *wlan_enum_to_str(esp32_wlan_enum_t x);
 
-int8_t esp32_spi_add_udp_data(uint8_t sock_num, uint8_t* data, uint16_t data_len);
+int8_t esp32_spi_add_udp_data(uint8_t sock_num, uint8_t* data, uint32_t data_len);
 int8_t esp32_spi_send_udp_data(uint8_t sock_num);
 int8_t esp32_spi_get_remote_info(uint8_t socket_num, uint8_t* ip, uint16_t* port);
 
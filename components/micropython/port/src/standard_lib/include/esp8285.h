@@ -37,6 +37,7 @@
 #include "modnetwork.h"
 
 #include "buffer.h"
+#include "esp8285_at.h"
 
 ////////////////////////// config /////////////////////////
 
@@ -57,6 +58,7 @@ typedef struct _esp8285_obj
 {
 	mp_obj_t uart_obj;
 	Buffer_t buffer;
+	uint32_t resp_len;      // bytes of the last AT response in buffer.buffer
 }esp8285_obj;
 
 /*
@@ -320,6 +322,11 @@ bool esp_send_mul(esp8285_obj* nic,char mux_id, const char* buffer, uint32_t len
  */
 int esp_recv(esp8285_obj* nic,char* buffer, uint32_t buffer_size, uint32_t* read_len, uint32_t timeout, bool* peer_closed, bool first_time_recv);
 
+/**
+ * Whether esp_recv() would return without waiting: data buffered or on the UART, or the peer closed.
+ */
+bool esp_recv_ready(esp8285_obj* nic);
+
 /**
  * Receive data from one of TCP or UDP builded already in multiple mode. 
  *
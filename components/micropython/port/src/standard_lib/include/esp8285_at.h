@@ -0,0 +1,69 @@
+#ifndef __ESP8285_AT_H__
+#define __ESP8285_AT_H__
+
+/*
+ * Streaming parsers for the ESP8285 AT link.
+ * Bytes are fed as they come from the UART, in chunks of any size, and each byte is looked at once:
+ *  - at_matcher_t waits for one of a few response tokens ("OK", "ERROR", ...), one KMP automaton per token
+ *  - at_ipd_t splits "+IPD,[<id>,]<len>:<data>" frames and hands back the payload in place
+ * No MicroPython dependency, so it can be fed with recorded transcripts on a PC.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AT_MATCHER_TOKENS_MAX   3
+#define AT_MATCHER_TOKEN_LEN    32  // longer tokens are never matched
+#define AT_IPD_HEAD_MAX         12  // "<id>,<len>" between "+IPD," and ':'
+
+typedef struct
+{
+    const char* str;
+    uint8_t len;
+    uint8_t state;                      // chars of str matched so far
+    uint8_t next[AT_MATCHER_TOKEN_LEN]; // KMP prefix function
+} at_token_t;
+
+typedef struct
+{
+    at_token_t token[AT_MATCHER_TOKENS_MAX];
+    uint8_t num;
+} at_matcher_t;
+
+void at_matcher_init(at_matcher_t* m, const char* const* tokens, uint8_t num);
+void at_matcher_reset(at_matcher_t* m);
+/**
+ * @param used bytes eaten, up to and including the end of the match. May be NULL
+ * @return index of the first token completed, -1 if none
+ */
+int at_matcher_feed(at_matcher_t* m, const uint8_t* data, uint32_t len, uint32_t* used);
+/* one-shot search, returns the offset of target in src, -1 if not found */
+int32_t at_find(const uint8_t* src, uint32_t src_len, const char* target);
+
+typedef enum
+{
+    AT_IPD_IDLE = 0,    // between frames, looking for "+IPD," or "CLOSED\r\n"
+    AT_IPD_HEAD,        // reading "<id>,<len>:"
+    AT_IPD_DATA,        // payload
+} at_ipd_state_t;
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t head_len;
+    char head[AT_IPD_HEAD_MAX + 1];
+    int8_t mux_id;      // -1 in single connection mode
+    uint32_t remain;    // payload bytes left in the current frame
+    bool closed;        // "CLOSED" seen between frames
+    at_matcher_t idle;
+} at_ipd_t;
+
+void at_ipd_init(at_ipd_t* p);
+/**
+ * parse until the end of data or of one payload run
+ * @param payload set to the payload bytes inside data, *payload_len is 0 if none
+ * @return bytes eaten, call again with the rest
+ */
+uint32_t at_ipd_parse(at_ipd_t* p, const uint8_t* data, uint32_t len, const uint8_t** payload, uint32_t* payload_len);
+
+#endif
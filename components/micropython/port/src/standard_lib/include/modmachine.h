@@ -11,4 +11,6 @@ extern const mp_obj_type_t machine_pin_type;
 extern const mp_obj_type_t machine_hw_spi_type;
 extern const mp_obj_type_t machine_wdt_type;
 extern const mp_obj_type_t machine_sdcard_type;
+
+int machine_hw_spi_get_dma_bus(mp_obj_t self_in);
 #endif // MICROPY_INCLUDED_MAIX_MODMACHINE_H
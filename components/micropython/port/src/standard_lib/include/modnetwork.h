@@ -73,8 +73,19 @@ typedef struct _mod_network_nic_type_t {
     int (*setsockopt)(struct _mod_network_socket_obj_t *socket, mp_uint_t level, mp_uint_t opt, const void *optval, mp_uint_t optlen, int *_errno);
     int (*settimeout)(struct _mod_network_socket_obj_t *socket, mp_uint_t timeout_ms, int *_errno);
     int (*ioctl)(struct _mod_network_socket_obj_t *socket, mp_uint_t request, mp_uint_t arg, int *_errno);
+
+    // interrupts seen from the NIC so far, false if it has no interrupt line; can be NULL
+    bool (*events)(mp_obj_t nic, uint32_t *count);
 } mod_network_nic_type_t;
 
+// uselect readiness of a socket, the NIC is only asked again when it
+// signalled an event or the backoff is over
+typedef struct _mod_network_poll_t {
+    mp_uint_t next_ms;
+    uint16_t interval_ms;
+    uint32_t events;
+} mod_network_poll_t;
+
 typedef struct _mod_network_socket_obj_t {
     mp_obj_base_t base;
     mp_obj_t nic;
@@ -91,6 +102,7 @@ typedef struct _mod_network_socket_obj_t {
     float timeout;
     bool peer_closed;
     bool first_read_after_write;
+    mod_network_poll_t poll;
 } mod_network_socket_obj_t;
 
 extern const mod_network_nic_type_t mod_network_nic_type_esp8285;
@@ -0,0 +1,33 @@
+#ifndef __SPIFFS_MOUNT_H
+#define __SPIFFS_MOUNT_H
+
+#include <stdint.h>
+#include "spiffs.h"
+
+// runtime limits, keep SPIFFS_CACHE_PAGES/SPIFFS_MAX_FDS in components/spiffs/Kconfig in step
+#define SPIFFS_MOUNT_CACHE_PAGES_MAX    64 // 0 mounts without a cache
+#define SPIFFS_MOUNT_FDS_MAX            64
+
+typedef enum {
+	SPIFFS_MOUNT_GC_NONE = 0,
+	SPIFFS_MOUNT_GC_QUICK,  // erase blocks that only hold deleted pages
+	SPIFFS_MOUNT_GC_FREE,   // collect until gc_size bytes can be written
+} spiffs_mount_gc_t;
+
+// chosen before mounting, see spiffs_mount_opt_default()
+typedef struct {
+	uint16_t cache_pages;
+	uint16_t fds;
+	uint8_t gc;
+	uint32_t gc_size;
+} spiffs_mount_opt_t;
+
+// the Kconfig choice
+void spiffs_mount_opt_default(spiffs_mount_opt_t *opt);
+// buffer sizes SPIFFS_mount() needs for opt, the work buffer is always 2 logical pages
+u32_t spiffs_mount_fds_size(const spiffs_mount_opt_t *opt);
+u32_t spiffs_mount_cache_size(const spiffs_config *cfg, const spiffs_mount_opt_t *opt);
+// run the GC chosen in opt on the mounted fs, returns SPIFFS_OK or the GC error
+s32_t spiffs_mount_gc(spiffs *fs, const spiffs_config *cfg, const spiffs_mount_opt_t *opt);
+
+#endif
@@ -30,6 +30,7 @@
 #include "py/obj.h"
 #include "extmod/vfs.h"
 #include "spiffs.h"
+#include "spiffs_mount.h"
 #include "global_config.h"
 // these are the values for fs_user_mount_t.flags
 #define MODULE_SPIFFS       (0x0001) // readblocks[2]/writeblocks[2] contain native func
@@ -41,6 +42,7 @@ typedef struct _spiffs_user_mount_t {
     mp_obj_base_t base;
     uint16_t flags;
 	spiffs_config cfg;
+	spiffs_mount_opt_t opt;
     spiffs fs;
 	mp_obj_t read_obj[5];
 	mp_obj_t write_obj[5];
@@ -93,10 +95,6 @@ typedef enum {
 }SPIFFS_ERR;
 
 
-extern u8_t spiffs_work_buf[CONFIG_SPIFFS_LOGICAL_PAGE_SIZE*2];
-extern u8_t spiffs_fds[CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE/CONFIG_SPIFFS_LOGICAL_PAGE_SIZE*4];
-extern u8_t spiffs_cache_buf[(CONFIG_SPIFFS_LOGICAL_PAGE_SIZE+CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE/CONFIG_SPIFFS_LOGICAL_PAGE_SIZE)*4];
-
 extern const byte SPIFFS_errno_table[43];
 extern const mp_obj_type_t mp_spiffs_vfs_type;
 extern const mp_obj_type_t mp_type_vfs_spiffs_fileio;
@@ -109,6 +107,9 @@ s32_t sys_spiffs_read(uint32_t addr, uint32_t size, uint8_t *buf);
 s32_t sys_spiffs_write(uint32_t addr, uint32_t size, uint8_t *buf);
 s32_t sys_spiffs_erase(uint32_t addr, uint32_t size);
 int mp_module_spiffs_mount(spiffs* fs,spiffs_config* cfg);
+void spiffs_mount_opt_update(spiffs_mount_opt_t *opt, mp_int_t cache_pages, mp_int_t fds, mp_int_t gc, mp_int_t gc_size);
+// mount with buffers sized from vfs->opt, then run the chosen GC. Usable before the heap is up for SYS_SPIFFS
+int spiffs_vfs_mount_fs(spiffs_user_mount_t *vfs);
 int mp_module_spiffs_format(spiffs* fs);
 
 MP_DECLARE_CONST_FUN_OBJ_3(spiffs_vfs_open_obj);
@@ -18,7 +18,12 @@ bool sdcard_power_on(void) {
     if (!sdcard_is_present()) {
         return false;
     }
-	if(0xff == sd_init())
+	// no queued read-ahead may run between the re-init and the cache drop
+	sd_dma_lock();
+	uint8_t ret = sd_init();
+	sd_cache_invalidate();
+	sd_dma_unlock();
+	if(0xff == ret)
 		 return false;
 	cardinfo.active = 1;
     return true;
@@ -26,6 +31,7 @@ bool sdcard_power_on(void) {
 
 void sdcard_power_off(void) {
     cardinfo.active = 0;
+    sd_cache_invalidate();
 }
 
 extern void mount_sdcard(void);
@@ -34,7 +40,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_sdcard_remount_obj, mount_sdcard);
 STATIC mp_obj_t machine_sdcard_write_sector(mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_READ);
-    mp_uint_t ret = sd_write_sector_dma(bufinfo.buf,mp_obj_get_int(block_num),bufinfo.len / SDCARD_BLOCK_SIZE);
+    mp_uint_t ret = sd_write_sector_cached(bufinfo.buf,mp_obj_get_int(block_num),bufinfo.len / SDCARD_BLOCK_SIZE);
     return mp_obj_new_bool(ret == 0);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(machine_sdcard_write_sector_obj, machine_sdcard_write_sector);
@@ -92,10 +98,10 @@ void sdcard_init_vfs(fs_user_mount_t *vfs, int part) {
     vfs->fatfs.part = part;
     vfs->readblocks[0] = NULL;
     vfs->readblocks[1] = NULL;
-    vfs->readblocks[2] = MP_OBJ_FROM_PTR(sd_read_sector_dma); // native version
+    vfs->readblocks[2] = MP_OBJ_FROM_PTR(sd_read_sector_cached); // native version
     vfs->writeblocks[0] = MP_OBJ_FROM_PTR(&machine_sdcard_write_sector_obj);
     vfs->writeblocks[1] = NULL;
-    vfs->writeblocks[2] = MP_OBJ_FROM_PTR(sd_write_sector_dma); // native version
+    vfs->writeblocks[2] = MP_OBJ_FROM_PTR(sd_write_sector_cached); // native version
 	vfs->u.ioctl[0] = MP_OBJ_FROM_PTR(&machine_sdcard_ioctl_obj);
     vfs->u.ioctl[1] = MP_OBJ_FROM_PTR(&machine_sdcard_obj);
 	//vfs->readblocks[0] = MP_OBJ_FROM_PTR(&pyb_sdcard_readblocks_obj);
@@ -238,6 +238,19 @@ STATIC void machine_hw_spi_transfer(mp_obj_base_t *self_in, size_t len, const ui
         sipeed_spi_transfer_data_standard(self->id, cs, src, dest, len, len);
 }
 
+// bus number for drivers that run their own DMA on the bus (8 bit master only), -1 if they can't
+int machine_hw_spi_get_dma_bus(mp_obj_t self_in) {
+    machine_hw_spi_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->state != MACHINE_HW_SPI_STATE_INIT || self->mode != MACHINE_SPI_MODE_MASTER || self->bits != 8)
+        return -1;
+#if MICROPY_PY_MACHINE_SW_SPI
+    if(self->id == SPI_SOFTWARE)
+        return -1;
+#endif
+    return self->id;
+}
+
 /******************************************************************************/
 // MicroPython bindings for hw_spi
 
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "esp32_spi.h"
 #include "esp32_spi_io.h"
@@ -81,6 +82,29 @@ static void esp32_spi_reset(void)
 #endif
 }
 
+// the ready line normally changes within microseconds of the last transfer,
+// so poll it busy for a while before falling back to sleeping
+#define ESP32_SPI_SPIN_US 2000
+
+//Wait until the ready pin reads level
+// 0 ok
+// -1 timed out
+static int8_t esp32_spi_poll_ready(uint8_t level, uint64_t timeout_us)
+{
+    uint64_t tm = sysctl_get_time_us();
+    uint64_t dt = 0;
+
+    while (dt < timeout_us)
+    {
+        if (gpiohs_get_pin(rdy_num) == level)
+            return 0;
+        if (dt > ESP32_SPI_SPIN_US)
+            msleep(1);
+        dt = sysctl_get_time_us() - tm;
+    }
+    return -1;
+}
+
 //Wait until the ready pin goes low
 // 0 get response
 // -1 error, no response
@@ -90,17 +114,8 @@ int8_t esp32_spi_wait_for_ready(void)
     printk("Wait for ESP32 ready\r\n");
 #endif
 
-    uint64_t tm = sysctl_get_time_us();
-    while ((sysctl_get_time_us() - tm) < 10 * 1000 * 1000) //10s
-    {
-        if (gpiohs_get_pin(rdy_num) == 0)
-            return 0;
-
-#if (ESP32_SPI_DEBUG >= 3)
-        printk(".");
-#endif
-        msleep(1); //FIXME
-    }
+    if (esp32_spi_poll_ready(0, 10 * 1000 * 1000) == 0) //10s
+        return 0;
 
 #if (ESP32_SPI_DEBUG >= 3)
     printk("esp32 not responding\r\n");
@@ -109,18 +124,44 @@ int8_t esp32_spi_wait_for_ready(void)
     return -1;
 }
 
+//Wait for ready, pull CS low and wait for the ESP32 to acknowledge it
+// 0 ok, CS is low
+// -1 timed out, CS released
+static int8_t esp32_spi_select(void)
+{
+    esp32_spi_wait_for_ready();
+    gpiohs_set_pin(cs_num, 0);
+
+    if (esp32_spi_poll_ready(1, 1000 * 1000) != 0)
+    {
+#if ESP32_SPI_DEBUG
+        printk("ESP32 timed out on SPI select\r\n");
+#endif
+        gpiohs_set_pin(cs_num, 1);
+        return -1;
+    }
+    return 0;
+}
+
 #define lc_buf_len 256
 uint8_t lc_send_buf[lc_buf_len];
-uint8_t lc_buf_flag = 0;
 
-/// Send over a command with a list of parameters
-// -1 error
-// other right
-static int8_t esp32_spi_send_command(uint8_t cmd, esp32_spi_params_t *params, uint8_t param_len_16)
+// two full size packets for socket writes, one is packed while the other is on the wire.
+// allocated on first use so boards without the ESP32 do not pay for them
+#define ESP32_SPI_TX_BUF_LEN (SPI_MAX_DMA_LEN + 16)
+static uint8_t *esp32_spi_tx_buf[2] = {NULL, NULL};
+
+static uint8_t *esp32_spi_get_tx_buf(uint8_t idx)
 {
-    uint32_t packet_len = 0;
+    if (esp32_spi_tx_buf[idx] == NULL)
+        esp32_spi_tx_buf[idx] = (uint8_t *)malloc(ESP32_SPI_TX_BUF_LEN);
+    return esp32_spi_tx_buf[idx];
+}
+
+static uint32_t esp32_spi_command_len(esp32_spi_params_t *params, uint8_t param_len_16)
+{
+    uint32_t packet_len = 4; // header + end byte
 
-    packet_len = 4; // header + end byte
     if (params != NULL)
     {
         for (uint32_t i = 0; i < params->params_num; i++)
@@ -131,28 +172,14 @@ static int8_t esp32_spi_send_command(uint8_t cmd, esp32_spi_params_t *params, ui
                 packet_len += 1;
         }
     }
-    while (packet_len % 4 != 0)
-        packet_len += 1;
-
-    uint8_t *sendbuf = NULL;
+    return (packet_len + 3) & ~3;
+}
 
-    if (packet_len > lc_buf_len)
-    {
-        sendbuf = (uint8_t *)malloc(sizeof(uint8_t) * packet_len);
-        lc_buf_flag = 0;
-        if (!sendbuf)
-        {
-#if (ESP32_SPI_DEBUG)
-            printk("%s: malloc error\r\n", __func__);
-#endif
-            return -1;
-        }
-    }
-    else
-    {
-        sendbuf = lc_send_buf;
-        lc_buf_flag = 1;
-    }
+/// Build a command packet in sendbuf, which must hold esp32_spi_command_len() bytes
+//return packet length
+static uint32_t esp32_spi_pack_command(uint8_t *sendbuf, uint8_t cmd, esp32_spi_params_t *params, uint8_t param_len_16)
+{
+    uint32_t packet_len = esp32_spi_command_len(params, param_len_16);
 
     sendbuf[0] = START_CMD;
     sendbuf[1] = cmd & ~REPLY_FLAG;
@@ -183,36 +210,20 @@ static int8_t esp32_spi_send_command(uint8_t cmd, esp32_spi_params_t *params, ui
             ptr += params->params[i]->param_len;
         }
     }
-    sendbuf[ptr] = END_CMD;
-
-    esp32_spi_wait_for_ready();
-    gpiohs_set_pin(cs_num, 0);
+    sendbuf[ptr++] = END_CMD;
+    while (ptr < packet_len)
+        sendbuf[ptr++] = 0;
 
-    uint64_t tm = sysctl_get_time_us();
-    while ((sysctl_get_time_us() - tm) < 1000 * 1000)
-    {
-        if (gpiohs_get_pin(rdy_num))
-            break;
-        msleep(1);
-    }
+    return packet_len;
+}
 
-    if ((sysctl_get_time_us() - tm) > 1000 * 1000)
-    {
-#if (ESP32_SPI_DEBUG)
-        printk("ESP32 timed out on SPI select\r\n");
-#endif
-        gpiohs_set_pin(cs_num, 1);
-        if (lc_buf_flag == 0)
-        {
-            free(sendbuf);
-            sendbuf = NULL;
-        }
-        else
-        {
-            memset(sendbuf, 0, packet_len);
-        }
+/// Send a packed command
+// -1 error
+// 0 ok
+static int8_t esp32_spi_send_packet(uint8_t *sendbuf, uint32_t packet_len)
+{
+    if (esp32_spi_select() != 0)
         return -1;
-    }
 
     if (is_hard_spi) {
         hard_spi_rw_len(sendbuf, NULL, packet_len);
@@ -230,16 +241,40 @@ static int8_t esp32_spi_send_command(uint8_t cmd, esp32_spi_params_t *params, ui
         printk("\r\n");
     }
 #endif
-    if (lc_buf_flag == 0)
+    return 0;
+}
+
+/// Send over a command with a list of parameters
+// -1 error
+// other right
+static int8_t esp32_spi_send_command(uint8_t cmd, esp32_spi_params_t *params, uint8_t param_len_16)
+{
+    uint32_t packet_len = esp32_spi_command_len(params, param_len_16);
+    uint8_t *sendbuf = lc_send_buf;
+    uint8_t *heap_buf = NULL;
+
+    if (packet_len > ESP32_SPI_TX_BUF_LEN)
     {
-        free(sendbuf);
-        sendbuf = NULL;
+        heap_buf = (uint8_t *)malloc(sizeof(uint8_t) * packet_len);
+        sendbuf = heap_buf;
     }
-    else
+    else if (packet_len > lc_buf_len)
     {
-        memset(sendbuf, 0, packet_len);
+        sendbuf = esp32_spi_get_tx_buf(0);
     }
-    return 0;
+    if (!sendbuf)
+    {
+#if (ESP32_SPI_DEBUG)
+        printk("%s: malloc error\r\n", __func__);
+#endif
+        return -1;
+    }
+
+    esp32_spi_pack_command(sendbuf, cmd, params, param_len_16);
+    int8_t ret = esp32_spi_send_packet(sendbuf, packet_len);
+
+    free(heap_buf);
+    return ret;
 }
 
 /// Read one byte from SPI
@@ -332,32 +367,102 @@ uint8_t esp32_spi_check_data(uint8_t want)
     return 0;
 }
 
-///Wait for ready, then parse the response
-//NULL error
-esp32_spi_params_t *esp32_spi_wait_response_cmd(uint8_t cmd, uint32_t *num_responses, uint8_t param_len_16)
+// Responses are parsed into a static arena while it is free, a caller that holds on to
+// one response while issuing other commands (the scan) gets the next ones from the heap
+#define ESP32_SPI_ARENA_PARAMS  8
+#define ESP32_SPI_ARENA_DATA    512
+
+typedef struct
 {
-    uint32_t num_of_resp = 0;
+    esp32_spi_params_t params; // first member, del gets this pointer back
+    esp32_spi_param_t *list[ESP32_SPI_ARENA_PARAMS];
+    esp32_spi_param_t param[ESP32_SPI_ARENA_PARAMS];
+    uint8_t data[ESP32_SPI_ARENA_DATA];
+    uint32_t used;
+    uint8_t busy;
+} esp32_spi_arena_t;
 
-    esp32_spi_wait_for_ready();
+static esp32_spi_arena_t resp_arena;
 
-    gpiohs_set_pin(cs_num, 0);
+static void release_esp32_spi_arena(void *arg)
+{
+    esp32_spi_arena_t *arena = (esp32_spi_arena_t *)arg;
 
-    uint64_t tm = sysctl_get_time_us();
-    while ((sysctl_get_time_us() - tm) < 1000 * 1000)
+    // params that did not fit in data came from the heap
+    for (uint32_t i = 0; i < arena->params.params_num; i++)
     {
-        if (gpiohs_get_pin(rdy_num))
-            break;
-        msleep(1);
+        uint8_t *p = arena->param[i].param;
+        if (p < arena->data || p >= arena->data + ESP32_SPI_ARENA_DATA)
+            free(p);
     }
+    arena->busy = 0;
+}
 
-    if ((sysctl_get_time_us() - tm) > 1000 * 1000)
+static esp32_spi_params_t *esp32_spi_resp_alloc(uint32_t num)
+{
+    esp32_spi_params_t *params;
+
+    if (!resp_arena.busy && num <= ESP32_SPI_ARENA_PARAMS)
     {
-#if ESP32_SPI_DEBUG
-        printk("ESP32 timed out on SPI select\r\n");
-#endif
-        gpiohs_set_pin(cs_num, 1);
+        resp_arena.busy = 1;
+        resp_arena.used = 0;
+        params = &resp_arena.params;
+        params->del = release_esp32_spi_arena;
+        params->params = resp_arena.list;
+        for (uint32_t i = 0; i < num; i++)
+        {
+            resp_arena.list[i] = &resp_arena.param[i];
+            resp_arena.param[i].param_len = 0;
+            resp_arena.param[i].param = NULL;
+        }
+        params->params_num = num;
+        return params;
+    }
+
+    params = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
+    if (!params)
+        return NULL;
+    params->del = delete_esp32_spi_params;
+    params->params_num = 0;
+    params->params = (void *)malloc(sizeof(void *) * (num ? num : 1));
+    if (!params->params)
+    {
+        free(params);
         return NULL;
     }
+    for (uint32_t i = 0; i < num; i++)
+    {
+        params->params[i] = (esp32_spi_param_t *)malloc(sizeof(esp32_spi_param_t));
+        if (!params->params[i])
+        {
+            params->del(params);
+            return NULL;
+        }
+        params->params[i]->param_len = 0;
+        params->params[i]->param = NULL;
+        params->params_num = i + 1;
+    }
+    return params;
+}
+
+static uint8_t *esp32_spi_resp_data(esp32_spi_params_t *params, uint32_t len)
+{
+    if (params == &resp_arena.params && resp_arena.used + len <= ESP32_SPI_ARENA_DATA)
+    {
+        uint8_t *p = resp_arena.data + resp_arena.used;
+        resp_arena.used += len;
+        return p;
+    }
+    return (uint8_t *)malloc(len ? len : 1);
+}
+
+///Wait for ready, then check the response header
+//0 ok, CS is left low for the parameters
+//-1 error, CS released
+static int8_t esp32_spi_response_begin(uint8_t cmd, uint32_t *num_responses, uint32_t *num_of_resp)
+{
+    if (esp32_spi_select() != 0)
+        return -1;
 
     if (esp32_spi_wait_spi_char(START_CMD) != 0)
     {
@@ -365,7 +470,7 @@ esp32_spi_params_t *esp32_spi_wait_response_cmd(uint8_t cmd, uint32_t *num_respo
         printk("esp32_spi_wait_spi_char START_CMD error\r\n");
 #endif
         gpiohs_set_pin(cs_num, 1);
-        return NULL;
+        return -1;
     }
 
     if (esp32_spi_check_data(cmd | REPLY_FLAG) != 0)
@@ -374,7 +479,7 @@ esp32_spi_params_t *esp32_spi_wait_response_cmd(uint8_t cmd, uint32_t *num_respo
         printk("esp32_spi_check_data cmd | REPLY_FLAG error\r\n");
 #endif
         gpiohs_set_pin(cs_num, 1);
-        return NULL;
+        return -1;
     }
 
     if (num_responses)
@@ -385,54 +490,110 @@ esp32_spi_params_t *esp32_spi_wait_response_cmd(uint8_t cmd, uint32_t *num_respo
             printk("esp32_spi_check_data num_responses error\r\n");
 #endif
             gpiohs_set_pin(cs_num, 1);
-            return NULL;
+            return -1;
         }
-        num_of_resp = *num_responses;
+        *num_of_resp = *num_responses;
     }
     else
     {
-        num_of_resp = esp32_spi_read_byte();
+        *num_of_resp = esp32_spi_read_byte();
     }
+    return 0;
+}
+
+///Check the end of the response and release CS
+//0 ok
+//-1 error
+static int8_t esp32_spi_response_end(void)
+{
+    int8_t ret = 0;
+
+    if (esp32_spi_check_data(END_CMD) != 0)
+    {
+#if ESP32_SPI_DEBUG
+        printk("esp32_spi_check_data END_CMD error\r\n");
+#endif
+        ret = -1;
+    }
+    gpiohs_set_pin(cs_num, 1);
+    return ret;
+}
+
+///Wait for ready, then parse the response
+//NULL error
+esp32_spi_params_t *esp32_spi_wait_response_cmd(uint8_t cmd, uint32_t *num_responses, uint8_t param_len_16)
+{
+    uint32_t num_of_resp = 0;
 
-    esp32_spi_params_t *params_ret = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
+    if (esp32_spi_response_begin(cmd, num_responses, &num_of_resp) != 0)
+        return NULL;
 
-    params_ret->del = delete_esp32_spi_params;
-    params_ret->params_num = num_of_resp;
-    params_ret->params = (void *)malloc(sizeof(void *) * num_of_resp);
+    esp32_spi_params_t *params_ret = esp32_spi_resp_alloc(num_of_resp);
+    if (!params_ret)
+    {
+        gpiohs_set_pin(cs_num, 1);
+        return NULL;
+    }
 
     for (uint32_t i = 0; i < num_of_resp; i++)
     {
-        params_ret->params[i] = (esp32_spi_param_t *)malloc(sizeof(esp32_spi_param_t));
-        params_ret->params[i]->param_len = esp32_spi_read_byte();
+        esp32_spi_param_t *param = params_ret->params[i];
+        param->param_len = esp32_spi_read_byte();
 
         if (param_len_16)
         {
-            params_ret->params[i]->param_len <<= 8;
-            params_ret->params[i]->param_len |= esp32_spi_read_byte();
+            param->param_len <<= 8;
+            param->param_len |= esp32_spi_read_byte();
         }
 
 #if (ESP32_SPI_DEBUG >= 2)
-        printk("\tParameter #%d length is %d\r\n", i, params_ret->params[i]->param_len);
+        printk("\tParameter #%d length is %d\r\n", i, param->param_len);
 #endif
 
-        params_ret->params[i]->param = (uint8_t *)malloc(sizeof(uint8_t) * params_ret->params[i]->param_len);
-        esp32_spi_read_bytes(params_ret->params[i]->param, params_ret->params[i]->param_len);
+        param->param = esp32_spi_resp_data(params_ret, param->param_len);
+        if (!param->param)
+        {
+            gpiohs_set_pin(cs_num, 1);
+            params_ret->del(params_ret);
+            return NULL;
+        }
+        esp32_spi_read_bytes(param->param, param->param_len);
     }
 
-    if (esp32_spi_check_data(END_CMD) != 0)
+    if (esp32_spi_response_end() != 0)
     {
-#if ESP32_SPI_DEBUG
-        printk("esp32_spi_check_data END_CMD error\r\n");
-#endif
-        gpiohs_set_pin(cs_num, 1);
+        params_ret->del(params_ret);
         return NULL;
     }
 
-    gpiohs_set_pin(cs_num, 1);
-
     return params_ret;
 }
 
+///Wait for a response with one 16-bit length parameter and read it straight into buff
+//-1 error
+//other bytes read
+static int esp32_spi_wait_response_data(uint8_t cmd, uint8_t *buff, uint32_t size)
+{
+    uint32_t num = 1, num_of_resp = 0;
+
+    if (esp32_spi_response_begin(cmd, &num, &num_of_resp) != 0)
+        return -1;
+
+    uint32_t len = esp32_spi_read_byte();
+    len = (len << 8) | esp32_spi_read_byte();
+    uint32_t n = len > size ? size : len;
+
+    if (n != 0)
+        esp32_spi_read_bytes(buff, n);
+    // the firmware never sends more than asked for, drop it if it ever does
+    for (uint32_t i = n; i < len; i++)
+        esp32_spi_read_byte();
+
+    if (esp32_spi_response_end() != 0)
+        return -1;
+    return n;
+}
+
 esp32_spi_params_t *esp32_spi_send_command_get_response(uint8_t cmd, esp32_spi_params_t *params, uint32_t *num_resp, uint8_t sent_param_len_16, uint8_t recv_param_len_16)
 {
     uint32_t resp_num;
@@ -442,7 +603,8 @@ esp32_spi_params_t *esp32_spi_send_command_get_response(uint8_t cmd, esp32_spi_p
     else
         resp_num = *num_resp;
 
-    esp32_spi_send_command(cmd, params, sent_param_len_16);
+    if (esp32_spi_send_command(cmd, params, sent_param_len_16) != 0)
+        return NULL;
     return esp32_spi_wait_response_cmd(cmd, &resp_num, recv_param_len_16);
 }
 
@@ -461,6 +623,47 @@ static void delete_esp32_spi_params(void *arg)
     free(params);
 }
 
+// Command params are built in a few static slots that point at the caller's buffers,
+// nothing is copied until the packet is packed. The heap is only used when all are taken
+#define ESP32_SPI_SEND_SLOTS 4
+
+typedef struct
+{
+    esp32_spi_params_t params; // first member, del gets this pointer back
+    esp32_spi_param_t *list[2];
+    esp32_spi_param_t param[2];
+    uint8_t busy;
+} esp32_spi_send_slot_t;
+
+static esp32_spi_send_slot_t send_slots[ESP32_SPI_SEND_SLOTS];
+
+static void release_esp32_spi_send_slot(void *arg)
+{
+    ((esp32_spi_send_slot_t *)arg)->busy = 0;
+}
+
+static esp32_spi_params_t *esp32_spi_send_slot_get(uint32_t num, uint32_t len_0, uint8_t *buf_0, uint32_t len_1, uint8_t *buf_1)
+{
+    for (uint32_t i = 0; i < ESP32_SPI_SEND_SLOTS; i++)
+    {
+        esp32_spi_send_slot_t *slot = &send_slots[i];
+        if (slot->busy)
+            continue;
+        slot->busy = 1;
+        slot->params.del = release_esp32_spi_send_slot;
+        slot->params.params_num = num;
+        slot->params.params = slot->list;
+        slot->list[0] = &slot->param[0];
+        slot->list[1] = &slot->param[1];
+        slot->param[0].param_len = len_0;
+        slot->param[0].param = buf_0;
+        slot->param[1].param_len = len_1;
+        slot->param[1].param = buf_1;
+        return &slot->params;
+    }
+    return NULL;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 /*
@@ -524,9 +727,15 @@ char *esp32_spi_firmware_version(char* fw_version)
 }
 
 // make params struct with one param
+// buf must stay valid until del
 static esp32_spi_params_t *esp32_spi_params_alloc_1param(uint32_t len, uint8_t *buf)
 {
-    esp32_spi_params_t *ret = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
+    esp32_spi_params_t *ret = esp32_spi_send_slot_get(1, len, buf, 0, NULL);
+
+    if (ret)
+        return ret;
+
+    ret = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
 
     ret->del = delete_esp32_spi_params;
 
@@ -541,9 +750,15 @@ static esp32_spi_params_t *esp32_spi_params_alloc_1param(uint32_t len, uint8_t *
 }
 
 // make params struct with two param
+// buf_0 and buf_1 must stay valid until del
 static esp32_spi_params_t *esp32_spi_params_alloc_2param(uint32_t len_0, uint8_t *buf_0, uint32_t len_1, uint8_t *buf_1)
 {
-    esp32_spi_params_t *ret = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
+    esp32_spi_params_t *ret = esp32_spi_send_slot_get(2, len_0, buf_0, len_1, buf_1);
+
+    if (ret)
+        return ret;
+
+    ret = (esp32_spi_params_t *)malloc(sizeof(esp32_spi_params_t));
 
     ret->del = delete_esp32_spi_params;
 
@@ -1337,85 +1552,116 @@ uint8_t esp32_spi_socket_connected(uint8_t socket_num)
     return (esp32_spi_socket_status(socket_num) == SOCKET_ESTABLISHED);
 }
 
-//Write the bytearray buffer to a socket
-//0 error
-//len ok
-uint32_t esp32_spi_socket_write(uint8_t socket_num, uint8_t *buffer, uint16_t len)
+static uint32_t esp32_spi_pack_socket_write(uint8_t *sendbuf, uint8_t socket_num, uint8_t *buffer, uint16_t len)
 {
     esp32_spi_params_t *send = esp32_spi_params_alloc_2param(1, &socket_num, len, buffer);
-    esp32_spi_params_t *resp = esp32_spi_send_command_get_response(SEND_DATA_TCP_CMD, send, NULL, 1, 0);
+    uint32_t packet_len = esp32_spi_pack_command(sendbuf, SEND_DATA_TCP_CMD, send, 1);
     send->del(send);
+    return packet_len;
+}
 
-    if (resp == NULL)
-    {
-#if ESP32_SPI_DEBUG
-        printk("%s: get resp error!\r\n", __func__);
-#endif
+//Write the bytearray buffer to a socket, SPI_MAX_DMA_LEN bytes per command.
+//NINA answers every command before taking the next one, so the next chunk is
+//packed while the ESP32 is still busy with the current one
+//0 error
+//other bytes taken by the firmware, less than len when its buffer is full
+uint32_t esp32_spi_socket_write(uint8_t socket_num, uint8_t *buffer, uint32_t len)
+{
+    uint8_t *sendbuf[2];
+    uint32_t packet_len[2];
+    uint32_t chunk[2];
+    uint32_t offset = 0, sent_total = 0;
+    uint32_t resp_num = 1;
+    uint8_t cur = 0;
+
+    if (len == 0)
         return 0;
-    }
-    uint16_t sent = ( ((uint16_t)(resp->params[0]->param[1]) << 8) & 0xff00 ) | (uint16_t)(resp->params[0]->param[0]);
-    // if (sent != len) //TODO: the firmware is nonblock, so return value maybe < len
-    if (sent == 0)
+    sendbuf[0] = esp32_spi_get_tx_buf(0);
+    sendbuf[1] = esp32_spi_get_tx_buf(1);
+    if (!sendbuf[0] || !sendbuf[1])
     {
 #if ESP32_SPI_DEBUG
-        printk("Failed to send %d bytes (sent %d)", len, sent);
+        printk("%s: malloc error\r\n", __func__);
 #endif
-        resp->del(resp);
         return 0;
     }
 
-//     resp->del(resp);
-
-//     send = esp32_spi_params_alloc_1param(1, &socket_num);
-//     resp = esp32_spi_send_command_get_response(DATA_SENT_TCP_CMD, send, NULL, 0, 0);
-//     send->del(send);
+    chunk[0] = len > SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : len;
+    packet_len[0] = esp32_spi_pack_socket_write(sendbuf[0], socket_num, buffer, chunk[0]);
+    while (1)
+    {
+        if (esp32_spi_send_packet(sendbuf[cur], packet_len[cur]) != 0)
+            break;
 
-//     if (resp == NULL)
-//     {
-//  #if ESP32_SPI_DEBUG
-//         printk("%s: get resp error!\r\n", __func__);
-//  #endif
-//         return 0;
-//     }
+        uint8_t next = cur ^ 1;
+        uint32_t left = len - offset - chunk[cur];
+        chunk[next] = left > SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : left;
+        if (chunk[next])
+            packet_len[next] = esp32_spi_pack_socket_write(sendbuf[next], socket_num, buffer + offset + chunk[cur], chunk[next]);
 
-//     if (resp->params[0]->param[0] != 1)
-//     {
-//  #if ESP32_SPI_DEBUG
-//         printk("%s: Failed to verify data sent\r\n", __func__);
-//  #endif
-//         resp->del(resp);
-//         return 0;
-//     }
+        esp32_spi_params_t *resp = esp32_spi_wait_response_cmd(SEND_DATA_TCP_CMD, &resp_num, 0);
+        if (resp == NULL)
+        {
+#if ESP32_SPI_DEBUG
+            printk("%s: get resp error!\r\n", __func__);
+#endif
+            break;
+        }
+        uint16_t sent = 0;
+        if (resp->params[0]->param_len >= 2)
+            sent = ( ((uint16_t)(resp->params[0]->param[1]) << 8) & 0xff00 ) | (uint16_t)(resp->params[0]->param[0]);
+        resp->del(resp);
 
-    resp->del(resp);
-    return sent;
+        sent_total += sent;
+        // the firmware is nonblock, a short write means its buffer is full
+        if (sent < chunk[cur])
+        {
+#if ESP32_SPI_DEBUG
+            printk("Failed to send %d bytes (sent %d)", chunk[cur], sent);
+#endif
+            break;
+        }
+        if (chunk[next] == 0)
+            break;
+        offset += chunk[cur];
+        cur = next;
+    }
+    return sent_total;
 }
-int8_t esp32_spi_add_udp_data(uint8_t socket_num, uint8_t* data, uint16_t data_len)
+
+//Append data to the socket's datagram, SPI_MAX_DMA_LEN bytes per command
+int8_t esp32_spi_add_udp_data(uint8_t socket_num, uint8_t* data, uint32_t data_len)
 {
-    esp32_spi_params_t *send = esp32_spi_params_alloc_2param(1, &socket_num, data_len, data );
-    esp32_spi_params_t *resp = esp32_spi_send_command_get_response(ADD_UDP_DATA_CMD, send, NULL, 1, 0);
-    send->del(send);
+    uint32_t offset = 0;
 
-    if (resp == NULL)
+    do
     {
+        uint32_t chunk = (data_len - offset) > SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : (data_len - offset);
+        esp32_spi_params_t *send = esp32_spi_params_alloc_2param(1, &socket_num, chunk, data + offset);
+        esp32_spi_params_t *resp = esp32_spi_send_command_get_response(ADD_UDP_DATA_CMD, send, NULL, 1, 0);
+        send->del(send);
+
+        if (resp == NULL)
+        {
 #if ESP32_SPI_DEBUG
-        printk("Failed  get response\r\n");
+            printk("Failed  get response\r\n");
 #endif
-        return -2;
-    }
+            return -2;
+        }
 
-    uint8_t ok = resp->params[0]->param[0];
+        uint8_t ok = resp->params[0]->param[0];
+        resp->del(resp);
 
-    if (ok != 1)
-    {
+        if (ok != 1)
+        {
 #if ESP32_SPI_DEBUG
-        printk("Failed to sendto\r\n");
+            printk("Failed to sendto\r\n");
 #endif
-        resp->del(resp);
-        return -1;
-    }
+            return -1;
+        }
+        offset += chunk;
+    } while (offset < data_len);
 
-    resp->del(resp);
     return 0;
 }
 
@@ -1476,52 +1722,54 @@ int esp32_spi_socket_available(uint8_t socket_num)
     return reply;
 }
 
-//Read up to 'size' bytes from the socket number. Returns a bytearray
-int esp32_spi_socket_read(uint8_t socket_num, uint8_t *buff, uint16_t size)
+//Read up to 'size' bytes from the socket number straight into buff,
+//SPI_MAX_DMA_LEN bytes per command
+//-1 error
+//other bytes read
+int esp32_spi_socket_read(uint8_t socket_num, uint8_t *buff, uint32_t size)
 {
 #if ESP32_SPI_DEBUG
     printk("Reading %d bytes from ESP socket with status %s\r\n", size, socket_enum_to_str(esp32_spi_socket_status(socket_num)));
 #endif
 
-    uint8_t len[2];
+    int total = 0;
+
+    while (size)
+    {
+        uint32_t chunk = size > SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : size;
+        uint8_t len[2];
 
-    len[0] = (uint8_t)(size & 0xff);
-    len[1] = (uint8_t)((size >> 8) & 0xff);
+        len[0] = (uint8_t)(chunk & 0xff);
+        len[1] = (uint8_t)((chunk >> 8) & 0xff);
 
 #if (ESP32_SPI_DEBUG > 2)
-    printk("len_0:%02x\tlen_1:%02x\r\n", len[0], len[1]);
+        printk("len_0:%02x\tlen_1:%02x\r\n", len[0], len[1]);
 #endif
 
-    esp32_spi_params_t *send = esp32_spi_params_alloc_2param(1, &socket_num, 2, len);
-    esp32_spi_params_t *resp = esp32_spi_send_command_get_response(GET_DATABUF_TCP_CMD, send, NULL, 1, 1);
-    send->del(send);
+        esp32_spi_params_t *send = esp32_spi_params_alloc_2param(1, &socket_num, 2, len);
+        int8_t ret = esp32_spi_send_command(GET_DATABUF_TCP_CMD, send, 1);
+        send->del(send);
 
-    if (resp == NULL)
-    {
+        int real_read_size = -1;
+        if (ret == 0)
+            real_read_size = esp32_spi_wait_response_data(GET_DATABUF_TCP_CMD, buff, chunk);
+        if (real_read_size < 0)
+        {
 #if ESP32_SPI_DEBUG
-        printk("%s: get resp error!\r\n", __func__);
+            printk("%s: get resp error!\r\n", __func__);
 #endif
-        return -1;
-    }
+            return total ? total : -1;
+        }
 
-#if 0
-    if (resp->params[0]->param_len != size)
-    {
-#if ESP32_SPI_DEBUG
-        printk("read error len\r\n");
-#endif
-        resp->del(resp);
-        return -1;
+        total += real_read_size;
+        buff += real_read_size;
+        size -= real_read_size;
+        // less than asked for, nothing more is buffered on the ESP32
+        if ((uint32_t)real_read_size < chunk)
+            break;
     }
-#endif
-
-    uint16_t real_read_size = resp->params[0]->param_len;
-
-    if (real_read_size != 0)
-        memcpy(buff, resp->params[0]->param, real_read_size);
-    resp->del(resp);
 
-    return real_read_size;
+    return total;
 }
 
 int8_t esp32_spi_get_remote_info(uint8_t socket_num, uint8_t* ip, uint16_t* port)
@@ -17,6 +17,8 @@
 #include "esp32_spi_io.h"
 #include "fpioa.h"
 
+#define ESP32_SEND_TIMEOUT_MS 10000 // blocking sockets, the firmware sends on within this when the link is up
+
 typedef struct _esp32_nic_obj_t
 {
     mp_obj_base_t base;
@@ -447,7 +449,7 @@ STATIC mp_uint_t esp32_socket_recv(mod_network_socket_obj_t *socket, byte *buf,
 	}
     esp32_nic_obj_t* self = (esp32_nic_obj_t*)socket->nic;
     int read_len = 0;
-    uint16_t once_read_len = 0;
+    uint32_t once_read_len = 0;
     int ret = -1;
     int len_avail = 0;
     mp_uint_t start_time = mp_hal_ticks_ms();
@@ -463,7 +465,6 @@ STATIC mp_uint_t esp32_socket_recv(mod_network_socket_obj_t *socket, byte *buf,
             if(len_avail > 0)
             {
                 once_read_len = len_avail>(len-read_len) ? (len-read_len) : len_avail;
-                once_read_len = once_read_len>SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : once_read_len;
                 ret = esp32_spi_socket_read(self->sock_id, (uint8_t*)buf+read_len, once_read_len);
                 if(ret == -1)
                 {
@@ -472,10 +473,13 @@ STATIC mp_uint_t esp32_socket_recv(mod_network_socket_obj_t *socket, byte *buf,
                 }
                 read_len += ret;
             }
-            if(read_len >= len)
+            // return what has come so far, don't wait for len bytes
+            if(read_len > 0 && (read_len >= len || socket->u_param.type == MOD_NETWORK_SOCK_STREAM))
                 break;
             if(socket->timeout == 0)
                 break;
+            if(len_avail == 0)
+                msleep(1);
             if( mp_hal_ticks_ms() - start_time > ((uint32_t)socket->timeout*1000) )
             {
                 // *_errno = MP_ETIMEDOUT;
@@ -531,19 +535,26 @@ STATIC mp_uint_t esp32_socket_send(mod_network_socket_obj_t *socket, const byte
         return -1;
     }
     mp_uint_t sent_len = 0;
-    uint16_t len_send;
-    while(1)
+    uint32_t len_send;
+    mp_uint_t start_time = mp_hal_ticks_ms();
+    uint32_t timeout_ms = socket->timeout < 0 ? ESP32_SEND_TIMEOUT_MS : (uint32_t)(socket->timeout * 1000);
+    while(sent_len < len)
     {
-        len_send = (len - sent_len) > SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : (len - sent_len);
-        //TODO: esp32_spi_socket_write is nonblock in esp32 firmware
-        if(esp32_spi_socket_write(self->sock_id, (uint8_t*)buf + sent_len, len_send ) == 0)
-        {
-            *_errno = MP_EIO;
-            return -1;
-        }
+        // chunked by esp32_spi_socket_write, short when the firmware buffer is full
+        len_send = esp32_spi_socket_write(self->sock_id, (uint8_t*)buf + sent_len, len - sent_len);
         sent_len += len_send;
         if(sent_len >= len)
             break;
+        // give the firmware time to pass its buffer on, return what was taken when it does not
+        if(mp_hal_ticks_ms() - start_time >= timeout_ms)
+        {
+            if(sent_len)
+                return sent_len;
+            *_errno = socket->timeout == 0 ? MP_EAGAIN : MP_EIO;
+            return -1;
+        }
+        MICROPY_EVENT_POLL_HOOK
+        msleep(1);
     }
 	
     return len;
@@ -589,7 +600,7 @@ STATIC mp_uint_t esp32_socket_sendto(mod_network_socket_obj_t *socket, const byt
         *_errno = MP_ETIMEDOUT;
         return -1;
     }
-    ret = esp32_spi_add_udp_data((uint8_t)self->sock_id, (uint8_t*)buf, (uint16_t)len);
+    ret = esp32_spi_add_udp_data((uint8_t)self->sock_id, (uint8_t*)buf, (uint32_t)len);
     if(ret != 0)
     {
         *_errno = MP_EIO;
@@ -613,7 +624,7 @@ STATIC mp_uint_t esp32_socket_recvfrom(mod_network_socket_obj_t *socket, byte *b
 	}
     esp32_nic_obj_t* self = (esp32_nic_obj_t*)socket->nic;
     int read_len = 0;
-    uint16_t once_read_len = 0;
+    uint32_t once_read_len = 0;
     int ret = -1;
     int len_avail = 0;
     mp_uint_t start_time = mp_hal_ticks_ms();
@@ -629,7 +640,6 @@ STATIC mp_uint_t esp32_socket_recvfrom(mod_network_socket_obj_t *socket, byte *b
             if(len_avail > 0)
             {
                 once_read_len = len_avail>(len-read_len) ? (len-read_len) : len_avail;
-                once_read_len = once_read_len>SPI_MAX_DMA_LEN ? SPI_MAX_DMA_LEN : once_read_len;
                 ret = esp32_spi_socket_read(self->sock_id, (uint8_t*)buf+read_len, once_read_len);
                 if(ret == -1)
                 {
@@ -704,6 +714,43 @@ STATIC void esp32_socket_close(mod_network_socket_obj_t *socket) {
     }
 }
 
+// uselect readiness. The ready pin only says the ESP32 takes a command, there is
+// no data interrupt, so socket_poll() backs off between these queries
+STATIC int esp32_socket_ioctl(mod_network_socket_obj_t *socket, mp_uint_t request, mp_uint_t arg, int *_errno) {
+	if((mp_obj_type_t*)&mod_network_nic_type_esp32 != mp_obj_get_type(MP_OBJ_TO_PTR(socket->nic)))
+	{
+		*_errno = MP_EPIPE;
+		return MP_STREAM_ERROR;
+	}
+    if(request != MP_STREAM_POLL)
+    {
+        *_errno = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    esp32_nic_obj_t* self = (esp32_nic_obj_t*)socket->nic;
+    bool stream = socket->u_param.type == MOD_NETWORK_SOCK_STREAM;
+    int ret = 0;
+    if(self->socket_fd != socket->fd || self->sock_id < 0)
+    {
+        // closed stream: recv() returns at once. UDP is opened by sendto()
+        return stream ? ((arg & MP_STREAM_POLL_RD) | MP_STREAM_POLL_HUP) : 0;
+    }
+    if(arg & MP_STREAM_POLL_RD)
+    {
+        int len_avail = esp32_spi_socket_available(self->sock_id);
+        if(len_avail == -1)
+        {
+            *_errno = MP_EIO;
+            return MP_STREAM_ERROR;
+        }
+        if(len_avail > 0 || (stream && esp32_spi_socket_status(self->sock_id) == SOCKET_CLOSED))
+            ret |= MP_STREAM_POLL_RD;
+    }
+    if(arg & MP_STREAM_POLL_WR)
+        ret |= MP_STREAM_POLL_WR; // send() waits for the ESP32 itself
+    return ret;
+}
+
 STATIC int esp32_socket_gethostbyname(mp_obj_t nic, const char *name, mp_uint_t len, uint8_t* out_ip) {
 	if((mp_obj_type_t*)&mod_network_nic_type_esp32 != mp_obj_get_type(nic))
 	{
@@ -733,12 +780,12 @@ const mod_network_nic_type_t mod_network_nic_type_esp32 = {
     .close = esp32_socket_close,
     .sendto = esp32_socket_sendto,
     .recvfrom = esp32_socket_recvfrom,
+    .ioctl = esp32_socket_ioctl,
     /*
     .bind = cc3k_socket_bind,
     .listen = cc3k_socket_listen,
     .accept = cc3k_socket_accept,
     .setsockopt = cc3k_socket_setsockopt,
     .settimeout = cc3k_socket_settimeout,
-    .ioctl = cc3k_socket_ioctl,
 */
 };
@@ -4,6 +4,8 @@
 // #include "task.h"
 
 #include "spi_drv.h"
+#include "spi_buf_pool.h"
+#include "adapter.h"
 
 #include "trace.h"
 #include "esp_common/common.h"
@@ -83,37 +85,78 @@ static void init_ap(void)
 //struct netif *g_netif_esp32c3[2]={NULL};
 
 
+/* one per SPI pool buffer, lets lwIP hold the received frame in place */
+static struct pbuf_custom rx_pbuf[SPI_BUF_POOL_NUM];
+
+static void esp32_rx_pbuf_free(struct pbuf *p)
+{
+	struct pbuf_custom *pc = (struct pbuf_custom *)p;
+
+	spi_buf_free(spi_buf_slot(pc - rx_pbuf));
+}
+
 /**
-  * @brief Station mode rx callback
-  * @param  net_handle - station network handle
+  * @brief Pass a received frame to lwIP
+  *        SPI pool buffers are lent as PBUF_REF custom pbufs, copied into
+  *        PBUF_POOL when the pool runs low so the SPI driver keeps buffers
+  * @param  net_handle - network handle
+  *         itf - ESP32_ITF_STA or ESP32_ITF_AP
   * @retval None
   */
-static void sta_rx_callback(struct network_handle *net_handle)
+static void esp32_rx_input(struct network_handle *net_handle, int itf)
 {
 	struct esp_pbuf *rx_buffer = NULL;
-	struct netif * netif = &esp32c3_state.netif[ESP32_ITF_STA];
+	struct netif * netif = &esp32c3_state.netif[itf];
+	struct pbuf* p = NULL;
+	int index;
 
 	rx_buffer = network_read(net_handle, 0);
+	if (!rx_buffer)
+		return;
+
 	if(rx_buffer->len){
 		//print_hex_dump(rx_buffer->payload, rx_buffer->len, "sta_rx_callback recv data");	
-		/* Allocate pbuf from pool (avoid using heap in interrupts) */
-		struct pbuf* p = pbuf_alloc(PBUF_RAW, rx_buffer->len, PBUF_POOL);
+		index = spi_buf_index(rx_buffer->payload);
+		if (index >= 0 && spi_buf_pool_free() >= SPI_BUF_POOL_RESERVE) {
+			rx_pbuf[index].custom_free_function = esp32_rx_pbuf_free;
+			p = pbuf_alloced_custom(PBUF_RAW, rx_buffer->len, PBUF_REF, &rx_pbuf[index],
+									rx_buffer->payload, rx_buffer->len);
+			if (p != NULL) {
+				rx_buffer->payload = NULL; // released by esp32_rx_pbuf_free
+				spi_buf_pool_count_lent();
+			}
+		}
+
+		if (p == NULL) {
+			/* Allocate pbuf from pool (avoid using heap in interrupts) */
+			p = pbuf_alloc(PBUF_RAW, rx_buffer->len, PBUF_POOL);
+			if (p != NULL)
+				pbuf_take(p, rx_buffer->payload, rx_buffer->len);
+		}
 
 		if (p != NULL) {
-            pbuf_take(p, rx_buffer->payload, rx_buffer->len);
-            //if (netif_esp32c3.input(p, &netif_esp32c3) != ERR_OK) {
 			if (netif->input(p, netif) != ERR_OK) {
-                pbuf_free(p);
-            }
-        }
+				pbuf_free(p);
+			}
+		}
 	}
 
-	if (rx_buffer) {
-		free(rx_buffer->payload);
+	if (rx_buffer->payload) {
+		spi_buf_free(rx_buffer->payload);
 		rx_buffer->payload = NULL;
-		free(rx_buffer);
-		rx_buffer = NULL;
 	}
+	free(rx_buffer);
+	rx_buffer = NULL;
+}
+
+/**
+  * @brief Station mode rx callback
+  * @param  net_handle - station network handle
+  * @retval None
+  */
+static void sta_rx_callback(struct network_handle *net_handle)
+{
+	esp32_rx_input(net_handle, ESP32_ITF_STA);
 }
 
 /**
@@ -123,30 +166,29 @@ static void sta_rx_callback(struct network_handle *net_handle)
   */
 static void ap_rx_callback(struct network_handle *net_handle)
 {
-	struct esp_pbuf *rx_buffer = NULL;
-	struct netif * netif = &esp32c3_state.netif[ESP32_ITF_AP];
-
-	rx_buffer = network_read(net_handle, 0);
-	if(rx_buffer->len){
-		/* Allocate pbuf from pool (avoid using heap in interrupts) */
-		struct pbuf* p = pbuf_alloc(PBUF_RAW, rx_buffer->len, PBUF_POOL);
+	esp32_rx_input(net_handle, ESP32_ITF_AP);
+}
 
-		if (p != NULL) {
-            pbuf_take(p, rx_buffer->payload, rx_buffer->len);
-            //if (netif_esp32c3.input(p, &netif_esp32c3) != ERR_OK) {
-			if (netif->input(p, netif) != ERR_OK) {
-                pbuf_free(p);
-            }
-        }
-	}
+/**
+  * @brief Tx payload buffer
+  *        Taken from the SPI pool behind room for the payload header, the SPI
+  *        driver then sends it in place. From the heap when the pool runs low
+  * @param  len - payload length
+  * @retval buffer, released with spi_buf_free()
+  */
+static uint8_t *esp32_tx_payload(size_t len)
+{
+	uint8_t *buf = NULL;
 
-	if (rx_buffer) {
-		free(rx_buffer->payload);
-		rx_buffer->payload = NULL;
-		free(rx_buffer);
-		rx_buffer = NULL;
+	if (len <= MAX_SPI_BUFFER_SIZE - sizeof(struct esp_payload_header) &&
+			spi_buf_pool_free() > SPI_BUF_POOL_RESERVE) {
+		buf = spi_buf_try_alloc();
+		if (buf)
+			return buf + sizeof(struct esp_payload_header);
 	}
+	return (uint8_t *)malloc(len);
 }
+
 #define netifGUARD_BLOCK_TIME			( 250 )
 static err_t esp32_netif_output(struct netif *netif, struct pbuf *p)
 {
@@ -166,7 +208,7 @@ static err_t esp32_netif_output(struct netif *netif, struct pbuf *p)
 		assert(snd_buffer);
 		//snd_buffer->payload = p->payload;
 
-		snd_buffer->payload = (uint8_t *)malloc(p->tot_len);
+		snd_buffer->payload = esp32_tx_payload(p->tot_len);
 		assert(snd_buffer->payload);
 
 		snd_buffer->len = p->tot_len;
@@ -360,7 +402,7 @@ int esp32c3_send_ethernet(esp32c3_t *self, int itf, size_t len, const void *buf)
 	// 申请发送缓冲
 	snd_buffer = (struct esp_pbuf *)malloc(sizeof(struct esp_pbuf));
 	assert(snd_buffer);
-	snd_buffer->payload = (uint8_t *)malloc(len);
+	snd_buffer->payload = esp32_tx_payload(len);
 	assert(snd_buffer->payload);
 
 	snd_buffer->len = len;
@@ -0,0 +1,52 @@
+/** prevent recursive inclusion **/
+#ifndef __CTRL_ARENA_H
+#define __CTRL_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Includes **/
+#include <stdint.h>
+#include <stddef.h>
+#include <protobuf-c/protobuf-c.h>
+
+/** constants/macros **/
+/* Every control request and every response/event is built or unpacked in one
+ * arena block and thrown away as a whole. The block starts small and grows up
+ * to CTRL_ARENA_MAX_SIZE after a round that did not fit (a long scan list),
+ * anything beyond that comes from the heap until the next reset */
+#define CTRL_ARENA_INIT_SIZE    1024
+#define CTRL_ARENA_MAX_SIZE     (16 * 1024)
+#define CTRL_ARENA_ALIGN        8
+
+/** Exported Structures **/
+typedef struct ctrl_arena_chunk ctrl_arena_chunk_t;
+
+typedef struct {
+	ProtobufCAllocator allocator;   /* hand &arena->allocator to protobuf-c */
+	uint8_t *mem;
+	size_t size;
+	size_t used;
+	size_t want;                    /* bytes asked for since the last reset */
+	ctrl_arena_chunk_t *overflow;   /* heap blocks, freed on reset */
+	uint32_t overflow_num;          /* rounds that did not fit in the block */
+} ctrl_arena_t;
+
+/** Exported Functions **/
+void ctrl_arena_init(ctrl_arena_t *arena);
+void ctrl_arena_deinit(ctrl_arena_t *arena);
+
+/* memory until the next reset, NULL if the heap is out too */
+void *ctrl_arena_alloc(ctrl_arena_t *arena, size_t size);
+void *ctrl_arena_calloc(ctrl_arena_t *arena, size_t blk_no, size_t size);
+
+/* drop everything allocated since the last reset. Nothing from the arena may
+ * be used after this, protobuf messages unpacked into it included */
+void ctrl_arena_reset(ctrl_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+/** prevent recursive inclusion **/
+#ifndef __SPI_BUF_POOL_H
+#define __SPI_BUF_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Includes **/
+#include <stdint.h>
+#include "esp_common/common.h"
+
+/** constants/macros **/
+/* SPI transaction buffers, MAX_SPI_BUFFER_SIZE each. RX buffers are lent to
+ * lwIP as custom pbufs, so the pool has to cover what lwIP may hold on to */
+#define SPI_BUF_POOL_NUM        12
+/* lwIP only gets a buffer while this many stay free for the SPI transactions,
+ * below that received packets are copied into PBUF_POOL instead */
+#define SPI_BUF_POOL_RESERVE    3
+#define SPI_BUF_ALIGN           8
+
+/** Exported Structures **/
+typedef struct {
+	uint32_t total;
+	uint32_t free;
+	uint32_t min_free;      /* low watermark of free */
+	uint32_t alloc;         /* buffers taken from the pool */
+	uint32_t fallback;      /* pool was empty, heap used */
+	uint32_t lent;          /* rx buffers handed to lwIP without a copy */
+	uint32_t checksum_err;  /* rx frames dropped on a bad checksum */
+} spi_buf_pool_stats_t;
+
+/** Exported Functions **/
+/* allocate the pool, ESP_OK / ESP_FAIL */
+int spi_buf_pool_init(void);
+
+/* buffer from the pool, NULL when it is empty */
+uint8_t *spi_buf_try_alloc(void);
+/* buffer from the pool, or from the heap when it is empty. NULL if both fail */
+uint8_t *spi_buf_alloc(void);
+/* release a buffer. Pool buffers may be given by any pointer into them,
+ * anything else must be the start of a heap block */
+void spi_buf_free(void *ptr);
+
+/* pool slot ptr points into, -1 if it is not a pool buffer */
+int spi_buf_index(const void *ptr);
+uint8_t *spi_buf_slot(int index);
+uint32_t spi_buf_pool_free(void);
+
+void spi_buf_pool_count_lent(void);
+void spi_buf_pool_count_checksum_err(void);
+void spi_buf_pool_get_stats(spi_buf_pool_stats_t *stats);
+
+/* memcpy that adds the copied bytes to sum (the esp_hosted byte sum) */
+uint16_t spi_buf_copy_checksum(uint8_t *dst, const uint8_t *src, uint16_t len, uint16_t sum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/** Includes **/
+#include "string.h"
+#include "stdlib.h"
+
+#include "ctrl_arena.h"
+#include "platform_wrapper.h"
+
+/** Constants/Macros **/
+#define ARENA_ROUND(x, a)       (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+/** Local Structures **/
+struct ctrl_arena_chunk {
+	union {
+		ctrl_arena_chunk_t *next;
+		uint64_t align;
+	};
+};
+
+static void *arena_pb_alloc(void *allocator_data, size_t size)
+{
+	return ctrl_arena_alloc((ctrl_arena_t *)allocator_data, size);
+}
+
+static void arena_pb_free(void *allocator_data, void *data)
+{
+	/* released together on ctrl_arena_reset */
+	(void)allocator_data;
+	(void)data;
+}
+
+/**
+  * @brief  set up an empty arena, the block is allocated on first use
+  * @param  arena - arena to set up
+  * @retval None
+  */
+void ctrl_arena_init(ctrl_arena_t *arena)
+{
+	memset(arena, 0, sizeof(ctrl_arena_t));
+	arena->allocator.alloc = arena_pb_alloc;
+	arena->allocator.free = arena_pb_free;
+	arena->allocator.allocator_data = arena;
+}
+
+/**
+  * @brief  release the block and anything still allocated from the arena
+  * @param  arena - arena to release
+  * @retval None
+  */
+void ctrl_arena_deinit(ctrl_arena_t *arena)
+{
+	ctrl_arena_reset(arena);
+	if (arena->mem)
+		hosted_free(arena->mem);
+	arena->mem = NULL;
+	arena->size = 0;
+	arena->want = 0;
+}
+
+/**
+  * @brief  bump allocate from the block, fall back to the heap when it is full
+  * @param  arena - arena to allocate from
+  *         size - bytes wanted
+  * @retval memory aligned to CTRL_ARENA_ALIGN, valid until the next reset,
+  *         NULL on failure
+  */
+void *ctrl_arena_alloc(ctrl_arena_t *arena, size_t size)
+{
+	ctrl_arena_chunk_t *chunk;
+	void *ptr;
+
+	size = ARENA_ROUND(size ? size : 1, CTRL_ARENA_ALIGN);
+	arena->want += size;
+
+	if (!arena->mem) {
+		arena->mem = (uint8_t *)hosted_malloc(CTRL_ARENA_INIT_SIZE);
+		arena->size = arena->mem ? CTRL_ARENA_INIT_SIZE : 0;
+		arena->used = 0;
+	}
+
+	if (arena->mem && size <= arena->size - arena->used) {
+		ptr = arena->mem + arena->used;
+		arena->used += size;
+		return ptr;
+	}
+
+	chunk = (ctrl_arena_chunk_t *)hosted_malloc(sizeof(ctrl_arena_chunk_t) + size);
+	if (!chunk)
+		return NULL;
+	if (!arena->overflow)
+		arena->overflow_num++;
+	chunk->next = arena->overflow;
+	arena->overflow = chunk;
+	return chunk + 1;
+}
+
+void *ctrl_arena_calloc(ctrl_arena_t *arena, size_t blk_no, size_t size)
+{
+	void *ptr = ctrl_arena_alloc(arena, blk_no * size);
+
+	if (ptr)
+		memset(ptr, 0, blk_no * size);
+	return ptr;
+}
+
+/**
+  * @brief  free everything allocated since the last reset. If the round did not
+  *         fit, the block is grown so that the next one of that size does
+  * @param  arena - arena to reset
+  * @retval None
+  */
+void ctrl_arena_reset(ctrl_arena_t *arena)
+{
+	ctrl_arena_chunk_t *chunk = arena->overflow;
+
+	while (chunk) {
+		ctrl_arena_chunk_t *next = chunk->next;
+		hosted_free(chunk);
+		chunk = next;
+	}
+	arena->overflow = NULL;
+
+	if (arena->mem && arena->want > arena->size && arena->size < CTRL_ARENA_MAX_SIZE) {
+		size_t size = ARENA_ROUND(arena->want, 1024);
+		uint8_t *mem;
+
+		if (size > CTRL_ARENA_MAX_SIZE)
+			size = CTRL_ARENA_MAX_SIZE;
+		/* old block first, it is what the new one is most likely to fit in */
+		hosted_free(arena->mem);
+		mem = (uint8_t *)hosted_malloc(size);
+		if (mem) {
+			arena->mem = mem;
+			arena->size = size;
+		} else {
+			arena->mem = (uint8_t *)hosted_malloc(arena->size);
+			if (!arena->mem)
+				arena->size = 0;
+		}
+	}
+
+	arena->used = 0;
+	arena->want = 0;
+}
@@ -8,6 +8,7 @@
 #include "serial_if.h"
 #include "platform_wrapper.h"
 #include "esp_queue.h"
+#include "ctrl_arena.h"
 #include <unistd.h>
 
 
@@ -76,14 +77,13 @@
 
 #define CTRL_ALLOC_ASSIGN(TyPe,MsG_StRuCt)                                    \
     TyPe *req_payload = (TyPe *)                                              \
-        hosted_calloc(1, sizeof(TyPe));                                       \
+        ctrl_arena_calloc(&tx_arena, 1, sizeof(TyPe));                        \
     if (!req_payload) {                                                       \
         command_log("Failed to allocate memory for req.%s\n",#MsG_StRuCt);    \
 		failure_status = CTRL_ERR_MEMORY_FAILURE;                             \
         goto fail_req;                                                        \
     }                                                                         \
-    req.MsG_StRuCt = req_payload;                                             \
-	buff_to_free1 = (uint8_t*)req_payload;
+    req.MsG_StRuCt = req_payload;
 
 struct ctrl_lib_context {
 	int state;
@@ -98,6 +98,13 @@ static void * ctrl_req_sem;
 static void * async_timer_handle;
 static struct ctrl_lib_context ctrl_lib_ctxt;
 
+/* Protobuf memory. tx_arena holds the request being composed and its packed
+ * bytes, it belongs to whoever holds ctrl_req_sem. rx_arena holds the msg being
+ * unpacked and is only touched by ctrl_rx_thread. Both are reset per msg, so
+ * nothing protobuf allocated may be kept past that */
+static ctrl_arena_t tx_arena;
+static ctrl_arena_t rx_arena;
+
 static int call_event_callback(ctrl_cmd_t *app_event);
 static int is_async_resp_callback_registered_by_resp_msg_id(int resp_msg_id);
 static int call_async_resp_callback(ctrl_cmd_t *app_resp);
@@ -262,12 +269,12 @@ static int ctrl_app_parse_event(CtrlMsg *ctrl_msg, ctrl_cmd_t *app_ntfy)
 		}
 	}
 
-	ctrl_msg__free_unpacked(ctrl_msg, NULL);
+	ctrl_msg__free_unpacked(ctrl_msg, &rx_arena.allocator);
 	ctrl_msg = NULL;
 	return SUCCESS;
 
 fail_parse_ctrl_msg:
-	ctrl_msg__free_unpacked(ctrl_msg, NULL);
+	ctrl_msg__free_unpacked(ctrl_msg, &rx_arena.allocator);
 	ctrl_msg = NULL;
 	app_ntfy->resp_event_status = FAILURE;
 	return FAILURE;
@@ -592,20 +599,20 @@ static int ctrl_app_parse_resp(CtrlMsg *ctrl_msg, ctrl_cmd_t *app_resp)
 	}
 
 	/* 4. Free up buffers */
-	ctrl_msg__free_unpacked(ctrl_msg, NULL);
+	ctrl_msg__free_unpacked(ctrl_msg, &rx_arena.allocator);
 	ctrl_msg = NULL;
 	app_resp->resp_event_status = SUCCESS;
 	return SUCCESS;
 
 	/* 5. Free up buffers in failure cases */
 fail_parse_ctrl_msg:
-	ctrl_msg__free_unpacked(ctrl_msg, NULL);
+	ctrl_msg__free_unpacked(ctrl_msg, &rx_arena.allocator);
 	ctrl_msg = NULL;
 	app_resp->resp_event_status = FAILURE;
 	return FAILURE;
 
 fail_parse_ctrl_msg2:
-	ctrl_msg__free_unpacked(ctrl_msg, NULL);
+	ctrl_msg__free_unpacked(ctrl_msg, &rx_arena.allocator);
 	ctrl_msg = NULL;
 	return FAILURE;
 }
@@ -768,7 +775,7 @@ free_buffers:
 	esp_mem_free(elem);
 	esp_mem_free(app_event);
 	if (proto_msg) {
-		ctrl_msg__free_unpacked(proto_msg, NULL);
+		ctrl_msg__free_unpacked(proto_msg, &rx_arena.allocator);
 		proto_msg = NULL;
 	}
 	return FAILURE;
@@ -821,24 +828,27 @@ static void ctrl_rx_thread(void const *arg)
 		}
 
 		/* 4.2 Decode protobuf */
-		resp = ctrl_msg__unpack(NULL, buf_len, buf);
+		resp = ctrl_msg__unpack(&rx_arena.allocator, buf_len, buf);
 		if (!resp) {
 			goto free_bufs;
 		}
 		/* 4.3 Free the read buffer */
 		esp_mem_free(buf);
 
-		/* 4.4 Send for further processing as event or response */
+		/* 4.4 Send for further processing as event or response.
+		 * Everything needed is copied into app structs there */
 		process_ctrl_rx_msg(resp, ctrl_rx_func);
+		ctrl_arena_reset(&rx_arena);
 		continue;
 
 		/* 5. cleanup */
 free_bufs:
 		esp_mem_free(buf);
 		if (resp) {
-			ctrl_msg__free_unpacked(resp, NULL);
+			ctrl_msg__free_unpacked(resp, &rx_arena.allocator);
 			resp = NULL;
 		}
+		ctrl_arena_reset(&rx_arena);
 	}
 }
 
@@ -1106,8 +1116,6 @@ int ctrl_app_send_req(ctrl_cmd_t *app_req)
 	CtrlMsg   req = {0};
 	uint32_t  tx_len = 0;
 	uint8_t  *tx_data = NULL;
-	uint8_t  *buff_to_free1 = NULL;
-	void     *buff_to_free2 = NULL;
 	uint8_t   failure_status = 0;
 
 
@@ -1125,6 +1133,8 @@ int ctrl_app_send_req(ctrl_cmd_t *app_req)
 		failure_status = CTRL_ERR_REQ_IN_PROG;
 		goto fail_req;
 	}
+	/* start from an empty arena whatever the last holder left in it */
+	ctrl_arena_reset(&tx_arena);
 
 	app_req->msg_type = CTRL_REQ;
 
@@ -1256,13 +1266,13 @@ int ctrl_app_send_req(ctrl_cmd_t *app_req)
 			req_payload->type = (CtrlVendorIEType) p->type;
 			req_payload->idx = (CtrlVendorIEID) p->idx;
 
-			req_payload->vendor_ie_data = (CtrlMsgReqVendorIEData *)hosted_malloc(sizeof(CtrlMsgReqVendorIEData));
+			req_payload->vendor_ie_data = (CtrlMsgReqVendorIEData *)
+				ctrl_arena_alloc(&tx_arena, sizeof(CtrlMsgReqVendorIEData));
 
 			if (!req_payload->vendor_ie_data) {
 				command_log("Mem alloc fail\n");
 				goto fail_req;
 			}
-			buff_to_free2 = req_payload->vendor_ie_data;
 
 			ctrl_msg__req__vendor_iedata__init(req_payload->vendor_ie_data);
 
@@ -1395,8 +1405,8 @@ int ctrl_app_send_req(ctrl_cmd_t *app_req)
 		goto fail_req;
 	}
 
-	/* 5. Allocate protobuf msg */
-	tx_data = (uint8_t *)hosted_calloc(1, tx_len);
+	/* 5. Allocate protobuf msg, transport_pserial_send copies it */
+	tx_data = (uint8_t *)ctrl_arena_alloc(&tx_arena, tx_len);
 	if (!tx_data) {
 		command_log("Failed to allocate memory for tx_data\n");
 		failure_status = CTRL_ERR_MEMORY_FAILURE;
@@ -1444,10 +1454,8 @@ int ctrl_app_send_req(ctrl_cmd_t *app_req)
 		}
 	}
 
-	/* 10. Cleanup */
-	esp_mem_free(tx_data);
-	esp_mem_free(buff_to_free2);
-	esp_mem_free(buff_to_free1);
+	/* 10. Cleanup. tx_arena is left as it is: the response may already have
+	 * released ctrl_req_sem to the next request, which resets it on entry */
 	return SUCCESS;
 
 fail_req:
@@ -1481,9 +1489,6 @@ fail_req2:
 		}
 	}
 
-	esp_mem_free(tx_data);
-	esp_mem_free(buff_to_free2);
-	esp_mem_free(buff_to_free1);
 	return FAILURE;
 }
 
@@ -1527,6 +1532,9 @@ int deinit_hosted_control_lib_internal(void)
 		printf("cancel ctrl rx thread failed\n");
 	}
 
+	ctrl_arena_deinit(&tx_arena);
+	ctrl_arena_deinit(&rx_arena);
+
 	return ret;
 }
 
@@ -1541,6 +1549,10 @@ int init_hosted_control_lib_internal(void)
 	}
 #endif
 
+	/* protobuf arenas */
+	ctrl_arena_init(&tx_arena);
+	ctrl_arena_init(&rx_arena);
+
 	/* semaphore init */
 	read_sem = hosted_create_semaphore(1);
 	ctrl_req_sem = hosted_create_semaphore(1);
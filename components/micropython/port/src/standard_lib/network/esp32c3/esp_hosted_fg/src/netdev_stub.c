@@ -19,6 +19,7 @@
 #include "netdev_if.h"
 //#include "app_main.h"
 #include "netdev_stub.h"
+#include "spi_buf_pool.h"
 // #include "esp_common/common.h"
 // #include "netdev_api.h"
 
@@ -275,7 +276,7 @@ int netdev_rx(netdev_handle_t dev, struct esp_pbuf *net_buf)
 done:
 	if (net_buf) {
 		if (net_buf->payload) {
-			free(net_buf->payload);
+			spi_buf_free(net_buf->payload);
 			net_buf->payload = NULL;
 		}
 		free(net_buf);
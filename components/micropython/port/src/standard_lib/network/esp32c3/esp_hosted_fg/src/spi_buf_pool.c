@@ -0,0 +1,145 @@
+/** Includes **/
+#include "string.h"
+#include "stdlib.h"
+
+#include "spi_buf_pool.h"
+#include "platform_wrapper.h"
+
+/** Constants/Macros **/
+#define SPI_BUF_STRIDE ((MAX_SPI_BUFFER_SIZE + SPI_BUF_ALIGN - 1) & ~(SPI_BUF_ALIGN - 1))
+
+/** Local variables **/
+static uint8_t *pool_mem = NULL;
+static uint8_t *free_list[SPI_BUF_POOL_NUM];
+static uint32_t free_num = 0;
+static spi_buf_pool_stats_t pool_stats;
+
+static uint8_t *spi_buf_base(void)
+{
+	return (uint8_t *)(((uintptr_t)pool_mem + SPI_BUF_ALIGN - 1) & ~(uintptr_t)(SPI_BUF_ALIGN - 1));
+}
+
+/**
+  * @brief  allocate the buffer pool, one block for all buffers
+  * @param  None
+  * @retval ESP_OK / ESP_FAIL
+  */
+int spi_buf_pool_init(void)
+{
+	if (pool_mem)
+		return ESP_OK;
+
+	pool_mem = (uint8_t *)malloc(SPI_BUF_STRIDE * SPI_BUF_POOL_NUM + SPI_BUF_ALIGN);
+	if (!pool_mem) {
+		printf("spi buffer pool alloc failed\n\r");
+		return ESP_FAIL;
+	}
+
+	memset(&pool_stats, 0, sizeof(pool_stats));
+	for (int i = 0; i < SPI_BUF_POOL_NUM; i++)
+		free_list[i] = spi_buf_slot(i);
+	free_num = SPI_BUF_POOL_NUM;
+	pool_stats.total = SPI_BUF_POOL_NUM;
+	pool_stats.min_free = SPI_BUF_POOL_NUM;
+
+	return ESP_OK;
+}
+
+int spi_buf_index(const void *ptr)
+{
+	const uint8_t *p = (const uint8_t *)ptr;
+	uint8_t *base;
+
+	if (!pool_mem || !p)
+		return -1;
+	base = spi_buf_base();
+	if (p < base || p >= base + SPI_BUF_STRIDE * SPI_BUF_POOL_NUM)
+		return -1;
+	return (p - base) / SPI_BUF_STRIDE;
+}
+
+uint8_t *spi_buf_slot(int index)
+{
+	if (!pool_mem || index < 0 || index >= SPI_BUF_POOL_NUM)
+		return NULL;
+	return spi_buf_base() + index * SPI_BUF_STRIDE;
+}
+
+uint8_t *spi_buf_try_alloc(void)
+{
+	uint8_t *buf = NULL;
+
+	taskENTER_CRITICAL();
+	if (free_num) {
+		buf = free_list[--free_num];
+		pool_stats.alloc++;
+		if (free_num < pool_stats.min_free)
+			pool_stats.min_free = free_num;
+	}
+	taskEXIT_CRITICAL();
+
+	return buf;
+}
+
+uint8_t *spi_buf_alloc(void)
+{
+	uint8_t *buf = spi_buf_try_alloc();
+
+	if (!buf) {
+		buf = (uint8_t *)malloc(MAX_SPI_BUFFER_SIZE);
+		taskENTER_CRITICAL();
+		pool_stats.fallback++;
+		taskEXIT_CRITICAL();
+	}
+	return buf;
+}
+
+void spi_buf_free(void *ptr)
+{
+	int index = spi_buf_index(ptr);
+
+	if (index < 0) {
+		free(ptr);
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	free_list[free_num++] = spi_buf_slot(index);
+	taskEXIT_CRITICAL();
+}
+
+uint32_t spi_buf_pool_free(void)
+{
+	return free_num;
+}
+
+void spi_buf_pool_count_lent(void)
+{
+	taskENTER_CRITICAL();
+	pool_stats.lent++;
+	taskEXIT_CRITICAL();
+}
+
+void spi_buf_pool_count_checksum_err(void)
+{
+	taskENTER_CRITICAL();
+	pool_stats.checksum_err++;
+	taskEXIT_CRITICAL();
+}
+
+void spi_buf_pool_get_stats(spi_buf_pool_stats_t *stats)
+{
+	taskENTER_CRITICAL();
+	*stats = pool_stats;
+	stats->free = free_num;
+	taskEXIT_CRITICAL();
+}
+
+uint16_t spi_buf_copy_checksum(uint8_t *dst, const uint8_t *src, uint16_t len, uint16_t sum)
+{
+	for (uint16_t i = 0; i < len; i++) {
+		dst[i] = src[i];
+		sum += src[i];
+	}
+	return sum;
+}
@@ -20,6 +20,7 @@
 #include "adapter.h"
 #include "serial_drv.h"
 #include "netdev_if.h"
+#include "spi_buf_pool.h"
 
 #include "platform_wrapper.h"
 #include "fpioa.h"
@@ -95,6 +96,9 @@ static thread_handle_t transaction_task_id = 0;
 static QueueHandle_t to_slave_queue = NULL;
 static QueueHandle_t from_slave_queue = NULL;
 
+/* clocked out when the host has nothing to send, only ever read by the DMA */
+static uint8_t dummy_txbuff[MAX_SPI_BUFFER_SIZE] __attribute__((aligned(SPI_BUF_ALIGN)));
+
 /* callback of event handler */
 //static void (*spi_drv_evt_handler_fp) (uint8_t);
 
@@ -327,6 +331,9 @@ void stm_spi_init(void)
     // gpiohs_set_pin(ESP_SPI_CS_GPIO, GPIO_PV_HIGH);
 	set_spi_pin();
 
+	retval = spi_buf_pool_init();
+	assert(retval==ESP_OK);
+
 	fpioa_set_function(DATA_READY_PIN, FUNC_GPIOHS0 + DATA_READY_GPIO); //ready pin
 	gpiohs_set_drive_mode(DATA_READY_GPIO, GPIO_DM_INPUT_PULL_DOWN);
     gpiohs_set_pin_edge(DATA_READY_GPIO, GPIO_PE_RISING);
@@ -469,7 +476,7 @@ stm_ret_t send_to_slave(uint8_t iface_type, uint8_t iface_num,
 		printf("write fail: buff(%p) 0? OR (0<len(%u)<=max_poss_len(%lu))?\n\r",
 				wbuffer, wlen, MAX_PAYLOAD_SIZE);
 		if(wbuffer) {
-			free(wbuffer);
+			spi_buf_free(wbuffer);
 			wbuffer = NULL;
 		}
 		return ESP_FAIL;
@@ -481,12 +488,12 @@ stm_ret_t send_to_slave(uint8_t iface_type, uint8_t iface_num,
 	buf_handle.payload_len = wlen;
 	buf_handle.payload = wbuffer;
 	buf_handle.priv_buffer_handle = wbuffer;
-	buf_handle.free_buf_handle = free;
+	buf_handle.free_buf_handle = spi_buf_free;
 
 	if (pdTRUE != xQueueSend(to_slave_queue, &buf_handle, portMAX_DELAY)) {
 		printf("Failed to send buffer to_slave_queue\n\r");
 		if(wbuffer) {
-			free(wbuffer);
+			spi_buf_free(wbuffer);
 			wbuffer = NULL;
 		}
 		return ESP_FAIL;
@@ -534,18 +541,15 @@ static stm_ret_t spi_transaction_v2(uint8_t * txbuff)
 	//HAL_StatusTypeDef retval = HAL_ERROR;
 	uint16_t rx_checksum = 0, checksum = 0;
 
-	/* Allocate rx buffer */
-	rxbuff = (uint8_t *)malloc(MAX_SPI_BUFFER_SIZE);
+	/* Rx buffer from the pool, the DMA writes all of it, no memset needed */
+	rxbuff = spi_buf_alloc();
 	assert(rxbuff);
-	memset(rxbuff, 0, MAX_SPI_BUFFER_SIZE);
 
 	if(!txbuff) {
 		/* Even though, there is nothing to send,
 		 * valid reseted txbuff is needed for SPI driver
 		 */
-		txbuff = (uint8_t *)malloc(MAX_SPI_BUFFER_SIZE);
-		assert(txbuff);
-		memset(txbuff, 0, MAX_SPI_BUFFER_SIZE);
+		txbuff = dummy_txbuff;
 	}
 
 	/* SPI transaction */
@@ -587,7 +591,7 @@ static stm_ret_t spi_transaction_v2(uint8_t * txbuff)
 				 * */
 				//ESP_DEBUG("spi_trans-- rxbuff:0x%x\r\n", rxbuff);
 				if (rxbuff) {
-					free(rxbuff);
+					spi_buf_free(rxbuff);
 					rxbuff = NULL;
 				}
 				/* Give chance to other tasks */
@@ -601,7 +605,7 @@ static stm_ret_t spi_transaction_v2(uint8_t * txbuff)
 
 				if (checksum == rx_checksum) {
 					buf_handle.priv_buffer_handle = rxbuff;
-					buf_handle.free_buf_handle = free;
+					buf_handle.free_buf_handle = spi_buf_free;
 					buf_handle.payload_len = len;
 					buf_handle.if_type     = payload_header->if_type;
 					buf_handle.if_num      = payload_header->if_num;
@@ -615,16 +619,17 @@ static stm_ret_t spi_transaction_v2(uint8_t * txbuff)
 						goto done;
 					}
 				} else {
+					spi_buf_pool_count_checksum_err();
 					if (rxbuff) {
-						free(rxbuff);
+						spi_buf_free(rxbuff);
 						rxbuff = NULL;
 					}
 				}
 			}
 
 			/* Free input TX buffer */
-			if (txbuff) {
-				free(txbuff);
+			if (txbuff && txbuff != dummy_txbuff) {
+				spi_buf_free(txbuff);
 				txbuff = NULL;
 			}
 	// 		break;
@@ -648,13 +653,13 @@ static stm_ret_t spi_transaction_v2(uint8_t * txbuff)
 
 done:
 	/* error cases, abort */
-	if (txbuff) {
-		free(txbuff);
+	if (txbuff && txbuff != dummy_txbuff) {
+		spi_buf_free(txbuff);
 		txbuff = NULL;
 	}
 
 	if (rxbuff) {
-		free(rxbuff);
+		spi_buf_free(rxbuff);
 		rxbuff = NULL;
 	}
 	return ESP_FAIL;
@@ -730,11 +735,18 @@ static void process_rx_task(void const* pvParameters)
 				assert(buffer);
 
 				buffer->len = buf_handle.payload_len;
-				buffer->payload = malloc(buf_handle.payload_len);
-				assert(buffer->payload);
+				if (spi_buf_index(buf_handle.priv_buffer_handle) >= 0) {
+					/* Lend the SPI buffer itself, whoever reads it
+					 * from the netdev releases it with spi_buf_free() */
+					buffer->payload = buf_handle.payload;
+					buf_handle.free_buf_handle = NULL;
+				} else {
+					buffer->payload = malloc(buf_handle.payload_len);
+					assert(buffer->payload);
 
-				memcpy(buffer->payload, buf_handle.payload,
-						buf_handle.payload_len);
+					memcpy(buffer->payload, buf_handle.payload,
+							buf_handle.payload_len);
+				}
 
 				netdev_rx(priv->netdev, buffer); // 调用 sta_rx_cb, ap_rx_cb
 			}
@@ -777,6 +789,8 @@ static uint8_t * get_tx_buffer(uint8_t *is_valid_tx_buf)
 	uint8_t *sendbuf = NULL;
 	uint8_t *payload = NULL;
 	uint16_t len = 0;
+	uint16_t checksum = 0;
+	int index = -1;
 	interface_buffer_handle_t buf_handle = {0};
 
 	*is_valid_tx_buf = 0;
@@ -792,13 +806,24 @@ static uint8_t * get_tx_buffer(uint8_t *is_valid_tx_buf)
 
 	if (len) {
 
-		sendbuf = (uint8_t *) malloc(MAX_SPI_BUFFER_SIZE);
-		if (!sendbuf) {
-			printf("malloc failed\n\r");
-			goto done;
+		index = spi_buf_index(buf_handle.payload);
+		if ((index >= 0) && (buf_handle.payload ==
+				spi_buf_slot(index) + sizeof(struct esp_payload_header))) {
+			/* Payload was built in a pool buffer behind room for
+			 * the header, send it in place */
+			sendbuf = spi_buf_slot(index);
+			buf_handle.free_buf_handle = NULL;
+		} else {
+			sendbuf = spi_buf_alloc();
+			if (!sendbuf) {
+				printf("malloc failed\n\r");
+				goto done;
+			}
+			index = -1;
 		}
 
-		memset(sendbuf, 0, MAX_SPI_BUFFER_SIZE);
+		/* Only the header needs clearing, the slave stops at len */
+		memset(sendbuf, 0, sizeof(struct esp_payload_header));
 
 		*is_valid_tx_buf = 1;
 
@@ -809,9 +834,17 @@ static uint8_t * get_tx_buffer(uint8_t *is_valid_tx_buf)
 		payload_header->offset  = htole16(sizeof(struct esp_payload_header));
 		payload_header->if_type = buf_handle.if_type;
 		payload_header->if_num  = buf_handle.if_num;
-		memcpy(payload, buf_handle.payload, min(len, MAX_PAYLOAD_SIZE));
-		payload_header->checksum = htole16(compute_checksum(sendbuf,
-				sizeof(struct esp_payload_header)+len));
+		if (index >= 0) {
+			checksum = compute_checksum(sendbuf,
+					sizeof(struct esp_payload_header)+len);
+		} else {
+			/* Checksum the payload while copying it */
+			checksum = compute_checksum(sendbuf,
+					sizeof(struct esp_payload_header));
+			checksum = spi_buf_copy_checksum(payload, buf_handle.payload,
+					min(len, MAX_PAYLOAD_SIZE), checksum);
+		}
+		payload_header->checksum = htole16(checksum);
 		//print_hex_dump(sendbuf, 12+len, "SPI send data");	
 	}
 
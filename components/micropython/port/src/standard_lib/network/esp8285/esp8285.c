@@ -42,65 +42,9 @@
 #include "sleep.h"
 
 
-STATIC void kmp_get_next(const char* targe, int next[])
-{  
-    int targe_Len = strlen(targe);  
-    next[0] = -1;  
-    int k = -1;  
-    int j = 0;  
-    while (j < targe_Len - 1)  
-    {     
-        if (k == -1 || targe[j] == targe[k])  
-        {  
-            ++j;  
-            ++k;   
-            if (targe[j] != targe[k])  
-                next[j] = k;    
-            else   
-                next[j] = next[k];  
-        }  
-        else  
-        {  
-            k = next[k];  
-        }  
-    }  
-}  
-STATIC int kmp_match(char* src,int src_len, const char* targe, int* next)  
-{  
-    int i = 0;  
-    int j = 0;  
-    int sLen = src_len;  
-    int pLen = strlen(targe);  
-    while (i < sLen && j < pLen)  
-    {     
-        if (j == -1 || src[i] == targe[j])  
-        {  
-            i++;  
-            j++;  
-        }  
-        else  
-        {       
-            j = next[j];  
-        }  
-    }  
-    if (j == pLen)  
-        return i - j;  
-    else  
-        return -1;  
-} 
-STATIC uint32_t kmp_find(char* src,uint32_t src_len, const char* tagert)
-{
-	uint32_t index = 0;
-	uint32_t tag_len = strlen(tagert);
-	int* next = (int*)malloc(sizeof(uint32_t) * tag_len);
-	kmp_get_next(tagert,next);
-	index = kmp_match(src,src_len,tagert, next);
-	free(next);
-	return index;
-}
-STATIC uint32_t data_find(uint8_t* src,uint32_t src_len, const char* tagert)
-{
-	return kmp_find((char*)src,src_len,tagert);
+STATIC int32_t data_find(uint8_t* src,uint32_t src_len, const char* tagert)
+{
+	return at_find(src,src_len,tagert);
 }
 
 bool kick(esp8285_obj* nic)
@@ -268,7 +212,9 @@ bool get_host_byname(esp8285_obj* nic, const char* host,uint32_t len,char* out_i
 		return false;
 	}
 	char IP_buf[16]={0};
-	index = data_find(nic->buffer.buffer,ESP8285_BUF_SIZE,"+CIPDOMAIN:");
+	index = data_find(nic->buffer.buffer,nic->resp_len,"+CIPDOMAIN:");
+	if(index < 0)
+		return false;
 	sscanf((char*)nic->buffer.buffer + index,"+CIPDOMAIN:%s",IP_buf);
 	mp_obj_t IP = mp_obj_new_str(IP_buf, strlen(IP_buf));
 	nlr_buf_t nlr;
@@ -373,6 +319,18 @@ uint32_t esp_recv_mul_id(esp8285_obj* nic,char* coming_mux_id, char* buffer, uin
 
 #include "printf.h"
 
+// only for single socket but need socket map & buffer TODO:
+static at_ipd_t recv_ipd;
+static bool recv_ipd_init = false;
+
+#define ESP8285_RECV_GAP_MS 5 // UART quiet this long after data, return what has come
+
+bool esp_recv_ready(esp8285_obj *nic)
+{
+    // UART bytes may be an AT status rather than +IPD, that's a spurious wakeup at worst
+    return Buffer_Size(&nic->buffer) > 0 || uart_rx_any(nic->uart_obj) > 0 || (recv_ipd_init && recv_ipd.closed);
+}
+
 /*----------------------------------------------------------------------------*/
 /* +IPD,<id>,<len>:<data> */
 /* +IPD,<len>:<data> */
@@ -382,251 +340,95 @@ uint32_t esp_recv_mul_id(esp8285_obj* nic,char* coming_mux_id, char* buffer, uin
  */
 uint32_t recvPkg(esp8285_obj *nic, char *out_buff, uint32_t out_buff_len, uint32_t *data_len, uint32_t timeout, char *coming_mux_id, bool *peer_closed, bool first_time_recv)
 {
-    // printk("%s | head obl %d *dl %d tu %d ftr %d peer_closed %d coming_mux_id %d\n", __func__, out_buff_len, *data_len, timeout, first_time_recv);
-    // printk("peer_closed %d coming_mux_id %d\r\n");
+    int err = 0;
+    uint32_t size = 0, got = 0;
 
-    int err = 0, size = 0;
-
-    // only for single socket but need socket map & buffer TODO:
     const mp_stream_p_t *uart_stream = mp_get_stream(nic->uart_obj);
-    static bool socket_eof = false;
-    static int8_t mux_id = -1;
-    static int32_t frame_sum = 0, frame_len = 0, frame_bak = 0;
+    at_ipd_t *ipd = &recv_ipd;
+    static uint8_t tmp_buf[1560 * 2];
 
     // parameters check
     if (out_buff == NULL) {
         return -1;
     }
-    
-    if (first_time_recv) {
-        frame_sum = frame_len = 0;
-        socket_eof = false;
+
+    if (first_time_recv || !recv_ipd_init) {
+        at_ipd_init(ipd);
+        recv_ipd_init = true;
     }
 
-    // required data already in buf, just return data
+    // data left over from the last call comes first
     size = Buffer_Size(&nic->buffer);
-    
-    if (size >= out_buff_len) {
-        Buffer_Gets(&nic->buffer, (uint8_t *)out_buff, out_buff_len);
-        if (data_len) {
-            *data_len = out_buff_len;
-        }
-        size = size > out_buff_len ? out_buff_len : size;
-        frame_sum -= size;
-        // printk("Buffer_Size frame_sum %d size %d *data_len %d\n", frame_sum, size, *data_len);
-
-        return size;
-    }
+    got = size > out_buff_len ? out_buff_len : size;
+    Buffer_Gets(&nic->buffer, (uint8_t *)out_buff, got);
 
-    if (frame_sum <= 0 && socket_eof) {
+    if (got == 0 && ipd->closed) { //buffer empty, return EOF
         Buffer_Clear(&nic->buffer);
-        if (socket_eof) { //buffer empty, return EOF
-            return -2;
-        }
+        return -2;
     }
 
-    enum fsm_state { IDLE, IPD, DATA, EXIT } State = IDLE;
-    static uint8_t tmp_buf[1560 * 2] = {0}; // tmp_buf as queue 1560
-    uint32_t tmp_bak = 0, tmp_state = 0, tmp_len = 0, tmp_pos = 0, tmp_eof = 0;
-    mp_uint_t interrupt = mp_hal_ticks_ms(), uart_recv_len = 0, res = 0;
-    while (socket_eof == false && State != EXIT) {
-        // wait any uart data
-        uart_recv_len = uart_rx_any(nic->uart_obj);
-        // printk("uart_recv_len %d\n", uart_recv_len);
-        if (uart_recv_len > 0) {
-
-            if (tmp_len >= sizeof(tmp_buf)) { // lock across
-                // printk("lock across frame_len %d tmp_len %d\n", frame_len, tmp_len);
-                tmp_len = 0;
-            }
-
-            res = uart_stream->read(nic->uart_obj, tmp_buf + tmp_len, 1, &err);
-            // printk("%s | tmp_buf %s res %d err %d\n", __func__, tmp_buf, res, err);
-            if (res == 1 && err == 0) {
-                
-                interrupt = mp_hal_ticks_ms();
-                // backup tmp_len to tmp_pos (tmp_pos - 1)
-
-                tmp_pos = tmp_len, tmp_len += 1; // buffer push
-                // printk("[%02X]", tmp_buf[tmp_pos]);
-
-                if (State == IDLE) {
-                    if (tmp_buf[tmp_pos] == '+') {
-                        tmp_state = 1, tmp_bak = tmp_pos, State = IPD;
-                        continue;
-                    } else {
-                        // printk("other (%02X)\n", tmp_buf[tmp_pos]);
-                        tmp_len -= 1; // clear don't need data, such as (0D)(0A)
-                        continue;
-                    }
-                    continue;
-                }
-
-                if (State == IPD) {
-
-                    if (tmp_pos - tmp_bak > 12) { // Over the length of the '+IPD,3,1452:' or '+IPD,1452:'
-                        tmp_state = 0, State = IDLE;
-                        continue;
-                    }
-
-                    if (0 < tmp_state && tmp_state < 5) {
-                        // printk("(%d, %02X) [%d, %02X]\n", tmp_pos, tmp_buf[tmp_pos], tmp_pos - tmp_bak, ("+IPD,")[tmp_pos - tmp_bak]);
-                        if (tmp_buf[tmp_pos] == ("+IPD,")[tmp_pos - tmp_bak]) {
-                            tmp_state += 1; // tmp_state 1 + "IPD," to tmp_state 5
-                        } else {
-                            tmp_state = 0, State = IDLE;
-                        }
-                        continue;
-                    }
-
-                    if (tmp_state == 5 && tmp_buf[tmp_pos] == ':')
-                    {
-                        tmp_state = 6, State = IDLE;
-                        tmp_buf[tmp_pos + 1] = '\0'; // lock tmp_buf
-                        // printk("%s | is `IPD` tmp_bak %d tmp_len %d command %s\n", __func__, tmp_bak, tmp_len, tmp_buf + tmp_bak);
-                        char *index = strstr((char *)tmp_buf + tmp_bak + 5 /* 5 > '+IPD,' and `+IPD,325:` in tmp_buf */, ",");
-                        int ret = 0, len = 0;
-                        if (index) { // '+IPD,3,1452:'
-                            ret = sscanf((char *)tmp_buf + tmp_bak, "+IPD,%hhd,%d:", &mux_id, &len);
-                            if (ret != 2 || mux_id < 0 || mux_id > 4 || len <= 0) {
-                                ; // Misjudge or fail, return, or clean up later
-                            } else {
-                                tmp_len = tmp_bak, tmp_bak = 0; // Clean up the commands in the buffer and roll back the data
-                                frame_len = len, State = DATA;
-                            }
-                        } else { // '+IPD,1452:'
-                            ret = sscanf((char *)tmp_buf + tmp_bak, "+IPD,%d:", &len);
-                            if (ret != 1 || len <= 0) {
-                                ; // Misjudge or fail, return, or clean up later
-                            } else {
-                                tmp_len = tmp_bak, tmp_bak = 0; // Clean up the commands in the buffer and roll back the data
-                                frame_len = len, State = DATA;
-                                // printk("%s | IPD frame_len %d\n", __func__, frame_len);
-                            }
-                        }
-                        continue;
-                    }
+    // read whatever the UART holds in one go, payload goes straight to out_buff, the rest of a frame to nic->buffer
+    mp_uint_t interrupt = mp_hal_ticks_ms();
+    while (!ipd->closed && got < out_buff_len) {
+        uint32_t avail = uart_rx_any(nic->uart_obj);
+        if (avail > 0) {
+            uint32_t room = (out_buff_len - got) + (ESP8285_BUF_SIZE - 1 - Buffer_Size(&nic->buffer));
+            if (avail > sizeof(tmp_buf))
+                avail = sizeof(tmp_buf);
+            if (avail > room)
+                avail = room;
+            if (avail == 0)
+                break;
+            mp_uint_t res = uart_stream->read(nic->uart_obj, tmp_buf, avail, &err);
+            if (res == MP_STREAM_ERROR || res == 0 || err != 0)
+                break;
+            interrupt = mp_hal_ticks_ms();
+
+            const uint8_t *data = tmp_buf;
+            while (res > 0) {
+                const uint8_t *payload;
+                uint32_t payload_len, n;
+                n = at_ipd_parse(ipd, data, res, &payload, &payload_len);
+                data += n, res -= n;
+                if (payload_len == 0)
                     continue;
+                if (coming_mux_id)
+                    *coming_mux_id = ipd->mux_id;
+                n = out_buff_len - got;
+                if (n > payload_len)
+                    n = payload_len;
+                memcpy(out_buff + got, payload, n);
+                got += n;
+                if (payload_len > n && !Buffer_Puts(&nic->buffer, (uint8_t *)payload + n, payload_len - n)) {
+                    printk("%s | network->buffer overflow Buffer Max %d Size %d\n", __func__, ESP8285_BUF_SIZE, Buffer_Size(&nic->buffer));
                 }
-
-                if (State == DATA) {
-                    // printk("%s | frame_len %d tmp_len %d tmp_buf[tmp_pos] %02X\n", __func__, frame_len, tmp_len, tmp_buf[tmp_pos]);
-                    
-                    frame_len -= tmp_len, tmp_len = 0; // get data
-
-                    if (frame_len < 0) { // already frame_len - tmp_len before (not frame_len <= 0)
-                        tmp_eof = 0;
-                        if (frame_len == -1 && tmp_buf[tmp_pos] == 'C') { // wait "CLOSED\r\n"
-                            frame_bak = frame_len;
-                            tmp_state = 7;
-                            continue;
-                        }
-                        if (tmp_state == 6 && tmp_buf[tmp_pos] == '\r') {
-                            tmp_state = 7;
-                            continue;
-                        }
-                        if (tmp_state == 7 && tmp_buf[tmp_pos] == '\n') {
-                            if (frame_len == -2) { // match +IPD EOF （\r\n）
-                                tmp_state = 0, State = IDLE;
-                                // After receive complete, confirm the data is enough
-                                size = Buffer_Size(&nic->buffer);
-                                // printk("%s | size %d out_buff_len %d\n", __func__, size, out_buff_len);
-                                if (size >= out_buff_len) { // data enough
-                                    // printk("%s | recv out_buff_len overflow\n", __func__);
-                                    State = EXIT;
-                                }
-                            } else if (frame_len == -8 && frame_bak == -1)  {
-                                // printk("%s | Get 'CLOSED'\n", __func__);
-                                socket_eof = true;
-                                frame_bak = 0, tmp_state = 0, State = EXIT;
-                            } else {
-                                tmp_state = 6;
-                            }
-                            continue;
-                        }
-                        
-                        // 存在异常，没有得到 \r\n 的匹配，并排除 CLOSED\r\n 的指令触发的可能性，意味着传输可能越界出错了 \r\n ，则立即回到空闲状态。
-                        if (frame_len <= -1 && frame_bak != -1) {
-                            // printk("%s | tmp_state %d frame_len %d tmp %02X\n", __func__, tmp_state, frame_len, tmp_buf[tmp_pos]);
-                            State = IDLE;
-                            continue;
-                        }
-                    } else {
-                        // for(int i = 0; i < tmp_len; i++) {
-                        //     int tmp = tmp_buf[i];
-                        //     printk("[%02X]", tmp);
-                        // }
-                        // printk("%s | frame_len %d tmp_len %d\n", __func__, frame_len, tmp_pos + 1);
-                        // printk("%.*s", tmp_len, tmp_buf);
-                        if (!Buffer_Puts(&nic->buffer, tmp_buf, (tmp_pos + 1))) {
-                            printk("%s | network->buffer overflow Buffer Max %d Size %d\n", __func__, ESP8285_BUF_SIZE, Buffer_Size(&nic->buffer));
-                            State = EXIT;
-                        } else {
-                            // reduce data len
-                            // printk("[%02X]", tmp_buf[tmp_pos]);
-                            frame_sum += (tmp_pos + 1);
-                        }
-                        // printk("frame_sum %d frame_len %d tmp_len %d\n", frame_sum, frame_len, tmp_pos + 1);
-                        if (frame_len == 0) {
-                            // After receive complete, confirm the data is enough
-                            size = Buffer_Size(&nic->buffer);
-                            // printk("%s | size %d out_buff_len %d\n", __func__, size, out_buff_len);
-                            if (size >= out_buff_len) { // data enough
-                                // printk("%s | recv out_buff_len overflow\n", __func__);
-                                tmp_eof = 1;
-                                // State = EXIT;
-                            }
-                        }
-                    }
-                    continue;
-                }
-
-                continue;
-
-            } else {
-                State = EXIT;
             }
-
             continue;
         }
-        
+
         if (mp_hal_ticks_ms() - interrupt > timeout) {
-            // printk("uart timeout break %d %d %d\r\n", mp_hal_ticks_ms(), interrupt, timeout);
             break; // uart no return data to timeout break
         }
 
-        if (*peer_closed) {
-            break; // disconnection
-        }
-        
-        if (tmp_eof > 0 && tmp_eof++ > 100) { // 806400 tmp_eof 10 > one byte so 115200 > tmp_eof * 8 
-            // printk("size %d\r\n", size);
-            break; // sometimes communication no eof(\r\n)
+        if (got > 0 && mp_hal_ticks_ms() - interrupt > ESP8285_RECV_GAP_MS) {
+            break; // don't wait for the buffer to fill
         }
 
-        // mp_hal_wake_main_task_from_isr();
+        if (peer_closed && *peer_closed) {
+            break; // disconnection
+        }
     }
 
-    size = Buffer_Size(&nic->buffer);
-    
     // peer closed and no data in buffer
-    if (size == 0 && *peer_closed) {
-        frame_sum = 0;
+    if (got == 0 && peer_closed && *peer_closed) {
         return -4;
     }
 
-    size = size > out_buff_len ? out_buff_len : size;
-    
-    Buffer_Gets(&nic->buffer, (uint8_t *)out_buff, size);
     if (data_len) {
-        *data_len = size;
+        *data_len = got;
     }
 
-    frame_sum -= size;
-
-    // printk(" %s | tail obl %d *dl %d se %d\n", __func__, out_buff_len, *data_len, size);
-
-    return size;
+    return got;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -830,90 +632,72 @@ void rx_empty(esp8285_obj* nic)
     }
 }
 
-char* recvString_1(esp8285_obj* nic, const char* target1,uint32_t timeout)
+/* read the response into nic->buffer.buffer in bulk, each byte goes through the matcher once */
+STATIC char* recvString_n(esp8285_obj* nic, const char* const* targets, uint8_t num, uint32_t timeout, int8_t* find_index)
 {
 	int errcode;
 	uint32_t iter = 0;
-	memset(nic->buffer.buffer,0,ESP8285_BUF_SIZE);
+	at_matcher_t matcher;
+	at_matcher_init(&matcher, targets, num);
+	nic->buffer.buffer[0] = '\0';
+	nic->resp_len = 0;
     unsigned long start = mp_hal_ticks_ms();
 	const mp_stream_p_t * uart_stream = mp_get_stream(nic->uart_obj);
     while (mp_hal_ticks_ms() - start < timeout) {
-        while(uart_rx_any(nic->uart_obj) > 0) {
-            uart_stream->read(nic->uart_obj,&nic->buffer.buffer[iter++],1,&errcode);
-        }
-        if (data_find(nic->buffer.buffer,iter,target1) != -1) {
+        uint32_t avail = uart_rx_any(nic->uart_obj);
+        if (avail == 0)
+            continue;
+        if (avail > ESP8285_BUF_SIZE - 1 - iter)
+            avail = ESP8285_BUF_SIZE - 1 - iter;
+        if (avail == 0)
+            break; // response does not fit, the target can not be in it
+        mp_uint_t n = uart_stream->read(nic->uart_obj, nic->buffer.buffer + iter, avail, &errcode);
+        if (n == MP_STREAM_ERROR || n == 0)
+            continue;
+        int found = at_matcher_feed(&matcher, nic->buffer.buffer + iter, n, NULL);
+        iter += n;
+        nic->buffer.buffer[iter] = '\0';
+        nic->resp_len = iter;
+        if (found >= 0) {
+            if (find_index)
+                *find_index = found;
             return (char*)nic->buffer.buffer;
-        } 
+        }
     }
     return NULL;
 }
 
+char* recvString_1(esp8285_obj* nic, const char* target1,uint32_t timeout)
+{
+    const char* targets[] = {target1};
+    return recvString_n(nic, targets, 1, timeout, NULL);
+}
+
 
 char* recvString_2(esp8285_obj* nic,char* target1, char* target2, uint32_t timeout, int8_t* find_index)
 {
-	int errcode;
-	uint32_t iter = 0;
+    const char* targets[] = {target1, target2};
     *find_index = -1;
-	memset(nic->buffer.buffer,0,ESP8285_BUF_SIZE);
-    unsigned int start = mp_hal_ticks_ms();
-	const mp_stream_p_t * uart_stream = mp_get_stream(nic->uart_obj);
-    while (mp_hal_ticks_ms() - start < timeout) {
-        while(uart_rx_any(nic->uart_obj) > 1 && iter < ESP8285_BUF_SIZE) {
-            uart_stream->read(nic->uart_obj,&nic->buffer.buffer[iter++],1,&errcode);
-        }
-        if (data_find(nic->buffer.buffer,iter,target1) != -1) {
-            *find_index = 0;
-            return (char*)nic->buffer.buffer;
-        } else if (data_find(nic->buffer.buffer,iter,target2) != -1) {
-            *find_index = 1;
-            return (char*)nic->buffer.buffer;
-        }
-    }
-    return NULL;
+    return recvString_n(nic, targets, 2, timeout, find_index);
 }
 
 char* recvString_3(esp8285_obj* nic,char* target1, char* target2,char* target3,uint32_t timeout, int8_t* find_index)
 {
-
-	int errcode;
-	uint32_t iter = 0;
+    const char* targets[] = {target1, target2, target3};
     *find_index = -1;
-	memset(nic->buffer.buffer,0,ESP8285_BUF_SIZE);
-    unsigned long start = mp_hal_ticks_ms();
-	const mp_stream_p_t * uart_stream = mp_get_stream(nic->uart_obj);
-    while (mp_hal_ticks_ms() - start < timeout) {
-        while(uart_rx_any(nic->uart_obj) > 0) {
-            uart_stream->read(nic->uart_obj,&nic->buffer.buffer[iter++],1,&errcode);
-        }
-        if (data_find(nic->buffer.buffer,iter,target1) != -1) {
-            *find_index = 0;
-            return (char*)nic->buffer.buffer;
-        } else if (data_find(nic->buffer.buffer,iter,target2) != -1) {
-            *find_index = 1;
-            return (char*)nic->buffer.buffer;
-        } else if (data_find(nic->buffer.buffer,iter,target3) != -1) {
-            *find_index = 2;
-            return (char*)nic->buffer.buffer;
-        }
-    }
-    return NULL;
+    return recvString_n(nic, targets, 3, timeout, find_index);
 }
 
 bool recvFind(esp8285_obj* nic, const char* target, uint32_t timeout)
 {
-    recvString_1(nic, target, timeout);
-    if (data_find(nic->buffer.buffer,ESP8285_BUF_SIZE,target) != -1) {
-        return true;
-    }
-    return false;
+    return recvString_1(nic, target, timeout) != NULL;
 }
 
 bool recvFindAndFilter(esp8285_obj* nic,const char* target, const char* begin, const char* end, char** data, uint32_t timeout)
 {
-    recvString_1(nic,target, timeout);
-    if (data_find(nic->buffer.buffer,ESP8285_BUF_SIZE,target) != -1) {
-        int32_t index1 = data_find(nic->buffer.buffer,ESP8285_BUF_SIZE,begin);
-        int32_t index2 = data_find(nic->buffer.buffer,ESP8285_BUF_SIZE,end);
+    if (recvString_1(nic,target, timeout) != NULL) {
+        int32_t index1 = data_find(nic->buffer.buffer,nic->resp_len,begin);
+        int32_t index2 = data_find(nic->buffer.buffer,nic->resp_len,end);
         if (index1 != -1 && index2 != -1) {
             index1 += strlen(begin);
 			*data = m_new(char, index2 - index1);
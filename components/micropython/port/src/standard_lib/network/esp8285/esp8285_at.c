@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp8285_at.h"
+
+static const char* const at_ipd_tokens[] = {"+IPD,", "CLOSED\r\n"};
+
+static void at_token_init(at_token_t* t, const char* str)
+{
+    size_t len = strlen(str);
+    t->str = str;
+    t->len = (len > AT_MATCHER_TOKEN_LEN) ? 0 : (uint8_t)len;
+    t->state = 0;
+    if (t->len == 0)
+        return;
+    t->next[0] = 0;
+    for (uint8_t i = 1, k = 0; i < t->len; i++)
+    {
+        while (k > 0 && str[i] != str[k])
+            k = t->next[k - 1];
+        if (str[i] == str[k])
+            k++;
+        t->next[i] = k;
+    }
+}
+
+static inline bool at_token_step(at_token_t* t, uint8_t c)
+{
+    uint8_t k = t->state;
+    while (k > 0 && c != (uint8_t)t->str[k])
+        k = t->next[k - 1];
+    if (c == (uint8_t)t->str[k])
+        k++;
+    if (k == t->len)
+    {
+        t->state = t->next[k - 1];
+        return true;
+    }
+    t->state = k;
+    return false;
+}
+
+void at_matcher_init(at_matcher_t* m, const char* const* tokens, uint8_t num)
+{
+    if (num > AT_MATCHER_TOKENS_MAX)
+        num = AT_MATCHER_TOKENS_MAX;
+    m->num = num;
+    for (uint8_t i = 0; i < num; i++)
+        at_token_init(&m->token[i], tokens[i]);
+}
+
+void at_matcher_reset(at_matcher_t* m)
+{
+    for (uint8_t i = 0; i < m->num; i++)
+        m->token[i].state = 0;
+}
+
+int at_matcher_feed(at_matcher_t* m, const uint8_t* data, uint32_t len, uint32_t* used)
+{
+    for (uint32_t n = 0; n < len; n++)
+    {
+        for (uint8_t i = 0; i < m->num; i++)
+        {
+            if (m->token[i].len && at_token_step(&m->token[i], data[n]))
+            {
+                if (used)
+                    *used = n + 1;
+                return i;
+            }
+        }
+    }
+    if (used)
+        *used = len;
+    return -1;
+}
+
+int32_t at_find(const uint8_t* src, uint32_t src_len, const char* target)
+{
+    at_token_t t;
+    at_token_init(&t, target);
+    if (t.len == 0)
+        return -1;
+    for (uint32_t n = 0; n < src_len; n++)
+    {
+        if (at_token_step(&t, src[n]))
+            return (int32_t)(n + 1 - t.len);
+    }
+    return -1;
+}
+
+void at_ipd_init(at_ipd_t* p)
+{
+    p->state = AT_IPD_IDLE;
+    p->head_len = 0;
+    p->mux_id = -1;
+    p->remain = 0;
+    p->closed = false;
+    at_matcher_init(&p->idle, at_ipd_tokens, 2);
+}
+
+/* "<len>" or "<id>,<len>" */
+static bool at_ipd_head(at_ipd_t* p)
+{
+    char* end;
+    char* comma;
+    long id = -1, len;
+
+    p->head[p->head_len] = '\0';
+    comma = strchr(p->head, ',');
+    if (comma)
+    {
+        id = strtol(p->head, &end, 10);
+        if (end != comma || id < 0 || id > 4)
+            return false;
+        len = strtol(comma + 1, &end, 10);
+    }
+    else
+    {
+        len = strtol(p->head, &end, 10);
+    }
+    if (*end != '\0' || end == p->head || len <= 0)
+        return false;
+    p->mux_id = (int8_t)id;
+    p->remain = (uint32_t)len;
+    return true;
+}
+
+uint32_t at_ipd_parse(at_ipd_t* p, const uint8_t* data, uint32_t len, const uint8_t** payload, uint32_t* payload_len)
+{
+    uint32_t n = 0;
+
+    *payload_len = 0;
+    while (n < len)
+    {
+        if (p->state == AT_IPD_DATA)
+        {
+            uint32_t run = len - n;
+            if (run > p->remain)
+                run = p->remain;
+            *payload = data + n;
+            *payload_len = run;
+            p->remain -= run;
+            if (p->remain == 0)
+                p->state = AT_IPD_IDLE;
+            return n + run;
+        }
+        if (p->state == AT_IPD_HEAD)
+        {
+            char c = (char)data[n++];
+            if (c == ':')
+            {
+                p->state = at_ipd_head(p) ? AT_IPD_DATA : AT_IPD_IDLE;
+            }
+            else if ((c >= '0' && c <= '9') || c == ',')
+            {
+                if (p->head_len < AT_IPD_HEAD_MAX)
+                    p->head[p->head_len++] = c;
+                else
+                    p->state = AT_IPD_IDLE; // not a frame header
+            }
+            else
+            {
+                p->state = AT_IPD_IDLE;
+            }
+            continue;
+        }
+        uint32_t used;
+        int found = at_matcher_feed(&p->idle, data + n, len - n, &used);
+        n += used;
+        if (found == 0)
+        {
+            p->state = AT_IPD_HEAD;
+            p->head_len = 0;
+        }
+        else if (found == 1)
+        {
+            p->closed = true;
+        }
+        if (found >= 0)
+            at_matcher_reset(&p->idle);
+    }
+    return n;
+}
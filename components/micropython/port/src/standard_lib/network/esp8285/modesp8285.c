@@ -126,6 +126,29 @@ STATIC mp_uint_t esp8285_socket_send(mod_network_socket_obj_t *socket, const byt
 }
 
 
+// uselect readiness, answered from the UART buffers without talking to the module
+STATIC int esp8285_socket_ioctl(mod_network_socket_obj_t *socket, mp_uint_t request, mp_uint_t arg, int *_errno) {
+	if((mp_obj_type_t*)&mod_network_nic_type_esp8285 != mp_obj_get_type(MP_OBJ_TO_PTR(socket->nic)))
+	{
+		*_errno = MP_EPIPE;
+		return MP_STREAM_ERROR;
+	}
+    if(request != MP_STREAM_POLL)
+    {
+        *_errno = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+	nic_obj_t* self = MP_OBJ_TO_PTR(socket->nic);
+    int ret = 0;
+    if((arg & MP_STREAM_POLL_RD) && (socket->peer_closed || esp_recv_ready(&self->esp8285)))
+        ret |= MP_STREAM_POLL_RD;
+    if((arg & MP_STREAM_POLL_WR) && !socket->peer_closed)
+        ret |= MP_STREAM_POLL_WR;
+    if(socket->peer_closed)
+        ret |= MP_STREAM_POLL_HUP;
+    return ret;
+}
+
 STATIC int esp8285_socket_socket(mod_network_socket_obj_t *socket, int *_errno) {
 
     return 0;
@@ -413,6 +436,7 @@ const mod_network_nic_type_t mod_network_nic_type_esp8285 = {
     .send = esp8285_socket_send,
     .recv = esp8285_socket_recv,
     .close = esp8285_socket_close,
+    .ioctl = esp8285_socket_ioctl,
 /*  
     .bind = cc3k_socket_bind,
     .listen = cc3k_socket_listen,
@@ -421,6 +445,5 @@ const mod_network_nic_type_t mod_network_nic_type_esp8285 = {
     .recvfrom = cc3k_socket_recvfrom,
     .setsockopt = cc3k_socket_setsockopt,
     .settimeout = cc3k_socket_settimeout,
-    .ioctl = cc3k_socket_ioctl,
 */
 };
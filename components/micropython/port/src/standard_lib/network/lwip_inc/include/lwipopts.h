@@ -24,6 +24,7 @@ typedef uint32_t sys_prot_t;
 #define LWIP_SOCKET                     0
 #define LWIP_STATS                      0
 #define LWIP_NETIF_HOSTNAME             1
+#define LWIP_SUPPORT_CUSTOM_PBUF        1 // esp32c3 的 SPI 接收缓冲直接作为 pbuf 交给 lwIP
 
 // 配置DHCP
 #define LWIP_IPV6                       0
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "dmac.h"
 #include "fpioa.h"
 #include "gpiohs.h"
 #include "modmachine.h"
@@ -39,6 +40,8 @@
 #include "py/objtuple.h"
 #include "py/runtime.h"
 #include "py/stream.h"
+#include "sdcard.h"
+#include "sipeed_spi.h"
 #include "sleep.h"
 #include "timer.h"
 #include "lib/netutils/netutils.h"
@@ -50,6 +53,7 @@
 #include "socket.h"
 #include "w5500/w5500.h"
 #include "wizchip_conf.h"
+#include "wiz_spi.h"
 
 /// \moduleref network
 // SPI protocol
@@ -65,7 +69,10 @@ typedef struct _wiznet5k_obj_t {
   mp_obj_base_t base;
   mp_uint_t cris_state;
   mp_obj_t spi;
+  int spi_bus;  // -1 when the bus can't do DMA
   uint8_t cs;
+  int8_t intr;  // INTn gpiohs, -1 if not wired
+  volatile uint32_t intr_events;
   uint8_t socket_used;
   volatile uint8_t dhcp_ip_assign_fl;
 } wiznet5k_obj_t;
@@ -351,17 +358,42 @@ STATIC int wiznet5k_socket_settimeout(mod_network_socket_obj_t *socket,
   */
 }
 
+// socket interrupts that pull INTn low, socket.c polls SENDOK and TIMEOUT itself
+#define WIZ_SN_IMR (Sn_IR_RECV | Sn_IR_DISCON | Sn_IR_CON)
+
+// INTn stays low while any unmasked socket has a flag set and only falls again
+// once all are cleared, so every flagged socket is cleared, not just the one
+// polled. The pollers of the others still see the edge count change and look.
+STATIC void wiz_intr_clear(void) {
+  uint8_t sir = getSIR();
+  for (uint8_t sn = 0; sir; sn++, sir >>= 1) {
+    if (sir & 1) setSn_IR(sn, WIZ_SN_IMR);
+  }
+}
+
 STATIC int wiznet5k_socket_ioctl(mod_network_socket_obj_t *socket,
                                  mp_uint_t request, mp_uint_t arg,
                                  int *_errno) {
   if (request == MP_STREAM_POLL) {
+    uint8_t sn = (uint8_t)socket->u_param.fileno;
     int ret = 0;
-    if (arg & MP_STREAM_POLL_RD && getSn_RX_RSR(socket->u_param.fileno) != 0) {
+    if (wiznet5k_obj.intr >= 0) {
+      // cleared before looking, so anything that comes after pulls INTn again
+      wiz_intr_clear();
+    }
+    uint8_t sr = getSn_SR(sn);
+    bool closed = socket->u_param.type == MOD_NETWORK_SOCK_STREAM &&
+                  (sr == SOCK_CLOSED || sr == SOCK_CLOSE_WAIT);
+    // a closed stream is readable, recv() returns at once
+    if (arg & MP_STREAM_POLL_RD && (closed || getSn_RX_RSR(sn) != 0)) {
       ret |= MP_STREAM_POLL_RD;
     }
-    if (arg & MP_STREAM_POLL_WR && getSn_TX_FSR(socket->u_param.fileno) != 0) {
+    if (arg & MP_STREAM_POLL_WR && getSn_TX_FSR(sn) != 0) {
       ret |= MP_STREAM_POLL_WR;
     }
+    if (socket->u_param.type == MOD_NETWORK_SOCK_STREAM && sr == SOCK_CLOSED) {
+      ret |= MP_STREAM_POLL_HUP;
+    }
     return ret;
   } else {
     *_errno = MP_EINVAL;
@@ -369,35 +401,47 @@ STATIC int wiznet5k_socket_ioctl(mod_network_socket_obj_t *socket,
   }
 }
 
-uint8_t wiz_spi_read(void) {
-  uint8_t ret;
-  mp_obj_base_t *s = (mp_obj_base_t *)MP_OBJ_TO_PTR(wiznet5k_obj.spi);
-  mp_machine_hw_spi_p_t *spi_p = (mp_machine_hw_spi_p_t *)s->type->protocol;
-  spi_p->transfer(s, 1, NULL, &ret, wiznet5k_obj.cs);
-  return ret;
+STATIC bool wiznet5k_events(mp_obj_t nic, uint32_t *count) {
+  if (wiznet5k_obj.intr < 0) return false;
+  *count = wiznet5k_obj.intr_events;
+  return true;
 }
 
-void wiz_spi_write(uint8_t wb) {
-  mp_obj_base_t *s = (mp_obj_base_t *)MP_OBJ_TO_PTR(wiznet5k_obj.spi);
-  mp_machine_hw_spi_p_t *spi_p = (mp_machine_hw_spi_p_t *)s->type->protocol;
-  spi_p->transfer(s, 1, &wb, NULL, wiznet5k_obj.cs);
+STATIC int wiz_intr_isr(void *ctx) {
+  wiznet5k_obj.intr_events++;
+  mp_hal_wake_main_task_from_isr();
+  return 0;
 }
 
-void wiz_spi_read_burst(uint8_t *pBuf, uint16_t len) {
-  mp_obj_base_t *s = (mp_obj_base_t *)MP_OBJ_TO_PTR(wiznet5k_obj.spi);
-  mp_machine_hw_spi_p_t *spi_p = (mp_machine_hw_spi_p_t *)s->type->protocol;
-  spi_p->transfer(s, len, NULL, pBuf, wiznet5k_obj.cs);
-}
+// the bus under wiz_spi.c
+#define WIZ_SPI_DMA_TX_CH DMAC_CHANNEL0  // same pair as the flash and SD drivers, under sd_dma_lock()
+#define WIZ_SPI_DMA_RX_CH DMAC_CHANNEL1
 
-void wiz_spi_write_burst(uint8_t *pBuf, uint16_t len) {
+void wiz_spi_bus_cs(uint8_t level) { gpiohs_set_pin(wiznet5k_obj.cs, level); }
+
+void wiz_spi_bus_transfer(const uint8_t *src, uint8_t *dest, size_t len) {
   mp_obj_base_t *s = (mp_obj_base_t *)MP_OBJ_TO_PTR(wiznet5k_obj.spi);
   mp_machine_hw_spi_p_t *spi_p = (mp_machine_hw_spi_p_t *)s->type->protocol;
-  spi_p->transfer(s, len, pBuf, NULL, wiznet5k_obj.cs);
+  spi_p->transfer(s, len, src, dest, wiznet5k_obj.cs);
 }
 
-void wiz_cs_select(void) { gpiohs_set_pin(wiznet5k_obj.cs, 0); }
+bool wiz_spi_bus_has_dma(void) { return wiznet5k_obj.spi_bus >= 0; }
+
+void wiz_spi_bus_dma_send(const uint32_t *buf, size_t len) {
+  sd_dma_lock();
+  sipeed_spi_send_data_normal_dma(WIZ_SPI_DMA_TX_CH, wiznet5k_obj.spi_bus,
+                                  wiznet5k_obj.cs, buf, len, SPI_TRANS_INT);
+  sd_dma_unlock();
+}
 
-void wiz_cs_deselect(void) { gpiohs_set_pin(wiznet5k_obj.cs, 1); }
+void wiz_spi_bus_dma_recv(const uint32_t *cmd, size_t cmd_len, uint32_t *rx,
+                          size_t rx_len) {
+  sd_dma_lock();
+  sipeed_spi_receive_data_normal_dma(WIZ_SPI_DMA_TX_CH, WIZ_SPI_DMA_RX_CH,
+                                     wiznet5k_obj.spi_bus, wiznet5k_obj.cs,
+                                     cmd, cmd_len, rx, rx_len);
+  sd_dma_unlock();
+}
 
 STATIC void wiz_cris_enter(void) {
   wiznet5k_obj.cris_state = MICROPY_BEGIN_ATOMIC_SECTION();
@@ -452,10 +496,11 @@ STATIC void wiznet5k_make_new_helper(size_t n_args, size_t n_kw,
   // check arguments
   mp_arg_check_num(n_args, n_kw, 0, 3, true);
 
-  enum { ARG_spi, ARG_cs };
+  enum { ARG_spi, ARG_cs, ARG_intr };
   static const mp_arg_t allowed_args[] = {
       {MP_QSTR_spi, MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
-      {MP_QSTR_cs, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 20}}};
+      {MP_QSTR_cs, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 20}},
+      {MP_QSTR_intr, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1}}};
 
   mp_arg_val_t args_parsed[MP_ARRAY_SIZE(allowed_args)];
   mp_arg_parse_all_kw_array(n_args, n_kw, args, MP_ARRAY_SIZE(allowed_args),
@@ -471,19 +516,26 @@ STATIC void wiznet5k_make_new_helper(size_t n_args, size_t n_kw,
     return mp_const_false;
   }
 
+  if (args_parsed[ARG_intr].u_int < -1 || args_parsed[ARG_intr].u_int > 31) {
+    mp_raise_ValueError("intr value error");
+  }
+
   // init the wiznet5k object
   wiznet5k_obj.base.type = (mp_obj_type_t *)&mod_network_nic_type_wiznet5k;
   wiznet5k_obj.cris_state = 0;
   wiznet5k_obj.spi = args_parsed[ARG_spi].u_obj;
+  wiznet5k_obj.spi_bus = machine_hw_spi_get_dma_bus(wiznet5k_obj.spi);
   wiznet5k_obj.socket_used = 0;
   wiznet5k_obj.cs = args_parsed[ARG_cs].u_int;
+  wiznet5k_obj.intr = args_parsed[ARG_intr].u_int;
+  wiznet5k_obj.intr_events = 0;
   wiznet5k_obj.dhcp_ip_assign_fl = 0;
 }
 
 /******************************************************************************/
 // MicroPython bindings
 
-/// \classmethod \constructor(spi, pin_cs, pin_rst)
+/// \classmethod \constructor(spi, cs, intr)
 /// Create and return a WIZNET5K object.
 STATIC mp_obj_t wiznet5k_make_new(const mp_obj_type_t *type, size_t n_args,
                                   size_t n_kw, const mp_obj_t *args) {
@@ -512,6 +564,18 @@ STATIC mp_obj_t wiznet5k_make_new(const mp_obj_type_t *type, size_t n_args,
 
   ctlnetwork(CN_SET_NETINFO, (void *)&netinfo);
 
+  if (wiznet5k_obj.intr >= 0) {
+    // uselect asks the chip only after INTn fell, see socket_poll()
+    fpioa_set_function(wiznet5k_obj.intr, FUNC_GPIOHS0 + wiznet5k_obj.intr);
+    gpiohs_set_drive_mode(wiznet5k_obj.intr, GPIO_DM_INPUT_PULL_UP);
+    gpiohs_set_pin_edge(wiznet5k_obj.intr, GPIO_PE_FALLING);
+    gpiohs_irq_register(wiznet5k_obj.intr, 1, wiz_intr_isr, NULL);
+    for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++) {
+      setSn_IMR(sn, WIZ_SN_IMR);
+    }
+    setSIMR(0xFF);
+  }
+
   // register with network module
   mod_network_register_nic(&wiznet5k_obj);
 
@@ -635,6 +699,7 @@ const mod_network_nic_type_t mod_network_nic_type_wiznet5k = {
     .setsockopt = wiznet5k_socket_setsockopt,
     .settimeout = wiznet5k_socket_settimeout,
     .ioctl = wiznet5k_socket_ioctl,
+    .events = wiznet5k_events,
 };
 
 #endif  // CONFIG_MAIXPY_WIZNET5K_ENABLE
@@ -181,15 +181,30 @@ void WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t *pBuf, uint16_t len) {
   WIZCHIP_CRITICAL_EXIT();
 }
 
+uint16_t WIZCHIP_READ16(uint32_t AddrSel) {
+  uint8_t spi_data[2];
+
+  WIZCHIP_READ_BUF(AddrSel, spi_data, 2);
+  return ((uint16_t)spi_data[0] << 8) | spi_data[1];
+}
+
+void WIZCHIP_WRITE16(uint32_t AddrSel, uint16_t wb) {
+  uint8_t spi_data[2];
+
+  spi_data[0] = (uint8_t)(wb >> 8);
+  spi_data[1] = (uint8_t)wb;
+  WIZCHIP_WRITE_BUF(AddrSel, spi_data, 2);
+}
+
+// both bytes come in one frame, the value is still read until two samples
+// agree since the chip may update it between the bytes
 uint16_t getSn_TX_FSR(uint8_t sn) {
   uint16_t val = 0, val1 = 0;
 
   do {
-    val1 = WIZCHIP_READ(Sn_TX_FSR(sn));
-    val1 = (val1 << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_FSR(sn), 1));
+    val1 = WIZCHIP_READ16(Sn_TX_FSR(sn));
     if (val1 != 0) {
-      val = WIZCHIP_READ(Sn_TX_FSR(sn));
-      val = (val << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_FSR(sn), 1));
+      val = WIZCHIP_READ16(Sn_TX_FSR(sn));
     }
   } while (val != val1);
   return val;
@@ -199,13 +214,10 @@ uint16_t getSn_RX_RSR(uint8_t sn) {
   uint16_t val = 0, val1 = 0;
 
   do {
-    val1 = WIZCHIP_READ(Sn_RX_RSR(sn));
-    val1 = (val1 << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RSR(sn), 1));
+    val1 = WIZCHIP_READ16(Sn_RX_RSR(sn));
     if (val1 != 0) {
-      val = WIZCHIP_READ(Sn_RX_RSR(sn));
-      val = (val << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RSR(sn), 1));
+      val = WIZCHIP_READ16(Sn_RX_RSR(sn));
     }
-    // printf("val: %d, %d\r\n", val, val1);
   } while (val != val1);
   return val;
 }
@@ -1405,6 +1405,22 @@ void WIZCHIP_READ_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  */
 void WIZCHIP_WRITE_BUF(uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function
+ * @brief It reads a 2 byte register in one SPI frame.
+ * @param AddrSel Register address of the high byte
+ * @return Register value
+ */
+uint16_t WIZCHIP_READ16(uint32_t AddrSel);
+
+/**
+ * @ingroup Basic_IO_function
+ * @brief It writes a 2 byte register in one SPI frame.
+ * @param AddrSel Register address of the high byte
+ * @param wb Write data
+ */
+void WIZCHIP_WRITE16(uint32_t AddrSel, uint16_t wb);
+
 /////////////////////////////////
 // Common Register I/O function //
 /////////////////////////////////
@@ -2100,9 +2116,7 @@ uint16_t getSn_TX_FSR(uint8_t sn);
                 ((WIZCHIP_READ(Sn_TX_RD(sn)) << 8) +
 WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_RD(sn),1)))
 */
-#define getSn_TX_RD(sn)                          \
-  (((uint16_t)WIZCHIP_READ(Sn_TX_RD(sn)) << 8) + \
-   WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_RD(sn), 1)))
+#define getSn_TX_RD(sn) WIZCHIP_READ16(Sn_TX_RD(sn))
 
 /**
  * @ingroup Socket_register_access_function
@@ -2111,11 +2125,7 @@ WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_RD(sn),1)))
  * @param (uint16_t)txwr Value to set @ref Sn_TX_WR
  * @sa GetSn_TX_WR()
  */
-#define setSn_TX_WR(sn, txwr)                                          \
-  {                                                                    \
-    WIZCHIP_WRITE(Sn_TX_WR(sn), (uint8_t)(txwr >> 8));                 \
-    WIZCHIP_WRITE(WIZCHIP_OFFSET_INC(Sn_TX_WR(sn), 1), (uint8_t)txwr); \
-  }
+#define setSn_TX_WR(sn, txwr) WIZCHIP_WRITE16(Sn_TX_WR(sn), (uint16_t)(txwr))
 
 /**
  * @ingroup Socket_register_access_function
@@ -2130,9 +2140,7 @@ WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_RD(sn),1)))
                 ((WIZCHIP_READ(Sn_TX_WR(sn)) << 8) +
 WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_WR(sn),1)))
 */
-#define getSn_TX_WR(sn)                          \
-  (((uint16_t)WIZCHIP_READ(Sn_TX_WR(sn)) << 8) + \
-   WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_WR(sn), 1)))
+#define getSn_TX_WR(sn) WIZCHIP_READ16(Sn_TX_WR(sn))
 
 /**
  * @ingroup Socket_register_access_function
@@ -2149,11 +2157,7 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  * @param (uint16_t)rxrd Value to set @ref Sn_RX_RD
  * @sa getSn_RX_RD()
  */
-#define setSn_RX_RD(sn, rxrd)                                          \
-  {                                                                    \
-    WIZCHIP_WRITE(Sn_RX_RD(sn), (uint8_t)(rxrd >> 8));                 \
-    WIZCHIP_WRITE(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn), 1), (uint8_t)rxrd); \
-  }
+#define setSn_RX_RD(sn, rxrd) WIZCHIP_WRITE16(Sn_RX_RD(sn), (uint16_t)(rxrd))
 
 /**
  * @ingroup Socket_register_access_function
@@ -2168,9 +2172,7 @@ uint16_t getSn_RX_RSR(uint8_t sn);
                 ((WIZCHIP_READ(Sn_RX_RD(sn)) << 8) +
 WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn),1)))
 */
-#define getSn_RX_RD(sn)                          \
-  (((uint16_t)WIZCHIP_READ(Sn_RX_RD(sn)) << 8) + \
-   WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn), 1)))
+#define getSn_RX_RD(sn) WIZCHIP_READ16(Sn_RX_RD(sn))
 
 /**
  * @ingroup Socket_register_access_function
@@ -2184,9 +2186,7 @@ WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn),1)))
                 ((WIZCHIP_READ(Sn_RX_WR(sn)) << 8) +
 WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_WR(sn),1)))
 */
-#define getSn_RX_WR(sn)                          \
-  (((uint16_t)WIZCHIP_READ(Sn_RX_WR(sn)) << 8) + \
-   WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_WR(sn), 1)))
+#define getSn_RX_WR(sn) WIZCHIP_READ16(Sn_RX_WR(sn))
 
 /**
  * @ingroup Socket_register_access_function
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "wiz_spi.h"
+
+static uint8_t wiz_spi_hdr[WIZ_SPI_HDR_LEN];
+static uint8_t wiz_spi_hdr_len;
+// one word per frame, (WIZ_SPI_HDR_LEN + WIZ_SPI_DMA_CHUNK) words, allocated on first use
+static uint32_t *wiz_spi_dma_buf;
+
+static bool wiz_spi_dma_ready(void) {
+  if (!wiz_spi_bus_has_dma()) return false;
+  if (wiz_spi_dma_buf == NULL)
+    wiz_spi_dma_buf =
+        malloc((WIZ_SPI_HDR_LEN + WIZ_SPI_DMA_CHUNK) * sizeof(uint32_t));
+  return wiz_spi_dma_buf != NULL;
+}
+
+static void wiz_spi_frame_dma(const uint8_t *hdr, uint8_t hdr_len,
+                              const uint8_t *src, uint8_t *dest, size_t len) {
+  uint32_t *buf = wiz_spi_dma_buf;
+  size_t i, n;
+
+  // CS stays low across the chunks, the chip keeps counting the address up
+  do {
+    n = len > WIZ_SPI_DMA_CHUNK ? WIZ_SPI_DMA_CHUNK : len;
+    for (i = 0; i < hdr_len; i++) buf[i] = hdr[i];
+    if (dest == NULL) {
+      for (i = 0; i < n; i++) buf[hdr_len + i] = src[i];
+      wiz_spi_bus_dma_send(buf, hdr_len + n);
+      src += n;
+    } else {
+      wiz_spi_bus_dma_recv(buf, hdr_len, buf + hdr_len, n);
+      for (i = 0; i < n; i++) dest[i] = (uint8_t)buf[hdr_len + i];
+      dest += n;
+    }
+    hdr_len = 0;
+    len -= n;
+  } while (len);
+}
+
+// send the held header with len bytes from src, or followed by len bytes read
+// into dest when src is NULL
+static void wiz_spi_frame(const uint8_t *src, uint8_t *dest, size_t len) {
+  uint8_t hdr_len = wiz_spi_hdr_len;
+  uint8_t buf[WIZ_SPI_HDR_LEN + WIZ_SPI_FIFO_MAX];
+
+  wiz_spi_hdr_len = 0;
+  if (hdr_len + len == 0) return;
+  if (len > WIZ_SPI_FIFO_MAX && wiz_spi_dma_ready()) {
+    wiz_spi_frame_dma(wiz_spi_hdr, hdr_len, src, dest, len);
+  } else if (hdr_len + len <= sizeof(buf)) {
+    // full duplex, the data read back lands after the header
+    memcpy(buf, wiz_spi_hdr, hdr_len);
+    if (src)
+      memcpy(buf + hdr_len, src, len);
+    else
+      memset(buf + hdr_len, 0, len);
+    wiz_spi_bus_transfer(buf, dest ? buf : NULL, hdr_len + len);
+    if (dest) memcpy(dest, buf + hdr_len, len);
+  } else {
+    if (hdr_len) wiz_spi_bus_transfer(wiz_spi_hdr, NULL, hdr_len);
+    if (dest)
+      wiz_spi_bus_transfer(dest, dest, len);
+    else
+      wiz_spi_bus_transfer(src, NULL, len);
+  }
+}
+
+uint8_t wiz_spi_read(void) {
+  uint8_t ret;
+  wiz_spi_frame(NULL, &ret, 1);
+  return ret;
+}
+
+void wiz_spi_write(uint8_t wb) { wiz_spi_frame(&wb, NULL, 1); }
+
+void wiz_spi_read_burst(uint8_t *pBuf, uint16_t len) {
+  wiz_spi_frame(NULL, pBuf, len);
+}
+
+void wiz_spi_write_burst(uint8_t *pBuf, uint16_t len) {
+  if (wiz_spi_hdr_len == 0 && len == WIZ_SPI_HDR_LEN) {
+    memcpy(wiz_spi_hdr, pBuf, WIZ_SPI_HDR_LEN);
+    wiz_spi_hdr_len = WIZ_SPI_HDR_LEN;
+    return;
+  }
+  wiz_spi_frame(pBuf, NULL, len);
+}
+
+void wiz_cs_select(void) {
+  wiz_spi_hdr_len = 0;
+  wiz_spi_bus_cs(0);
+}
+
+void wiz_cs_deselect(void) {
+  if (wiz_spi_hdr_len) wiz_spi_frame(NULL, NULL, 0);  // header with no data
+  wiz_spi_bus_cs(1);
+}
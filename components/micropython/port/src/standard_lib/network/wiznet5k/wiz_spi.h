@@ -0,0 +1,39 @@
+/*
+ * W5500 SPI framing for the wizchip_conf callbacks.
+ *
+ * A W5500 frame is a 3 byte header (address, control) then the data, all
+ * under one CS. w5500.c always sends the header as a 3 byte burst right after
+ * select, it is held back here and goes out in the same transfer as the data.
+ * The bus itself is below, modnwwiznet5k.c provides it.
+ */
+#ifndef _WIZ_SPI_H_
+#define _WIZ_SPI_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WIZ_SPI_HDR_LEN 3
+#define WIZ_SPI_FIFO_MAX 32     // shorter frames go through the FIFO, DMA setup costs more
+#define WIZ_SPI_DMA_CHUNK 1024  // data bytes per DMA transfer
+
+// the bus
+void wiz_spi_bus_cs(uint8_t level);
+// full duplex, dest or src may be NULL
+void wiz_spi_bus_transfer(const uint8_t *src, uint8_t *dest, size_t len);
+// false on buses that can't run DMA
+bool wiz_spi_bus_has_dma(void);
+// one word per frame, CS stays low between the calls of one frame
+void wiz_spi_bus_dma_send(const uint32_t *buf, size_t len);
+void wiz_spi_bus_dma_recv(const uint32_t *cmd, size_t cmd_len, uint32_t *rx,
+                          size_t rx_len);
+
+// the wizchip_conf callbacks
+void wiz_cs_select(void);
+void wiz_cs_deselect(void);
+uint8_t wiz_spi_read(void);
+void wiz_spi_write(uint8_t wb);
+void wiz_spi_read_burst(uint8_t *pBuf, uint16_t len);
+void wiz_spi_write_burst(uint8_t *pBuf, uint16_t len);
+
+#endif
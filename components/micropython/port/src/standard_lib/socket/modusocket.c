@@ -32,6 +32,7 @@
 #include "py/runtime.h"
 #include "py/stream.h"
 #include "py/mperrno.h"
+#include "py/mphal.h"
 #include "lib/netutils/netutils.h"
 #include "modnetwork.h"
 
@@ -412,6 +413,9 @@ STATIC mp_obj_t socket_make_new(const mp_obj_type_t *type, size_t n_args, size_t
     }
     s->timeout = 10; // default timeout: 10s
     s->peer_closed = false;
+    s->poll.next_ms = mp_hal_ticks_ms();
+    s->poll.interval_ms = 0;
+    s->poll.events = 0;
 	if (n_args >= 1) {
         s->u_param.domain = mp_obj_get_int(args[0]);
         if (n_args >= 2) {
@@ -449,6 +453,43 @@ STATIC mp_uint_t socket_stream_write(mp_obj_t self_in, const void *buf, mp_uint_
     MP_THREAD_GIL_ENTER();
     return ret;
 }
+#define SOCKET_POLL_MIN_MS    (1)
+#define SOCKET_POLL_MAX_MS    (16)
+
+// uselect asks every socket in a tight loop. Asking the NIC costs a bus
+// transaction, so after a not ready answer it is only asked again once the
+// NIC signalled an event or after a backoff that doubles up to the maximum.
+// The maximum is the same with an interrupt line, a missed edge costs no
+// more latency than polling.
+STATIC mp_uint_t socket_poll(mod_network_socket_obj_t *self, uintptr_t flags, int *errcode) {
+    mod_network_poll_t *p = &self->poll;
+    mp_uint_t now = mp_hal_ticks_ms();
+    uint32_t events = 0;
+    bool has_events = self->nic_type->events && self->nic_type->events(self->nic, &events);
+
+    if ((mp_int_t)(now - p->next_ms) < 0 && !(has_events && events != p->events)) {
+        return 0;
+    }
+    p->events = events; // taken before the query, an event during it is not lost
+    MP_THREAD_GIL_EXIT();
+    mp_uint_t ret = self->nic_type->ioctl(self, MP_STREAM_POLL, flags, errcode);
+    MP_THREAD_GIL_ENTER();
+    if (ret == MP_STREAM_ERROR) {
+        return ret;
+    }
+    if (ret & flags) {
+        p->interval_ms = 0;
+        p->next_ms = now;
+    } else {
+        p->interval_ms = p->interval_ms ? p->interval_ms * 2 : SOCKET_POLL_MIN_MS;
+        if (p->interval_ms > SOCKET_POLL_MAX_MS) {
+            p->interval_ms = SOCKET_POLL_MAX_MS;
+        }
+        p->next_ms = now + p->interval_ms;
+    }
+    return ret;
+}
+
 mp_uint_t socket_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg, int *errcode) {
     mod_network_socket_obj_t *self = MP_OBJ_TO_PTR(self_in);
     if (request == MP_STREAM_CLOSE) {
@@ -461,6 +502,14 @@ mp_uint_t socket_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg, int *
             self->fd = -1;
         }
         return 0;
+    }
+    if (request == MP_STREAM_POLL) {
+        if (self->nic == MP_OBJ_NULL) {
+            return 0;
+        }
+        if (self->nic_type->ioctl) {
+            return socket_poll(self, arg, errcode);
+        }
     }
 	if(self->nic_type->ioctl) {
         MP_THREAD_GIL_EXIT();
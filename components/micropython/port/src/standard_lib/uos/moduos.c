@@ -54,6 +54,7 @@
 #include "rng.h"
 #include "machine_uart.h"
 #include "vfs_spiffs.h"
+#include "w25qxx.h"
 
 //extern mp_obj_t file_open(const char* file_name, const mp_obj_type_t *type, mp_arg_val_t *args);
 extern const mp_obj_type_t mp_type_spiffs_textio;
@@ -141,23 +142,28 @@ STATIC mp_obj_t os_sync(void) {
     #if MICROPY_VFS
 	//TODO
     #endif
+    w25qxx_cache_sync();
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_os_sync_obj, os_sync);
 
-STATIC mp_obj_t mod_os_flash_format(void) {
-
-    spiffs_user_mount_t* spiffs = NULL;
+STATIC spiffs_user_mount_t* flash_spiffs_find(void) {
     mp_vfs_mount_t *m = MP_STATE_VM(vfs_mount_table);
     for(;NULL != m ; m = m->next)
     {
         if(0 == strcmp(m->str,"/flash"))
         {
-            spiffs = MP_OBJ_TO_PTR(m->obj);
-            break;
+            return MP_OBJ_TO_PTR(m->obj);
         }
     }
+    mp_raise_OSError(MP_ENODEV);
+}
+
+STATIC mp_obj_t mod_os_flash_format(void) {
+
+    spiffs_user_mount_t* spiffs = flash_spiffs_find();
     SPIFFS_unmount(&spiffs->fs);
+    w25qxx_cache_sync();
     mp_printf(&mp_plat_print, "[CANMV]:Spiffs Unmount.\r\n");
     mp_printf(&mp_plat_print, "[CANMV]:Spiffs Formating...\r\n");
     uint32_t format_res=SPIFFS_format(&spiffs->fs);
@@ -168,14 +174,7 @@ STATIC mp_obj_t mod_os_flash_format(void) {
     }
     uint32_t res = 0;
 
-    res = SPIFFS_mount(&spiffs->fs,
-        &spiffs->cfg,
-        spiffs_work_buf,
-        spiffs_fds,
-        sizeof(spiffs_fds),
-        spiffs_cache_buf,
-        sizeof(spiffs_cache_buf),
-        0);
+    res = spiffs_vfs_mount_fs(spiffs);
     mp_printf(&mp_plat_print, "[CANMV]:Spiffs Mount %s \r\n", res?"failed":"successful");
     if(!res)
     {
@@ -185,6 +184,44 @@ STATIC mp_obj_t mod_os_flash_format(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_os_flash_format_obj, mod_os_flash_format);
 
+// remount /flash with other cache/fd/gc settings, returns the microseconds spent mounting.
+// Files open on /flash are closed
+STATIC mp_obj_t mod_os_flash_remount(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_cache_pages, ARG_fds, ARG_gc, ARG_gc_size };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_cache_pages, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_fds, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_gc, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_gc_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    spiffs_user_mount_t* spiffs = flash_spiffs_find();
+    spiffs_mount_opt_t old = spiffs->opt;
+    spiffs_mount_opt_t opt = old;
+    spiffs_mount_opt_update(&opt, args[ARG_cache_pages].u_int, args[ARG_fds].u_int,
+                            args[ARG_gc].u_int, args[ARG_gc_size].u_int);
+    SPIFFS_unmount(&spiffs->fs);
+    w25qxx_cache_sync();
+    spiffs->opt = opt;
+    mp_uint_t t = mp_hal_ticks_us();
+    int res = spiffs_vfs_mount_fs(spiffs);
+    t = mp_hal_ticks_us() - t;
+    if (res != SPIFFS_OK)
+    {
+        // e.g. no memory for the bigger buffers, /flash must not stay unmounted
+        mp_printf(&mp_plat_print, "[CanMV]:SPIFFS Error Code %d\r\n", res);
+        spiffs->opt = old;
+        res = spiffs_vfs_mount_fs(spiffs);
+        if (res != SPIFFS_OK)
+            mp_printf(&mp_plat_print, "[CanMV]:SPIFFS Remount with old settings failed %d\r\n", res);
+        mp_raise_OSError(MP_EIO);
+    }
+    return mp_obj_new_int_from_uint(t);
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mod_os_flash_remount_obj, 0, mod_os_flash_remount);
+
 STATIC const mp_rom_map_elem_t os_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uos) },
     { MP_ROM_QSTR(MP_QSTR_uname), MP_ROM_PTR(&os_uname_obj) },
@@ -210,6 +247,7 @@ STATIC const mp_rom_map_elem_t os_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_umount), MP_ROM_PTR(&mp_vfs_umount_obj) },
     { MP_ROM_QSTR(MP_QSTR_sync), MP_ROM_PTR(&mod_os_sync_obj) },
     { MP_ROM_QSTR(MP_QSTR_flash_format), MP_ROM_PTR(&mod_os_flash_format_obj) },
+    { MP_ROM_QSTR(MP_QSTR_flash_remount), MP_ROM_PTR(&mod_os_flash_remount_obj) },
     #endif
 	#if MICROPY_VFS_SPIFFS
 	{ MP_ROM_QSTR(MP_QSTR_VfsSpiffs), MP_ROM_PTR(&mp_spiffs_vfs_type) },
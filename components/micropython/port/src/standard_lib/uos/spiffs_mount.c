@@ -0,0 +1,54 @@
+// mount settings of a SPIFFS volume, free of MicroPython so the host benchmark
+// in tools/tests/host can mount the same way the firmware does
+#include "global_config.h"
+#include "spiffs_mount.h"
+#include "spiffs_nucleus.h"
+
+void spiffs_mount_opt_default(spiffs_mount_opt_t *opt)
+{
+#if SPIFFS_CACHE
+	opt->cache_pages = CONFIG_SPIFFS_CACHE_PAGES;
+#else
+	opt->cache_pages = 0;
+#endif
+	opt->fds = CONFIG_SPIFFS_MAX_FDS;
+	opt->gc_size = 0;
+#if CONFIG_SPIFFS_MOUNT_GC_QUICK
+	opt->gc = SPIFFS_MOUNT_GC_QUICK;
+#elif CONFIG_SPIFFS_MOUNT_GC_FREE
+	opt->gc = SPIFFS_MOUNT_GC_FREE;
+	opt->gc_size = CONFIG_SPIFFS_MOUNT_GC_FREE_SIZE;
+#else
+	opt->gc = SPIFFS_MOUNT_GC_NONE;
+#endif
+}
+
+u32_t spiffs_mount_fds_size(const spiffs_mount_opt_t *opt)
+{
+	return opt->fds * sizeof(spiffs_fd);
+}
+
+u32_t spiffs_mount_cache_size(const spiffs_config *cfg, const spiffs_mount_opt_t *opt)
+{
+#if SPIFFS_CACHE
+	if (opt->cache_pages)
+		return sizeof(spiffs_cache) + opt->cache_pages * (sizeof(spiffs_cache_page) + cfg->log_page_size);
+#endif
+	return 0;
+}
+
+s32_t spiffs_mount_gc(spiffs *fs, const spiffs_config *cfg, const spiffs_mount_opt_t *opt)
+{
+	s32_t res = SPIFFS_OK;
+	if (opt->gc == SPIFFS_MOUNT_GC_QUICK) {
+		// one block per call, stop when no block is fully deleted
+		u32_t blocks = cfg->phys_size / cfg->log_block_size;
+		for (u32_t i = 0; i < blocks && res == SPIFFS_OK; i++)
+			res = SPIFFS_gc_quick(fs, 0);
+		if (res == SPIFFS_ERR_NO_DELETED_BLOCKS)
+			res = SPIFFS_OK;
+	} else if (opt->gc == SPIFFS_MOUNT_GC_FREE && opt->gc_size) {
+		res = SPIFFS_gc(fs, opt->gc_size);
+	}
+	return res;
+}
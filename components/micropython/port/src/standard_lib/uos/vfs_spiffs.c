@@ -43,6 +43,7 @@
 #include "vfs_spiffs.h"
 #include "spiffs_config.h"
 #include "global_config.h"
+#include "w25qxx.h"
 #if _MAX_SS == _MIN_SS
 #define SECSIZE(fs) (_MIN_SS)
 #else
@@ -52,9 +53,6 @@
 #define GET_ERR_CODE(res) ((-res)-10000+1)
 #define mp_obj_spiffs_vfs_t spiffs_user_mount_t
 const mp_obj_type_t mp_spiffs_vfs_type;
-u8_t spiffs_work_buf[CONFIG_SPIFFS_LOGICAL_PAGE_SIZE*2];
-u8_t spiffs_fds[CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE/CONFIG_SPIFFS_LOGICAL_PAGE_SIZE*4];
-u8_t spiffs_cache_buf[(CONFIG_SPIFFS_LOGICAL_PAGE_SIZE+CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE/CONFIG_SPIFFS_LOGICAL_PAGE_SIZE)*4];
 
 STATIC mp_import_stat_t spiffs_vfs_import_stat(void *vfs_in,const char *path) {
     spiffs_user_mount_t *vfs = vfs_in;
@@ -86,13 +84,26 @@ STATIC mp_import_stat_t spiffs_vfs_import_stat(void *vfs_in,const char *path) {
     return MP_IMPORT_STAT_NO_EXIST;
 }
 
-STATIC mp_obj_t spiffs_vfs_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
-    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+STATIC mp_obj_t spiffs_vfs_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    enum { ARG_bdev, ARG_cache_pages, ARG_fds, ARG_gc, ARG_gc_size };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_bdev, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_cache_pages, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_fds, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_gc, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+        { MP_QSTR_gc_size, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t arg_vals[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(allowed_args), allowed_args, arg_vals);
+    const mp_obj_t *args = &arg_vals[ARG_bdev].u_obj;
     // create new object
     spiffs_user_mount_t *vfs = m_new_obj(spiffs_user_mount_t);
 	vfs->base.type = &mp_spiffs_vfs_type;
     vfs->flags = MODULE_SPIFFS;
 	vfs->fs.user_data = vfs;
+	spiffs_mount_opt_default(&vfs->opt);
+	spiffs_mount_opt_update(&vfs->opt, arg_vals[ARG_cache_pages].u_int, arg_vals[ARG_fds].u_int,
+	                        arg_vals[ARG_gc].u_int, arg_vals[ARG_gc_size].u_int);
     //TODO:load block protocol methods mp_load_method() vfs_fat.c
 	//TODO: add error-returning process	
 //	mp_buffer_info_t bufinfo;
@@ -116,6 +127,7 @@ STATIC mp_obj_t spiffs_vfs_del(mp_obj_t self_in) {
     spiffs_user_mount_t *self = MP_OBJ_TO_PTR(self_in);
     //f_umount only needs to be called to release the sync object
     int res = SPIFFS_unmount(&self->fs);
+    w25qxx_cache_sync();
 	if(SPIFFS_OK != res)
 	{
 		mp_printf(&mp_plat_print, "[CanMV]:SPIFFS Error Code %d\r\n",res);
@@ -267,6 +279,7 @@ STATIC mp_obj_t spiffs_vfs_remove(mp_obj_t vfs_in, mp_obj_t path_in) {
         strcat(open_name, path);
     }
 	int res = SPIFFS_remove(&vfs->fs, open_name); 
+    w25qxx_cache_sync();
     if (res != SPIFFS_OK) {
 	   	mp_printf(&mp_plat_print, "[CanMV]:SPIFFS Error Code %d\r\n",res);
 		mp_raise_OSError(SPIFFS_errno_table[GET_ERR_CODE(res)]);
@@ -321,6 +334,7 @@ STATIC mp_obj_t spiffs_vfs_rename(mp_obj_t vfs_in, mp_obj_t path_in, mp_obj_t pa
         // try to rename again
         res = SPIFFS_rename(&self->fs, old_name, new_name);
     }
+    w25qxx_cache_sync();
     if (res == SPIFFS_OK) {
         return mp_const_none;
     } else {
@@ -490,6 +504,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(vfs_spiffs_mount_obj, vfs_spiffs_mount);
 
 STATIC mp_obj_t vfs_spiffs_umount(mp_obj_t self_in) {
     (void)self_in;
+    w25qxx_cache_sync();
     // keep the FAT filesystem mounted internally so the VFS methods can still be used
     return mp_const_none;
 }
@@ -512,6 +527,9 @@ STATIC const mp_rom_map_elem_t spiffs_vfs_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_stat), MP_ROM_PTR(&spiffs_vfs_stat_obj) },
     { MP_ROM_QSTR(MP_QSTR_statvfs), MP_ROM_PTR(&spiffs_vfs_statvfs_obj) },
     { MP_ROM_QSTR(MP_QSTR_umount), MP_ROM_PTR(&spiffs_vfs_umount_obj) },
+    { MP_ROM_QSTR(MP_QSTR_GC_NONE), MP_ROM_INT(SPIFFS_MOUNT_GC_NONE) },
+    { MP_ROM_QSTR(MP_QSTR_GC_QUICK), MP_ROM_INT(SPIFFS_MOUNT_GC_QUICK) },
+    { MP_ROM_QSTR(MP_QSTR_GC_FREE), MP_ROM_INT(SPIFFS_MOUNT_GC_FREE) },
 };
 STATIC MP_DEFINE_CONST_DICT(spiffs_vfs_locals_dict, spiffs_vfs_locals_dict_table);
 
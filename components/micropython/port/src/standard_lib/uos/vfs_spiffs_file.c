@@ -34,6 +34,7 @@
 #include "py/stream.h"
 #include "py/mperrno.h"
 #include "vfs_spiffs.h"
+#include "w25qxx.h"
 
 
 spiffs* glb_fs;
@@ -163,6 +164,7 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
 
     } else if (request == MP_STREAM_FLUSH) {
         uint32_t ret = SPIFFS_fflush(fp.fs, fp.fd);
+        w25qxx_cache_sync();
         if (ret != 0) {
             *errcode = MP_EIO;
             return MP_STREAM_ERROR;
@@ -174,6 +176,7 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
         if (fp.fd > 0) {
             int32_t ret = SPIFFS_close(fp.fs, fp.fd);
             self->fp.fd = 0;
+            w25qxx_cache_sync();
             if (ret != 0) {
                 *errcode = MP_EIO;
                 return MP_STREAM_ERROR;
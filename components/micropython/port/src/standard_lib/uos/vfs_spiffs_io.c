@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "py/binary.h"
 #include "py/objarray.h"
@@ -9,6 +10,7 @@
 #include "w25qxx.h"
 #include "sleep.h"
 #include "syscalls.h"
+#include "printf.h"
 
 #include "spiffs_config.h"
 #include "spiffs_configport.h"
@@ -22,7 +24,7 @@ typedef struct _spiffs_FILE{
 s32_t sys_spiffs_read(uint32_t addr, uint32_t size, uint8_t *buf)
 {
     uint32_t phy_addr=addr;
-    w25qxx_status_t res = w25qxx_read_data_dma(phy_addr, buf, size,W25QXX_QUAD_FAST);
+    w25qxx_status_t res = w25qxx_cache_read(phy_addr, buf, size);
 	#if open_fs_debug
     mp_printf(&mp_plat_print, "flash read addr:%x size:%d buf_head:%x %x\r\n",phy_addr,size,buf[0],buf[1]);
 	#endif
@@ -38,7 +40,7 @@ s32_t sys_spiffs_write(uint32_t addr, uint32_t size, uint8_t *buf)
 {
     int phy_addr=addr;
     
-    w25qxx_status_t res = w25qxx_write_data_dma(phy_addr, buf, size);
+    w25qxx_status_t res = w25qxx_cache_write(phy_addr, buf, size);
 	#if open_fs_debug
     mp_printf(&mp_plat_print, "flash write addr:%x size:%d buf_head:%x,%x\r\n",phy_addr,size,buf[0],buf[1]);
 	#endif
@@ -56,7 +58,7 @@ s32_t sys_spiffs_erase(uint32_t addr, uint32_t size)
 	#if open_fs_debug
     mp_printf(&mp_plat_print, "flash erase addr:%x size:%f\r\n",phy_addr,size/1024.00);
 	#endif
-    w25qxx_status_t res = w25qxx_sector_erase_dma(phy_addr);
+    w25qxx_status_t res = w25qxx_cache_erase_sector(phy_addr);
     if (res != W25QXX_OK) {
 		#if open_fs_debug
         mp_printf(&mp_plat_print, "spifalsh erase err\r\n");
@@ -133,19 +135,72 @@ s32_t spiffs_erase_method(spiffs* fs,uint32_t addr, uint32_t size)
 }
 
 
+// a negative value keeps the current setting
+void spiffs_mount_opt_update(spiffs_mount_opt_t *opt, mp_int_t cache_pages, mp_int_t fds, mp_int_t gc, mp_int_t gc_size)
+{
+	if (cache_pages >= 0) {
+#if !SPIFFS_CACHE
+		if (cache_pages)
+			mp_raise_ValueError("spiffs built without cache");
+#endif
+		if (cache_pages > SPIFFS_MOUNT_CACHE_PAGES_MAX)
+			mp_raise_ValueError("cache_pages 0~" MP_STRINGIFY(SPIFFS_MOUNT_CACHE_PAGES_MAX));
+		opt->cache_pages = cache_pages;
+	}
+	if (fds >= 0) {
+		if (fds < 1 || fds > SPIFFS_MOUNT_FDS_MAX)
+			mp_raise_ValueError("fds 1~" MP_STRINGIFY(SPIFFS_MOUNT_FDS_MAX));
+		opt->fds = fds;
+	}
+	if (gc >= 0) {
+		if (gc > SPIFFS_MOUNT_GC_FREE)
+			mp_raise_ValueError("gc");
+		opt->gc = gc;
+	}
+	if (gc_size >= 0)
+		opt->gc_size = gc_size;
+}
+
+// buffers of the /flash mount, it lives outside the GC heap and survives soft resets
+static u8_t* sys_spiffs_work_buf = NULL;
+static u8_t* sys_spiffs_fds = NULL;
+static u8_t* sys_spiffs_cache_buf = NULL;
+
+int spiffs_vfs_mount_fs(spiffs_user_mount_t *vfs)
+{
+	spiffs_config* cfg = &vfs->cfg;
+	spiffs_mount_opt_t* opt = &vfs->opt;
+	u32_t fds_size = spiffs_mount_fds_size(opt);
+	u32_t cache_size = spiffs_mount_cache_size(cfg, opt);
+	u8_t *work, *fds, *cache;
+	if (vfs->flags == SYS_SPIFFS) {
+		// the fs is unmounted here, a remount may change the sizes
+		free(sys_spiffs_work_buf);
+		free(sys_spiffs_fds);
+		free(sys_spiffs_cache_buf);
+		work = sys_spiffs_work_buf = (u8_t*)malloc(cfg->log_page_size * 2);
+		fds = sys_spiffs_fds = (u8_t*)malloc(fds_size);
+		cache = sys_spiffs_cache_buf = cache_size ? (u8_t*)malloc(cache_size) : NULL;
+		if (!work || !fds || (cache_size && !cache))
+			return SPIFFS_ERR_INTERNAL;
+	} else {
+		work = (u8_t*)m_malloc(cfg->log_page_size * 2);
+		fds = (u8_t*)m_malloc(fds_size);
+		cache = cache_size ? (u8_t*)m_malloc(cache_size) : NULL;
+	}
+	int res = SPIFFS_mount(&vfs->fs, cfg, work, fds, fds_size, cache, cache_size, 0);
+	if (res == SPIFFS_OK) {
+		s32_t gc_res = spiffs_mount_gc(&vfs->fs, cfg, opt);
+		if (gc_res != SPIFFS_OK)
+			printk("[CANMV]:Spiffs gc after mount error %d\r\n", gc_res);
+	}
+	return res;
+}
+
 int mp_module_spiffs_mount(spiffs* fs,spiffs_config* cfg)
 {
-	u8_t* spiffs_work_buf = (u8_t*)m_malloc(cfg->log_page_size * 2 );
-	u8_t* spiffs_fds = (u8_t*)m_malloc(cfg->log_block_size/cfg->log_page_size*4);
-	u8_t* spiffs_cache_buf = (u8_t*)m_malloc((cfg->log_page_size+cfg->log_block_size/cfg->log_page_size)*4);
-	int res = SPIFFS_mount(fs,
-						   cfg,
-						   spiffs_work_buf,
-						   spiffs_fds,
-						   cfg->log_block_size/cfg->log_page_size*4,
-					       spiffs_cache_buf,
-						   (cfg->log_block_size/cfg->log_page_size)*4,
-						   0);
+	(void)cfg;
+	int res = spiffs_vfs_mount_fs((spiffs_user_mount_t*)fs->user_data);
 	mp_printf(&mp_plat_print, "[CANMV]:Spiffs Mount %s \r\n", res?"failed":"successful");
 	return res;
 }
@@ -154,6 +209,7 @@ int mp_module_spiffs_format(spiffs* fs)
 {
 	
 	SPIFFS_unmount(fs);
+	w25qxx_cache_sync();
 	mp_printf(&mp_plat_print, "[CANMV]:Spiffs Unmount.\r\n");
 	mp_printf(&mp_plat_print, "[CANMV]:Spiffs Formating...\r\n");
 	s32_t format_res=SPIFFS_format(fs);
@@ -2,6 +2,7 @@
 #include "avi.h"
 #include "stdio.h"
 #include "video.h"
+#include <errno.h>
 
 
 uint8_t* const AVI_VIDS_FLAG_TBL[2]={(uint8_t*)"00dc",(uint8_t*)"01dc"};
@@ -101,6 +102,15 @@ int avi_init(uint8_t* buf, uint32_t size, avi_t* avi)
 	if(offset==0)
         return AVI_STATUS_ERR_MOVI;
 	avi->offset_movi = offset;
+	// idx1 follows LIST movi, LIST size(offset_movi-4) counts from "movi"
+	avi->offset_idx1 = 0;
+	if(offset >= 4)
+	{
+		buf = buf_start + offset - 4;
+		uint32_t movi_size = buf[0]|buf[1]<<8|buf[2]<<16|buf[3]<<24;
+		if(movi_size > 4)
+			avi->offset_idx1 = offset + movi_size + (movi_size%2);
+	}
 	if(avi->audio_sample_rate)
 	{
 		buf = buf_start + offset;
@@ -162,9 +172,248 @@ int avi_get_streaminfo(uint8_t* buf, avi_t* avi)
 	return AVI_STATUS_ERR_STREAM;	
 }
 
+static int avi_video_index_push(avi_t* avi, uint32_t* capacity, uint32_t offset)
+{
+	if(avi->video_index_num >= *capacity)
+	{
+		uint32_t new_capacity = *capacity ? *capacity*2 : 1024;
+		uint32_t* new_index = (uint32_t*)video_hal_malloc(new_capacity*sizeof(uint32_t));
+		if(!new_index)
+			return ENOMEM;
+		if(avi->video_index)
+		{
+			memcpy(new_index, avi->video_index, avi->video_index_num*sizeof(uint32_t));
+			video_hal_free((uint8_t*)avi->video_index);
+		}
+		avi->video_index = new_index;
+		*capacity = new_capacity;
+	}
+	avi->video_index[avi->video_index_num++] = offset;
+	return 0;
+}
+
+static int avi_load_idx1(avi_t* avi, uint8_t* buf, uint32_t buf_size, uint32_t* capacity)
+{
+	int ret;
+	uint32_t size, num, base, i;
+	avi_idx1_entry_t* entry;
+
+	if(avi->offset_idx1 == 0)
+		return ENOENT;
+	ret = video_hal_file_seek(avi, avi->offset_idx1, VIDEO_HAL_FILE_SEEK_SET);
+	if(ret != 0)
+		return -ret;
+	ret = video_hal_file_read(avi, buf, 8);
+	if(ret != 0)
+		return -ret;
+	if(MAKEDWORD(buf) != AVI_IDX1_ID)
+		return ENOENT;
+	size = MAKEDWORD(buf+4);
+	num = size/sizeof(avi_idx1_entry_t);
+	if(num == 0)
+		return ENOENT;
+	*capacity = avi->total_frame ? avi->total_frame : num;
+	avi->video_index = (uint32_t*)video_hal_malloc(*capacity*sizeof(uint32_t));
+	if(!avi->video_index)
+		return ENOMEM;
+	buf_size -= buf_size%sizeof(avi_idx1_entry_t);
+	base = 0;
+	for(i=0; i<num; )
+	{
+		uint32_t n = (num - i)*sizeof(avi_idx1_entry_t);
+		if(n > buf_size)
+			n = buf_size;
+		ret = video_hal_file_read(avi, buf, n);
+		if(ret != 0)
+			return -ret;
+		n /= sizeof(avi_idx1_entry_t);
+		entry = (avi_idx1_entry_t*)buf;
+		if(i == 0) // offsets relative to "movi" or absolute, decide by the first chunk
+			base = (entry[0].offset >= avi->offset_movi+4) ? 0 : avi->offset_movi;
+		for(uint32_t j=0; j<n; ++j)
+		{
+			if(MAKEWORD((uint8_t*)&entry[j].ckid + 2) != AVI_VIDS_FLAG)
+				continue;
+			ret = avi_video_index_push(avi, capacity, base + entry[j].offset);
+			if(ret != 0)
+				return ret;
+		}
+		i += n;
+	}
+	return 0;
+}
+
+static int avi_scan_movi(avi_t* avi, uint8_t* buf, uint32_t* capacity)
+{
+	int ret;
+	uint32_t pos = avi->offset_movi + 4;
+	uint32_t end = video_hal_file_size(avi);
+	uint32_t id, size;
+
+	if(avi->offset_idx1 && avi->offset_idx1 < end)
+		end = avi->offset_idx1;
+	while(pos + 8 <= end)
+	{
+		ret = video_hal_file_seek(avi, pos, VIDEO_HAL_FILE_SEEK_SET);
+		if(ret != 0)
+			return -ret;
+		ret = video_hal_file_read(avi, buf, 8);
+		if(ret != 0)
+			return -ret;
+		id = MAKEDWORD(buf);
+		size = MAKEDWORD(buf+4);
+		if(id == AVI_LIST_ID) // LIST rec, chunks inside
+		{
+			pos += 12;
+			continue;
+		}
+		if(MAKEWORD(buf+2) == AVI_VIDS_FLAG)
+		{
+			ret = avi_video_index_push(avi, capacity, pos);
+			if(ret != 0)
+				return ret;
+		}
+		pos += 8 + size + (size%2);
+	}
+	return 0;
+}
+
+int avi_load_index(avi_t* avi, uint8_t* buf, uint32_t buf_size, bool scan)
+{
+	int ret;
+	uint32_t capacity = 0;
+
+	avi_free_index(avi);
+	ret = avi_load_idx1(avi, buf, buf_size, &capacity);
+	if(ret == 0)
+		return 0;
+	avi_free_index(avi);
+	if(ret != ENOENT || !scan)
+		return ret;
+	// no idx1, hop over chunk headers instead of reading the data
+	capacity = 0;
+	ret = avi_scan_movi(avi, buf, &capacity);
+	if(ret != 0)
+		avi_free_index(avi);
+	return ret;
+}
+
+void avi_free_index(avi_t* avi)
+{
+	if(avi->video_index)
+	{
+		video_hal_free((uint8_t*)avi->video_index);
+		avi->video_index = NULL;
+	}
+	avi->video_index_num = 0;
+}
+
+int avi_seek_frame(avi_t* avi, uint32_t frame, uint8_t* buf)
+{
+	int ret;
+
+	if(!avi->video_index)
+		return ENOENT;
+	if(frame >= avi->video_index_num)
+		return EINVAL;
+	ret = video_hal_file_seek(avi, avi->video_index[frame], VIDEO_HAL_FILE_SEEK_SET);
+	if(ret != 0)
+		return -ret;
+	ret = video_hal_file_read(avi, buf, 8);
+	if(ret != 0)
+		return -ret;
+	if(avi_get_streaminfo(buf, avi) != AVI_STATUS_OK || avi->stream_id != AVI_VIDS_FLAG)
+		return EIO;
+	avi->frame_count = frame;
+	return 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 
 
+static void avi_record_index_add(avi_t* avi, uint32_t size)
+{
+	avi_index_block_t* block = avi->index_tail;
+
+	if(avi->index_error)
+		return;
+	if(!block || block->num >= AVI_INDEX_BLOCK_ENTRIES)
+	{
+		block = (avi_index_block_t*)video_hal_malloc(sizeof(avi_index_block_t));
+		if(!block)
+		{
+			avi->index_error = true; // keep recording, just no idx1
+			return;
+		}
+		block->next = NULL;
+		block->num = 0;
+		if(avi->index_tail)
+			avi->index_tail->next = block;
+		else
+			avi->index_head = block;
+		avi->index_tail = block;
+	}
+	block->entry[block->num].offset = 4 + avi->content_size; // chunk header offset from "movi"
+	block->entry[block->num].size = size;
+	++block->num;
+}
+
+void avi_record_index_free(avi_t* avi)
+{
+	avi_index_block_t* block = avi->index_head;
+
+	while(block)
+	{
+		avi_index_block_t* next = block->next;
+		video_hal_free((uint8_t*)block);
+		block = next;
+	}
+	avi->index_head = NULL;
+	avi->index_tail = NULL;
+}
+
+static int avi_record_write_index(avi_t* avi)
+{
+	int ret;
+	uint32_t num = 0, n = 0;
+	uint32_t header[2];
+	avi_idx1_entry_t entry[32];
+	avi_index_block_t* block;
+
+	for(block = avi->index_head; block; block = block->next)
+		num += block->num;
+	header[0] = AVI_IDX1_ID;                              //"idx1"
+	header[1] = num*sizeof(avi_idx1_entry_t);
+	ret = video_hal_file_write(avi, (uint8_t*)header, 8);
+	if( ret <= 0)
+		return ret;
+	for(block = avi->index_head; block; block = block->next)
+	{
+		for(uint32_t i=0; i<block->num; ++i)
+		{
+			bool audio = block->entry[i].size & AVI_INDEX_AUDIO_BIT;
+			entry[n].ckid = audio ? *((uint32_t*)AVI_AUDS_FLAG_TBL[1]) : *((uint32_t*)AVI_VIDS_FLAG_TBL[0]);
+			entry[n].flags = audio ? 0 : AVI_IDX1_KEYFRAME;
+			entry[n].offset = block->entry[i].offset;
+			entry[n].size = block->entry[i].size & ~AVI_INDEX_AUDIO_BIT;
+			if(++n == sizeof(entry)/sizeof(entry[0]))
+			{
+				ret = video_hal_file_write(avi, (uint8_t*)entry, sizeof(entry));
+				if( ret <= 0)
+					return ret;
+				n = 0;
+			}
+		}
+	}
+	if(n)
+	{
+		ret = video_hal_file_write(avi, (uint8_t*)entry, n*sizeof(avi_idx1_entry_t));
+		if( ret <= 0)
+			return ret;
+	}
+	return 8 + num*sizeof(avi_idx1_entry_t);
+}
+
 /**
  * 
  * @avi_config: config: usec_per_frame, max_byte_sec, width, height,
@@ -349,7 +598,7 @@ int avi_record_append_video(avi_t* avi, image_t* img)
 	if (ret < 0 )
 		return ret;
 	data.len = ret;
-	ret = video_hal_file_seek(avi, -(data.len+4), VIDEO_HAL_FILE_SEEK_CUR);
+	ret = video_hal_file_seek(avi, -(long)(data.len+4), VIDEO_HAL_FILE_SEEK_CUR);
 	if( ret != 0)
 		return -ret;
 	ret = video_hal_file_write(avi, (uint8_t*)&data.len, 4);
@@ -358,6 +607,7 @@ int avi_record_append_video(avi_t* avi, image_t* img)
 	ret = video_hal_file_seek(avi, data.len, VIDEO_HAL_FILE_SEEK_CUR);
 	if( ret != 0)
 		return -ret;
+	avi_record_index_add(avi, data.len);
 	avi->content_size += 8 + data.len; //header length + data length
 	++avi->total_frame;
 	return data.len;
@@ -366,7 +616,7 @@ int avi_record_append_video(avi_t* avi, image_t* img)
 int avi_record_append_audio(avi_t* avi, uint8_t* buf, uint32_t len)
 {
 	avi_data_t data = {
-		.id = (uint32_t)AVI_AUDS_FLAG_TBL[1],
+		.id = *((uint32_t*)AVI_AUDS_FLAG_TBL[1]),
 		.len = len,
 		.data = buf
 	};
@@ -376,11 +626,14 @@ int avi_record_append_audio(avi_t* avi, uint8_t* buf, uint32_t len)
 	ret = video_hal_file_write(avi, buf, len);
 	if( ret <= 0 )
 		return -ret;
+	avi_record_index_add(avi, len | AVI_INDEX_AUDIO_BIT);
+	avi->content_size += 8 + len;
 	return 0;
 }
 
 int avi_record_fail(avi_t* avi)
 {
+	avi_record_index_free(avi);
 	video_hal_file_close(avi);
 	return 0;
 }
@@ -390,10 +643,23 @@ int avi_record_finish(avi_t* avi)
 	
 	int ret;
 	uint32_t size;
+	uint32_t flags = 0;
 
+	//append idx1 after movi data, skip it if index allocation failed while recording
+	if(!avi->index_error)
+	{
+		ret = avi_record_write_index(avi);
+		if( ret <= 0)
+		{
+			avi_record_index_free(avi);
+			return -ret;
+		}
+		flags = AVI_AVIF_HASINDEX;
+	}
+	avi_record_index_free(avi);
 	//write content length
-	  //move cursor after to LIST(LIST....movi00dc)
-	ret = video_hal_file_seek(avi, -(avi->content_size+8), VIDEO_HAL_FILE_SEEK_CUR);
+	  //move cursor after to LIST(LIST....movi)
+	ret = video_hal_file_seek(avi, avi->offset_movi-4, VIDEO_HAL_FILE_SEEK_SET);
 	if( ret != 0)
 		return -ret;
 	size = avi->content_size+4; // len(content) + len(movi)
@@ -411,10 +677,13 @@ int avi_record_finish(avi_t* avi)
 	ret = video_hal_file_write(avi, (uint8_t*)&size, 4);
 	if( ret <= 0)
 		return -ret;
-	//write total_frame in avih
-	ret = video_hal_file_seek(avi, 40, VIDEO_HAL_FILE_SEEK_CUR); //4+ sizeof(list_header_t) +4*6
+	//write flags and total_frame in avih
+	ret = video_hal_file_seek(avi, 36, VIDEO_HAL_FILE_SEEK_CUR); //4+ sizeof(list_header_t) +4*5
 	if(ret!=0)
 		return -ret;
+	ret = video_hal_file_write(avi, (uint8_t*)(&flags), 4);
+	if( ret <= 0)
+		return -ret;
 	ret = video_hal_file_write(avi, (uint8_t*)(&avi->total_frame), 4);
 	if( ret <= 0)
 		return -ret;
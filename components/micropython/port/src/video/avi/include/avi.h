@@ -9,8 +9,6 @@
 
 #include "imlib.h" // need image_t related
 
-#define AVI_AUDIO_BUF_MAX_NUM 4
-
 //Little endian
 #define AVI_RIFF_ID			0X46464952  
 #define AVI_AVI_ID			0X20495641
@@ -23,6 +21,7 @@
 #define AVI_STRH_ID			0X68727473
 #define AVI_STRF_ID			0X66727473
 #define AVI_STRD_ID			0X64727473
+#define AVI_IDX1_ID			0X31786469          //"idx1"
 
 #define AVI_VIDS_STREAM		0X73646976
 #define AVI_AUDS_STREAM		0X73647561
@@ -32,6 +31,12 @@
 
 #define AVI_FORMAT_MJPG		0X47504A4D          //"MJPG"
 
+#define AVI_AVIF_HASINDEX   0x00000010          // avih flags: file has idx1
+#define AVI_IDX1_KEYFRAME   0x00000010          // idx1 flags: key frame (every mjpeg frame)
+
+#define AVI_INDEX_BLOCK_ENTRIES 1024            // record index entries per allocated block
+#define AVI_INDEX_AUDIO_BIT     0x80000000      // record index: set in size for audio chunks
+
 #define AVI_AUDIO_FORMAT_PCM  0x00000001        // PCM
 #define AVI_AUDIO_FORMAT_MP2  0x00000050        // MP2
 #define AVI_AUDIO_FORMAT_MP3  0x00000055        // MP3
@@ -165,11 +170,26 @@ typedef struct{
 	uint8_t* data;
 } avi_data_t;
 
-typedef struct{
-	uint8_t* buf;
-	uint32_t len;
-	volatile bool     empty;
-} audio_buf_info_t __attribute__((aligned(8)));
+typedef struct
+{
+	uint32_t ckid;             // "00dc" / "01wb"
+	uint32_t flags;            // AVI_IDX1_KEYFRAME
+	uint32_t offset;           // chunk header offset, relative to "movi" or absolute
+	uint32_t size;             // chunk data size
+}avi_idx1_entry_t;
+
+typedef struct
+{
+	uint32_t offset;           // chunk header offset relative to "movi"
+	uint32_t size;             // chunk data size, AVI_INDEX_AUDIO_BIT for audio chunks
+}avi_index_entry_t;
+
+typedef struct avi_index_block
+{
+	struct avi_index_block* next;
+	uint32_t num;
+	avi_index_entry_t entry[AVI_INDEX_BLOCK_ENTRIES];
+}avi_index_block_t;
 
 typedef struct
 {
@@ -195,10 +215,15 @@ typedef struct
 	uint8_t* video_buf;
 	uint8_t* img_buf;
 	uint32_t offset_movi;         //start index of movi flag
-
-	audio_buf_info_t audio_buf[AVI_AUDIO_BUF_MAX_NUM];
-	volatile uint8_t  index_buf_save;
-	volatile uint8_t  index_buf_play;
+	uint32_t offset_idx1;         //start index of idx1 chunk, 0 if file has no index
+	uint32_t* video_index;        //play: absolute file offset of each video chunk header
+	uint32_t video_index_num;     //play: number of entries in video_index
+	avi_index_block_t* index_head;//record: collected chunk index
+	avi_index_block_t* index_tail;
+	bool     index_error;         //record: index allocation failed, finish without idx1
+
+	uint8_t* audio_buf;           //play: one audio chunk plus the next chunk header
+	int      audio_source;        //play: audio_out source, -1 if none
 	uint32_t audio_count;
 	uint8_t  volume;
 
@@ -214,6 +239,22 @@ uint32_t avi_srarch_id(uint8_t* buf, uint32_t size, uint8_t* id);
 int avi_get_streaminfo(uint8_t* buf, avi_t* avi);
 void avi_debug_info(avi_t* avi);
 
+/**
+ * Build avi->video_index from idx1 (if avi->offset_idx1 is set), or by hopping
+ * over the chunk headers in movi if @scan. File position is undefined after.
+ * @buf: scratch buffer, at least 16 bytes
+ * @return 0 if success, ENOENT if no idx1 and not @scan, or other error code(>0 from errno.h)
+ */
+int avi_load_index(avi_t* avi, uint8_t* buf, uint32_t buf_size, bool scan);
+void avi_free_index(avi_t* avi);
+/**
+ * Seek to video frame, leave the file position after the frame's chunk header
+ * and update stream info, next play/capture will decode this frame.
+ * @buf: scratch buffer, at least 8 bytes
+ * @return 0 if success, or return error code(>0 from errno.h)
+ */
+int avi_seek_frame(avi_t* avi, uint32_t frame, uint8_t* buf);
+
 /**
  * 
  * @avi_config: config: usec_per_frame, max_byte_sec, width, height,
@@ -228,7 +269,12 @@ int avi_record_header_init(const char* path, avi_t* avi_config);
 int avi_record_append_video(avi_t* avi, image_t* img);
 int avi_record_append_audio(avi_t* avi, uint8_t* buf, uint32_t len);
 int avi_record_fail(avi_t* avi);
+/**
+ * 
+ * append idx1, fix sizes and total frame in header, then close file
+ */
 int avi_record_finish(avi_t* avi);
+void avi_record_index_free(avi_t* avi);
 
 
 #endif
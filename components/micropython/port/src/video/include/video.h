@@ -37,11 +37,18 @@ void video_play_avi_destroy(avi_t* avi);
 int video_play_avi(avi_t* avi);
 int video_stop_play();
 int video_avi_capture(avi_t* avi, image_t *img);
+/**
+ * 
+ * seek to video frame, next play/capture decodes it
+ * @return 0 if success, or return error code(>0 from errno.h)
+ */
+int video_avi_seek(avi_t* avi, uint32_t frame);
+uint32_t video_avi_frame_count(avi_t* avi);
 int video_hal_display_init();
 int video_hal_display(image_t* img, video_display_roi_t img_roi);
 uint64_t video_hal_ticks_us(void);
 int video_hal_audio_init(avi_t* avi);
-int video_hal_audio_play(uint8_t* data, uint32_t len, uint8_t channels);
+int video_hal_audio_play(avi_t* avi, uint8_t* data, uint32_t len);
 void video_avi_record_fail(avi_t* avi);
 void video_avi_record_success(avi_t* avi);
 int video_hal_file_open(avi_t* avi, const char* path, bool write);
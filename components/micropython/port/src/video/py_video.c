@@ -78,6 +78,33 @@ STATIC mp_obj_t py_video_volume(size_t n_args, const mp_obj_t *args, mp_map_t *k
 
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_video_volume_obj, 0, py_video_volume);
 
+STATIC mp_obj_t py_video_seek(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_video_avi_obj_t* arg_avi = (py_video_avi_obj_t*)args[0];
+    if( arg_avi->obj.record )
+        mp_raise_OSError(MP_EPERM);
+    int frame = mp_obj_get_int(args[1]);
+    if( frame < 0 )
+        mp_raise_ValueError("frame must >= 0");
+    int err = video_avi_seek(&arg_avi->obj, (uint32_t)frame);
+    if( err != 0 )
+        mp_raise_OSError(err);
+    return mp_const_none;
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_video_seek_obj, 2, py_video_seek);
+
+STATIC mp_obj_t py_video_frame_count(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
+{
+    py_video_avi_obj_t* arg_avi = (py_video_avi_obj_t*)args[0];
+    avi_t* avi = &arg_avi->obj;
+    if( avi->record )
+        return mp_obj_new_int(avi->total_frame);
+    return mp_obj_new_int(video_avi_frame_count(avi));
+}
+
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(py_video_frame_count_obj, 0, py_video_frame_count);
+
 static const mp_obj_type_t py_video_avi_type;
 STATIC mp_obj_t py_video_record(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
 {
@@ -126,9 +153,10 @@ STATIC mp_obj_t py_video_del(size_t n_args, const mp_obj_t *args, mp_map_t *kw_a
     }
     else // record
     {
-
+        avi_record_index_free(avi);
     }
     memset(avi, 0, sizeof(avi_t));
+    avi->audio_source = -1;
     return mp_const_none;
 }
 
@@ -141,6 +169,8 @@ static const mp_rom_map_elem_t locals_dict_table[] = {
     {MP_OBJ_NEW_QSTR(MP_QSTR_record),  (&py_video_record_obj)},
     {MP_OBJ_NEW_QSTR(MP_QSTR_record_finish),  (&py_video_record_finish_obj)},
     {MP_OBJ_NEW_QSTR(MP_QSTR_capture),  (&py_video_capture_obj)},
+    {MP_OBJ_NEW_QSTR(MP_QSTR_seek),  (&py_video_seek_obj)},
+    {MP_OBJ_NEW_QSTR(MP_QSTR_frame_count),  (&py_video_frame_count_obj)},
 };
 
 STATIC MP_DEFINE_CONST_DICT(locals_dict, locals_dict_table);
@@ -185,6 +215,7 @@ mp_obj_t py_video_open(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args)
         o->base.type = &py_video_avi_type;
         avi_t* avi = &o->obj;
         memset(avi, 0, sizeof(avi_t));
+        avi->audio_source = -1;
         if(args_parsed[ARG_record].u_bool)// record avi
         {
             avi->record = true;
@@ -50,6 +50,8 @@ int video_play_avi_init(const char* path, avi_t* avi)
         return err;
     }
     // mp_printf(&mp_plat_print, "----2--:%d %d\r\n", avi->stream_id, avi->stream_size);
+    // load idx1 if file has one, files without index are scanned on first seek
+    avi_load_index(avi, buf, VIDEO_AVI_BUFF_SIZE, false);
     vfs_internal_seek(file, avi->offset_movi+12, VFS_SEEK_SET, &err);
     avi->img_buf = (uint8_t*)video_hal_malloc(avi->width * avi->height * 2);
     if(!avi->img_buf)
@@ -66,7 +68,13 @@ int video_play_avi_init(const char* path, avi_t* avi)
     avi->audio_count = 0;
     if(avi->audio_sample_rate)//init audio device
     {
-        video_hal_audio_init(avi);
+        err = video_hal_audio_init(avi);
+        if(err != 0)
+        {
+            video_stop_play(avi);
+            video_play_avi_destroy(avi);
+            return err;
+        }
     }
 #ifdef VIDEO_DEBUG
     avi_debug_info(avi);
@@ -86,6 +94,7 @@ void video_play_avi_destroy(avi_t* avi)
         video_hal_free(avi->img_buf);
         avi->img_buf = NULL;
     }
+    avi_free_index(avi);
 }
 #include "printf.h"
 video_status_t video_play_avi(avi_t* avi)
@@ -135,46 +144,16 @@ video_status_t video_play_avi(avi_t* avi)
         status = VIDEO_STATUS_DECODE_VIDEO;
     }
     else // audio
-    {//TODO:
-        
-        if(++avi->index_buf_save > 3)
-            avi->index_buf_save = 0;
-        // mp_printf(&mp_plat_print, "save index:%d\r\n", avi->index_buf_save);
-
-        while( !avi->audio_buf[avi->index_buf_save].empty );//buffer full, wait for play complete
-        // mp_printf(&mp_plat_print, "save index:%d ok\r\n", avi->index_buf_save);
-        vfs_internal_read(avi->file, avi->audio_buf[avi->index_buf_save].buf, avi->stream_size+8, &err);
+    {
+        vfs_internal_read(avi->file, avi->audio_buf, avi->stream_size+8, &err);
         if( err != 0)
         {
             video_stop_play(avi);
             return err;
         }
-        avi->audio_buf[avi->index_buf_save].len = avi->stream_size;
-        for(uint32_t i = 0; i< avi->audio_buf[avi->index_buf_save].len/2; ++i)
-        {
-            ((int16_t*)avi->audio_buf[avi->index_buf_save].buf)[i] = (int16_t)( ((int16_t*)avi->audio_buf[avi->index_buf_save].buf)[i] * (avi->volume/100.0) );
-        }
-        avi->audio_buf[avi->index_buf_save].empty = false;
-        if(avi->audio_count==0)//first once play
-        {
-            ++avi->index_buf_play;
-            if(!avi->audio_buf[avi->index_buf_play].empty)
-            {
-                video_hal_audio_play(avi->audio_buf[avi->index_buf_play].buf, avi->audio_buf[avi->index_buf_play].len, avi->audio_channels);
-                // mp_printf(&mp_plat_print, "play index:%d\r\n", avi->index_buf_play);
-            }
-        }
-        else if(avi->index_buf_play == avi->index_buf_save)//play complete already, restart play, play index no change
-        {
-            if(!avi->audio_buf[avi->index_buf_play].empty)
-            {
-                video_hal_audio_play(avi->audio_buf[avi->index_buf_play].buf, avi->audio_buf[avi->index_buf_play].len, avi->audio_channels);
-                // mp_printf(&mp_plat_print, "play index:%d\r\n", avi->index_buf_play);
-            }
-        }
+        video_hal_audio_play(avi, avi->audio_buf, avi->stream_size);//blocks while the mixer FIFO is full, drops the chunk if it stays full
         ++avi->audio_count;
-        pbuf = avi->audio_buf[avi->index_buf_save].buf;
-        // mp_printf(&mp_plat_print, "save:%d %d\r\n", avi->index_buf_save, avi->audio_buf_len[avi->index_buf_save]);
+        pbuf = avi->audio_buf;
         status = VIDEO_STATUS_DECODE_AUDIO;
     } 
     err = avi_get_streaminfo(pbuf + avi->stream_size, avi);
@@ -246,14 +225,14 @@ int video_avi_capture(avi_t* avi, image_t *img)
     }
     else // audio: pass
     {
-            vfs_internal_read(avi->file, avi->audio_buf[avi->index_buf_save].buf, avi->stream_size+8, &err);
+            vfs_internal_read(avi->file, avi->audio_buf, avi->stream_size+8, &err);
             if( err != 0)
             {
                 video_stop_play(avi);
                 return err;
             }
             ++avi->audio_count;
-            pbuf = avi->audio_buf[avi->index_buf_save].buf;
+            pbuf = avi->audio_buf;
             status = VIDEO_STATUS_DECODE_AUDIO;
     } 
     err = avi_get_streaminfo(pbuf + avi->stream_size, avi);
@@ -272,6 +251,37 @@ int video_avi_capture(avi_t* avi, image_t *img)
     return status;
 }
 
+/**
+ * 
+ * @return 0 if success, or return error code(>0 from errno.h)
+ */
+int video_avi_seek(avi_t* avi, uint32_t frame)
+{
+    int err;
+
+    if(avi->status != VIDEO_STATUS_RESUME && avi->status != VIDEO_STATUS_PLAYING)
+        return MP_EPERM; // file closed by video_stop_play
+    if(!avi->video_index)
+    {
+        err = avi_load_index(avi, avi->video_buf, VIDEO_AVI_BUFF_SIZE, true);
+        if(err != 0)
+            return err;
+    }
+    err = avi_seek_frame(avi, frame, avi->video_buf);
+    if(err != 0)
+        return err;
+    avi->status = VIDEO_STATUS_RESUME;
+    avi->time_us_fps_ctrl = video_hal_ticks_us();
+    return 0;
+}
+
+uint32_t video_avi_frame_count(avi_t* avi)
+{
+    if(avi->video_index)
+        return avi->video_index_num;
+    return avi->total_frame;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////
 
 void video_avi_record_fail(avi_t* avi)
@@ -9,6 +9,11 @@
 #include "io.h"
 #include "lcd.h"
 #include "vfs_internal.h"
+#include "audio_out.h"
+#include "py/runtime.h"
+#include "py/mphal.h"
+
+#define VIDEO_AUDIO_WRITE_TIMEOUT_MS 200 // several DMA blocks, longer means the ring is not running
 
 extern volatile i2s_t *const i2s[3]; //TODO: remove register, replace with function
 
@@ -66,20 +71,6 @@ uint64_t inline video_hal_ticks_us(void)
 }
 
 
-static int on_irq_dma4(void *ctx)
-{
-    avi_t* avi = (avi_t*)ctx;
-
-    avi->audio_buf[avi->index_buf_play].empty = true;
-    if(++avi->index_buf_play > 3)
-        avi->index_buf_play = 0;
-    if( !avi->audio_buf[avi->index_buf_play].empty )
-    {
-        video_hal_audio_play(avi->audio_buf[avi->index_buf_play].buf, avi->audio_buf[avi->index_buf_play].len, (uint8_t)avi->audio_channels);
-    }
-    return 0;
-}
-
 int video_hal_display_init()
 {
     // ! don't init here, init on system start up
@@ -90,66 +81,41 @@ int video_hal_display_init()
 
 int video_hal_audio_init(avi_t* avi)
 {
-    // //TODO:optimize
-    // i2s_init(I2S_DEVICE_0, I2S_TRANSMITTER, 0x0C);
-    // i2s_tx_channel_config(I2S_DEVICE_0, I2S_CHANNEL_1,
-    //     RESOLUTION_16_BIT, SCLK_CYCLES_32,
-    //     /*TRIGGER_LEVEL_1*/TRIGGER_LEVEL_4,
-    //     RIGHT_JUSTIFYING_MODE
-    //     );
-    i2s_set_sample_rate(I2S_DEVICE_0, avi->audio_sample_rate);
-    dmac_set_irq(DMAC_CHANNEL4, on_irq_dma4, (void*)avi, 1);
-    avi->audio_buf[0].buf = (uint8_t*)malloc(avi->audio_buf_size+8);
-    if( !avi->audio_buf[0].buf )
-        return ENOMEM;
-    avi->audio_buf[1].buf = (uint8_t*)malloc(avi->audio_buf_size+8);
-    if( !avi->audio_buf[1].buf )
-    {
-        free(avi->audio_buf[0].buf);
+    avi->audio_source = -1;
+    avi->audio_buf = (uint8_t*)malloc(avi->audio_buf_size+8);
+    if( !avi->audio_buf )
         return ENOMEM;
-    }
-    avi->audio_buf[2].buf = (uint8_t*)malloc(avi->audio_buf_size+8);
-    if( !avi->audio_buf[2].buf )
+    // another player may own the output already, keep its rate and resample this stream to it
+    if( !audio_out_running() )
+        i2s_set_sample_rate(I2S_DEVICE_0, avi->audio_sample_rate);
+    if( audio_out_start(I2S_DEVICE_0, avi->audio_sample_rate) != 0 )
     {
-        free(avi->audio_buf[0].buf);
-        free(avi->audio_buf[1].buf);
-        return ENOMEM;
+        free(avi->audio_buf);
+        avi->audio_buf = NULL;
+        return EBUSY;
     }
-    avi->audio_buf[3].buf = (uint8_t*)malloc(avi->audio_buf_size+8);
-    if( !avi->audio_buf[3].buf )
+    avi->audio_source = audio_out_open(avi->audio_sample_rate, (uint8_t)avi->audio_channels);
+    if( avi->audio_source < 0 )
     {
-        free(avi->audio_buf[0].buf);
-        free(avi->audio_buf[1].buf);
-        free(avi->audio_buf[2].buf);
-        return ENOMEM;
+        int err = (avi->audio_source == -2) ? ENOMEM : EBUSY;
+        avi->audio_source = -1;
+        free(avi->audio_buf);
+        avi->audio_buf = NULL;
+        return err;
     }
-    avi->index_buf_save = 0;
-    avi->index_buf_play = 0;
-    avi->audio_buf[0].len = 0;
-    avi->audio_buf[1].len = 0;
-    avi->audio_buf[2].len = 0;
-    avi->audio_buf[3].len = 0;
-    avi->audio_buf[0].empty = true;
-    avi->audio_buf[1].empty = true;
-    avi->audio_buf[2].empty = true;
-    avi->audio_buf[3].empty = true;
     return 0;
 }
 
 int video_hal_audio_deinit(avi_t* avi)
 {
-    if(avi->audio_buf[0].buf)
-        free(avi->audio_buf[0].buf);
-    if(avi->audio_buf[1].buf)
-        free(avi->audio_buf[1].buf);
-    if(avi->audio_buf[2].buf)
-        free(avi->audio_buf[2].buf);
-    if(avi->audio_buf[3].buf)
-        free(avi->audio_buf[3].buf);
-    avi->audio_buf[0].buf = NULL;
-    avi->audio_buf[1].buf = NULL;
-    avi->audio_buf[2].buf = NULL;
-    avi->audio_buf[3].buf = NULL;
+    if(avi->audio_source >= 0)
+        audio_out_close(avi->audio_source);
+    avi->audio_source = -1;
+    if(avi->audio_buf)
+        free(avi->audio_buf);
+    avi->audio_buf = NULL;
+    if(audio_out_running()) // still playing for someone else
+        return 0;
     //TODO: replace register version with function
     ier_t u_ier;
     u_ier.reg_data = readl(&i2s[I2S_DEVICE_0]->ier);
@@ -162,9 +128,31 @@ int video_hal_audio_deinit(avi_t* avi)
     return 0;
 }
 
-int video_hal_audio_play(uint8_t* data, uint32_t len, uint8_t channels)
+int video_hal_audio_play(avi_t* avi, uint8_t* data, uint32_t len)
 {
-    i2s_play(I2S_DEVICE_0, DMAC_CHANNEL4, data, len, 1024, 16, channels);
+    audio_mixer_t* mixer = audio_out_mixer();
+    uint32_t frame_bytes = avi->audio_channels * sizeof(int16_t);
+    uint32_t frames = len / frame_bytes;
+
+    if(avi->audio_source < 0)
+        return -EPERM;
+    audio_mixer_set_gain(mixer, avi->audio_source, (int32_t)avi->volume * AUDIO_MIXER_GAIN_ONE / 100);
+    mp_uint_t last = mp_hal_ticks_ms();
+    while(frames)
+    {
+        uint32_t n = audio_mixer_write(mixer, avi->audio_source, (int16_t*)data, frames);
+        if(n == 0) // FIFO full, wait for the DMA to take some
+        {
+            // the DMA ring stopped taking data, drop the rest of the chunk
+            if(mp_hal_ticks_ms() - last >= VIDEO_AUDIO_WRITE_TIMEOUT_MS)
+                return -ETIMEDOUT;
+            MICROPY_EVENT_POLL_HOOK
+            continue;
+        }
+        last = mp_hal_ticks_ms();
+        data += n * frame_bytes;
+        frames -= n;
+    }
     return 0;
 }
 
@@ -0,0 +1,300 @@
+// audio_mixer with WAV files in and out: tone files at the rates the players
+// see are resampled to 44.1k and checked for pitch, noise and clipping, then
+// mixed together into build/mix.wav to listen to.
+//
+//   audio_mixer_test                      the checks
+//   audio_mixer_test in.wav... out.wav    mix 16-bit WAV files to a 44.1k stereo file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "audio_mixer.h"
+
+#define OUT_RATE    44100
+#define FIFO_FRAMES 4096
+#define BLOCK       512     // frames of one DMA block in audio_out.c
+
+typedef struct {
+    uint32_t rate;
+    uint16_t channels;
+    uint32_t frames;
+    int16_t* pcm;
+} wav_t;
+
+static void put32(FILE* f, uint32_t v)
+{
+    uint8_t b[4] = {v, v >> 8, v >> 16, v >> 24};
+    fwrite(b, 1, 4, f);
+}
+
+static void put16(FILE* f, uint16_t v)
+{
+    uint8_t b[2] = {v, v >> 8};
+    fwrite(b, 1, 2, f);
+}
+
+static void wav_save(const char* path, const wav_t* w)
+{
+    FILE* f = fopen(path, "wb");
+    uint32_t bytes = w->frames * w->channels * 2;
+    assert(f);
+    fwrite("RIFF", 1, 4, f);
+    put32(f, 36 + bytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put32(f, 16);
+    put16(f, 1);
+    put16(f, w->channels);
+    put32(f, w->rate);
+    put32(f, w->rate * w->channels * 2);
+    put16(f, w->channels * 2);
+    put16(f, 16);
+    fwrite("data", 1, 4, f);
+    put32(f, bytes);
+    for (uint32_t i = 0; i < w->frames * w->channels; i++)
+        put16(f, w->pcm[i]);
+    fclose(f);
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// 16-bit PCM only, the other widths are widened by wav.c before they reach the mixer
+static int wav_load(const char* path, wav_t* w)
+{
+    uint8_t hdr[8];
+    FILE* f = fopen(path, "rb");
+    memset(w, 0, sizeof(*w));
+    if (!f || fread(hdr, 1, 8, f) != 8 || memcmp(hdr, "RIFF", 4) || fseek(f, 12, SEEK_SET))
+        goto fail;
+    while (fread(hdr, 1, 8, f) == 8)
+    {
+        uint32_t size = get32(hdr + 4);
+        if (memcmp(hdr, "fmt ", 4) == 0)
+        {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16 || fseek(f, size - 16 + (size & 1), SEEK_CUR))
+                goto fail;
+            w->channels = fmt[2] | fmt[3] << 8;
+            w->rate = get32(fmt + 4);
+            if ((fmt[14] | fmt[15] << 8) != 16 || w->channels < 1 || w->channels > 2)
+                goto fail;
+        }
+        else if (memcmp(hdr, "data", 4) == 0 && w->channels)
+        {
+            w->frames = size / (2 * w->channels);
+            w->pcm = malloc(w->frames * w->channels * 2 + 2);
+            if (fread(w->pcm, 2 * w->channels, w->frames, f) != w->frames)
+                goto fail;
+            fclose(f);
+            return 0;
+        }
+        else if (fseek(f, size + (size & 1), SEEK_CUR))
+        {
+            goto fail;
+        }
+    }
+fail:
+    fprintf(stderr, "%s: not a 16-bit PCM WAV file\n", path);
+    if (f)
+        fclose(f);
+    free(w->pcm);
+    return -1;
+}
+
+static wav_t tone(uint32_t rate, uint16_t channels, double freq, double amp, uint32_t frames)
+{
+    wav_t w = {rate, channels, frames, malloc(frames * channels * 2)};
+    for (uint32_t i = 0; i < frames; i++)
+        for (int c = 0; c < channels; c++)
+            w.pcm[i * channels + c] = (int16_t)lrint(amp * sin(2 * M_PI * freq * i / rate));
+    return w;
+}
+
+// feeds every file through its own FIFO the way the players do, a block at a time
+static wav_t mix(const wav_t* in, int num, const int32_t* gains, uint32_t* underruns)
+{
+    static audio_mixer_t mixer;
+    static int16_t fifos[AUDIO_MIXER_MAX_SOURCES][FIFO_FRAMES * 2];
+    uint32_t fed[AUDIO_MIXER_MAX_SOURCES] = {0};
+    uint32_t longest = 0, block[BLOCK];
+    int ids[AUDIO_MIXER_MAX_SOURCES];
+    wav_t out = {OUT_RATE, 2, 0, NULL};
+
+    audio_mixer_init(&mixer, OUT_RATE);
+    for (int s = 0; s < num; s++)
+    {
+        ids[s] = audio_mixer_open(&mixer, in[s].rate, in[s].channels, fifos[s], FIFO_FRAMES);
+        assert(ids[s] >= 0);
+        if (gains)
+            audio_mixer_set_gain(&mixer, ids[s], gains[s]);
+        uint32_t len = (uint32_t)((uint64_t)in[s].frames * OUT_RATE / in[s].rate);
+        if (len > longest)
+            longest = len;
+    }
+    out.pcm = malloc((longest + 2 * BLOCK) * 4);
+    while (audio_mixer_active(&mixer))
+    {
+        for (int s = 0; s < num; s++)
+        {
+            if (!mixer.source[ids[s]].used)
+                continue;
+            fed[s] += audio_mixer_write(&mixer, ids[s], in[s].pcm + fed[s] * in[s].channels, in[s].frames - fed[s]);
+            if (fed[s] == in[s].frames)
+                audio_mixer_end(&mixer, ids[s]);
+        }
+        audio_mixer_mix(&mixer, block, BLOCK);
+        for (uint32_t i = 0; i < BLOCK && out.frames < longest + 2 * BLOCK; i++, out.frames++)
+        {
+            out.pcm[out.frames * 2] = (int16_t)(block[i] & 0xffff);
+            out.pcm[out.frames * 2 + 1] = (int16_t)(block[i] >> 16);
+        }
+        // audio_out closes a source once it has drained
+        for (int s = 0; s < num; s++)
+        {
+            if (mixer.source[ids[s]].used && audio_mixer_drained(&mixer, ids[s]))
+            {
+                if (underruns)
+                    underruns[s] = mixer.source[ids[s]].underruns;
+                audio_mixer_close(&mixer, ids[s]);
+            }
+        }
+    }
+    return out;
+}
+
+// zero crossings of the left channel over the middle of the output
+static double measure_freq(const wav_t* w, uint32_t from, uint32_t to)
+{
+    int crossings = 0;
+    uint32_t first = 0, last = 0;
+    for (uint32_t i = from + 1; i < to; i++)
+    {
+        if (w->pcm[(i - 1) * 2] < 0 && w->pcm[i * 2] >= 0)
+        {
+            if (!crossings++)
+                first = i;
+            last = i;
+        }
+    }
+    return (crossings - 1) * (double)w->rate / (last - first);
+}
+
+// against the ideal tone at the times the Q16 phase actually lands on
+static double measure_snr(const wav_t* out, const wav_t* in, double freq, double amp, uint32_t from, uint32_t to)
+{
+    uint32_t step = (uint32_t)(((uint64_t)in->rate << 16) / OUT_RATE);
+    double sig = 0, noise = 0;
+    for (uint32_t i = from; i < to; i++)
+    {
+        double t = (double)i * step / 65536.0 / in->rate;
+        double ideal = amp * sin(2 * M_PI * freq * t);
+        double e = out->pcm[i * 2] - ideal;
+        sig += ideal * ideal;
+        noise += e * e;
+    }
+    return 10 * log10(sig / noise);
+}
+
+static void test_tones(void)
+{
+    static const struct {
+        uint32_t rate;
+        uint16_t channels;
+        double freq;
+        double min_snr;     // linear interpolation loses ~12 dB per octave nearer to Nyquist
+        const char* path;
+    } cases[] = {
+        {16000, 1, 440, 48, "build/tone_16k_mono.wav"},
+        {44100, 2, 1000, 80, "build/tone_44k_stereo.wav"},
+        {22050, 1, 2000, 28, "build/tone_22k_mono.wav"},
+    };
+    wav_t in[3];
+    for (int c = 0; c < 3; c++)
+    {
+        wav_t w = tone(cases[c].rate, cases[c].channels, cases[c].freq, 8000, cases[c].rate);
+        wav_save(cases[c].path, &w);
+        free(w.pcm);
+        assert(wav_load(cases[c].path, &in[c]) == 0);
+        assert(in[c].rate == cases[c].rate && in[c].frames == cases[c].rate);
+
+        uint32_t underruns = 0;
+        wav_t out = mix(&in[c], 1, NULL, &underruns);
+        double freq = measure_freq(&out, 1000, OUT_RATE - 1000);
+        double snr = measure_snr(&out, &in[c], cases[c].freq, 8000, 1000, OUT_RATE - 1000);
+        printf("%5u Hz %s %4.0f Hz tone: %.1f Hz out, SNR %.1f dB, %u underruns\n", cases[c].rate,
+               cases[c].channels == 1 ? "mono  " : "stereo", cases[c].freq, freq, snr, underruns);
+        assert(fabs(freq - cases[c].freq) < cases[c].freq * 0.005);
+        assert(snr > cases[c].min_snr);
+        assert(underruns == 0);
+        // mono is sent on both channels
+        for (uint32_t i = 0; i < OUT_RATE - 1000; i++)
+            assert(out.pcm[i * 2] == out.pcm[i * 2 + 1]);
+        free(out.pcm);
+    }
+
+    wav_t out = mix(in, 3, NULL, NULL);
+    wav_save("build/mix.wav", &out);
+    printf("three tones mixed into build/mix.wav, %u frames\n", out.frames);
+    assert(out.frames >= OUT_RATE);
+    free(out.pcm);
+    for (int c = 0; c < 3; c++)
+        free(in[c].pcm);
+}
+
+static void test_gain_and_clip(void)
+{
+    wav_t loud[3];
+    for (int c = 0; c < 3; c++)
+    {
+        loud[c] = tone(OUT_RATE, 1, 0, 0, 4096);
+        for (uint32_t i = 0; i < 4096; i++)
+            loud[c].pcm[i] = i < 2048 ? 30000 : -30000;
+    }
+    // three full scale sources saturate instead of wrapping around
+    wav_t out = mix(loud, 3, NULL, NULL);
+    assert(out.pcm[100 * 2] == 32767 && out.pcm[3000 * 2] == -32768);
+    free(out.pcm);
+    // half gain on each: 45000 still clips, one alone is halved exactly
+    int32_t half[3] = {AUDIO_MIXER_GAIN_ONE / 2, AUDIO_MIXER_GAIN_ONE / 2, AUDIO_MIXER_GAIN_ONE / 2};
+    out = mix(loud, 3, half, NULL);
+    assert(out.pcm[100 * 2] == 32767 && out.pcm[3000 * 2] == -32768);
+    free(out.pcm);
+    out = mix(loud, 1, half, NULL);
+    assert(out.pcm[100 * 2] == 15000 && out.pcm[3000 * 2] == -15000);
+    free(out.pcm);
+    for (int c = 0; c < 3; c++)
+        free(loud[c].pcm);
+    printf("gain and saturation: ok\n");
+}
+
+int main(int argc, char** argv)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (argc >= 3)
+    {
+        wav_t in[AUDIO_MIXER_MAX_SOURCES];
+        int num = argc - 2;
+        if (num > AUDIO_MIXER_MAX_SOURCES)
+        {
+            fprintf(stderr, "at most %d inputs\n", AUDIO_MIXER_MAX_SOURCES);
+            return 2;
+        }
+        for (int i = 0; i < num; i++)
+            if (wav_load(argv[i + 1], &in[i]))
+                return 1;
+        wav_t out = mix(in, num, NULL, NULL);
+        wav_save(argv[argc - 1], &out);
+        printf("%s: %u frames at %u Hz\n", argv[argc - 1], out.frames, OUT_RATE);
+        free(out.pcm);
+        for (int i = 0; i < num; i++)
+            free(in[i].pcm);
+        return 0;
+    }
+    test_tones();
+    test_gain_and_clip();
+    printf("audio_mixer: ok\n");
+    return 0;
+}
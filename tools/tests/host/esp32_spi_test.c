@@ -0,0 +1,144 @@
+// esp32_spi against the NINA responder in mock/nina_spi.h: chunked socket
+// writes and reads, short writes, the UDP split, the scan that holds one
+// response while it asks for more, and a module that stops answering.
+// malloc is wrapped to count what the driver takes from the heap.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "nina_spi.h"
+
+static uint32_t mallocs;
+
+void* __real_malloc(size_t size);
+void* __wrap_malloc(size_t size)
+{
+    mallocs++;
+    return __real_malloc(size);
+}
+
+static uint8_t data[NINA_BUF];
+
+static void open_socket(void)
+{
+    nina_init();
+    esp32_spi_init(NINA_CS, 0xff, NINA_RDY, 1);
+    uint8_t ip[4] = {192, 168, 0, 10};
+    uint8_t sock = esp32_spi_get_socket();
+    assert(sock == 0);
+    assert(esp32_spi_socket_connect(sock, ip, 0, 8080, TCP_MODE) == 0);
+    assert(nina.commands[SOFT_RESET_CMD] == 1 && nina.bad_commands == 0);
+}
+
+static void test_write(void)
+{
+    open_socket();
+    for (uint32_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)(i * 31 + (i >> 8));
+    // the first write allocates the two packet buffers
+    assert(esp32_spi_socket_write(0, data, 10) == 10);
+    nina.tx_len = 0;
+    memset(nina.commands, 0, sizeof(nina.commands));
+    mallocs = 0;
+
+    assert(esp32_spi_socket_write(0, data, 30000) == 30000);
+    printf("30000 byte write: %u commands, largest packet %u, %u mallocs\n",
+           nina.commands[SEND_DATA_TCP_CMD], nina.max_packet, mallocs);
+    assert(nina.commands[SEND_DATA_TCP_CMD] == (30000 + SPI_MAX_DMA_LEN - 1) / SPI_MAX_DMA_LEN);
+    assert(mallocs == 0 && nina.bad_commands == 0);
+    assert(nina.tx_len == 30000 && memcmp(nina.tx, data, 30000) == 0);
+
+    // the firmware buffer fills up in the third chunk: the count it took, no more commands
+    nina.tx_len = 0;
+    nina.tx_space = 2 * SPI_MAX_DMA_LEN + 1000;
+    memset(nina.commands, 0, sizeof(nina.commands));
+    assert(esp32_spi_socket_write(0, data, 30000) == 2 * SPI_MAX_DMA_LEN + 1000);
+    assert(nina.commands[SEND_DATA_TCP_CMD] == 3);
+    assert(memcmp(nina.tx, data, nina.tx_len) == 0);
+    // full: nothing taken, the caller decides whether to wait
+    assert(esp32_spi_socket_write(0, data, 100) == 0);
+    printf("short writes: ok\n");
+}
+
+static void test_read(void)
+{
+    static uint8_t buf[NINA_BUF];
+    open_socket();
+    for (uint32_t i = 0; i < 10000; i++)
+        nina.rx[i] = (uint8_t)(i * 7);
+    nina.rx_len = 10000;
+    assert(esp32_spi_socket_available(0) == 10000);
+    mallocs = 0;
+    assert(esp32_spi_socket_read(0, buf, 10000) == 10000);
+    assert(memcmp(buf, nina.rx, 10000) == 0);
+    assert(nina.commands[GET_DATABUF_TCP_CMD] == 3 && mallocs == 0);
+
+    // less buffered than asked for: one short chunk ends the read
+    nina.rx_len = nina.rx_pos + 5000;
+    memset(nina.commands, 0, sizeof(nina.commands));
+    assert(esp32_spi_socket_read(0, buf, 9000) == 5000);
+    assert(memcmp(buf, nina.rx + 10000, 5000) == 0);
+    assert(nina.commands[GET_DATABUF_TCP_CMD] == 2);
+    assert(esp32_spi_socket_available(0) == 0);
+    printf("chunked reads: ok\n");
+}
+
+static void test_udp(void)
+{
+    open_socket();
+    assert(esp32_spi_add_udp_data(0, data, 9000) == 0);
+    assert(esp32_spi_send_udp_data(0) == 0);
+    assert(nina.commands[ADD_UDP_DATA_CMD] == 3 && nina.udp_sent == 9000);
+    assert(memcmp(nina.udp, data, 9000) == 0);
+    printf("udp split: ok\n");
+}
+
+static void test_scan(void)
+{
+    static const char* names[] = {"maix", "sipeed-guest", "a network name of 32 characters!"};
+    nina_init();
+    esp32_spi_init(NINA_CS, 0xff, NINA_RDY, 1);
+    for (int i = 0; i < 3; i++)
+    {
+        nina.aps[i].ssid = names[i];
+        nina.aps[i].rssi = -40 - 10 * i;
+        nina.aps[i].encr = i;
+    }
+    nina.aps_num = 3;
+    // the scan list stays in the response arena while the RSSI answers go to the heap
+    esp32_spi_aps_list_t* aps = esp32_spi_scan_networks();
+    assert(aps && aps->aps_num == 3);
+    for (int i = 0; i < 3; i++)
+    {
+        assert(strcmp((char*)aps->aps[i]->ssid, names[i]) == 0);
+        assert(aps->aps[i]->rssi == -40 - 10 * i && aps->aps[i]->encr == i);
+    }
+    aps->del(aps);
+    assert(nina.commands[GET_IDX_RSSI_CMD] == 3 && nina.bad_commands == 0);
+    printf("scan: ok\n");
+}
+
+static void test_dead(void)
+{
+    open_socket();
+    nina.dead = true;
+    uint64_t start = nina.now_us;
+    assert(esp32_spi_socket_write(0, data, 100) == 0);
+    // one select timeout, no second one waiting for a response to a command never sent
+    uint64_t ms = (nina.now_us - start) / 1000;
+    printf("write to a silent module gave up after %llu ms\n", (unsigned long long)ms);
+    assert(ms >= 1000 && ms < 1500);
+    assert(esp32_spi_socket_available(0) == -1);
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    test_write();
+    test_read();
+    test_udp();
+    test_scan();
+    test_dead();
+    printf("esp32_spi: ok\n");
+    return 0;
+}
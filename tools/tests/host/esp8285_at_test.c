@@ -0,0 +1,310 @@
+// esp8285_at parsers fed with recorded AT transcripts, each replayed with
+// many random chunk splits since the UART hands over whatever it has.
+//
+//   esp8285_at_test transcript...
+//
+// Transcript format, one line each, strings with C escapes (\r \n \\ \" \xHH):
+//   > <command>               command sent, starts a new exchange
+//   < <bytes>                 bytes received, appended to the exchange
+//   wait <tok>|<tok>... = <tok>
+//                             recvString_n: the matcher must stop on <tok>,
+//                             right after its first occurrence
+//   find <target> = <offset>  at_find over the bytes received, -1 if absent
+//   data <id|-> <bytes>       at_ipd: the next payload frame, - in single mode
+//   closed                    at_ipd: "CLOSED" seen between the frames
+//   # comment
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "esp8285_at.h"
+
+#define RX_MAX      8192
+#define FRAMES_MAX  16
+#define SPLITS      200
+
+typedef struct {
+    int mux_id;
+    uint32_t len;
+    uint8_t data[RX_MAX];
+} frame_t;
+
+static uint8_t rx[RX_MAX];
+static uint32_t rx_len;
+static frame_t want[FRAMES_MAX], got[FRAMES_MAX];
+static int want_num;
+static bool want_closed, ipd_pending;
+static const char* file;
+static int line_no, checks;
+
+static void fail(const char* what)
+{
+    fprintf(stderr, "%s:%d: %s\n", file, line_no, what);
+    exit(1);
+}
+
+// C escapes to bytes, returns the length
+static uint32_t unescape(const char* s, uint8_t* out, uint32_t cap)
+{
+    uint32_t n = 0;
+    while (*s && n < cap)
+    {
+        char c = *s++;
+        if (c == '\\')
+        {
+            c = *s++;
+            if (c == 'r')
+                c = '\r';
+            else if (c == 'n')
+                c = '\n';
+            else if (c == 'x')
+            {
+                unsigned int v;
+                if (sscanf(s, "%2x", &v) != 1)
+                    fail("bad \\x escape");
+                c = (char)v;
+                s += 2;
+            }
+            else if (c == '\0')
+                fail("trailing backslash");
+        }
+        out[n++] = (uint8_t)c;
+    }
+    if (*s)
+        fail("line longer than the receive buffer");
+    return n;
+}
+
+// 1 to 64 bytes, the sizes uart_rx_any() returns between polls
+static uint32_t chunk(uint32_t left)
+{
+    uint32_t n = 1 + rand() % 64;
+    return n < left ? n : left;
+}
+
+// the first occurrence that ends first wins, the earlier token on a tie
+static int reference_wait(char tokens[][AT_MATCHER_TOKEN_LEN + 1], int num, uint32_t* end)
+{
+    int best = -1;
+    for (int i = 0; i < num; i++)
+    {
+        uint32_t len = strlen(tokens[i]);
+        for (uint32_t k = 0; k + len <= rx_len; k++)
+        {
+            if (memcmp(rx + k, tokens[i], len) == 0)
+            {
+                if (best < 0 || k + len < *end)
+                {
+                    best = i;
+                    *end = k + len;
+                }
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+static void check_wait(char* spec)
+{
+    char tokens[AT_MATCHER_TOKENS_MAX][AT_MATCHER_TOKEN_LEN + 1];
+    const char* ptrs[AT_MATCHER_TOKENS_MAX];
+    uint8_t buf[AT_MATCHER_TOKEN_LEN + 1];
+    int num = 0, expect = -1;
+    char* eq = strstr(spec, " = ");
+    if (!eq)
+        fail("wait needs ' = <token>'");
+    *eq = '\0';
+    for (char* tok = strtok(spec, "|"); tok; tok = strtok(NULL, "|"))
+    {
+        if (num == AT_MATCHER_TOKENS_MAX)
+            fail("too many tokens");
+        uint32_t len = unescape(tok, buf, AT_MATCHER_TOKEN_LEN);
+        memcpy(tokens[num], buf, len);
+        tokens[num][len] = '\0';
+        ptrs[num] = tokens[num];
+        num++;
+    }
+    uint32_t len = unescape(eq + 3, buf, AT_MATCHER_TOKEN_LEN);
+    buf[len] = '\0';
+    for (int i = 0; i < num; i++)
+        if (strcmp((char*)buf, tokens[i]) == 0)
+            expect = i;
+    if (expect < 0)
+        fail("expected token is not in the list");
+
+    uint32_t ref_end = 0;
+    if (reference_wait(tokens, num, &ref_end) != expect)
+        fail("transcript does not end the wait on the expected token");
+    for (int s = 0; s < SPLITS; s++)
+    {
+        at_matcher_t m;
+        uint32_t pos = 0, used;
+        int found = -1;
+        at_matcher_init(&m, ptrs, num);
+        while (pos < rx_len && found < 0)
+        {
+            uint32_t n = chunk(rx_len - pos);
+            found = at_matcher_feed(&m, rx + pos, n, &used);
+            pos += used;
+        }
+        if (found != expect || pos != ref_end)
+            fail("matcher stopped on another token or at another byte");
+    }
+    checks++;
+}
+
+static void check_find(char* spec)
+{
+    uint8_t target[AT_MATCHER_TOKEN_LEN + 1];
+    char* eq = strstr(spec, " = ");
+    if (!eq)
+        fail("find needs ' = <offset>'");
+    *eq = '\0';
+    uint32_t len = unescape(spec, target, AT_MATCHER_TOKEN_LEN);
+    target[len] = '\0';
+    if (at_find(rx, rx_len, (char*)target) != atoi(eq + 3))
+        fail("at_find returned another offset");
+    checks++;
+}
+
+static void check_ipd(void)
+{
+    for (int s = 0; s < SPLITS; s++)
+    {
+        at_ipd_t p;
+        uint32_t pos = 0, limit = 0;
+        int num = 0;
+        bool new_frame = false;
+        at_ipd_init(&p);
+        while (pos < rx_len)
+        {
+            const uint8_t* payload;
+            uint32_t payload_len;
+            if (pos == limit)
+                limit = pos + chunk(rx_len - pos);
+            // a header may end in one call and its payload start in the next
+            new_frame |= p.state != AT_IPD_DATA;
+            pos += at_ipd_parse(&p, rx + pos, limit - pos, &payload, &payload_len);
+            if (!payload_len)
+                continue;
+            if (new_frame)
+            {
+                if (num == FRAMES_MAX)
+                    fail("more frames than expected");
+                got[num].mux_id = p.mux_id;
+                got[num].len = 0;
+                num++;
+                new_frame = false;
+            }
+            // the payload points into the bytes that were passed in
+            assert(payload >= rx && payload + payload_len <= rx + limit);
+            memcpy(got[num - 1].data + got[num - 1].len, payload, payload_len);
+            got[num - 1].len += payload_len;
+        }
+        if (num != want_num)
+        {
+            for (int i = 0; i < num; i++)
+                fprintf(stderr, "frame %d: id %d len %u\n", i, got[i].mux_id, got[i].len);
+            fail("number of frames differs");
+        }
+        for (int i = 0; i < num; i++)
+        {
+            if (got[i].mux_id != want[i].mux_id || got[i].len != want[i].len ||
+                memcmp(got[i].data, want[i].data, got[i].len))
+            {
+                fprintf(stderr, "frame %d: id %d len %u, expected id %d len %u\n",
+                        i, got[i].mux_id, got[i].len, want[i].mux_id, want[i].len);
+                fail("payload differs");
+            }
+        }
+        if (p.closed != want_closed)
+            fail(want_closed ? "CLOSED was missed" : "CLOSED seen inside a payload");
+    }
+    checks++;
+}
+
+static void exchange_end(void)
+{
+    if (ipd_pending)
+        check_ipd();
+    rx_len = 0;
+    want_num = 0;
+    want_closed = false;
+    ipd_pending = false;
+}
+
+static void replay(const char* path)
+{
+    char line[RX_MAX];
+    FILE* f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+    file = path;
+    line_no = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        if (strncmp(line, "> ", 2) == 0)
+        {
+            exchange_end();
+        }
+        else if (strncmp(line, "< ", 2) == 0)
+        {
+            rx_len += unescape(line + 2, rx + rx_len, RX_MAX - rx_len);
+        }
+        else if (strncmp(line, "wait ", 5) == 0)
+        {
+            check_wait(line + 5);
+        }
+        else if (strncmp(line, "find ", 5) == 0)
+        {
+            check_find(line + 5);
+        }
+        else if (strncmp(line, "data ", 5) == 0)
+        {
+            char* sp = strchr(line + 5, ' ');
+            if (!sp || want_num == FRAMES_MAX)
+                fail("bad data line");
+            want[want_num].mux_id = line[5] == '-' ? -1 : atoi(line + 5);
+            want[want_num].len = unescape(sp + 1, want[want_num].data, RX_MAX);
+            want_num++;
+            ipd_pending = true;
+        }
+        else if (strcmp(line, "closed") == 0)
+        {
+            want_closed = true;
+            ipd_pending = true;
+        }
+        else
+        {
+            fail("unknown line");
+        }
+    }
+    exchange_end();
+    fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s transcript...\n", argv[0]);
+        return 2;
+    }
+    srand(1);
+    for (int i = 1; i < argc; i++)
+    {
+        int before = checks;
+        replay(argv[i]);
+        printf("%s: %d checks, %d splits each\n", argv[i], checks - before, SPLITS);
+    }
+    printf("esp8285_at: ok\n");
+    return 0;
+}
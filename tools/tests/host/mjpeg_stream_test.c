@@ -0,0 +1,141 @@
+// mjpeg_stream over a socketpair loopback: one fast client that is drained
+// every poll and one slow client with a tiny socket buffer
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "mjpeg_stream.h"
+
+#define FRAME_SIZE  15000
+#define FRAMES      50
+
+static int closed;
+
+static int loop_send(void* sock, const uint8_t* buf, uint32_t len)
+{
+    int ret = send((int)(long)sock, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(ret < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    return ret;
+}
+
+static void loop_close(void* sock)
+{
+    close((int)(long)sock);
+    ++closed;
+}
+
+static int drain(int fd, char* buf, int cap)
+{
+    int total = 0, ret;
+    while(total < cap && (ret = recv(fd, buf + total, cap - total, MSG_DONTWAIT)) > 0)
+        total += ret;
+    return total;
+}
+
+// every part must carry a whole frame of one letter, no mixing between slots
+static int check_parts(char* rx, int len)
+{
+    int parts = 0;
+    char* end = rx + len;
+    char* p = rx;
+    while((p = strstr(p, "--" MJPEG_STREAM_BOUNDARY "\r\n")) != NULL)
+    {
+        unsigned int size;
+        char* body = strstr(p, "\r\n\r\n");
+        if(!body || sscanf(strstr(p, "Content-Length: "), "Content-Length: %u", &size) != 1)
+            break;
+        body += 4;
+        if(body + size + 2 > end)
+            break;
+        assert(size == FRAME_SIZE);
+        for(unsigned int i=1; i<size; ++i)
+            assert(body[i] == body[0]);
+        assert(body[size] == '\r' && body[size + 1] == '\n');
+        p = body + size;
+        ++parts;
+    }
+    return parts;
+}
+
+static void test_loopback(void)
+{
+    int fast[2], slow[2], small = 4096;
+    static char rx[1 << 22], sink[1 << 20];
+    int got = 0;
+    mjpeg_stream_t s;
+
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fast) == 0);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, slow) == 0);
+    setsockopt(slow[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    setsockopt(slow[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    assert(mjpeg_stream_init(&s, 3, 20000, loop_send, loop_close) == 0);
+    assert(mjpeg_stream_add_client(&s, (void*)(long)fast[0]) == 0);
+    assert(mjpeg_stream_add_client(&s, (void*)(long)slow[0]) == 1);
+
+    for(int f=0; f<FRAMES; ++f)
+    {
+        uint32_t capacity;
+        uint8_t* slot = mjpeg_stream_acquire(&s, &capacity);
+        // three slots, two clients: the producer always finds a free one
+        assert(slot && capacity == 20000);
+        memset(slot, 'A' + f % 26, FRAME_SIZE);
+        mjpeg_stream_commit(&s, FRAME_SIZE);
+        for(int k=0; k<4; ++k)
+        {
+            mjpeg_stream_poll(&s);
+            got += drain(fast[1], rx + got, sizeof(rx) - got);
+        }
+        if(f % 10 == 0)
+            drain(slow[1], sink, sizeof(sink));
+    }
+    for(int k=0; k<20; ++k)
+    {
+        mjpeg_stream_poll(&s);
+        got += drain(fast[1], rx + got, sizeof(rx) - got);
+    }
+
+    assert(strncmp(rx, "HTTP/1.1 200 OK\r\n", 17) == 0);
+    int parts = check_parts(rx, got);
+    printf("committed %u, producer dropped %u\n", s.frames, s.dropped);
+    printf("fast: frames %u dropped %u parts %d\n", s.clients[0].frames, s.clients[0].dropped, parts);
+    printf("slow: frames %u dropped %u\n", s.clients[1].frames, s.clients[1].dropped);
+    assert(s.frames == FRAMES && s.dropped == 0);
+    assert(parts == (int)s.clients[0].frames && parts >= FRAMES - 1);
+    // the slow client skips stale frames instead of holding the camera back
+    assert(s.clients[1].dropped > 0 && s.clients[1].frames < s.clients[0].frames);
+
+    // a client that hangs up is removed and closed on the next poll
+    close(slow[1]);
+    for(int k=0; k<5; ++k)
+        mjpeg_stream_poll(&s);
+    assert(mjpeg_stream_client_num(&s) == 1 && closed == 1);
+
+    mjpeg_stream_deinit(&s);
+    assert(closed == 2 && mjpeg_stream_client_num(&s) == 0);
+    close(fast[1]);
+}
+
+// the finaliser path must not touch client sockets, they may be freed already
+static void test_release(void)
+{
+    mjpeg_stream_t s;
+    closed = 0;
+    assert(mjpeg_stream_init(&s, 2, 1024, loop_send, loop_close) == 0);
+    assert(mjpeg_stream_add_client(&s, (void*)(long)-1) == 0);
+    mjpeg_stream_release(&s);
+    assert(closed == 0 && mjpeg_stream_client_num(&s) == 0);
+    assert(mjpeg_stream_acquire(&s, NULL) == NULL);
+    mjpeg_stream_deinit(&s);
+    assert(closed == 0);
+}
+
+int main(void)
+{
+    test_loopback();
+    test_release();
+    printf("mjpeg_stream: ok\n");
+    return 0;
+}
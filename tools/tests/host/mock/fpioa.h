@@ -0,0 +1,7 @@
+// fpioa.h of the K210 SDK, the function numbers the drivers compute pins from
+#ifndef _DRIVER_FPIOA_H
+#define _DRIVER_FPIOA_H
+
+#define FUNC_GPIOHS0    24
+
+#endif
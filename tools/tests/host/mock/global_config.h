@@ -0,0 +1,31 @@
+// CONFIG_* read by the SPIFFS port headers and spiffs_mount.c, the values of
+// projects/*/config_defaults.mk. Override with -D to try other geometries.
+#ifndef __GLOBAL_CONFIG_H
+#define __GLOBAL_CONFIG_H
+
+#ifndef CONFIG_SPIFFS_SIZE
+#define CONFIG_SPIFFS_SIZE                  0x300000
+#endif
+#ifndef CONFIG_SPIFFS_START_ADDR
+#define CONFIG_SPIFFS_START_ADDR            0xD00000
+#endif
+#ifndef CONFIG_SPIFFS_EREASE_SIZE
+#define CONFIG_SPIFFS_EREASE_SIZE           0x1000
+#endif
+#ifndef CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE
+#define CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE    0x20000
+#endif
+#ifndef CONFIG_SPIFFS_LOGICAL_PAGE_SIZE
+#define CONFIG_SPIFFS_LOGICAL_PAGE_SIZE     0x1000
+#endif
+#ifndef CONFIG_SPIFFS_CACHE_PAGES
+#define CONFIG_SPIFFS_CACHE_PAGES           4
+#endif
+#ifndef CONFIG_SPIFFS_MAX_FDS
+#define CONFIG_SPIFFS_MAX_FDS               4
+#endif
+#if !defined(CONFIG_SPIFFS_MOUNT_GC_QUICK) && !defined(CONFIG_SPIFFS_MOUNT_GC_FREE)
+#define CONFIG_SPIFFS_MOUNT_GC_NONE         1
+#endif
+
+#endif
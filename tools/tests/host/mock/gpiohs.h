@@ -0,0 +1,23 @@
+// gpiohs.h of the K210 SDK, the pins are modelled by the device mock in use
+#ifndef _DRIVER_GPIOHS_H
+#define _DRIVER_GPIOHS_H
+
+#include <stdint.h>
+
+typedef enum {
+    GPIO_DM_INPUT,
+    GPIO_DM_INPUT_PULL_DOWN,
+    GPIO_DM_INPUT_PULL_UP,
+    GPIO_DM_OUTPUT,
+} gpio_drive_mode_t;
+
+typedef enum {
+    GPIO_PV_LOW,
+    GPIO_PV_HIGH,
+} gpio_pin_value_t;
+
+void gpiohs_set_drive_mode(uint8_t pin, gpio_drive_mode_t mode);
+void gpiohs_set_pin(uint8_t pin, gpio_pin_value_t value);
+gpio_pin_value_t gpiohs_get_pin(uint8_t pin);
+
+#endif
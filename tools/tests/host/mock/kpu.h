@@ -0,0 +1,11 @@
+// kpu.h of the K210 SDK, only the quantization parameters of a layer
+#ifndef _KPU_H
+#define _KPU_H
+
+typedef struct
+{
+    float scale;
+    float bias;
+} kpu_model_quant_param_t;
+
+#endif
@@ -0,0 +1,311 @@
+// ESP32 running the NINA firmware, as esp32_spi.c sees it over SPI: CS and
+// ready pins, a command in one CS session, its response in the next. Defines
+// the gpiohs, sysctl, sleep and spi functions the driver links against, so
+// include it in exactly one file of a test.
+//
+// The firmware side is a model: one TCP socket with a send buffer of
+// tx_space bytes and a receive buffer the test fills, one UDP datagram being
+// built, a scan list. The clock only moves when the driver polls or sleeps.
+#ifndef __NINA_SPI_H
+#define __NINA_SPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpiohs.h"
+#include "sysctl.h"
+#include "sleep.h"
+#include "esp32_spi.h"
+#include "esp32_spi_io.h"
+
+#define NINA_CS         1
+#define NINA_RDY        2
+#define NINA_BUF        (64 * 1024)
+#define NINA_APS_MAX    8
+
+typedef struct {
+    // pins and framing
+    uint8_t cs;                 // level the driver set
+    bool dead;                  // never acknowledges a select
+    uint8_t cmd[NINA_BUF];
+    uint32_t cmd_len;
+    uint8_t resp[NINA_BUF];
+    uint32_t resp_len;
+    uint32_t resp_pos;
+    uint64_t now_us;
+
+    // firmware state
+    uint8_t sock_state;
+    uint32_t tx_space;          // bytes the send buffer still takes
+    uint8_t tx[NINA_BUF];
+    uint32_t tx_len;
+    uint8_t rx[NINA_BUF];
+    uint32_t rx_len;
+    uint32_t rx_pos;
+    uint8_t udp[NINA_BUF];
+    uint32_t udp_len;
+    uint32_t udp_sent;          // length of the last datagram sent
+    struct {
+        const char* ssid;
+        int8_t rssi;
+        uint8_t encr;
+    } aps[NINA_APS_MAX];
+    uint8_t aps_num;
+
+    // what the driver did
+    uint32_t commands[256];
+    uint32_t bad_commands;
+    uint32_t max_packet;
+} nina_t;
+
+static nina_t nina;
+
+static void nina_init(void)
+{
+    memset(&nina, 0, sizeof(nina));
+    nina.cs = 1;
+    nina.tx_space = NINA_BUF;
+}
+
+// commands whose parameter lengths are 16-bit in the request
+static bool nina_len16(uint8_t cmd)
+{
+    return cmd == SEND_DATA_TCP_CMD || cmd == ADD_UDP_DATA_CMD || cmd == GET_DATABUF_TCP_CMD;
+}
+
+static void nina_resp_begin(uint8_t cmd, uint8_t num)
+{
+    nina.resp_len = 0;
+    nina.resp_pos = 0;
+    nina.resp[nina.resp_len++] = START_CMD;
+    nina.resp[nina.resp_len++] = cmd | REPLY_FLAG;
+    nina.resp[nina.resp_len++] = num;
+}
+
+static void nina_resp_param(const void* data, uint32_t len, bool len16)
+{
+    if (len16)
+        nina.resp[nina.resp_len++] = (uint8_t)(len >> 8);
+    nina.resp[nina.resp_len++] = (uint8_t)len;
+    memcpy(nina.resp + nina.resp_len, data, len);
+    nina.resp_len += len;
+}
+
+static void nina_resp_byte(uint8_t cmd, uint8_t value)
+{
+    nina_resp_begin(cmd, 1);
+    nina_resp_param(&value, 1, false);
+    nina.resp[nina.resp_len++] = END_CMD;
+}
+
+static void nina_resp_error(void)
+{
+    nina.resp_len = 0;
+    nina.resp_pos = 0;
+    nina.resp[nina.resp_len++] = ERR_CMD;
+}
+
+// a whole command arrived, check its framing and prepare the response
+static void nina_command(void)
+{
+    uint8_t* p = nina.cmd;
+    const uint8_t* param[8];
+    uint32_t len[8];
+
+    if (nina.cmd_len < 4 || p[0] != START_CMD || (nina.cmd_len & 3))
+        goto bad;
+    uint8_t cmd = p[1], num = p[2];
+    uint32_t pos = 3;
+    if (num > 8)
+        goto bad;
+    for (uint8_t i = 0; i < num; i++)
+    {
+        len[i] = p[pos++];
+        if (nina_len16(cmd))
+            len[i] = (len[i] << 8) | p[pos++];
+        param[i] = p + pos;
+        pos += len[i];
+        if (pos >= nina.cmd_len)
+            goto bad;
+    }
+    if (p[pos] != END_CMD)
+        goto bad;
+    if (nina.cmd_len > nina.max_packet)
+        nina.max_packet = nina.cmd_len;
+    nina.commands[cmd]++;
+
+    switch (cmd)
+    {
+    case SOFT_RESET_CMD:
+        nina.resp_len = 0;
+        return;
+    case GET_SOCKET_CMD:
+        nina_resp_byte(cmd, 0);
+        return;
+    case START_CLIENT_TCP_CMD:
+        nina.sock_state = SOCKET_ESTABLISHED;
+        nina_resp_byte(cmd, 1);
+        return;
+    case STOP_CLIENT_TCP_CMD:
+        nina.sock_state = SOCKET_CLOSED;
+        nina_resp_byte(cmd, 1);
+        return;
+    case GET_CLIENT_STATE_TCP_CMD:
+        nina_resp_byte(cmd, nina.sock_state);
+        return;
+    case SEND_DATA_TCP_CMD:
+    {
+        if (num != 2)
+            goto bad;
+        uint32_t n = len[1] < nina.tx_space ? len[1] : nina.tx_space;
+        uint8_t sent[2] = {(uint8_t)n, (uint8_t)(n >> 8)};
+        memcpy(nina.tx + nina.tx_len, param[1], n);
+        nina.tx_len += n;
+        nina.tx_space -= n;
+        nina_resp_begin(cmd, 1);
+        nina_resp_param(sent, 2, false);
+        nina.resp[nina.resp_len++] = END_CMD;
+        return;
+    }
+    case AVAIL_DATA_TCP_CMD:
+    {
+        uint32_t n = nina.rx_len - nina.rx_pos;
+        uint8_t avail[2] = {(uint8_t)n, (uint8_t)(n >> 8)};
+        nina_resp_begin(cmd, 1);
+        nina_resp_param(avail, 2, false);
+        nina.resp[nina.resp_len++] = END_CMD;
+        return;
+    }
+    case GET_DATABUF_TCP_CMD:
+    {
+        if (num != 2 || len[1] != 2)
+            goto bad;
+        uint32_t want = param[1][0] | param[1][1] << 8;
+        uint32_t n = nina.rx_len - nina.rx_pos;
+        if (n > want)
+            n = want;
+        nina_resp_begin(cmd, 1);
+        nina_resp_param(nina.rx + nina.rx_pos, n, true);
+        nina.resp[nina.resp_len++] = END_CMD;
+        nina.rx_pos += n;
+        return;
+    }
+    case ADD_UDP_DATA_CMD:
+        if (num != 2)
+            goto bad;
+        memcpy(nina.udp + nina.udp_len, param[1], len[1]);
+        nina.udp_len += len[1];
+        nina_resp_byte(cmd, 1);
+        return;
+    case SEND_UDP_DATA_CMD:
+        nina.udp_sent = nina.udp_len;
+        nina_resp_byte(cmd, 1);
+        return;
+    case START_SCAN_NETWORKS:
+        nina_resp_byte(cmd, 1);
+        return;
+    case SCAN_NETWORKS:
+        nina_resp_begin(cmd, nina.aps_num);
+        for (uint8_t i = 0; i < nina.aps_num; i++)
+            nina_resp_param(nina.aps[i].ssid, strlen(nina.aps[i].ssid), false);
+        nina.resp[nina.resp_len++] = END_CMD;
+        return;
+    case GET_IDX_RSSI_CMD:
+    case GET_IDX_ENCT_CMD:
+        if (num != 1 || param[0][0] >= nina.aps_num)
+            goto bad;
+        nina_resp_byte(cmd, cmd == GET_IDX_RSSI_CMD ? (uint8_t)nina.aps[param[0][0]].rssi : nina.aps[param[0][0]].encr);
+        return;
+    default:
+        break;
+    }
+bad:
+    nina.bad_commands++;
+    nina_resp_error();
+}
+
+static void nina_transfer(const uint8_t* send, uint8_t* recv, uint32_t len)
+{
+    // about 20 Mbit/s
+    nina.now_us += 1 + len / 2;
+    if (nina.cs)
+        return;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        // the driver clocks 0xff out while it reads, only a pure write is a command
+        if (send && !recv)
+        {
+            if (nina.cmd_len < NINA_BUF)
+                nina.cmd[nina.cmd_len++] = send[i];
+        }
+        if (recv)
+            recv[i] = nina.resp_pos < nina.resp_len ? nina.resp[nina.resp_pos++] : 0xff;
+    }
+}
+
+void gpiohs_set_drive_mode(uint8_t pin, gpio_drive_mode_t mode)
+{
+}
+
+void gpiohs_set_pin(uint8_t pin, gpio_pin_value_t value)
+{
+    if (pin != NINA_CS || nina.cs == value)
+        return;
+    nina.cs = value;
+    // a session that carried a command ends
+    if (value && nina.cmd_len)
+    {
+        nina_command();
+        nina.cmd_len = 0;
+    }
+}
+
+// low when idle, high once the ESP32 has seen CS go low
+gpio_pin_value_t gpiohs_get_pin(uint8_t pin)
+{
+    if (pin != NINA_RDY)
+        return GPIO_PV_LOW;
+    return (!nina.cs && !nina.dead) ? GPIO_PV_HIGH : GPIO_PV_LOW;
+}
+
+uint64_t sysctl_get_time_us(void)
+{
+    return nina.now_us++;
+}
+
+int msleep(uint64_t msec)
+{
+    nina.now_us += msec * 1000;
+    return 0;
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+    nina.now_us += seconds * 1000000ULL;
+    return 0;
+}
+
+uint8_t hard_spi_rw(uint8_t data)
+{
+    uint8_t r;
+    nina_transfer(&data, &r, 1);
+    return r;
+}
+
+void hard_spi_rw_len(uint8_t* send, uint8_t* recv, uint32_t len)
+{
+    nina_transfer(send, recv, len);
+}
+
+uint8_t soft_spi_rw(uint8_t data)
+{
+    return hard_spi_rw(data);
+}
+
+void soft_spi_rw_len(uint8_t* send, uint8_t* recv, uint32_t len)
+{
+    nina_transfer(send, recv, len);
+}
+
+#endif
@@ -0,0 +1,95 @@
+// NOR flash stand-in for the w25qxx driver: erase sets a sector to 0xFF and
+// programming can only clear bits, like the real part. Every access advances a
+// virtual clock by the time the K210 would spend on it, so results do not
+// depend on the host. Typical W25Q128JV figures, reads at the quad DMA rate.
+#ifndef __NOR_FLASH_H
+#define __NOR_FLASH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NOR_FLASH_SIZE          (16 * 1024 * 1024)
+#define NOR_FLASH_SECTOR        4096
+#define NOR_FLASH_PAGE          256
+#define NOR_FLASH_CMD_US        2       // command, address and CS turnaround
+#define NOR_FLASH_READ_B_US     25      // bytes per microsecond
+#define NOR_FLASH_PROG_US       400     // tPP of one 256 byte page
+#define NOR_FLASH_ERASE_US      45000   // tSE of one 4K sector
+
+typedef struct {
+    uint8_t* mem;
+    uint64_t us;            // virtual time spent in flash
+    uint64_t read_bytes;
+    uint64_t prog_bytes;
+    uint32_t reads;
+    uint32_t progs;
+    uint32_t erases;
+    uint32_t bad_writes;    // programs that tried to turn a 0 into a 1
+} nor_flash_t;
+
+static nor_flash_t nor_flash;
+
+static void nor_flash_init(void)
+{
+    if (!nor_flash.mem)
+        nor_flash.mem = (uint8_t*)malloc(NOR_FLASH_SIZE);
+    memset(nor_flash.mem, 0xFF, NOR_FLASH_SIZE);
+}
+
+static void nor_flash_reset_stats(void)
+{
+    uint8_t* mem = nor_flash.mem;
+    memset(&nor_flash, 0, sizeof(nor_flash));
+    nor_flash.mem = mem;
+}
+
+static int nor_flash_read(uint32_t addr, uint32_t size, uint8_t* dst)
+{
+    if (addr + size > NOR_FLASH_SIZE)
+        return -1;
+    memcpy(dst, nor_flash.mem + addr, size);
+    nor_flash.us += NOR_FLASH_CMD_US + size / NOR_FLASH_READ_B_US;
+    nor_flash.read_bytes += size;
+    nor_flash.reads++;
+    return 0;
+}
+
+// split at page boundaries like the driver, each page is one program cycle
+static int nor_flash_write(uint32_t addr, uint32_t size, const uint8_t* src)
+{
+    if (addr + size > NOR_FLASH_SIZE)
+        return -1;
+    while (size)
+    {
+        uint32_t n = NOR_FLASH_PAGE - addr % NOR_FLASH_PAGE;
+        if (n > size)
+            n = size;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (src[i] & ~nor_flash.mem[addr + i])
+                nor_flash.bad_writes++;
+            nor_flash.mem[addr + i] &= src[i];
+        }
+        nor_flash.us += NOR_FLASH_CMD_US + NOR_FLASH_PROG_US;
+        nor_flash.prog_bytes += n;
+        nor_flash.progs++;
+        addr += n;
+        src += n;
+        size -= n;
+    }
+    return 0;
+}
+
+static int nor_flash_erase(uint32_t addr, uint32_t size)
+{
+    if (addr % NOR_FLASH_SECTOR || size % NOR_FLASH_SECTOR || addr + size > NOR_FLASH_SIZE)
+        return -1;
+    memset(nor_flash.mem + addr, 0xFF, size);
+    nor_flash.us += (uint64_t)(size / NOR_FLASH_SECTOR) * (NOR_FLASH_CMD_US + NOR_FLASH_ERASE_US);
+    nor_flash.erases += size / NOR_FLASH_SECTOR;
+    return 0;
+}
+
+#endif
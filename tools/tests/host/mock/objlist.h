@@ -0,0 +1,41 @@
+// py/objlist.h of MicroPython, enough to build code that returns lists. The
+// lists only count what is appended, tests read results through plain C calls
+#ifndef MICROPY_INCLUDED_PY_OBJLIST_H
+#define MICROPY_INCLUDED_PY_OBJLIST_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef void* mp_obj_t;
+
+typedef struct
+{
+    size_t len;
+} mp_obj_list_t;
+
+#define m_new(type, num) ((type*)calloc((num), sizeof(type)))
+
+static inline void mp_obj_list_init(mp_obj_list_t* o, size_t n)
+{
+    o->len = n;
+}
+
+static inline void mp_obj_list_append(mp_obj_list_t* o, void* item)
+{
+    (void)item;
+    o->len++;
+}
+
+static inline mp_obj_t mp_obj_new_int(intptr_t v)
+{
+    (void)v;
+    return NULL;
+}
+
+static inline mp_obj_t mp_obj_new_float(float v)
+{
+    (void)v;
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,9 @@
+// printf.h of the K210 SDK
+#ifndef _BSP_PRINTF_H
+#define _BSP_PRINTF_H
+
+#include <stdio.h>
+
+#define printk printf
+
+#endif
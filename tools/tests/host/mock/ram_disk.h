@@ -0,0 +1,63 @@
+// RAM disk stand-in for the SD card DMA functions, with a cost model of an
+// SPI card: every command costs a fixed overhead plus a time per sector.
+// The cost is really slept, so a worker task can overlap it with the caller.
+#ifndef __RAM_DISK_H
+#define __RAM_DISK_H
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RAM_DISK_SECTORS    8192 // 4 MB
+#define RAM_DISK_CMD_US     60   // CMD18/CMD25 round trip and start token wait
+#define RAM_DISK_SECTOR_US  20   // one sector on the bus
+
+typedef struct {
+    uint8_t  data[RAM_DISK_SECTORS][512];
+    uint32_t reads;       // backend calls
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t fail_sector; // a transfer touching it fails, 0 for none
+    int      timing;      // sleep the modelled cost
+} ram_disk_t;
+
+static ram_disk_t ram_disk;
+
+static void ram_disk_init(int timing)
+{
+    memset(&ram_disk, 0, sizeof(ram_disk));
+    for (uint32_t s = 0; s < RAM_DISK_SECTORS; s++)
+        for (int i = 0; i < 512; i += 4)
+            memcpy(&ram_disk.data[s][i], &(uint32_t){s * 131u + i}, 4);
+    ram_disk.timing = timing;
+}
+
+static uint8_t ram_disk_io(uint8_t *buff, uint32_t sector, uint32_t count, int write)
+{
+    if (sector + count > RAM_DISK_SECTORS)
+        return 0xFF;
+    if (ram_disk.fail_sector && ram_disk.fail_sector >= sector && ram_disk.fail_sector < sector + count)
+        return 0xFF;
+    if (ram_disk.timing)
+        usleep(RAM_DISK_CMD_US + RAM_DISK_SECTOR_US * count);
+    if (write)
+        memcpy(ram_disk.data[sector], buff, count * 512);
+    else
+        memcpy(buff, ram_disk.data[sector], count * 512);
+    return 0;
+}
+
+static uint8_t ram_disk_read(uint8_t *buff, uint32_t sector, uint32_t count)
+{
+    ram_disk.reads++;
+    ram_disk.sectors_read += count;
+    return ram_disk_io(buff, sector, count, 0);
+}
+
+static uint8_t ram_disk_write(uint8_t *buff, uint32_t sector, uint32_t count)
+{
+    ram_disk.writes++;
+    return ram_disk_io(buff, sector, count, 1);
+}
+
+#endif
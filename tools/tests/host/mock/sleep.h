@@ -0,0 +1,10 @@
+// sleep.h of the K210 SDK, usleep is left to unistd.h
+#ifndef _BSP_SLEEP_H
+#define _BSP_SLEEP_H
+
+#include <stdint.h>
+
+int msleep(uint64_t msec);
+unsigned int sleep(unsigned int seconds);
+
+#endif
@@ -0,0 +1,9 @@
+// sysctl.h of the K210 SDK, only the clock the drivers poll
+#ifndef _DRIVER_SYSCTL_H
+#define _DRIVER_SYSCTL_H
+
+#include <stdint.h>
+
+uint64_t sysctl_get_time_us(void);
+
+#endif
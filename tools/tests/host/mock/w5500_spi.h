@@ -0,0 +1,273 @@
+// W5500 register model behind the wiz_spi.c bus: frames of a 3 byte header
+// (address, block select, read/write) and variable length data under one CS,
+// the common and socket registers, and the socket TX/RX buffers with their
+// pointer arithmetic. Defines the wiz_spi_bus_* functions, so include it in
+// exactly one file of a test.
+//
+// Only what the socket data path needs is modelled: SEND takes everything
+// between TX_RD and TX_WR, the test puts received bytes in with w5500_rx_push,
+// RECV leaves the buffer to RX_RD. Each frame and each bus call is counted.
+#ifndef __W5500_SPI_H
+#define __W5500_SPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "wiz_spi.h"
+
+#define W5500_SOCKETS   8
+#define W5500_BUF_MAX   (16 * 1024)
+
+// register offsets, the same as w5500.h without the block bits
+#define W5500_MR        0x00
+#define W5500_VERSIONR  0x39
+#define W5500_Sn_CR     0x01
+#define W5500_Sn_RXBUF_SIZE 0x1e
+#define W5500_Sn_TXBUF_SIZE 0x1f
+#define W5500_Sn_TX_FSR 0x20
+#define W5500_Sn_TX_RD  0x22
+#define W5500_Sn_TX_WR  0x24
+#define W5500_Sn_RX_RSR 0x26
+#define W5500_Sn_RX_RD  0x28
+#define W5500_Sn_RX_WR  0x2a
+
+typedef struct {
+    uint8_t common[0x40];
+    uint8_t sreg[W5500_SOCKETS][0x30];
+    uint8_t tx[W5500_SOCKETS][W5500_BUF_MAX];
+    uint8_t rx[W5500_SOCKETS][W5500_BUF_MAX];
+    uint8_t sent[W5500_SOCKETS][W5500_BUF_MAX];     // what SEND took, in order
+    uint32_t sent_len[W5500_SOCKETS];
+
+    // the frame on the wire
+    uint8_t cs;
+    uint8_t hdr[3];
+    uint32_t pos;               // bytes of this frame so far
+    uint16_t addr;              // data address, counts up
+    uint32_t frame_calls;       // bus calls that carried this frame
+
+    // bus options
+    bool dma;
+    uint32_t drip;              // bytes that arrive on socket 0 after each RX_RSR read
+
+    // what the driver did
+    uint32_t frames;
+    uint32_t calls;             // FIFO and DMA transfers
+    uint32_t dma_calls;
+    uint32_t split_frames;      // frames that took more than one bus call
+    uint32_t bad_frames;        // CS raised inside the header
+    uint32_t max_frame_calls;
+} w5500_t;
+
+static w5500_t w5500;
+
+static uint16_t w5500_get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void w5500_set16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint32_t w5500_size(int sn, uint8_t reg)
+{
+    return w5500.sreg[sn][reg] * 1024u;
+}
+
+static void w5500_init(void)
+{
+    memset(&w5500, 0, sizeof(w5500));
+    w5500.cs = 1;
+    w5500.common[W5500_VERSIONR] = 0x04;
+    for (int sn = 0; sn < W5500_SOCKETS; sn++)
+    {
+        w5500.sreg[sn][W5500_Sn_RXBUF_SIZE] = 2;
+        w5500.sreg[sn][W5500_Sn_TXBUF_SIZE] = 2;
+    }
+}
+
+// the network side puts len bytes in the RX buffer of a socket
+static void w5500_rx_push(int sn, const uint8_t* data, uint32_t len)
+{
+    uint8_t* r = w5500.sreg[sn];
+    uint16_t wr = w5500_get16(r + W5500_Sn_RX_WR);
+    uint32_t size = w5500_size(sn, W5500_Sn_RXBUF_SIZE);
+    for (uint32_t i = 0; i < len; i++, wr++)
+        w5500.rx[sn][wr % size] = data[i];
+    w5500_set16(r + W5500_Sn_RX_WR, wr);
+}
+
+// the registers the chip computes on read
+static void w5500_update(int sn)
+{
+    uint8_t* r = w5500.sreg[sn];
+    uint16_t used = w5500_get16(r + W5500_Sn_TX_WR) - w5500_get16(r + W5500_Sn_TX_RD);
+    w5500_set16(r + W5500_Sn_TX_FSR, (uint16_t)(w5500_size(sn, W5500_Sn_TXBUF_SIZE) - used));
+    w5500_set16(r + W5500_Sn_RX_RSR, w5500_get16(r + W5500_Sn_RX_WR) - w5500_get16(r + W5500_Sn_RX_RD));
+}
+
+static void w5500_command(int sn, uint8_t cmd)
+{
+    uint8_t* r = w5500.sreg[sn];
+    if (cmd == 0x20)    // SEND
+    {
+        uint16_t rd = w5500_get16(r + W5500_Sn_TX_RD), wr = w5500_get16(r + W5500_Sn_TX_WR);
+        uint32_t size = w5500_size(sn, W5500_Sn_TXBUF_SIZE);
+        for (; rd != wr; rd++)
+        {
+            assert(w5500.sent_len[sn] < W5500_BUF_MAX);
+            w5500.sent[sn][w5500.sent_len[sn]++] = w5500.tx[sn][rd % size];
+        }
+        w5500_set16(r + W5500_Sn_TX_RD, rd);
+    }
+    r[W5500_Sn_CR] = 0;     // done at once
+}
+
+// one data byte of the current frame, the value read back
+static uint8_t w5500_data(uint8_t out)
+{
+    uint8_t ctl = w5500.hdr[2];
+    uint8_t bsb = ctl >> 3, sn = bsb >> 2;
+    bool write = ctl & 0x04;
+    uint16_t addr = w5500.addr++;
+    uint8_t* cell;
+
+    assert((ctl & 0x03) == 0);  // variable length data mode only
+    if (bsb == 0)
+    {
+        cell = addr < sizeof(w5500.common) ? &w5500.common[addr] : NULL;
+    }
+    else if ((bsb & 3) == 1)
+    {
+        w5500_update(sn);
+        cell = addr < sizeof(w5500.sreg[0]) ? &w5500.sreg[sn][addr] : NULL;
+        if (write && addr == W5500_Sn_CR)
+        {
+            w5500_command(sn, out);
+            return 0;
+        }
+        // the read only registers
+        if (write && ((addr >= W5500_Sn_TX_FSR && addr < W5500_Sn_TX_WR) ||
+                      (addr >= W5500_Sn_RX_RSR && addr < W5500_Sn_RX_RD) ||
+                      (addr >= W5500_Sn_RX_WR && addr < W5500_Sn_RX_WR + 2)))
+            cell = NULL;
+    }
+    else if ((bsb & 3) == 2)
+    {
+        cell = &w5500.tx[sn][addr % w5500_size(sn, W5500_Sn_TXBUF_SIZE)];
+    }
+    else
+    {
+        cell = &w5500.rx[sn][addr % w5500_size(sn, W5500_Sn_RXBUF_SIZE)];
+    }
+    if (!cell)
+        return 0;
+    if (write)
+    {
+        *cell = out;
+        // MR.RST clears itself
+        if (bsb == 0 && addr == W5500_MR)
+            *cell &= 0x7f;
+        return 0;
+    }
+    return *cell;
+}
+
+static void w5500_byte(uint8_t out, uint8_t* in)
+{
+    uint8_t ret = 0;
+    if (w5500.pos < 3)
+    {
+        w5500.hdr[w5500.pos] = out;
+        if (w5500.pos == 1)
+            w5500.addr = w5500_get16(w5500.hdr);
+    }
+    else
+    {
+        ret = w5500_data(out);
+    }
+    w5500.pos++;
+    if (in)
+        *in = ret;
+}
+
+static void w5500_call(void)
+{
+    assert(!w5500.cs);
+    w5500.calls++;
+    w5500.frame_calls++;
+}
+
+void wiz_spi_bus_cs(uint8_t level)
+{
+    if (level == w5500.cs)
+        return;
+    w5500.cs = level;
+    if (!level)
+    {
+        w5500.pos = 0;
+        w5500.frame_calls = 0;
+        return;
+    }
+    if (w5500.pos < 3)
+    {
+        w5500.bad_frames++;
+        return;
+    }
+    w5500.frames++;
+    if (w5500.frame_calls > 1)
+        w5500.split_frames++;
+    if (w5500.frame_calls > w5500.max_frame_calls)
+        w5500.max_frame_calls = w5500.frame_calls;
+    // data arriving while the driver polls RX_RSR
+    if (w5500.drip && w5500.hdr[2] == (1 << 3) && w5500_get16(w5500.hdr) == W5500_Sn_RX_RSR)
+    {
+        uint8_t b[1] = {(uint8_t)w5500.drip};
+        w5500_rx_push(0, b, 1);
+        w5500.drip--;
+    }
+}
+
+void wiz_spi_bus_transfer(const uint8_t* src, uint8_t* dest, size_t len)
+{
+    w5500_call();
+    for (size_t i = 0; i < len; i++)
+        w5500_byte(src ? src[i] : 0xff, dest ? dest + i : NULL);
+}
+
+bool wiz_spi_bus_has_dma(void)
+{
+    return w5500.dma;
+}
+
+// the SPI takes the low byte of each word in 8 bit frames
+void wiz_spi_bus_dma_send(const uint32_t* buf, size_t len)
+{
+    assert(w5500.dma);
+    w5500_call();
+    w5500.dma_calls++;
+    for (size_t i = 0; i < len; i++)
+        w5500_byte((uint8_t)buf[i], NULL);
+}
+
+void wiz_spi_bus_dma_recv(const uint32_t* cmd, size_t cmd_len, uint32_t* rx, size_t rx_len)
+{
+    assert(w5500.dma);
+    w5500_call();
+    w5500.dma_calls++;
+    for (size_t i = 0; i < cmd_len; i++)
+        w5500_byte((uint8_t)cmd[i], NULL);
+    for (size_t i = 0; i < rx_len; i++)
+    {
+        uint8_t b;
+        w5500_byte(0xff, &b);
+        rx[i] = b;
+    }
+}
+
+#endif
@@ -0,0 +1,260 @@
+// sdcard_blk on a RAM disk: coherence against a reference copy, the request
+// queue, and a benchmark of the access patterns FatFs produces for a media file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include "sdcard_blk.h"
+#include "ram_disk.h"
+
+/* worker task stand-in, like sd_blk_worker/sd_blk_kick in sdcard.c */
+static sd_blk_t blk;
+static pthread_mutex_t blk_mutex;
+static pthread_mutex_t kick_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kick_cond = PTHREAD_COND_INITIALIZER;
+static int kicks, worker_quit;
+static pthread_t worker;
+
+static void host_lock(void *arg)
+{
+    pthread_mutex_lock(&blk_mutex);
+}
+
+static void host_unlock(void *arg)
+{
+    pthread_mutex_unlock(&blk_mutex);
+}
+
+static void host_kick(void *arg)
+{
+    pthread_mutex_lock(&kick_mutex);
+    kicks++;
+    pthread_cond_signal(&kick_cond);
+    pthread_mutex_unlock(&kick_mutex);
+}
+
+static void *host_worker(void *arg)
+{
+    pthread_mutex_lock(&kick_mutex);
+    while (!worker_quit)
+    {
+        if (!kicks)
+        {
+            pthread_cond_wait(&kick_cond, &kick_mutex);
+            continue;
+        }
+        kicks = 0;
+        pthread_mutex_unlock(&kick_mutex);
+        sd_blk_process(&blk);
+        pthread_mutex_lock(&kick_mutex);
+    }
+    pthread_mutex_unlock(&kick_mutex);
+    return NULL;
+}
+
+static void blk_open(int threaded)
+{
+    sd_blk_hooks_t hooks = {0};
+    if (threaded)
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutex_init(&blk_mutex, &attr);
+        hooks.lock = host_lock;
+        hooks.unlock = host_unlock;
+        hooks.kick = host_kick;
+        worker_quit = 0;
+        assert(pthread_create(&worker, NULL, host_worker, NULL) == 0);
+    }
+    assert(sd_blk_init(&blk, ram_disk_read, ram_disk_write, &hooks) == 0);
+    blk.sectors = RAM_DISK_SECTORS;
+}
+
+static void blk_close(void)
+{
+    if (blk.hooks.kick)
+    {
+        while (sd_blk_pending(&blk) || blk.prefetch.state == SD_BLK_REQ_QUEUED)
+            usleep(100);
+        pthread_mutex_lock(&kick_mutex);
+        worker_quit = 1;
+        pthread_cond_signal(&kick_cond);
+        pthread_mutex_unlock(&kick_mutex);
+        pthread_join(worker, NULL);
+        pthread_mutex_destroy(&blk_mutex);
+    }
+    sd_blk_deinit(&blk);
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// random reads and writes of random lengths, checked against a plain copy of the disk
+static void test_coherence(int threaded)
+{
+    static uint8_t ref[RAM_DISK_SECTORS][512];
+    static uint8_t buf[32 * 512];
+    ram_disk_init(0);
+    memcpy(ref, ram_disk.data, sizeof(ref));
+    blk_open(threaded);
+    srand(1);
+    for (int i = 0; i < 20000; i++)
+    {
+        uint32_t count = 1 + rand() % ((rand() % 4) ? 3 : 32);
+        uint32_t sector = (rand() % 3) ? blk.next_sector : rand() % 2048;
+        if (sector + count > RAM_DISK_SECTORS)
+            sector = 0;
+        if (rand() % 5 == 0)
+        {
+            for (uint32_t k = 0; k < count * 512; k++)
+                buf[k] = rand();
+            assert(sd_blk_write(&blk, buf, sector, count) == 0);
+            memcpy(ref[sector], buf, count * 512);
+        }
+        else
+        {
+            assert(sd_blk_read(&blk, buf, sector, count) == 0);
+            assert(memcmp(buf, ref[sector], count * 512) == 0);
+        }
+    }
+    blk_close();
+    assert(memcmp(ram_disk.data, ref, sizeof(ref)) == 0);
+
+    // a failing card must not leave half filled lines behind
+    ram_disk_init(0);
+    blk_open(0);
+    ram_disk.fail_sector = 100;
+    assert(sd_blk_read(&blk, buf, 96, 2) == 0);
+    assert(sd_blk_read(&blk, buf, 100, 1) != 0);
+    ram_disk.fail_sector = 0;
+    assert(sd_blk_read(&blk, buf, 100, 1) == 0 && memcmp(buf, ram_disk.data[100], 512) == 0);
+    blk_close();
+    printf("coherence (%s): ok\n", threaded ? "worker" : "inline");
+}
+
+static void req_done(sd_blk_req_t *req, void *arg)
+{
+    ++*(int *)arg;
+}
+
+static void test_queue(void)
+{
+    static uint8_t buf[SD_BLK_QUEUE_LEN][4 * 512];
+    sd_blk_req_t reqs[SD_BLK_QUEUE_LEN];
+    int done = 0;
+    ram_disk_init(1);
+    blk_open(1);
+    for (int i = 0; i < SD_BLK_QUEUE_LEN - 1; i++)
+    {
+        reqs[i] = (sd_blk_req_t){.op = SD_BLK_REQ_READ, .buff = buf[i], .sector = 1000 + 64 * i,
+                                 .count = 4, .done = req_done, .arg = &done};
+        assert(sd_blk_submit(&blk, &reqs[i]) == 0);
+    }
+    while (done < SD_BLK_QUEUE_LEN - 1)
+        usleep(100);
+    for (int i = 0; i < SD_BLK_QUEUE_LEN - 1; i++)
+    {
+        assert(reqs[i].state == SD_BLK_REQ_DONE && reqs[i].result == 0);
+        assert(memcmp(buf[i], ram_disk.data[1000 + 64 * i], 4 * 512) == 0);
+    }
+    blk_close();
+    printf("queue: ok\n");
+}
+
+typedef enum
+{
+    BENCH_RAW = 0,
+    BENCH_INLINE,
+    BENCH_WORKER,
+} bench_mode_t;
+
+static const char *bench_names[] = {"raw dma", "cache", "cache+worker"};
+
+static uint8_t bench_read(bench_mode_t mode, uint8_t *buff, uint32_t sector, uint32_t count)
+{
+    if (mode == BENCH_RAW)
+        return ram_disk_read(buff, sector, count);
+    return sd_blk_read(&blk, buff, sector, count);
+}
+
+/*
+ * one file of 1024 sectors read in chunks of `chunk` sectors with `decode_us`
+ * of work on each chunk, a FAT sector is looked up every cluster (8 sectors)
+ */
+static double bench(bench_mode_t mode, uint32_t chunk, int decode_us, uint32_t *calls, sd_blk_stats_t *stats)
+{
+    static uint8_t buf[64 * 512], fat[512];
+    const uint32_t file = 4096, fat_start = 32, length = 1024;
+    ram_disk_init(1);
+    if (mode != BENCH_RAW)
+        blk_open(mode == BENCH_WORKER);
+    double start = now_ms();
+    for (uint32_t off = 0; off < length; off += chunk)
+    {
+        if (off % 8 == 0)
+            assert(bench_read(mode, fat, fat_start + off / 8 / 128, 1) == 0);
+        assert(bench_read(mode, buf, file + off, chunk) == 0);
+        assert(memcmp(buf, ram_disk.data[file + off], chunk * 512) == 0);
+        // on the board the DMA runs while the CPU decodes, here both may share one host core
+        if (decode_us)
+            usleep(decode_us);
+    }
+    double ms = now_ms() - start;
+    if (mode != BENCH_RAW)
+        blk_close();
+    *stats = blk.stats;
+    *calls = ram_disk.reads;
+    return ms;
+}
+
+static void test_bench(void)
+{
+    static const struct
+    {
+        const char *name;
+        uint32_t chunk;
+        int decode_us;
+    } cases[] = {
+        {"1 sector, no decode ", 1, 0},
+        {"1 sector, 100us/blk", 1, 100},
+        {"8 sectors, 800us   ", 8, 800},
+    };
+    double ms[3];
+    sd_blk_stats_t stats[3];
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        printf("%s:", cases[c].name);
+        for (int m = BENCH_RAW; m <= BENCH_WORKER; m++)
+        {
+            uint32_t calls;
+            ms[m] = bench(m, cases[c].chunk, cases[c].decode_us, &calls, &stats[m]);
+            printf("  %s %.1f ms / %u calls", bench_names[m], ms[m], calls);
+        }
+        printf("\n");
+        // the times depend on the host, so check the work that was saved instead:
+        // the cache saves commands, the worker has the next window ready before it is asked for
+        if (cases[c].chunk == 1)
+            assert(stats[BENCH_INLINE].io_read * 4 < 1152);
+        if (cases[c].decode_us)
+            assert(stats[BENCH_WORKER].prefetch > 0 &&
+                   stats[BENCH_WORKER].misses + stats[BENCH_WORKER].direct <
+                       (stats[BENCH_INLINE].misses + stats[BENCH_INLINE].direct) / 2);
+    }
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    test_coherence(0);
+    test_coherence(1);
+    test_queue();
+    test_bench();
+    printf("sdcard_blk: ok\n");
+    return 0;
+}
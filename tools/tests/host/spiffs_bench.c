@@ -0,0 +1,487 @@
+// SPIFFS benchmark on the NOR flash stand-in: replays operation traces against
+// the SPIFFS core with the /flash geometry, once for each mount setting, and
+// reports the flash time every kind of operation costs. Mounts go through
+// spiffs_mount.c like the firmware, so the settings are those os.flash_remount() takes.
+//
+//   spiffs_bench [-c cache_pages,...] [-g none|quick|free:<bytes>,...] [-f fds] trace...
+//
+// Trace format, one operation per line, # starts a comment:
+//   phase <name>              print the stats gathered so far and start a new phase
+//   remount                   close every fd, unmount and mount again with the setting
+//   open <fd> <path> <mode>   mode: r, w, a, rw, followed by c (create) and t (truncate)
+//   read <fd> <bytes>         read in one call
+//   write <fd> <bytes>        write a pattern in one call
+//   seek <fd> <offset>
+//   close <fd>
+//   remove <path>
+//   stat <path>
+//   repeat <n> ... end        run the lines in between n times, may nest
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "spiffs.h"
+#include "spiffs_nucleus.h"
+#include "spiffs_mount.h"
+#include "nor_flash.h"
+
+#define TRACE_MAX_LINES 1024
+#define TRACE_MAX_FDS   16
+#define IO_MAX          (256 * 1024)
+
+typedef enum {
+    OP_MOUNT = 0,
+    OP_OPEN,
+    OP_READ,
+    OP_WRITE,
+    OP_SEEK,
+    OP_CLOSE,
+    OP_REMOVE,
+    OP_STAT,
+    OP_NUM,
+} op_t;
+
+static const char* op_names[OP_NUM] = {"mount", "open", "read", "write", "seek", "close", "remove", "stat"};
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint64_t us;
+    uint64_t max_us;
+} op_stat_t;
+
+typedef struct {
+    char* lines[TRACE_MAX_LINES];
+    int num;
+    const char* name;
+} trace_t;
+
+static spiffs fs;
+static spiffs_config cfg;
+static spiffs_mount_opt_t opt;
+static u8_t* work_buf;
+static u8_t* fds_buf;
+static u8_t* cache_buf;
+static spiffs_file fds[TRACE_MAX_FDS];
+static op_stat_t stats[OP_NUM];
+static uint8_t io_buf[IO_MAX];
+static uint64_t phase_start_us;
+static nor_flash_t phase_start;
+
+static s32_t bench_read(spiffs* f, u32_t addr, u32_t size, u8_t* dst)
+{
+    return nor_flash_read(addr, size, dst) ? SPIFFS_ERR_INTERNAL : SPIFFS_OK;
+}
+
+static s32_t bench_write(spiffs* f, u32_t addr, u32_t size, u8_t* src)
+{
+    return nor_flash_write(addr, size, src) ? SPIFFS_ERR_INTERNAL : SPIFFS_OK;
+}
+
+static s32_t bench_erase(spiffs* f, u32_t addr, u32_t size)
+{
+    return nor_flash_erase(addr, size) ? SPIFFS_ERR_INTERNAL : SPIFFS_OK;
+}
+
+// same buffers spiffs_vfs_mount_fs() allocates for opt, then the chosen GC
+static s32_t bench_mount(void)
+{
+    u32_t fds_size = spiffs_mount_fds_size(&opt);
+    u32_t cache_size = spiffs_mount_cache_size(&cfg, &opt);
+    free(work_buf);
+    free(fds_buf);
+    free(cache_buf);
+    work_buf = malloc(cfg.log_page_size * 2);
+    fds_buf = malloc(fds_size);
+    cache_buf = cache_size ? malloc(cache_size) : NULL;
+    s32_t res = SPIFFS_mount(&fs, &cfg, work_buf, fds_buf, fds_size, cache_buf, cache_size, 0);
+    if (res == SPIFFS_OK)
+        res = spiffs_mount_gc(&fs, &cfg, &opt);
+    return res;
+}
+
+static void bench_format(void)
+{
+    memset(&fs, 0, sizeof(fs));
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.hal_read_f = bench_read;
+    cfg.hal_write_f = bench_write;
+    cfg.hal_erase_f = bench_erase;
+    cfg.phys_size = CONFIG_SPIFFS_SIZE;
+    cfg.phys_addr = CONFIG_SPIFFS_START_ADDR;
+    cfg.phys_erase_block = CONFIG_SPIFFS_EREASE_SIZE;
+    cfg.log_block_size = CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE;
+    cfg.log_page_size = CONFIG_SPIFFS_LOGICAL_PAGE_SIZE;
+    nor_flash_init();
+    // the first mount only configures fs, as in init_flash_spiffs()
+    bench_mount();
+    SPIFFS_unmount(&fs);
+    s32_t res = SPIFFS_format(&fs);
+    assert(res == SPIFFS_OK);
+    res = bench_mount();
+    assert(res == SPIFFS_OK);
+}
+
+static void phase_begin(void)
+{
+    memset(stats, 0, sizeof(stats));
+    phase_start = nor_flash;
+    phase_start_us = nor_flash.us;
+#if SPIFFS_CACHE_STATS
+    fs.cache_hits = 0;
+    fs.cache_misses = 0;
+#endif
+}
+
+static void phase_end(const trace_t* t, const char* phase, const char* setting)
+{
+    uint64_t total = nor_flash.us - phase_start_us;
+    if (!phase[0] || (!total && !stats[OP_OPEN].count))
+        return;
+    printf("%-12s %-10s %-22s %9.1f ms |", t->name, phase, setting, total / 1000.0);
+    for (int i = 0; i < OP_NUM; i++)
+    {
+        if (!stats[i].count)
+            continue;
+        printf(" %s %ux%.2f/%.2f", op_names[i], stats[i].count,
+               stats[i].us / 1000.0 / stats[i].count, stats[i].max_us / 1000.0);
+        if (stats[i].errors)
+            printf("(%u err)", stats[i].errors);
+    }
+    printf(" | flash r %lluK w %lluK e %u",
+           (unsigned long long)(nor_flash.read_bytes - phase_start.read_bytes) / 1024,
+           (unsigned long long)(nor_flash.prog_bytes - phase_start.prog_bytes) / 1024,
+           nor_flash.erases - phase_start.erases);
+#if SPIFFS_CACHE_STATS
+    if (fs.cache_hits + fs.cache_misses)
+        printf(" cache %u%%", fs.cache_hits * 100 / (fs.cache_hits + fs.cache_misses));
+#endif
+    printf("\n");
+    if (nor_flash.bad_writes)
+    {
+        printf("  %u programs tried to set bits without an erase\n", nor_flash.bad_writes);
+        exit(1);
+    }
+}
+
+static spiffs_flags parse_mode(const char* mode)
+{
+    spiffs_flags flags = 0;
+    if (strncmp(mode, "rw", 2) == 0)
+    {
+        flags |= SPIFFS_O_RDWR;
+        mode += 2;
+    }
+    else if (*mode == 'r')
+    {
+        flags |= SPIFFS_O_RDONLY;
+        mode++;
+    }
+    else if (*mode == 'w')
+    {
+        flags |= SPIFFS_O_WRONLY;
+        mode++;
+    }
+    else if (*mode == 'a')
+    {
+        flags |= SPIFFS_O_WRONLY | SPIFFS_O_APPEND;
+        mode++;
+    }
+    for (; *mode; mode++)
+    {
+        if (*mode == 'c')
+            flags |= SPIFFS_O_CREAT;
+        else if (*mode == 't')
+            flags |= SPIFFS_O_TRUNC;
+    }
+    return flags;
+}
+
+static int fd_index(const char* arg)
+{
+    int i = atoi(arg);
+    if (i < 0 || i >= TRACE_MAX_FDS)
+    {
+        fprintf(stderr, "fd %d out of range\n", i);
+        exit(2);
+    }
+    return i;
+}
+
+static void close_all(void)
+{
+    for (int i = 0; i < TRACE_MAX_FDS; i++)
+    {
+        if (fds[i] > 0)
+            SPIFFS_close(&fs, fds[i]);
+        fds[i] = 0;
+    }
+}
+
+static void run_op(char* line)
+{
+    char cmd[16], a[128], b[128];
+    int n = sscanf(line, "%15s %127s %127s", cmd, a, b);
+    if (n < 1)
+        return;
+    op_t op;
+    s32_t res = SPIFFS_OK;
+    uint64_t start = nor_flash.us;
+    if (strcmp(cmd, "remount") == 0)
+    {
+        op = OP_MOUNT;
+        close_all();
+        SPIFFS_unmount(&fs);
+        start = nor_flash.us;
+        res = bench_mount();
+    }
+    else if (strcmp(cmd, "open") == 0)
+    {
+        char path[128], mode[16];
+        op = OP_OPEN;
+        if (sscanf(line, "%*s %*s %127s %15s", path, mode) != 2)
+            goto syntax;
+        int i = fd_index(a);
+        fds[i] = SPIFFS_open(&fs, path, parse_mode(mode), 0);
+        res = fds[i] < 0 ? fds[i] : SPIFFS_OK;
+    }
+    else if (strcmp(cmd, "read") == 0 || strcmp(cmd, "write") == 0)
+    {
+        if (n != 3 || atoi(b) < 0 || atoi(b) > IO_MAX)
+            goto syntax;
+        int i = fd_index(a);
+        int len = atoi(b);
+        if (cmd[0] == 'r')
+        {
+            op = OP_READ;
+            res = SPIFFS_read(&fs, fds[i], io_buf, len);
+        }
+        else
+        {
+            op = OP_WRITE;
+            for (int k = 0; k < len; k++)
+                io_buf[k] = (uint8_t)(k * 7 + i);
+            res = SPIFFS_write(&fs, fds[i], io_buf, len);
+        }
+        // reading past the end of a file is not an error here
+        if (res >= 0 || res == SPIFFS_ERR_END_OF_OBJECT)
+            res = SPIFFS_OK;
+    }
+    else if (strcmp(cmd, "seek") == 0)
+    {
+        op = OP_SEEK;
+        if (n != 3)
+            goto syntax;
+        res = SPIFFS_lseek(&fs, fds[fd_index(a)], atoi(b), SPIFFS_SEEK_SET);
+        if (res >= 0)
+            res = SPIFFS_OK;
+    }
+    else if (strcmp(cmd, "close") == 0)
+    {
+        op = OP_CLOSE;
+        int i = fd_index(a);
+        res = SPIFFS_close(&fs, fds[i]);
+        fds[i] = 0;
+    }
+    else if (strcmp(cmd, "remove") == 0)
+    {
+        op = OP_REMOVE;
+        res = SPIFFS_remove(&fs, a);
+    }
+    else if (strcmp(cmd, "stat") == 0)
+    {
+        spiffs_stat st;
+        op = OP_STAT;
+        res = SPIFFS_stat(&fs, a, &st);
+        // a miss is a normal answer for an import that looks in several places
+        if (res == SPIFFS_ERR_NOT_FOUND)
+            res = SPIFFS_OK;
+    }
+    else
+    {
+        goto syntax;
+    }
+    uint64_t us = nor_flash.us - start;
+    stats[op].count++;
+    stats[op].us += us;
+    if (us > stats[op].max_us)
+        stats[op].max_us = us;
+    if (res != SPIFFS_OK)
+    {
+        if (!stats[op].errors)
+            fprintf(stderr, "  '%s' failed %d\n", line, res);
+        stats[op].errors++;
+    }
+    return;
+syntax:
+    fprintf(stderr, "bad trace line '%s'\n", line);
+    exit(2);
+}
+
+// runs lines [from, to), returns the index after the matching end when called for a repeat
+static int run_lines(const trace_t* t, int from, int to, char* phase, const char* setting)
+{
+    int i = from;
+    while (i < to)
+    {
+        char* line = t->lines[i];
+        int count;
+        if (sscanf(line, "repeat %d", &count) == 1)
+        {
+            int depth = 1, end = i + 1;
+            for (; end < to && depth; end++)
+            {
+                if (strncmp(t->lines[end], "repeat", 6) == 0)
+                    depth++;
+                else if (strcmp(t->lines[end], "end") == 0)
+                    depth--;
+            }
+            if (depth)
+            {
+                fprintf(stderr, "%s: repeat without end\n", t->name);
+                exit(2);
+            }
+            for (int k = 0; k < count; k++)
+                run_lines(t, i + 1, end - 1, phase, setting);
+            i = end;
+            continue;
+        }
+        if (strncmp(line, "phase ", 6) == 0)
+        {
+            phase_end(t, phase, setting);
+            snprintf(phase, 32, "%s", line + 6);
+            phase_begin();
+        }
+        else
+        {
+            run_op(line);
+        }
+        i++;
+    }
+    return i;
+}
+
+static void trace_load(trace_t* t, const char* path)
+{
+    static char buf[256];
+    FILE* f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        exit(2);
+    }
+    t->num = 0;
+    t->name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    while (fgets(buf, sizeof(buf), f))
+    {
+        char* s = buf;
+        char* hash = strchr(s, '#');
+        if (hash)
+            *hash = 0;
+        while (isspace((unsigned char)*s))
+            s++;
+        for (char* e = s + strlen(s); e > s && isspace((unsigned char)e[-1]); )
+            *--e = 0;
+        if (!*s)
+            continue;
+        if (t->num == TRACE_MAX_LINES)
+        {
+            fprintf(stderr, "%s: more than %d lines\n", path, TRACE_MAX_LINES);
+            exit(2);
+        }
+        t->lines[t->num++] = strdup(s);
+    }
+    fclose(f);
+}
+
+static int parse_list(const char* arg, int* out, int max)
+{
+    int n = 0;
+    char* copy = strdup(arg);
+    for (char* tok = strtok(copy, ","); tok && n < max; tok = strtok(NULL, ","))
+        out[n++] = atoi(tok);
+    free(copy);
+    return n;
+}
+
+int main(int argc, char** argv)
+{
+    int caches[16] = {0, 2, 4, 8, 16}, cache_num = 5;
+    spiffs_mount_opt_t gcs[8] = {{.gc = SPIFFS_MOUNT_GC_NONE}, {.gc = SPIFFS_MOUNT_GC_QUICK}};
+    int gc_num = 2, fds_num = 8;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (arg + 1 >= argc)
+            break;
+        if (strcmp(argv[arg], "-c") == 0)
+            cache_num = parse_list(argv[arg + 1], caches, 16);
+        else if (strcmp(argv[arg], "-f") == 0)
+            fds_num = atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-g") == 0)
+        {
+            char* copy = strdup(argv[arg + 1]);
+            gc_num = 0;
+            for (char* tok = strtok(copy, ","); tok && gc_num < 8; tok = strtok(NULL, ","))
+            {
+                spiffs_mount_opt_t* g = &gcs[gc_num++];
+                memset(g, 0, sizeof(*g));
+                if (strcmp(tok, "quick") == 0)
+                    g->gc = SPIFFS_MOUNT_GC_QUICK;
+                else if (strncmp(tok, "free:", 5) == 0)
+                {
+                    g->gc = SPIFFS_MOUNT_GC_FREE;
+                    g->gc_size = strtoul(tok + 5, NULL, 0);
+                }
+            }
+            free(copy);
+        }
+    }
+    if (arg >= argc)
+    {
+        fprintf(stderr, "usage: %s [-c cache_pages,...] [-g none|quick|free:<bytes>,...] [-f fds] trace...\n", argv[0]);
+        return 2;
+    }
+    if (fds_num < 1 || fds_num > SPIFFS_MOUNT_FDS_MAX)
+    {
+        fprintf(stderr, "fds 1~%d\n", SPIFFS_MOUNT_FDS_MAX);
+        return 2;
+    }
+    printf("flash %uK, block %uK, page %u, times are flash busy time in ms, op count x avg/max\n",
+           CONFIG_SPIFFS_SIZE / 1024, CONFIG_SPIFFS_LOGICAL_BLOCK_SIZE / 1024, CONFIG_SPIFFS_LOGICAL_PAGE_SIZE);
+    for (; arg < argc; arg++)
+    {
+        trace_t t;
+        trace_load(&t, argv[arg]);
+        for (int g = 0; g < gc_num; g++)
+        {
+            for (int c = 0; c < cache_num; c++)
+            {
+                char phase[32] = "", setting[32];
+                const char* gc_name = gcs[g].gc == SPIFFS_MOUNT_GC_QUICK ? "quick" :
+                                      gcs[g].gc == SPIFFS_MOUNT_GC_FREE ? "free" : "none";
+                if (caches[c] < 0 || caches[c] > SPIFFS_MOUNT_CACHE_PAGES_MAX)
+                {
+                    fprintf(stderr, "cache_pages 0~%d\n", SPIFFS_MOUNT_CACHE_PAGES_MAX);
+                    return 2;
+                }
+                opt = gcs[g];
+                opt.cache_pages = caches[c];
+                opt.fds = fds_num;
+                snprintf(setting, sizeof(setting), "cache %d gc %s", caches[c], gc_name);
+                memset(fds, 0, sizeof(fds));
+                bench_format();
+                nor_flash_reset_stats();
+                phase_begin();
+                run_lines(&t, 0, t.num, phase, setting);
+                phase_end(&t, phase, setting);
+                close_all();
+                SPIFFS_unmount(&fs);
+            }
+        }
+        for (int i = 0; i < t.num; i++)
+            free(t.lines[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+// w5500.c register access over the wiz_spi.c framing, against the register
+// model in mock/w5500_spi.h: register and socket buffer round trips, pointer
+// wrap, the 16-bit pointer registers, and how many frames and bus calls each
+// access takes through the FIFO and the DMA paths.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "w5500_spi.h"
+#include "wizchip_conf.h"
+#include "w5500/w5500.h"
+
+static uint8_t data[W5500_BUF_MAX];
+
+static void setup(bool dma)
+{
+    w5500_init();
+    w5500.dma = dma;
+    reg_wizchip_cs_cbfunc(wiz_cs_select, wiz_cs_deselect);
+    reg_wizchip_spi_cbfunc(wiz_spi_read, wiz_spi_write);
+    reg_wizchip_spiburst_cbfunc(wiz_spi_read_burst, wiz_spi_write_burst);
+}
+
+// frames and bus calls taken by what runs between two marks
+static uint32_t frames0, calls0;
+
+static void mark(void)
+{
+    frames0 = w5500.frames;
+    calls0 = w5500.calls;
+}
+
+static void taken(uint32_t frames, uint32_t calls)
+{
+    if (w5500.frames - frames0 != frames || w5500.calls - calls0 != calls)
+    {
+        fprintf(stderr, "%u frames in %u calls, expected %u in %u\n",
+                w5500.frames - frames0, w5500.calls - calls0, frames, calls);
+        abort();
+    }
+    mark();
+}
+
+static void test_registers(void)
+{
+    uint8_t mac[6] = {0x02, 0x00, 0x5e, 0x10, 0x20, 0x30}, back[6];
+    uint8_t tx[8] = {4, 4, 2, 2, 1, 1, 1, 1}, rx[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+    setup(false);
+    mark();
+    assert(getVERSIONR() == 0x04);
+    taken(1, 1);
+    setSHAR(mac);
+    getSHAR(back);
+    taken(2, 2);
+    assert(memcmp(mac, back, 6) == 0 && memcmp(w5500.common + 0x09, mac, 6) == 0);
+
+    assert(wizchip_init(tx, rx) == 0);
+    for (int sn = 0; sn < 8; sn++)
+        assert(w5500.sreg[sn][W5500_Sn_TXBUF_SIZE] == tx[sn] && w5500.sreg[sn][W5500_Sn_RXBUF_SIZE] == rx[sn]);
+
+    // the pointer registers go in one frame each way
+    mark();
+    setSn_TX_WR(1, 0x1234);
+    taken(1, 1);
+    assert(getSn_TX_WR(1) == 0x1234 && w5500_get16(w5500.sreg[1] + W5500_Sn_TX_WR) == 0x1234);
+    setSn_RX_RD(2, 0xfedc);
+    assert(getSn_RX_RD(2) == 0xfedc);
+    taken(3, 3);
+    // free space follows TX_WR, 4k buffer with 0x1234 - 0 in it
+    assert(getSn_TX_FSR(1) == (uint16_t)(4096 - 0x1234));
+    taken(2, 2);
+    assert(w5500.bad_frames == 0);
+    printf("registers: ok\n");
+}
+
+// sizes around the FIFO limit and the DMA chunk, the pointer starts near the 16-bit wrap
+static void test_send(bool dma)
+{
+    static const uint16_t lens[] = {1, 31, 32, 33, 1024, 1025, 1500, 2048};
+    uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+    setup(dma);
+    assert(wizchip_init(sizes, sizes) == 0);
+    w5500_set16(w5500.sreg[0] + W5500_Sn_TX_RD, 0xfff0);
+    setSn_TX_WR(0, 0xfff0);
+    for (uint32_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)(i * 13 + (i >> 7));
+
+    uint32_t total = 0;
+    for (unsigned k = 0; k < sizeof(lens) / sizeof(lens[0]); k++)
+    {
+        uint16_t len = lens[k];
+        assert(getSn_TX_FSR(0) == 2048);
+        mark();
+        wiz_send_data(0, data + total, len);
+        // TX_WR read, the data, TX_WR write; the data frame is one call through
+        // the FIFO up to 32 bytes, one call per 1k chunk with DMA, else header + data
+        uint32_t data_calls = len <= WIZ_SPI_FIFO_MAX ? 1 :
+                              dma ? (len + WIZ_SPI_DMA_CHUNK - 1) / WIZ_SPI_DMA_CHUNK : 2;
+        taken(3, 2 + data_calls);
+        setSn_CR(0, Sn_CR_SEND);
+        total += len;
+        assert(w5500.sent_len[0] == total);
+    }
+    assert(memcmp(w5500.sent[0], data, total) == 0);
+    assert(getSn_TX_WR(0) == (uint16_t)(0xfff0 + total));
+    assert(w5500.bad_frames == 0);
+    printf("send %s: %u bytes, %u frames in %u calls, %u by DMA\n", dma ? "dma " : "fifo",
+           total, w5500.frames, w5500.calls, w5500.dma_calls);
+}
+
+static void test_recv(bool dma)
+{
+    static uint8_t buf[2048];
+    static const uint16_t lens[] = {1, 32, 33, 700, 1025, 2048};
+    uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+    setup(dma);
+    assert(wizchip_init(sizes, sizes) == 0);
+    w5500_set16(w5500.sreg[0] + W5500_Sn_RX_WR, 0xff00);
+    setSn_RX_RD(0, 0xff00);
+    uint32_t total = 0;
+    for (unsigned k = 0; k < sizeof(lens) / sizeof(lens[0]); k++)
+    {
+        uint16_t len = lens[k];
+        w5500_rx_push(0, data + total, len);
+        assert(getSn_RX_RSR(0) == len);
+        mark();
+        wiz_recv_data(0, buf, len);
+        uint32_t data_calls = len <= WIZ_SPI_FIFO_MAX ? 1 :
+                              dma ? (len + WIZ_SPI_DMA_CHUNK - 1) / WIZ_SPI_DMA_CHUNK : 2;
+        taken(3, 2 + data_calls);
+        assert(memcmp(buf, data + total, len) == 0);
+        assert(getSn_RX_RSR(0) == 0);
+        total += len;
+    }
+    assert(w5500.bad_frames == 0);
+    printf("recv %s: %u bytes, %u by DMA\n", dma ? "dma " : "fifo", total, w5500.dma_calls);
+}
+
+// bytes arriving between samples: RX_RSR is read until two samples agree
+static void test_rsr_moving(void)
+{
+    setup(false);
+    w5500_rx_push(0, data, 10);
+    w5500.drip = 5;
+    mark();
+    uint16_t n = getSn_RX_RSR(0);
+    assert(n == 15 && w5500.drip == 0);
+    // a new byte after each of the first five samples, then one round that agrees
+    taken(8, 8);
+    printf("RX_RSR while data arrives: ok\n");
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    test_registers();
+    test_send(false);
+    test_send(true);
+    test_recv(false);
+    test_recv(true);
+    test_rsr_moving();
+    printf("w5500_spi: ok\n");
+    return 0;
+}
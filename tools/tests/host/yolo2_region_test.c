@@ -0,0 +1,371 @@
+// yolo2_region_layer.c against the dense decode it replaced: every box and
+// class activated, per class qsort and nms, then the best class of each box.
+// The candidate/heap decode must report the same boxes on the float tensor, and
+// yolo_region_layer_run_quant the same ones on the uint8 tensor the float one
+// was dequantized from, up to the rounding of its lookup tables.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+#include "yolo2_region_layer.h"
+
+#define LAYER_W     10
+#define LAYER_H     8
+#define ANCHORS     5
+#define CLASSES_MAX 20
+#define RECTS_MAX   (LAYER_W * LAYER_H * ANCHORS)
+
+static float anchor[ANCHORS * 2] = {1.08, 1.19, 3.42, 4.41, 6.63, 11.38, 9.42, 5.11, 16.62, 10.52};
+
+//---------------- the dense decode, as it was before the candidate list ----------------
+
+typedef struct
+{
+    float x, y, w, h;
+} ref_box_t;
+
+typedef struct
+{
+    int index;
+    int class;
+    float** probs;
+} ref_sortable_t;
+
+typedef struct
+{
+    yolo2_region_layer_t* rl;
+    float* output;
+    ref_box_t* boxes;
+    float* probs_buf;
+    float** probs;
+} ref_t;
+
+static int ref_entry(yolo2_region_layer_t* rl, int location, int entry)
+{
+    int wh = rl->layer_width * rl->layer_height;
+    return location / wh * wh * (rl->coords + rl->classes + 1) + entry * wh + location % wh;
+}
+
+static void ref_forward(ref_t* r)
+{
+    yolo2_region_layer_t* rl = r->rl;
+    int wh = rl->layer_width * rl->layer_height;
+
+    memcpy(r->output, rl->input, rl->output_number * sizeof(float));
+    for (int n = 0; n < rl->anchor_number; ++n)
+    {
+        int index = ref_entry(rl, n * wh, 0);
+        for (int i = 0; i < 2 * wh; i++)
+            r->output[index + i] = sigmoid(rl->input[index + i]);
+        index = ref_entry(rl, n * wh, 4);
+        for (int i = 0; i < wh; i++)
+            r->output[index + i] = sigmoid(rl->input[index + i]);
+        // softmax over the classes of every cell
+        index = ref_entry(rl, n * wh, rl->coords + 1);
+        for (int g = 0; rl->classes && g < wh; g++)
+        {
+            float* in = rl->input + index + g;
+            float* out = r->output + index + g;
+            float largest = in[0], sum = 0;
+            for (int c = 0; c < rl->classes; c++)
+                if (in[c * wh] > largest)
+                    largest = in[c * wh];
+            for (int c = 0; c < rl->classes; c++)
+            {
+                out[c * wh] = expf(in[c * wh] - largest);
+                sum += out[c * wh];
+            }
+            for (int c = 0; c < rl->classes; c++)
+                out[c * wh] /= sum;
+        }
+    }
+}
+
+static void ref_boxes(ref_t* r)
+{
+    yolo2_region_layer_t* rl = r->rl;
+    int lw = rl->layer_width, lh = rl->layer_height, wh = lw * lh;
+    int classes = rl->classes ? rl->classes : 1;
+    float* p = r->output;
+    int new_w, new_h;
+
+    if ((float)rl->net_width / rl->image_width < (float)rl->net_height / rl->image_height)
+    {
+        new_w = rl->net_width;
+        new_h = (rl->image_height * rl->net_width) / rl->image_width;
+    }
+    else
+    {
+        new_h = rl->net_height;
+        new_w = (rl->image_width * rl->net_height) / rl->image_height;
+    }
+    for (int i = 0; i < wh; ++i)
+    {
+        for (int n = 0; n < rl->anchor_number; ++n)
+        {
+            int index = n * wh + i;
+            int box = ref_entry(rl, index, 0);
+            float scale = p[ref_entry(rl, index, rl->coords)];
+            ref_box_t b;
+
+            b.x = (i % lw + p[box]) / lw;
+            b.y = (i / lw + p[box + wh]) / lh;
+            b.w = expf(p[box + 2 * wh]) * rl->anchor[2 * n] / lw;
+            b.h = expf(p[box + 3 * wh]) * rl->anchor[2 * n + 1] / lh;
+            b.x = (b.x - (rl->net_width - new_w) / 2. / rl->net_width) / ((float)new_w / rl->net_width);
+            b.y = (b.y - (rl->net_height - new_h) / 2. / rl->net_height) / ((float)new_h / rl->net_height);
+            b.w *= (float)rl->net_width / new_w;
+            b.h *= (float)rl->net_height / new_h;
+            r->boxes[index] = b;
+            for (int j = 0; j < classes; ++j)
+            {
+                float prob = rl->classes ? scale * p[ref_entry(rl, index, rl->coords + 1 + j)] : scale;
+                r->probs[index][j] = prob > rl->threshold ? prob : 0;
+            }
+        }
+    }
+}
+
+static int ref_class;
+
+static int ref_compare(const void* pa, const void* pb)
+{
+    const ref_sortable_t* a = pa;
+    const ref_sortable_t* b = pb;
+    float diff = a->probs[a->index][ref_class] - b->probs[b->index][ref_class];
+    return diff < 0 ? 1 : diff > 0 ? -1 : 0;
+}
+
+static float ref_overlap(float x1, float w1, float x2, float w2)
+{
+    float left = fmaxf(x1 - w1 / 2, x2 - w2 / 2);
+    float right = fminf(x1 + w1 / 2, x2 + w2 / 2);
+    return right - left;
+}
+
+static float ref_iou(ref_box_t a, ref_box_t b)
+{
+    float w = ref_overlap(a.x, a.w, b.x, b.w);
+    float h = ref_overlap(a.y, a.h, b.y, b.h);
+    float i = (w < 0 || h < 0) ? 0 : w * h;
+    return i / (a.w * a.h + b.w * b.h - i);
+}
+
+static void ref_nms(ref_t* r)
+{
+    yolo2_region_layer_t* rl = r->rl;
+    int boxes = rl->boxes_number;
+    int classes = rl->classes ? rl->classes : 1;
+    ref_sortable_t* s = malloc(boxes * sizeof(ref_sortable_t));
+
+    for (int k = 0; k < classes; ++k)
+    {
+        for (int i = 0; i < boxes; ++i)
+        {
+            s[i].index = i;
+            s[i].class = k;
+            s[i].probs = r->probs;
+        }
+        ref_class = k;
+        qsort(s, boxes, sizeof(ref_sortable_t), ref_compare);
+        for (int i = 0; i < boxes; ++i)
+        {
+            if (r->probs[s[i].index][k] == 0)
+                continue;
+            for (int j = i + 1; j < boxes; ++j)
+            {
+                if (ref_iou(r->boxes[s[i].index], r->boxes[s[j].index]) > rl->nms_value)
+                    r->probs[s[j].index][k] = 0;
+            }
+        }
+    }
+    free(s);
+}
+
+static int ref_run(ref_t* r, yolo2_rect_t* rects)
+{
+    yolo2_region_layer_t* rl = r->rl;
+    int classes = rl->classes ? rl->classes : 1;
+    int num = 0;
+
+    ref_forward(r);
+    ref_boxes(r);
+    ref_nms(r);
+    for (int i = 0; i < rl->boxes_number; ++i)
+    {
+        int class = 0;
+        for (int j = 1; j < classes; j++)
+            if (r->probs[i][j] > r->probs[i][class])
+                class = j;
+        float prob = r->probs[i][class];
+        if (!(prob > rl->threshold))
+            continue;
+        ref_box_t* b = r->boxes + i;
+        uint32_t x1 = b->x * rl->image_width - (b->w * rl->image_width / 2);
+        uint32_t y1 = b->y * rl->image_height - (b->h * rl->image_height / 2);
+        uint32_t x2 = b->x * rl->image_width + (b->w * rl->image_width / 2);
+        uint32_t y2 = b->y * rl->image_height + (b->h * rl->image_height / 2);
+        rects[num++] = (yolo2_rect_t){x1, y1, x2 - x1, y2 - y1, class, prob};
+    }
+    return num;
+}
+
+static void ref_init(ref_t* r, yolo2_region_layer_t* rl)
+{
+    int classes = rl->classes ? rl->classes : 1;
+    r->rl = rl;
+    r->output = malloc(rl->output_number * sizeof(float));
+    r->boxes = malloc(rl->boxes_number * sizeof(ref_box_t));
+    r->probs_buf = malloc(rl->boxes_number * classes * sizeof(float));
+    r->probs = malloc(rl->boxes_number * sizeof(float*));
+    for (int i = 0; i < rl->boxes_number; i++)
+        r->probs[i] = r->probs_buf + i * classes;
+}
+
+static void ref_deinit(ref_t* r)
+{
+    free(r->output);
+    free(r->boxes);
+    free(r->probs_buf);
+    free(r->probs);
+}
+
+//---------------- tensors ----------------
+
+static uint32_t seed;
+
+static float uniform(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) / 16777216.f;
+}
+
+// a KPU-like output: a few cells sure of an object next to each other, so nms
+// has overlapping boxes of the same class to remove, the rest well below threshold
+static void make_tensor(uint8_t* q, int classes)
+{
+    int wh = LAYER_W * LAYER_H, stride = classes + 5;
+    for (int n = 0; n < ANCHORS; n++)
+    {
+        uint8_t* t = q + n * wh * stride;
+        for (int i = 0; i < wh; i++)
+        {
+            for (int c = 0; c < 4; c++)
+                t[c * wh + i] = 96 + uniform() * 64;
+            t[4 * wh + i] = uniform() < 0.15f ? 150 + uniform() * 100 : uniform() * 110;
+            for (int c = 0; c < classes; c++)
+                t[(5 + c) * wh + i] = uniform() * 255;
+        }
+    }
+}
+
+static void setup(yolo2_region_layer_t* rl, int classes, float threshold)
+{
+    memset(rl, 0, sizeof(*rl));
+    rl->threshold = threshold;
+    rl->nms_value = 0.3f;
+    rl->anchor_number = ANCHORS;
+    rl->anchor = anchor;
+    rl->classes = classes;
+    rl->image_width = 320;
+    rl->image_height = 240;
+    assert(yolo_region_layer_init(rl, LAYER_W, LAYER_H, (classes + 5) * ANCHORS, 320, 256) == 0);
+}
+
+//---------------- comparisons ----------------
+
+static int rect_diff(const yolo2_rect_t* a, const yolo2_rect_t* b, int px, float prob)
+{
+    return a->class_id != b->class_id || fabsf(a->prob - b->prob) > prob ||
+           abs((int)a->x - (int)b->x) > px || abs((int)a->y - (int)b->y) > px ||
+           abs((int)a->w - (int)b->w) > px || abs((int)a->h - (int)b->h) > px;
+}
+
+static void same_rects(const char* what, const yolo2_rect_t* a, int na, const yolo2_rect_t* b, int nb, int px, float prob)
+{
+    int bad = na != nb;
+    for (int i = 0; !bad && i < na; i++)
+        bad = rect_diff(a + i, b + i, px, prob);
+    if (!bad)
+        return;
+    fprintf(stderr, "%s: %d rects against %d\n", what, na, nb);
+    for (int i = 0; i < na || i < nb; i++)
+    {
+        if (i < na)
+            fprintf(stderr, "  %3u %3u %3u %3u c%-2u %.6f", a[i].x, a[i].y, a[i].w, a[i].h, a[i].class_id, a[i].prob);
+        else
+            fprintf(stderr, "  %30s", "");
+        if (i < nb)
+            fprintf(stderr, " | %3u %3u %3u %3u c%-2u %.6f", b[i].x, b[i].y, b[i].w, b[i].h, b[i].class_id, b[i].prob);
+        fprintf(stderr, "\n");
+    }
+    abort();
+}
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void test_decoders(int classes, float threshold)
+{
+    static uint8_t q[RECTS_MAX * (CLASSES_MAX + 5)];
+    static float input[RECTS_MAX * (CLASSES_MAX + 5)];
+    static yolo2_rect_t ref[RECTS_MAX], cand[RECTS_MAX], quant[RECTS_MAX];
+    const kpu_model_quant_param_t qp = {0.0625f, -8.f};
+    yolo2_region_layer_t rl;
+    ref_t r;
+    int rects = 0, suppressed = 0;
+    double t_ref = 0, t_cand = 0, t_quant = 0;
+
+    setup(&rl, classes, threshold);
+    ref_init(&r, &rl);
+    rl.input = input;
+    for (int k = 0; k < 50; k++)
+    {
+        seed = 1000 * classes + k;
+        make_tensor(q, classes);
+        for (uint32_t i = 0; i < rl.output_number; i++)
+            input[i] = q[i] * qp.scale + qp.bias;
+
+        double t0 = now_ms();
+        int nr = ref_run(&r, ref);
+        double t1 = now_ms();
+        yolo_region_layer_run(&rl);
+        int nc = yolo_region_layer_get_rects(&rl, cand, RECTS_MAX);
+        double t2 = now_ms();
+        yolo_region_layer_run_quant(&rl, q, &qp);
+        int nq = yolo_region_layer_get_rects(&rl, quant, RECTS_MAX);
+        double t3 = now_ms();
+        t_ref += t1 - t0;
+        t_cand += t2 - t1;
+        t_quant += t3 - t2;
+
+        // the candidate list must not have dropped anything, else the cap decides
+        assert(rl.candidate_number < rl.candidate_max);
+        same_rects("candidates vs dense", cand, nc, ref, nr, 0, 1e-6f);
+        same_rects("quant vs float", quant, nq, cand, nc, 1, 1e-4f);
+        rects += nr;
+        suppressed += rl.candidate_number - nr;
+    }
+    assert(rects > 0 && suppressed > 0);
+    printf("%2d classes, threshold %.1f: %3d boxes, %4d pairs removed; dense %.2f ms, candidates %.2f ms, quant %.2f ms\n",
+           classes, threshold, rects, suppressed, t_ref, t_cand, t_quant);
+    ref_deinit(&r);
+    yolo_region_layer_deinit(&rl);
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    test_decoders(0, 0.5f);
+    test_decoders(1, 0.5f);
+    test_decoders(20, 0.3f);
+    test_decoders(20, 0.5f);
+    printf("yolo2_region: ok\n");
+    return 0;
+}